@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+
+/**
+ * Remembers which notes are sounding on each of 16 channels and where their note-offs are due,
+ * so note-offs can be sent for exactly the notes that need them instead of broadcast CC123s.
+ * Channels are zero based here. Sample positions are whatever clock the owner schedules with.
+ * Not thread safe: the audio thread owns it.
+ */
+class ActiveNoteTable
+{
+public:
+    static constexpr std::size_t kChannelCount = 16;
+    static constexpr std::size_t kNoteCount = 128;
+
+    /** Marks a note as sounding until offSample. Returns false if the channel or note is out of range. */
+    bool noteOn(std::size_t channel, int note, int offSample) noexcept
+    {
+        if (!inRange(channel, note))
+            return false;
+        active[channel].set(static_cast<std::size_t>(note));
+        offSamples[channel][static_cast<std::size_t>(note)] = offSample;
+        return true;
+    }
+
+    /** Forgets a note, e.g. once its note-off has been sent. */
+    void noteOff(std::size_t channel, int note) noexcept
+    {
+        if (inRange(channel, note))
+            active[channel].reset(static_cast<std::size_t>(note));
+    }
+
+    bool isActive(std::size_t channel, int note) const noexcept
+    {
+        return inRange(channel, note) && active[channel].test(static_cast<std::size_t>(note));
+    }
+
+    /** Where the pending note-off of an active note is due. Only meaningful if isActive. */
+    int getOffSample(std::size_t channel, int note) const noexcept
+    {
+        return inRange(channel, note) ? offSamples[channel][static_cast<std::size_t>(note)] : 0;
+    }
+
+    bool anyActive(std::size_t channel) const noexcept
+    {
+        return channel < kChannelCount && active[channel].any();
+    }
+
+    bool anyActive() const noexcept
+    {
+        for (const auto& notes : active)
+            if (notes.any())
+                return true;
+        return false;
+    }
+
+    /** Calls emit(channel, note, offSample) for every note whose isDue(offSample) holds and forgets it. */
+    template <typename IsDue, typename Emit>
+    void releaseDue(IsDue&& isDue, Emit&& emit)
+    {
+        for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+        {
+            if (active[channel].none())
+                continue;
+            for (std::size_t note = 0; note < kNoteCount; ++note)
+            {
+                if (!active[channel].test(note) || !isDue(offSamples[channel][note]))
+                    continue;
+                active[channel].reset(note);
+                emit(channel, static_cast<int>(note), offSamples[channel][note]);
+            }
+        }
+    }
+
+    /** Calls emit(channel, note, offSample) for every active note on the channel and forgets them. */
+    template <typename Emit>
+    void releaseChannel(std::size_t channel, Emit&& emit)
+    {
+        if (channel >= kChannelCount)
+            return;
+        for (std::size_t note = 0; note < kNoteCount && active[channel].any(); ++note)
+        {
+            if (!active[channel].test(note))
+                continue;
+            active[channel].reset(note);
+            emit(channel, static_cast<int>(note), offSamples[channel][note]);
+        }
+    }
+
+    /** Calls emit(channel, note, offSample) for every active note and forgets them all. */
+    template <typename Emit>
+    void releaseAll(Emit&& emit)
+    {
+        for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+            releaseChannel(channel, emit);
+    }
+
+    void clear() noexcept
+    {
+        for (auto& notes : active)
+            notes.reset();
+    }
+
+private:
+    static bool inRange(std::size_t channel, int note) noexcept
+    {
+        return channel < kChannelCount && note >= 0 && note < static_cast<int>(kNoteCount);
+    }
+
+    std::array<std::bitset<kNoteCount>, kChannelCount> active{};
+    std::array<std::array<int, kNoteCount>, kChannelCount> offSamples{};
+};
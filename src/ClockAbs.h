@@ -3,20 +3,49 @@
 #include <JuceHeader.h>
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <vector>
 
+/** One engine tick as the clock hands it to listeners. */
+struct ClockTick
+{
+    /** The bar position in quarter-beats, from 1 to 16. */
+    int quarterBeat = 0;
+    /** 0 on a grid tick, then counting the engine ticks until the next one. */
+    int engineTickInGridTick = 0;
+    /** How many engine ticks make up one grid tick at the current resolution. */
+    int ticksPerGridTick = 1;
+
+    bool isGridTick() const noexcept { return engineTickInGridTick == 0; }
+};
+
 class ClockListener
 {
 public:
     virtual ~ClockListener() = default;
-    virtual void tick(int quarterBeat) = 0;
+    /** Called on every engine tick, grid ticks included. */
+    virtual void tick(const ClockTick& clockTick) = 0;
     virtual void reset() = 0;
+    /** Jumps to where the sent number of engine ticks after a reset would leave the listener.
+        Listeners that cannot seek just reset. */
+    virtual void seek(std::uint64_t engineTicksSinceReset, int ticksPerGridTick)
+    {
+        juce::ignoreUnused(engineTicksSinceReset, ticksPerGridTick);
+        reset();
+    }
 };
 
 // Abstract transport clock interface used by the tracker and clocked machines.
 class ClockAbs
 {
 public:
+    /** Song rows and quarter-beats move in grid ticks, 8 to the quarter note, and step lengths, arp rates and
+        delay sync are set in them. The engine can tick faster than this; grid ticks then land on every
+        getTicksPerGridTick()th engine tick. Sequences, arps and note lengths run on engine ticks, so at a
+        finer resolution a step can be a fraction of a grid tick long and start between grid ticks. */
+    static constexpr int kGridTicksPerQuarter = 8;
+
     /** Sets the clock tempo in beats per minute. */
     virtual void setBPM(double bpm) = 0;
     /** Returns the current tempo in beats per minute. */
@@ -44,26 +73,69 @@ public:
         listeners.clear();
     }
 
-    /** Returns the absolute transport tick count. */
-    long getCurrentTick() const noexcept { return currentTick; }
+    /** Returns the absolute transport tick count in grid ticks. 64-bit so long sessions never wrap. */
+    std::int64_t getCurrentTick() const noexcept { return currentTick; }
     /** Returns the current bar position in quarter-beats, from 1 to 16. */
     int getCurrentQuarterBeat() const noexcept { return currentQuarterBeat; }
 
+    /** Returns the engine resolution in ticks per quarter note. */
+    int getTicksPerQuarter() const noexcept { return ticksPerQuarter; }
+    /** Returns how many engine ticks make up one grid tick. */
+    int getTicksPerGridTick() const noexcept { return ticksPerQuarter / kGridTicksPerQuarter; }
+    /** True for the resolutions the engine supports: 8, 24, 48 or 96 ticks per quarter. */
+    static bool isSupportedTicksPerQuarter(int ppq) noexcept
+    {
+        return ppq == 8 || ppq == 24 || ppq == 48 || ppq == 96;
+    }
+    /** Converts a note length in grid ticks, which may be fractional, to whole engine ticks.
+        Any length above zero lasts at least one engine tick. */
+    unsigned short gridToEngineTicks(double gridTicks) const noexcept
+    {
+        if (!(gridTicks > 0.0))
+            return 0;
+        const double engineTicks = std::round(gridTicks * static_cast<double>(getTicksPerGridTick()));
+        return static_cast<unsigned short>(std::clamp(engineTicks, 1.0, 65535.0));
+    }
+    /** Converts a length in engine ticks to the nearest whole grid tick. Non-zero lengths keep at least one. */
+    unsigned short engineToGridTicks(unsigned short engineTicks) const noexcept
+    {
+        if (engineTicks == 0)
+            return 0;
+        const int perGridTick = getTicksPerGridTick();
+        return static_cast<unsigned short>(std::max(1, (static_cast<int>(engineTicks) + perGridTick / 2) / perGridTick));
+    }
+
 protected:
-    /** Advances the absolute transport tick by one engine tick. */
+    /** Advances the absolute transport tick by one grid tick. Called on grid ticks only. */
     void advanceClockTick() noexcept { ++currentTick; }
     /** Resets the absolute transport tick counter. */
     void resetClockTicks() noexcept { currentTick = 0; }
+    /** Places the absolute transport tick counter, e.g. after a seek. */
+    void setClockTicks(std::int64_t tick) noexcept { currentTick = tick; }
+    /** Sets the engine resolution. Returns false and changes nothing for unsupported values. */
+    bool setTicksPerQuarter(int ppq) noexcept
+    {
+        if (!isSupportedTicksPerQuarter(ppq))
+            return false;
+        ticksPerQuarter = ppq;
+        return true;
+    }
     /** Sets the current published quarter-beat. */
     void setCurrentQuarterBeat(int quarterBeat) noexcept { currentQuarterBeat = quarterBeat; }
-    /** Broadcasts a quarter-beat tick to listeners. */
+    /** Broadcasts a grid tick, publishing its quarter-beat, to listeners. */
     void notifyClockTick(int quarterBeat)
     {
         setCurrentQuarterBeat(quarterBeat);
+        notifyClockEngineTick(0);
+    }
+    /** Broadcasts an engine tick to listeners. engineTickInGridTick is 0 on grid ticks. */
+    void notifyClockEngineTick(int engineTickInGridTick)
+    {
+        const ClockTick clockTick { currentQuarterBeat, engineTickInGridTick, getTicksPerGridTick() };
         const juce::ScopedLock lock(listenerLock);
         for (auto* listener : listeners)
             if (listener != nullptr)
-                listener->tick(quarterBeat);
+                listener->tick(clockTick);
     }
     /** Broadcasts a clock reset to listeners. */
     void notifyClockReset()
@@ -73,10 +145,20 @@ protected:
             if (listener != nullptr)
                 listener->reset();
     }
+    /** Broadcasts a transport seek, in engine ticks since the last reset, to listeners. */
+    void notifyClockSeek(std::uint64_t engineTicksSinceReset)
+    {
+        const int perGridTick = getTicksPerGridTick();
+        const juce::ScopedLock lock(listenerLock);
+        for (auto* listener : listeners)
+            if (listener != nullptr)
+                listener->seek(engineTicksSinceReset, perGridTick);
+    }
 
 private:
-    long currentTick = 0;
+    std::int64_t currentTick = 0;
     int currentQuarterBeat = 0;
+    int ticksPerQuarter = kGridTicksPerQuarter;
     juce::CriticalSection listenerLock;
     std::vector<ClockListener*> listeners;
 };
@@ -0,0 +1,307 @@
+#include "EditJournal.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+constexpr std::size_t kFrameBytes = sizeof(std::uint32_t);
+
+bool hasBeforeAndAfter(EditDelta::Kind kind)
+{
+    switch (kind)
+    {
+        case EditDelta::Kind::cell:
+        case EditDelta::Kind::stepActive:
+        case EditDelta::Kind::sequenceLength:
+        case EditDelta::Kind::sequenceSetting:
+        case EditDelta::Kind::stackGain:
+        case EditDelta::Kind::slotEnabled:
+        case EditDelta::Kind::songRowSet:
+        case EditDelta::Kind::songRowBeats:
+        case EditDelta::Kind::songRowTrackPattern:
+        case EditDelta::Kind::sequenceMute:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool hasValues(EditDelta::Kind kind)
+{
+    return kind == EditDelta::Kind::rowInsert
+        || kind == EditDelta::Kind::rowRemove
+        || kind == EditDelta::Kind::stepRows;
+}
+
+void putVarint(std::vector<std::uint8_t>& out, std::uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+void putDouble(std::vector<std::uint8_t>& out, double value)
+{
+    std::uint8_t bytes[sizeof(double)];
+    std::memcpy(bytes, &value, sizeof(double));
+    out.insert(out.end(), bytes, bytes + sizeof(double));
+}
+
+/** reads back what putVarint and putDouble wrote, failing rather than running off the end */
+struct Unpacker
+{
+    const std::vector<std::uint8_t>& bytes;
+    std::size_t position = 0;
+
+    bool varint(std::uint64_t& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (position >= bytes.size())
+                return false;
+            const auto byte = bytes[position++];
+            value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    bool varint32(std::uint32_t& value)
+    {
+        std::uint64_t wide = 0;
+        if (!varint(wide) || wide > 0xffffffffull)
+            return false;
+        value = static_cast<std::uint32_t>(wide);
+        return true;
+    }
+
+    bool real(double& value)
+    {
+        if (bytes.size() - position < sizeof(double))
+            return false;
+        std::memcpy(&value, bytes.data() + position, sizeof(double));
+        position += sizeof(double);
+        return true;
+    }
+
+    bool count(std::size_t& value, std::size_t bytesEach)
+    {
+        std::uint64_t wide = 0;
+        if (!varint(wide) || wide > (bytes.size() - position) / bytesEach)
+            return false;
+        value = static_cast<std::size_t>(wide);
+        return true;
+    }
+};
+}
+
+EditJournal::EditJournal(std::size_t capacityBytes) : arena(std::max<std::size_t>(capacityBytes, 64))
+{
+}
+
+bool EditJournal::record(const Action& action)
+{
+    encode(action);
+    const std::uint64_t frameSize = packed.size() + 2 * kFrameBytes;
+    if (frameSize > arena.size())
+    {
+        clear();
+        return false;
+    }
+
+    newest = cursor;
+    while (newest + frameSize - oldest > arena.size())
+        oldest += readFrameSize(oldest) + 2 * kFrameBytes;
+
+    const auto size = static_cast<std::uint32_t>(packed.size());
+    writeBytes(newest, &size, kFrameBytes);
+    writeBytes(newest + kFrameBytes, packed.data(), packed.size());
+    writeBytes(newest + kFrameBytes + size, &size, kFrameBytes);
+    newest += frameSize;
+    cursor = newest;
+    return true;
+}
+
+bool EditJournal::undo(Action& action)
+{
+    if (!canUndo())
+        return false;
+    const auto size = readFrameSize(cursor - kFrameBytes);
+    const auto start = cursor - size - 2 * kFrameBytes;
+    if (!decode(start + kFrameBytes, size, action))
+    {
+        clear();
+        return false;
+    }
+    cursor = start;
+    return true;
+}
+
+bool EditJournal::redo(Action& action)
+{
+    if (!canRedo())
+        return false;
+    const auto size = readFrameSize(cursor);
+    if (!decode(cursor + kFrameBytes, size, action))
+    {
+        clear();
+        return false;
+    }
+    cursor += size + 2 * kFrameBytes;
+    return true;
+}
+
+bool EditJournal::peekUndo(Action& action) const
+{
+    if (!canUndo())
+        return false;
+    const auto size = readFrameSize(cursor - kFrameBytes);
+    return decode(cursor - size - kFrameBytes, size, action);
+}
+
+bool EditJournal::peekRedo(Action& action) const
+{
+    if (!canRedo())
+        return false;
+    return decode(cursor + kFrameBytes, readFrameSize(cursor), action);
+}
+
+bool EditJournal::canUndo() const
+{
+    return cursor > oldest;
+}
+
+bool EditJournal::canRedo() const
+{
+    return cursor < newest;
+}
+
+void EditJournal::clear()
+{
+    oldest = 0;
+    cursor = 0;
+    newest = 0;
+}
+
+std::size_t EditJournal::getUsedBytes() const
+{
+    return static_cast<std::size_t>(newest - oldest);
+}
+
+void EditJournal::encode(const Action& action)
+{
+    packed.clear();
+    putVarint(packed, action.sequenceSet);
+    putVarint(packed, action.deltas.size());
+    for (const auto& delta : action.deltas)
+    {
+        packed.push_back(static_cast<std::uint8_t>(delta.kind));
+        putVarint(packed, delta.target);
+        putVarint(packed, delta.index);
+        putVarint(packed, delta.row);
+        putVarint(packed, delta.col);
+        if (hasBeforeAndAfter(delta.kind))
+        {
+            putDouble(packed, delta.before);
+            putDouble(packed, delta.after);
+        }
+        if (hasValues(delta.kind))
+        {
+            putVarint(packed, delta.values.size());
+            for (const double value : delta.values)
+                putDouble(packed, value);
+        }
+        if (delta.kind == EditDelta::Kind::machineState)
+        {
+            putVarint(packed, delta.path.size());
+            packed.insert(packed.end(), delta.path.begin(), delta.path.end());
+            putVarint(packed, delta.beforeBytes.size());
+            packed.insert(packed.end(), delta.beforeBytes.begin(), delta.beforeBytes.end());
+            putVarint(packed, delta.afterBytes.size());
+            packed.insert(packed.end(), delta.afterBytes.begin(), delta.afterBytes.end());
+        }
+    }
+}
+
+bool EditJournal::decode(std::uint64_t start, std::uint32_t size, Action& action) const
+{
+    std::vector<std::uint8_t> bytes(size);
+    readBytes(start, bytes.data(), size);
+    Unpacker in{bytes};
+
+    std::uint64_t sequenceSet = 0;
+    std::size_t deltaCount = 0;
+    if (!in.varint(sequenceSet) || !in.count(deltaCount, 5))
+        return false;
+    action.sequenceSet = static_cast<std::size_t>(sequenceSet);
+    action.deltas.assign(deltaCount, EditDelta{});
+    for (auto& delta : action.deltas)
+    {
+        if (in.position >= bytes.size() || bytes[in.position] > static_cast<std::uint8_t>(EditDelta::Kind::sequenceMute))
+            return false;
+        delta.kind = static_cast<EditDelta::Kind>(bytes[in.position++]);
+        if (!in.varint32(delta.target) || !in.varint32(delta.index) || !in.varint32(delta.row) || !in.varint32(delta.col))
+            return false;
+        if (hasBeforeAndAfter(delta.kind) && (!in.real(delta.before) || !in.real(delta.after)))
+            return false;
+        if (hasValues(delta.kind))
+        {
+            std::size_t valueCount = 0;
+            if (!in.count(valueCount, sizeof(double)))
+                return false;
+            delta.values.resize(valueCount);
+            for (auto& value : delta.values)
+                in.real(value);
+        }
+        if (delta.kind == EditDelta::Kind::machineState)
+        {
+            std::size_t pathLength = 0;
+            if (!in.count(pathLength, 1))
+                return false;
+            delta.path.assign(bytes.begin() + static_cast<std::ptrdiff_t>(in.position),
+                              bytes.begin() + static_cast<std::ptrdiff_t>(in.position + pathLength));
+            in.position += pathLength;
+            for (auto* side : {&delta.beforeBytes, &delta.afterBytes})
+            {
+                std::size_t byteCount = 0;
+                if (!in.count(byteCount, 1))
+                    return false;
+                side->assign(bytes.begin() + static_cast<std::ptrdiff_t>(in.position),
+                             bytes.begin() + static_cast<std::ptrdiff_t>(in.position + byteCount));
+                in.position += byteCount;
+            }
+        }
+    }
+    return true;
+}
+
+std::uint32_t EditJournal::readFrameSize(std::uint64_t position) const
+{
+    std::uint32_t size = 0;
+    readBytes(position, &size, kFrameBytes);
+    return size;
+}
+
+void EditJournal::writeBytes(std::uint64_t position, const void* data, std::size_t size)
+{
+    const auto* source = static_cast<const std::uint8_t*>(data);
+    const auto offset = static_cast<std::size_t>(position % arena.size());
+    const auto firstPart = std::min(size, arena.size() - offset);
+    std::memcpy(arena.data() + offset, source, firstPart);
+    std::memcpy(arena.data(), source + firstPart, size - firstPart);
+}
+
+void EditJournal::readBytes(std::uint64_t position, void* data, std::size_t size) const
+{
+    auto* target = static_cast<std::uint8_t*>(data);
+    const auto offset = static_cast<std::size_t>(position % arena.size());
+    const auto firstPart = std::min(size, arena.size() - offset);
+    std::memcpy(target, arena.data() + offset, firstPart);
+    std::memcpy(target + firstPart, arena.data(), size - firstPart);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * One reversible change made by an editor action. Each kind keeps both sides of the change,
+ * so the same delta can be undone and redone. Which fields a kind uses:
+ *  cell: sequence, step, row and col, before and after values
+ *  rowInsert, rowRemove: sequence, step, row and the row's values
+ *  stepRows: sequence, step, row is the number of rows before, col the columns per row,
+ *            values holds the rows before then the rows after
+ *  stepActive, sequenceLength, sequenceSetting: sequence, step or setting index as index, before and after
+ *  stackGain: stack as target, before and after
+ *  slotMove: stack as target, index is the slot moved from, row the slot moved to
+ *  slotEnabled: stack as target, index is the slot, before and after
+ *  machineState: command type as target, machine index as index. For machines that save JSON,
+ *                path names one changed value ('/' separated property names and array indices)
+ *                and beforeBytes and afterBytes hold its JSON. Otherwise path is empty, row and col
+ *                are how many bytes the states share at the start and end, and beforeBytes and
+ *                afterBytes what lies between
+ *  songRowInsert: the new row as index, the sequence set it cloned the viewed set into as target
+ *  songRowSet, songRowBeats: song row as index, before and after
+ *  songRowTrackPattern: song row as index, track as row, the set it plays before and after
+ *  sequenceMute: sequence as target, before and after
+ */
+struct EditDelta
+{
+    enum class Kind : std::uint8_t
+    {
+        cell,
+        rowInsert,
+        rowRemove,
+        stepRows,
+        stepActive,
+        sequenceLength,
+        sequenceSetting,
+        stackGain,
+        slotMove,
+        slotEnabled,
+        machineState,
+        songRowInsert,
+        songRowSet,
+        songRowBeats,
+        songRowTrackPattern,
+        sequenceMute
+    };
+
+    Kind kind = Kind::cell;
+    /** the sequence, stack or machine type the delta applies to */
+    std::uint32_t target = 0;
+    std::uint32_t index = 0;
+    std::uint32_t row = 0;
+    std::uint32_t col = 0;
+    double before = 0.0;
+    double after = 0.0;
+    std::vector<double> values;
+    std::string path;
+    std::vector<std::uint8_t> beforeBytes;
+    std::vector<std::uint8_t> afterBytes;
+};
+
+/**
+ * Bounded undo and redo history. Each action is packed into a fixed size byte ring as a
+ * length-framed run of deltas, so the history costs its capacity and no more: once it is
+ * full the oldest actions are dropped to make room. Recording an action throws away anything
+ * that could have been redone. Not thread safe: the editor owns it.
+ */
+class EditJournal
+{
+public:
+    static constexpr std::size_t kDefaultCapacityBytes = 128 * 1024;
+
+    /** everything one editor action changed, in the order it should be applied */
+    struct Action
+    {
+        /** the sequence set the action edited */
+        std::size_t sequenceSet = 0;
+        std::vector<EditDelta> deltas;
+    };
+
+    explicit EditJournal(std::size_t capacityBytes = kDefaultCapacityBytes);
+
+    /** adds an action after the current position. Returns false, and clears the history,
+     * if the action is too big to ever fit */
+    bool record(const Action& action);
+    /** steps back over the newest action that has not been undone. Returns false if there is none */
+    bool undo(Action& action);
+    /** steps forward over the action undo last stepped back over. Returns false if there is none */
+    bool redo(Action& action);
+    /** reads the action undo would step back over, without moving. Returns false if there is none */
+    bool peekUndo(Action& action) const;
+    /** reads the action redo would step forward over, without moving. Returns false if there is none */
+    bool peekRedo(Action& action) const;
+    bool canUndo() const;
+    bool canRedo() const;
+    void clear();
+    /** bytes the recorded actions take up, including any that could be redone */
+    std::size_t getUsedBytes() const;
+
+private:
+    void encode(const Action& action);
+    bool decode(std::uint64_t start, std::uint32_t size, Action& action) const;
+    std::uint32_t readFrameSize(std::uint64_t position) const;
+    void writeBytes(std::uint64_t position, const void* data, std::size_t size);
+    void readBytes(std::uint64_t position, void* data, std::size_t size) const;
+
+    std::vector<std::uint8_t> arena;
+    /** scratch buffer an action is packed into before it goes into the ring */
+    std::vector<std::uint8_t> packed;
+    /** byte positions in the ring's unbounded history, taken modulo its size to index arena.
+     * Actions live between oldest and newest, and cursor splits them into undo and redo */
+    std::uint64_t oldest = 0;
+    std::uint64_t cursor = 0;
+    std::uint64_t newest = 0;
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+
+// Small seedable PCG32 generator used wherever playback needs reproducible randomness.
+class FastRandom
+{
+public:
+    /** Creates a generator seeded with the sent value. */
+    explicit FastRandom(std::uint32_t seedValue = 1u) noexcept { seed(seedValue); }
+
+    /** Restarts the sequence of numbers from the sent seed. */
+    void seed(std::uint32_t seedValue) noexcept
+    {
+        seedUsed = seedValue;
+        state = 0u;
+        nextUInt32();
+        state += 0x853c49e6748fea9bULL + static_cast<std::uint64_t>(seedValue);
+        nextUInt32();
+    }
+
+    /** Restarts the sequence of numbers from the last seed. */
+    void reseed() noexcept { seed(seedUsed); }
+
+    /** Returns the seed that the current sequence was started from. */
+    std::uint32_t getSeed() const noexcept { return seedUsed; }
+
+    /** Returns the next 32 random bits. */
+    std::uint32_t nextUInt32() noexcept
+    {
+        const std::uint64_t oldState = state;
+        state = oldState * kMultiplier + kIncrement;
+        const auto xorShifted = static_cast<std::uint32_t>(((oldState >> 18u) ^ oldState) >> 27u);
+        const auto rotation = static_cast<std::uint32_t>(oldState >> 59u);
+        return (xorShifted >> rotation) | (xorShifted << ((32u - rotation) & 31u));
+    }
+
+    /** Returns a double in the range [0, 1). */
+    double nextDouble() noexcept
+    {
+        return static_cast<double>(nextUInt32()) * (1.0 / 4294967296.0);
+    }
+
+    /** Returns an int in the range [0, maxExclusive), or 0 if maxExclusive < 1. */
+    int nextInt(int maxExclusive) noexcept
+    {
+        if (maxExclusive < 1)
+            return 0;
+        return static_cast<int>((static_cast<std::uint64_t>(nextUInt32()) * static_cast<std::uint64_t>(maxExclusive)) >> 32u);
+    }
+
+    /** Skips the next delta numbers in O(log delta) steps, as if they had been drawn. */
+    void discard(std::uint64_t delta) noexcept
+    {
+        std::uint64_t accMult = 1u;
+        std::uint64_t accPlus = 0u;
+        std::uint64_t curMult = kMultiplier;
+        std::uint64_t curPlus = kIncrement;
+        while (delta > 0u)
+        {
+            if ((delta & 1u) != 0u)
+            {
+                accMult *= curMult;
+                accPlus = accPlus * curMult + curPlus;
+            }
+            curPlus = (curMult + 1u) * curPlus;
+            curMult *= curMult;
+            delta >>= 1u;
+        }
+        state = accMult * state + accPlus;
+    }
+
+    /** Restarts from a point keyed on the seed and the sent position, keeping the seed.
+        Lets playback land on any position without drawing every number before it. */
+    void restartAt(std::uint64_t position) noexcept
+    {
+        const std::uint32_t keptSeed = seedUsed;
+        seed(seedForIndex(keptSeed, static_cast<std::uint32_t>(position)) ^ static_cast<std::uint32_t>(position >> 32u));
+        seedUsed = keptSeed;
+    }
+
+    /** Lets the generator drive std::shuffle and friends. */
+    using result_type = std::uint32_t;
+    static constexpr result_type min() noexcept { return 0u; }
+    static constexpr result_type max() noexcept { return 0xffffffffu; }
+    result_type operator()() noexcept { return nextUInt32(); }
+
+    /** Mixes an index into a well spread seed, e.g. for per-track defaults. */
+    static std::uint32_t seedForIndex(std::uint32_t baseSeed, std::uint32_t index) noexcept
+    {
+        std::uint32_t mixed = baseSeed + 0x9e3779b9u * (index + 1u);
+        mixed = (mixed ^ (mixed >> 16u)) * 0x85ebca6bu;
+        mixed = (mixed ^ (mixed >> 13u)) * 0xc2b2ae35u;
+        return mixed ^ (mixed >> 16u);
+    }
+
+private:
+    static constexpr std::uint64_t kMultiplier = 6364136223846793005ULL;
+    static constexpr std::uint64_t kIncrement = 1442695040888963407ULL;
+    std::uint64_t state = 0u;
+    std::uint32_t seedUsed = 1u;
+};
@@ -67,10 +67,19 @@ public:
         return true;
     }
 
-    /** Updates the duration of a tracker tick in seconds. */
+    /** Updates the duration of a tracker tick in seconds. Called on the audio thread, so don't lock. */
     virtual void setSecondsPerTick(double secondsPerTick) { (void)secondsPerTick; }
     /** Silences any currently playing notes or tails. */
     virtual void allNotesOff() {}
+    /** Number of parameters that sequencer steps can lock, addressed by ids 0 to count - 1. */
+    virtual int getLockableParameterCount() const { return 0; }
+    /** Short label for a lockable parameter, or an empty string for an unknown id. */
+    virtual const char* getLockableParameterName(int parameterId) const { (void)parameterId; return ""; }
+    /** Holds a parameter at a 0-1 position in its range until the lock is cleared.
+        Called on the audio thread between renders, so it must not block or allocate. */
+    virtual void setParameterLock(int parameterId, float normalisedValue) { (void)parameterId; (void)normalisedValue; }
+    /** Hands a locked parameter back to the machine's own setting. Same threading rules as setParameterLock. */
+    virtual void clearParameterLock(int parameterId) { (void)parameterId; }
     /** Applies a learned MIDI note value to the current UI target. */
     virtual void applyLearnedNote(int midiNote) { (void)midiNote; }
     /** Adds a machine-specific entry, such as a sampler slot or read head. */
@@ -13,9 +13,15 @@ class MachineUtilsAbs{
         /** send the all notes off message */
         virtual void allNotesOff() = 0;
         /** play a note - would generally trigger a note on now
-         * and schedule a note off for later
+         * and schedule a note off for later. durInTicks counts engine ticks,
+         * see ClockAbs::gridToEngineTicks
          */
         virtual void sendMessageToMachine(CommandType machineType, unsigned short machineId, unsigned short note, unsigned short velocity, unsigned short durInTicks) = 0;
+        /** hold parameter parameterId of the machine in slot slotIndex of stack machineId
+         * at value (0-127 across the parameter's range) from now until holdTicks engine ticks
+         * later, then hand it back to the machine's own setting
+         */
+        virtual void sendParameterLock(unsigned short machineId, unsigned short slotIndex, unsigned short parameterId, unsigned short value, unsigned short holdTicks) = 0;
         virtual std::string describeStepNote(CommandType machineType, unsigned short machineId, unsigned short note) const = 0;
         /**
          * send any queued notes, e.g. note offs 
@@ -0,0 +1,111 @@
+#include "ProjectFile.h"
+
+namespace
+{
+constexpr juce::int64 kChunkHeaderBytes = 8;
+/** rewrite the file once it grows past this many times its compacted size */
+constexpr juce::int64 kMaxGrowth = 2;
+}
+
+ProjectFile::ProjectFile(const juce::File& file) : file{file}
+{
+}
+
+const juce::File& ProjectFile::getFile() const
+{
+    return file;
+}
+
+bool ProjectFile::save(const ProjectSnapshot& snapshot)
+{
+    return writeAll(ProjectFormat::encodeChunks(snapshot));
+}
+
+bool ProjectFile::update(const ProjectSnapshot& snapshot)
+{
+    const auto chunks = ProjectFormat::encodeChunks(snapshot);
+    if (savedHashes.empty() || !file.existsAsFile())
+        return writeAll(chunks);
+
+    std::vector<std::uint64_t> hashes;
+    hashes.reserve(chunks.size());
+    std::vector<std::size_t> toAppend;
+    juce::int64 appendBytes = 0;
+    for (std::size_t i = 0; i < chunks.size(); ++i)
+    {
+        hashes.push_back(hashPayload(chunks[i].payload));
+        const auto saved = savedHashes.find(chunkKey(chunks[i]));
+        if (saved != savedHashes.end() && saved->second == hashes[i])
+            continue;
+        toAppend.push_back(i);
+        appendBytes += kChunkHeaderBytes + static_cast<juce::int64>(chunks[i].payload.getSize());
+    }
+    if (toAppend.empty())
+        return true;
+    if (file.getSize() + appendBytes > fullSize * kMaxGrowth)
+        return writeAll(chunks);
+
+    juce::FileOutputStream out(file);
+    if (!out.openedOk())
+        return false;
+    for (const auto i : toAppend)
+        ProjectFormat::writeChunk(out, chunks[i]);
+    out.flush();
+    if (out.getStatus().failed())
+        return false;
+
+    for (const auto i : toAppend)
+        savedHashes[chunkKey(chunks[i])] = hashes[i];
+    return true;
+}
+
+bool ProjectFile::load(const juce::File& file, ProjectSnapshot& snapshot)
+{
+    juce::FileInputStream in(file);
+    if (!in.openedOk())
+        return false;
+    return ProjectFormat::read(in, snapshot, true);
+}
+
+bool ProjectFile::writeAll(const std::vector<ProjectFormat::Chunk>& chunks)
+{
+    // write beside the target and move it into place, so a failed save leaves the old file whole
+    juce::TemporaryFile temp(file);
+    {
+        juce::FileOutputStream out(temp.getFile());
+        if (!out.openedOk())
+            return false;
+        ProjectFormat::writeHeader(out);
+        for (const auto& chunk : chunks)
+            ProjectFormat::writeChunk(out, chunk);
+        out.flush();
+        if (out.getStatus().failed())
+            return false;
+    }
+    if (!temp.overwriteTargetFileWithTemporary())
+        return false;
+
+    savedHashes.clear();
+    for (const auto& chunk : chunks)
+        savedHashes[chunkKey(chunk)] = hashPayload(chunk.payload);
+    fullSize = file.getSize();
+    return true;
+}
+
+std::uint64_t ProjectFile::chunkKey(const ProjectFormat::Chunk& chunk)
+{
+    return (static_cast<std::uint64_t>(chunk.id) << 32) | chunk.key;
+}
+
+std::uint64_t ProjectFile::hashPayload(const juce::MemoryBlock& payload)
+{
+    // FNV-1a, only used to spot chunks that changed between autosaves
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    const auto* bytes = static_cast<const std::uint8_t*>(payload.getData());
+    for (std::size_t i = 0; i < payload.getSize(); ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "ProjectFormat.h"
+
+/**
+ * A project file on disk. save streams every chunk into a fresh file; update appends just the
+ * chunks whose bytes changed since the last save or update, which ProjectFormat::read then lets
+ * replace the earlier copies. Once the appended chunks outweigh the project itself the file is
+ * rewritten in full. Not thread safe: the owner serialises calls.
+ */
+class ProjectFile
+{
+public:
+    explicit ProjectFile(const juce::File& file);
+
+    const juce::File& getFile() const;
+    /** replace the file with the whole snapshot. Returns false if it could not be written */
+    bool save(const ProjectSnapshot& snapshot);
+    /** bring the file up to date with the snapshot, writing as little as possible.
+     * Returns false if it could not be written */
+    bool update(const ProjectSnapshot& snapshot);
+    /** read a file written by save or update */
+    static bool load(const juce::File& file, ProjectSnapshot& snapshot);
+
+private:
+    bool writeAll(const std::vector<ProjectFormat::Chunk>& chunks);
+    /** chunk id and key together, which name the chunk a later copy replaces */
+    static std::uint64_t chunkKey(const ProjectFormat::Chunk& chunk);
+    static std::uint64_t hashPayload(const juce::MemoryBlock& payload);
+
+    juce::File file;
+    /** hash of each chunk as the file holds it now, by chunkKey. Empty until the first save */
+    std::unordered_map<std::uint64_t, std::uint64_t> savedHashes;
+    /** size of the file as last written in full */
+    juce::int64 fullSize = 0;
+};
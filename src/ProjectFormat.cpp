@@ -0,0 +1,678 @@
+#include "ProjectFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+
+namespace
+{
+constexpr char kMagic[4] = { 'M', 'Y', 'K', 'T' };
+constexpr std::uint32_t kNoBlock = 0xffffffffu;
+
+constexpr std::uint32_t chunkId(const char (&id)[5])
+{
+    return static_cast<std::uint32_t>(static_cast<unsigned char>(id[0]))
+        | (static_cast<std::uint32_t>(static_cast<unsigned char>(id[1])) << 8)
+        | (static_cast<std::uint32_t>(static_cast<unsigned char>(id[2])) << 16)
+        | (static_cast<std::uint32_t>(static_cast<unsigned char>(id[3])) << 24);
+}
+
+constexpr std::uint32_t kTrackCountsChunk = chunkId("TRKS");
+constexpr std::uint32_t kTrackPatternChunk = chunkId("PATN");
+constexpr std::uint32_t kSongChunk = chunkId("SONG");
+constexpr std::uint32_t kEditorChunk = chunkId("EDIT");
+constexpr std::uint32_t kStacksChunk = chunkId("STCK");
+constexpr std::uint32_t kAuxBusesChunk = chunkId("AUXB");
+constexpr std::uint32_t kClockChunk = chunkId("CLCK");
+
+void writeU32(juce::OutputStream& out, std::size_t value)
+{
+    out.writeInt(static_cast<int>(static_cast<std::uint32_t>(value)));
+}
+
+std::uint32_t readU32(juce::InputStream& in)
+{
+    return static_cast<std::uint32_t>(in.readInt());
+}
+
+void writeBlob(juce::OutputStream& out, const juce::MemoryBlock& block)
+{
+    writeU32(out, block.getSize());
+    out.write(block.getData(), block.getSize());
+}
+
+bool readBlob(juce::InputStream& in, juce::MemoryBlock& block)
+{
+    const auto size = readU32(in);
+    if (size > static_cast<std::uint64_t>(in.getNumBytesRemaining()))
+        return false;
+    block.setSize(size);
+    return size == 0 || in.read(block.getData(), static_cast<int>(size)) == static_cast<int>(size);
+}
+
+/** reads an item count, rejecting counts the rest of the chunk could not hold at minItemBytes each,
+ * so a damaged file cannot ask for a huge allocation */
+bool readCount(juce::InputStream& in, std::size_t minItemBytes, std::uint32_t& count)
+{
+    count = readU32(in);
+    return static_cast<std::uint64_t>(count) * minItemBytes <= static_cast<std::uint64_t>(in.getNumBytesRemaining());
+}
+
+/** adds a chunk whose payload is whatever fillPayload writes */
+template <typename Fn>
+void encodeChunk(std::vector<ProjectFormat::Chunk>& chunks, std::uint32_t id, std::uint32_t key, Fn&& fillPayload)
+{
+    auto& chunk = chunks.emplace_back();
+    chunk.id = id;
+    chunk.key = key;
+    juce::MemoryOutputStream payload(chunk.payload, false);
+    fillPayload(payload);
+}
+
+void writeBlocks(juce::OutputStream& out, const std::vector<const Step::Rows*>& blocks)
+{
+    writeU32(out, blocks.size());
+    for (const auto* rows : blocks)
+    {
+        writeU32(out, rows->size());
+        for (const auto& row : *rows)
+        {
+            writeU32(out, row.size());
+            for (const double value : row)
+                out.writeDouble(value);
+        }
+    }
+}
+
+bool readBlocks(juce::InputStream& in, std::vector<Step::SharedRows>& blocks)
+{
+    std::uint32_t blockCount = 0;
+    if (!readCount(in, 4, blockCount))
+        return false;
+    blocks.clear();
+    blocks.reserve(blockCount);
+    for (std::uint32_t block = 0; block < blockCount; ++block)
+    {
+        std::uint32_t rowCount = 0;
+        if (!readCount(in, 4, rowCount))
+            return false;
+        Step::Rows rows(rowCount);
+        for (auto& row : rows)
+        {
+            std::uint32_t colCount = 0;
+            if (!readCount(in, sizeof(double), colCount))
+                return false;
+            row.resize(colCount);
+            for (auto& value : row)
+                value = in.readDouble();
+        }
+        if (rows.empty())
+            rows = Step{}.getData();
+        blocks.push_back(std::make_shared<Step::Rows>(std::move(rows)));
+    }
+    return true;
+}
+
+constexpr std::size_t kPatternStepBytes = 1 + 4;
+
+void writePatternSettings(juce::OutputStream& out, const ProjectSnapshot::Pattern& pattern)
+{
+    writeU32(out, pattern.length);
+    out.writeByte(static_cast<char>(pattern.type));
+    out.writeDouble(pattern.ticksPerStep);
+    out.writeBool(pattern.muted);
+    out.writeDouble(pattern.machineId);
+    out.writeDouble(pattern.machineType);
+    out.writeDouble(pattern.triggerProbability);
+    writeU32(out, pattern.randomSeed);
+}
+
+void readPatternSettings(juce::InputStream& in, ProjectSnapshot::Pattern& pattern)
+{
+    pattern.length = std::max<std::uint32_t>(1, readU32(in));
+    pattern.type = static_cast<SequenceType>(juce::jlimit(0, static_cast<int>(SequenceType::tickChanger), static_cast<int>(in.readByte())));
+    const double ticksPerStep = in.readDouble();
+    pattern.ticksPerStep = std::isfinite(ticksPerStep) ? juce::jlimit(1.0, 16.0, ticksPerStep) : 4.0;
+    pattern.muted = in.readBool();
+    pattern.machineId = in.readDouble();
+    pattern.machineType = in.readDouble();
+    pattern.triggerProbability = in.readDouble();
+    pattern.randomSeed = readU32(in);
+}
+
+/** the step count, then each step's active flag and index into blocks */
+bool readPatternSteps(juce::InputStream& in, const std::vector<Step::SharedRows>& blocks, ProjectSnapshot::Pattern& pattern)
+{
+    std::uint32_t stepCount = 0;
+    if (!readCount(in, kPatternStepBytes, stepCount))
+        return false;
+    pattern.stepData.resize(stepCount);
+    pattern.stepActive.resize(stepCount);
+    for (std::uint32_t step = 0; step < stepCount; ++step)
+    {
+        pattern.stepActive[step] = in.readBool();
+        const auto blockIndex = readU32(in);
+        if (blockIndex < blocks.size())
+            pattern.stepData[step] = blocks[blockIndex];
+    }
+    return true;
+}
+
+/** fails for counts the track pattern keys cannot tell apart or a sequencer cannot hold */
+bool readTrackCounts(juce::InputStream& in, std::vector<std::uint32_t>& trackCounts)
+{
+    static_assert(Sequencer::maxSequences <= 0xffffu, "tracks must fit the 16 bits of a track pattern key");
+    std::uint32_t setCount = 0;
+    if (!readCount(in, 4, setCount) || setCount > 0x10000u)
+        return false;
+    trackCounts.resize(setCount);
+    for (auto& count : trackCounts)
+    {
+        count = readU32(in);
+        if (count > Sequencer::maxSequences)
+            return false;
+    }
+    return true;
+}
+
+bool readSong(juce::InputStream& in, ProjectSnapshot& snapshot)
+{
+    snapshot.songMode = in.readBool();
+    snapshot.viewedSequenceSetIndex = readU32(in);
+    snapshot.activePlaybackSequenceSetIndex = readU32(in);
+    snapshot.selectedSongRow = readU32(in);
+    snapshot.currentSongRow = readU32(in);
+    snapshot.currentSongRowBeatCounter = in.readInt();
+
+    std::uint32_t rowCount = 0;
+    if (!readCount(in, 12, rowCount))
+        return false;
+    snapshot.songRows.assign(rowCount, {});
+    for (auto& row : snapshot.songRows)
+    {
+        row.sequenceSetId = readU32(in);
+        row.beatCount = in.readInt();
+        std::uint32_t trackCount = 0;
+        if (!readCount(in, 4, trackCount))
+            return false;
+        row.trackPatterns.resize(trackCount);
+        for (auto& setId : row.trackPatterns)
+            setId = in.readInt();
+    }
+    return true;
+}
+
+bool readEditor(juce::InputStream& in, ProjectSnapshot& snapshot)
+{
+    snapshot.currentSequence = readU32(in);
+    snapshot.currentStep = readU32(in);
+    snapshot.currentStepRow = readU32(in);
+    snapshot.currentStepCol = readU32(in);
+    snapshot.songRowCursor = readU32(in);
+    snapshot.songColCursor = readU32(in);
+    snapshot.editMode = in.readString().toStdString();
+    return true;
+}
+
+bool readStacks(juce::InputStream& in, std::vector<ProjectSnapshot::Stack>& stacks)
+{
+    std::uint32_t stackCount = 0;
+    if (!readCount(in, 16, stackCount))
+        return false;
+    stacks.assign(stackCount, {});
+    for (auto& stack : stacks)
+    {
+        std::uint32_t slotCount = 0;
+        if (!readCount(in, 13, slotCount))
+            return false;
+        stack.slots.resize(slotCount);
+        for (auto& slot : stack.slots)
+        {
+            slot.type = static_cast<CommandType>(readU32(in));
+            slot.enabled = in.readBool();
+            slot.sendLevelDb = in.readFloat();
+            slot.returnLevelDb = in.readFloat();
+        }
+        stack.midiOutputChannel = in.readInt();
+        stack.gainDb = in.readFloat();
+
+        std::uint32_t machineCount = 0;
+        if (!readCount(in, 8, machineCount))
+            return false;
+        stack.machines.resize(machineCount);
+        for (auto& machine : stack.machines)
+        {
+            machine.type = static_cast<CommandType>(readU32(in));
+            if (!readBlob(in, machine.data))
+                return false;
+        }
+    }
+    return true;
+}
+}
+
+bool ProjectFormat::isProjectData(const void* data, std::size_t sizeInBytes)
+{
+    return data != nullptr && sizeInBytes >= sizeof(kMagic) + 4 && std::memcmp(data, kMagic, sizeof(kMagic)) == 0;
+}
+
+void ProjectFormat::writeHeader(juce::OutputStream& out)
+{
+    out.write(kMagic, sizeof(kMagic));
+    writeU32(out, kVersion);
+}
+
+namespace
+{
+constexpr std::uint64_t kHashSeed = 14695981039346656037ULL;
+
+/** FNV-1a, continuing from hash */
+std::uint64_t hashBytes(std::uint64_t hash, const void* bytes, std::size_t count)
+{
+    const auto* data = static_cast<const unsigned char*>(bytes);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::uint64_t hashRows(std::uint64_t hash, const Step::Rows& rows)
+{
+    for (const std::vector<double>& row : rows)
+        hash = hashBytes(hash, row.data(), row.size() * sizeof(double));
+    return hash;
+}
+
+std::uint64_t patternContentHash(const ProjectSnapshot::Pattern& pattern)
+{
+    // over the saved fields
+    std::uint64_t hash = kHashSeed;
+    auto mixValue = [&hash](auto value) { hash = hashBytes(hash, &value, sizeof(value)); };
+
+    mixValue(pattern.length);
+    mixValue(static_cast<int>(pattern.type));
+    mixValue(pattern.ticksPerStep);
+    mixValue(pattern.muted);
+    mixValue(pattern.machineId);
+    mixValue(pattern.machineType);
+    mixValue(pattern.triggerProbability);
+    mixValue(pattern.randomSeed);
+    for (std::size_t step = 0; step < pattern.stepData.size(); ++step)
+    {
+        mixValue(step < pattern.stepActive.size() && pattern.stepActive[step]);
+        if (pattern.stepData[step] != nullptr)
+            hash = hashRows(hash, *pattern.stepData[step]);
+    }
+    return hash;
+}
+
+bool haveSameContent(const ProjectSnapshot::Pattern& a, const ProjectSnapshot::Pattern& b)
+{
+    if (a.length != b.length || a.type != b.type || a.ticksPerStep != b.ticksPerStep || a.muted != b.muted
+        || a.machineId != b.machineId || a.machineType != b.machineType
+        || a.triggerProbability != b.triggerProbability || a.randomSeed != b.randomSeed
+        || a.stepActive != b.stepActive || a.stepData.size() != b.stepData.size())
+        return false;
+    for (std::size_t step = 0; step < a.stepData.size(); ++step)
+    {
+        const auto& mine = a.stepData[step];
+        const auto& theirs = b.stepData[step];
+        if (mine == theirs)
+            continue;
+        if (mine == nullptr || theirs == nullptr || *mine != *theirs)
+            return false;
+    }
+    return true;
+}
+
+constexpr std::uint8_t kOwnPattern = 0;
+constexpr std::uint8_t kSameAsPattern = 1;
+
+/** sets and tracks share the 32 bit chunk key, 16 bits each */
+std::uint32_t trackPatternKey(std::size_t set, std::size_t track)
+{
+    return static_cast<std::uint32_t>(((set & 0xffffu) << 16) | (track & 0xffffu));
+}
+
+/** a track's pattern as written, with its own step blocks */
+void writeTrackPattern(juce::OutputStream& out, const ProjectSnapshot::Pattern& pattern)
+{
+    out.writeByte(static_cast<char>(kOwnPattern));
+    writePatternSettings(out, pattern);
+
+    // blocks shared between this pattern's steps are written once
+    std::vector<const Step::Rows*> blocks;
+    std::unordered_map<const Step::Rows*, std::uint32_t> indexOfBlock;
+    for (const auto& data : pattern.stepData)
+        if (data != nullptr && indexOfBlock.emplace(data.get(), static_cast<std::uint32_t>(blocks.size())).second)
+            blocks.push_back(data.get());
+    writeBlocks(out, blocks);
+
+    writeU32(out, pattern.stepData.size());
+    for (std::size_t step = 0; step < pattern.stepData.size(); ++step)
+    {
+        const auto& data = pattern.stepData[step];
+        out.writeBool(step < pattern.stepActive.size() ? pattern.stepActive[step] : true);
+        writeU32(out, data != nullptr ? indexOfBlock[data.get()] : kNoBlock);
+    }
+}
+
+/** a track playing the same pattern as an earlier one. The pattern's hash goes along so this
+ * chunk changes, and is saved again, whenever the earlier track's pattern does */
+void writeSameAsTrackPattern(juce::OutputStream& out, std::uint32_t sourceKey, std::uint64_t patternHash)
+{
+    out.writeByte(static_cast<char>(kSameAsPattern));
+    writeU32(out, sourceKey);
+    out.writeInt64(static_cast<juce::int64>(patternHash));
+}
+
+struct TrackPattern
+{
+    bool sameAsAnother = false;
+    std::uint32_t sourceKey = 0;
+    ProjectSnapshot::Pattern pattern;
+};
+
+/** shares identical step blocks read from different patterns, as they were shared when saved */
+class BlockInterner
+{
+public:
+    Step::SharedRows intern(Step::SharedRows rows)
+    {
+        auto& candidates = blocksByHash[hashRows(kHashSeed, *rows)];
+        for (const auto& candidate : candidates)
+            if (*candidate == *rows)
+                return candidate;
+        candidates.push_back(rows);
+        return rows;
+    }
+
+private:
+    std::unordered_map<std::uint64_t, std::vector<Step::SharedRows>> blocksByHash;
+};
+
+bool readTrackPattern(juce::InputStream& in, BlockInterner& interner, std::map<std::uint32_t, TrackPattern>& trackPatterns)
+{
+    const auto set = readU32(in);
+    const auto track = readU32(in);
+    auto& entry = trackPatterns[trackPatternKey(set, track)];
+    entry = TrackPattern{};
+    if (static_cast<std::uint8_t>(in.readByte()) == kSameAsPattern)
+    {
+        entry.sameAsAnother = true;
+        entry.sourceKey = readU32(in);
+        return true;
+    }
+
+    readPatternSettings(in, entry.pattern);
+    std::vector<Step::SharedRows> blocks;
+    if (!readBlocks(in, blocks))
+        return false;
+    for (auto& block : blocks)
+        block = interner.intern(std::move(block));
+    return readPatternSteps(in, blocks, entry.pattern);
+}
+
+/** turns the track pattern chunks into the snapshot's patterns, one per distinct pattern */
+void resolveTrackPatterns(const std::vector<std::uint32_t>& trackCounts,
+                          const std::map<std::uint32_t, TrackPattern>& trackPatterns,
+                          ProjectSnapshot& snapshot)
+{
+    snapshot.patterns.clear();
+    snapshot.sequenceSets.assign(trackCounts.size(), {});
+    std::map<std::uint32_t, std::uint32_t> patternOfKey;
+    for (std::size_t set = 0; set < trackCounts.size(); ++set)
+    {
+        for (std::uint32_t track = 0; track < trackCounts[set]; ++track)
+        {
+            auto key = trackPatternKey(set, track);
+            auto found = trackPatterns.find(key);
+            if (found != trackPatterns.end() && found->second.sameAsAnother)
+            {
+                key = found->second.sourceKey;
+                found = trackPatterns.find(key);
+                if (found != trackPatterns.end() && found->second.sameAsAnother)
+                    found = trackPatterns.end();
+            }
+
+            const auto known = patternOfKey.find(key);
+            if (found != trackPatterns.end() && known != patternOfKey.end())
+            {
+                snapshot.sequenceSets[set].push_back(known->second);
+                continue;
+            }
+            const auto patternIndex = static_cast<std::uint32_t>(snapshot.patterns.size());
+            // a track with no chunk, which only a damaged file has, comes back empty
+            snapshot.patterns.push_back(found != trackPatterns.end() ? found->second.pattern : ProjectSnapshot::Pattern{});
+            if (found != trackPatterns.end())
+                patternOfKey[key] = patternIndex;
+            snapshot.sequenceSets[set].push_back(patternIndex);
+        }
+    }
+}
+}
+
+void ProjectSnapshot::mergeDuplicatePatterns()
+{
+    std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> keptByHash;
+    std::vector<std::uint32_t> remap(patterns.size());
+    std::vector<Pattern> kept;
+    kept.reserve(patterns.size());
+    for (std::size_t i = 0; i < patterns.size(); ++i)
+    {
+        auto& candidates = keptByHash[patternContentHash(patterns[i])];
+        const auto match = std::find_if(candidates.begin(), candidates.end(),
+                                        [&](std::uint32_t candidate) { return haveSameContent(kept[candidate], patterns[i]); });
+        if (match != candidates.end())
+        {
+            remap[i] = *match;
+            continue;
+        }
+        remap[i] = static_cast<std::uint32_t>(kept.size());
+        candidates.push_back(remap[i]);
+        kept.push_back(std::move(patterns[i]));
+    }
+    patterns = std::move(kept);
+    for (auto& tracks : sequenceSets)
+        for (auto& patternIndex : tracks)
+            if (patternIndex < remap.size())
+                patternIndex = remap[patternIndex];
+}
+
+void ProjectFormat::writeChunk(juce::OutputStream& out, const Chunk& chunk)
+{
+    writeU32(out, chunk.id);
+    writeU32(out, chunk.payload.getSize());
+    out.write(chunk.payload.getData(), chunk.payload.getSize());
+}
+
+void ProjectFormat::write(const ProjectSnapshot& snapshot, juce::OutputStream& out)
+{
+    writeHeader(out);
+    for (const auto& chunk : encodeChunks(snapshot))
+        writeChunk(out, chunk);
+}
+
+std::vector<ProjectFormat::Chunk> ProjectFormat::encodeChunks(const ProjectSnapshot& snapshot)
+{
+    std::vector<Chunk> chunks;
+
+    encodeChunk(chunks, kTrackCountsChunk, 0, [&](juce::OutputStream& chunk)
+    {
+        writeU32(chunk, snapshot.sequenceSets.size());
+        for (const auto& tracks : snapshot.sequenceSets)
+            writeU32(chunk, tracks.size());
+    });
+
+    // each track is a chunk of its own, so an edit only rewrites the tracks it touched.
+    // The first track to play a pattern holds it, later ones refer back to that track
+    constexpr std::uint32_t kNotWritten = 0xffffffffu;
+    std::vector<std::uint32_t> writtenAt(snapshot.patterns.size(), kNotWritten);
+    for (std::size_t set = 0; set < snapshot.sequenceSets.size(); ++set)
+    {
+        for (std::size_t track = 0; track < snapshot.sequenceSets[set].size(); ++track)
+        {
+            const auto patternIndex = snapshot.sequenceSets[set][track];
+            if (patternIndex >= snapshot.patterns.size())
+                continue;
+            const auto key = trackPatternKey(set, track);
+            encodeChunk(chunks, kTrackPatternChunk, key, [&](juce::OutputStream& chunk)
+            {
+                writeU32(chunk, set);
+                writeU32(chunk, track);
+                const auto& pattern = snapshot.patterns[patternIndex];
+                if (writtenAt[patternIndex] == kNotWritten)
+                {
+                    writtenAt[patternIndex] = key;
+                    writeTrackPattern(chunk, pattern);
+                }
+                else
+                {
+                    writeSameAsTrackPattern(chunk, writtenAt[patternIndex], patternContentHash(pattern));
+                }
+            });
+        }
+    }
+
+    encodeChunk(chunks, kSongChunk, 0, [&](juce::OutputStream& chunk)
+    {
+        chunk.writeBool(snapshot.songMode);
+        writeU32(chunk, snapshot.viewedSequenceSetIndex);
+        writeU32(chunk, snapshot.activePlaybackSequenceSetIndex);
+        writeU32(chunk, snapshot.selectedSongRow);
+        writeU32(chunk, snapshot.currentSongRow);
+        chunk.writeInt(snapshot.currentSongRowBeatCounter);
+        writeU32(chunk, snapshot.songRows.size());
+        for (const auto& row : snapshot.songRows)
+        {
+            writeU32(chunk, row.sequenceSetId);
+            chunk.writeInt(row.beatCount);
+            writeU32(chunk, row.trackPatterns.size());
+            for (const int setId : row.trackPatterns)
+                chunk.writeInt(setId);
+        }
+    });
+
+    encodeChunk(chunks, kClockChunk, 0, [&](juce::OutputStream& chunk)
+    {
+        chunk.writeInt(snapshot.ticksPerQuarter);
+    });
+
+    encodeChunk(chunks, kEditorChunk, 0, [&](juce::OutputStream& chunk)
+    {
+        writeU32(chunk, snapshot.currentSequence);
+        writeU32(chunk, snapshot.currentStep);
+        writeU32(chunk, snapshot.currentStepRow);
+        writeU32(chunk, snapshot.currentStepCol);
+        writeU32(chunk, snapshot.songRowCursor);
+        writeU32(chunk, snapshot.songColCursor);
+        chunk.writeString(juce::String(snapshot.editMode));
+    });
+
+    encodeChunk(chunks, kStacksChunk, 0, [&](juce::OutputStream& chunk)
+    {
+        writeU32(chunk, snapshot.stacks.size());
+        for (const auto& stack : snapshot.stacks)
+        {
+            writeU32(chunk, stack.slots.size());
+            for (const auto& slot : stack.slots)
+            {
+                writeU32(chunk, static_cast<std::size_t>(slot.type));
+                chunk.writeBool(slot.enabled);
+                chunk.writeFloat(slot.sendLevelDb);
+                chunk.writeFloat(slot.returnLevelDb);
+            }
+            chunk.writeInt(stack.midiOutputChannel);
+            chunk.writeFloat(stack.gainDb);
+            writeU32(chunk, stack.machines.size());
+            for (const auto& machine : stack.machines)
+            {
+                writeU32(chunk, static_cast<std::size_t>(machine.type));
+                writeBlob(chunk, machine.data);
+            }
+        }
+    });
+
+    encodeChunk(chunks, kAuxBusesChunk, 0, [&](juce::OutputStream& chunk)
+    {
+        writeBlob(chunk, snapshot.aux1State);
+        writeBlob(chunk, snapshot.aux2State);
+    });
+    return chunks;
+}
+
+bool ProjectFormat::read(juce::InputStream& in, ProjectSnapshot& snapshot, bool ignoreTruncatedTail)
+{
+    char magic[sizeof(kMagic)] = {};
+    if (in.read(magic, sizeof(magic)) != static_cast<int>(sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0)
+        return false;
+    if (in.getNumBytesRemaining() < 4)
+        return false;
+    if (readU32(in) != kVersion)
+        return false;
+
+    snapshot = ProjectSnapshot{};
+    // track patterns are gathered by key and resolved once every chunk is in
+    std::vector<std::uint32_t> trackCounts;
+    bool haveTrackCounts = false;
+    std::map<std::uint32_t, TrackPattern> trackPatterns;
+    BlockInterner interner;
+    bool complete = true;
+    while (!in.isExhausted())
+    {
+        if (in.getNumBytesRemaining() < 8)
+        {
+            complete = false;
+            break;
+        }
+        const auto id = readU32(in);
+        const auto size = readU32(in);
+        if (size > static_cast<std::uint64_t>(in.getNumBytesRemaining()))
+        {
+            complete = false;
+            break;
+        }
+
+        juce::MemoryBlock payload(size);
+        if (size > 0 && in.read(payload.getData(), static_cast<int>(size)) != static_cast<int>(size))
+            return false;
+        juce::MemoryInputStream chunk(payload, false);
+
+        bool ok = true;
+        if (id == kTrackCountsChunk)
+        {
+            ok = readTrackCounts(chunk, trackCounts);
+            haveTrackCounts = true;
+        }
+        else if (id == kTrackPatternChunk)
+            ok = readTrackPattern(chunk, interner, trackPatterns);
+        else if (id == kSongChunk)
+            ok = readSong(chunk, snapshot);
+        else if (id == kEditorChunk)
+            ok = readEditor(chunk, snapshot);
+        else if (id == kStacksChunk)
+            ok = readStacks(chunk, snapshot.stacks);
+        else if (id == kAuxBusesChunk)
+            ok = readBlob(chunk, snapshot.aux1State) && readBlob(chunk, snapshot.aux2State);
+        else if (id == kClockChunk)
+        {
+            // a resolution the engine cannot run at falls back to the grid rather than reaching the clock
+            const int ticksPerQuarter = chunk.readInt();
+            snapshot.ticksPerQuarter = ClockAbs::isSupportedTicksPerQuarter(ticksPerQuarter) ? ticksPerQuarter : ClockAbs::kGridTicksPerQuarter;
+        }
+        // anything else is a chunk from a later version and is skipped
+
+        if (!ok)
+            return false;
+    }
+    if (!complete && !ignoreTruncatedTail)
+        return false;
+
+    if (haveTrackCounts)
+        resolveTrackPatterns(trackCounts, trackPatterns, snapshot);
+    return true;
+}
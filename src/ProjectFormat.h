@@ -0,0 +1,130 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Sequencer.h"
+#include "SequencerCommands.h"
+
+/**
+ * Plain copy of everything a project file holds, independent of the live sequencer objects.
+ * Step blocks are the shared, immutable Step::SharedRows, so taking one costs reference counts
+ * rather than copies, and blocks shared between patterns stay shared through a save and load.
+ */
+struct ProjectSnapshot
+{
+    struct Pattern
+    {
+        std::size_t length = 1;
+        SequenceType type = SequenceType::midiNote;
+        /** in grid ticks, fractional at engine resolutions finer than the grid */
+        double ticksPerStep = 4;
+        bool muted = false;
+        double machineId = 0.0;
+        double machineType = 0.0;
+        double triggerProbability = 1.0;
+        std::uint32_t randomSeed = 1;
+        /** one entry per step up to length. A null block leaves the step at its default */
+        std::vector<Step::SharedRows> stepData;
+        std::vector<bool> stepActive;
+    };
+    struct SongRow
+    {
+        std::size_t sequenceSetId = 0;
+        int beatCount = 16;
+        /** per track, the sequence set to play, or -1 for the row's own set */
+        std::vector<int> trackPatterns;
+    };
+    struct Slot
+    {
+        CommandType type = CommandType::MidiNote;
+        bool enabled = true;
+        float sendLevelDb = 0.0f;
+        float returnLevelDb = 0.0f;
+    };
+    /** a machine's own getStateInformation output, stored as is */
+    struct MachineState
+    {
+        CommandType type = CommandType::MidiNote;
+        juce::MemoryBlock data;
+    };
+    struct Stack
+    {
+        std::vector<Slot> slots;
+        int midiOutputChannel = 1;
+        float gainDb = 0.0f;
+        std::vector<MachineState> machines;
+    };
+
+    /** every distinct pattern once, referenced by index from sequenceSets */
+    std::vector<Pattern> patterns;
+    /** per sequence set, the pattern each track plays */
+    std::vector<std::vector<std::uint32_t>> sequenceSets;
+
+    std::vector<SongRow> songRows;
+    bool songMode = false;
+    std::size_t viewedSequenceSetIndex = 0;
+    std::size_t activePlaybackSequenceSetIndex = 0;
+    std::size_t selectedSongRow = 0;
+    std::size_t currentSongRow = 0;
+    int currentSongRowBeatCounter = 16;
+    /** engine ticks per quarter note. Projects saved before it was stored ran at the 8 tick grid */
+    int ticksPerQuarter = 8;
+
+    std::size_t currentSequence = 0;
+    std::size_t currentStep = 0;
+    std::size_t currentStepRow = 0;
+    std::size_t currentStepCol = 0;
+    std::size_t songRowCursor = 0;
+    std::size_t songColCursor = 0;
+    std::string editMode = "sequence";
+
+    std::vector<Stack> stacks;
+    juce::MemoryBlock aux1State;
+    juce::MemoryBlock aux2State;
+
+    /** store identical patterns once, e.g. one drum pattern under several bass lines, pointing
+     * every set that used a copy at the one kept. Cheap to capture without it, so the capture
+     * can leave this until after it has let the audio thread go */
+    void mergeDuplicatePatterns();
+};
+
+/**
+ * The binary project file: the "MYKT" magic and a format version, then a run of chunks, each a
+ * four character id, a 32 bit payload size and the payload. All numbers are little endian.
+ * Readers skip chunks they do not know, so chunks can be added without breaking older builds;
+ * a version bump is only needed when an existing chunk's layout changes, and files of any other
+ * version are turned away.
+ * A chunk that appears again replaces the earlier copy, so a file can be brought up to date by
+ * appending only the chunks that changed. Each track's pattern is a chunk of its own, holding its
+ * step blocks, or for a track identical to an earlier one a reference to it, so an edit only
+ * rewrites the tracks it touched.
+ */
+namespace ProjectFormat
+{
+    constexpr std::uint32_t kVersion = 3;
+
+    struct Chunk
+    {
+        std::uint32_t id = 0;
+        /** which item a per item chunk holds, e.g. set and track for a pattern. A later chunk
+         * replaces the earlier one with the same id and key. Kept in the payload too */
+        std::uint32_t key = 0;
+        juce::MemoryBlock payload;
+    };
+
+    /** true if the data starts with the project magic */
+    bool isProjectData(const void* data, std::size_t sizeInBytes);
+    /** the snapshot's chunks in file order */
+    std::vector<Chunk> encodeChunks(const ProjectSnapshot& snapshot);
+    void writeHeader(juce::OutputStream& out);
+    void writeChunk(juce::OutputStream& out, const Chunk& chunk);
+    /** the header followed by every chunk */
+    void write(const ProjectSnapshot& snapshot, juce::OutputStream& out);
+    /** fills snapshot from the stream. Returns false for data that is not a project, is truncated
+     * or was written by another format version. With ignoreTruncatedTail, a last chunk cut short,
+     * as an interrupted append leaves it, is dropped instead */
+    bool read(juce::InputStream& in, ProjectSnapshot& snapshot, bool ignoreTruncatedTail = false);
+}
@@ -0,0 +1,126 @@
+#include "SampleBuffer.h"
+#include <cmath>
+#include <cstring>
+
+SampleBuffer::SampleBuffer (juce::AudioBuffer<float>&& audio, SampleFormat newFormat)
+    : format (newFormat),
+      numChannels (audio.getNumChannels()),
+      numSamples (audio.getNumSamples())
+{
+    if (format == SampleFormat::float32)
+    {
+        floats = std::move (audio);
+        return;
+    }
+
+    packed.resize ((size_t) numChannels * (size_t) numSamples);
+    for (int chan = 0; chan < numChannels; ++chan)
+    {
+        const float* source = audio.getReadPointer (chan);
+        std::uint16_t* dest = packed.data() + (size_t) chan * (size_t) numSamples;
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] = format == SampleFormat::int16 ? floatToInt16 (source[i]) : floatToFloat16 (source[i]);
+    }
+}
+
+const float* SampleBuffer::getFloatPointer (int channel) const noexcept
+{
+    return format == SampleFormat::float32 ? floats.getReadPointer (channel) : nullptr;
+}
+
+void SampleBuffer::readFrames (int channel, int start, float* dest, int count) const noexcept
+{
+    if (format == SampleFormat::float32)
+    {
+        juce::FloatVectorOperations::copy (dest, floats.getReadPointer (channel, start), count);
+        return;
+    }
+
+    const std::uint16_t* source = packed.data() + (size_t) channel * (size_t) numSamples + (size_t) start;
+    if (format == SampleFormat::int16)
+        int16ToFloat (source, dest, count);
+    else
+        float16ToFloat (source, dest, count);
+}
+
+juce::int64 SampleBuffer::getSizeInBytes() const noexcept
+{
+    const auto bytesPerFrame = format == SampleFormat::float32 ? sizeof (float) : sizeof (std::uint16_t);
+    return (juce::int64) numChannels * numSamples * (juce::int64) bytesPerFrame;
+}
+
+void SampleBuffer::int16ToFloat (const std::uint16_t* source, float* dest, int count) noexcept
+{
+    constexpr float scale = 1.0f / 32768.0f;
+    for (int i = 0; i < count; ++i)
+        dest[i] = static_cast<float> (static_cast<std::int16_t> (source[i])) * scale;
+}
+
+void SampleBuffer::float16ToFloat (const std::uint16_t* source, float* dest, int count) noexcept
+{
+    // rebias the exponent in the integer domain; subnormal halves land one exponent step high and
+    // have that step subtracted again, so no denormal floats appear for the FTZ/DAZ modes to flush.
+    // Masks rather than branches keep the loop vectorisable.
+    constexpr std::uint32_t rebias = (127 - 15) << 23;
+    constexpr std::uint32_t subnormalOffsetBits = (127 - 14) << 23; // 2^-14
+    for (int i = 0; i < count; ++i)
+    {
+        const std::uint32_t half = source[i];
+        const std::uint32_t subnormalMask = 0u - static_cast<std::uint32_t> ((half & 0x7c00u) == 0);
+        const std::uint32_t bits = ((half & 0x7fffu) << 13) + rebias + (subnormalMask & (1u << 23));
+        const std::uint32_t offsetBits = subnormalMask & subnormalOffsetBits;
+        float value, offset;
+        std::memcpy (&value, &bits, sizeof (value));
+        std::memcpy (&offset, &offsetBits, sizeof (offset));
+        value -= offset;
+
+        std::uint32_t valueBits;
+        std::memcpy (&valueBits, &value, sizeof (valueBits));
+        valueBits |= (half & 0x8000u) << 16;
+        std::memcpy (dest + i, &valueBits, sizeof (valueBits));
+    }
+}
+
+std::uint16_t SampleBuffer::floatToInt16 (float value) noexcept
+{
+    const auto scaled = std::lround (juce::jlimit (-1.0f, 1.0f, value) * 32768.0f);
+    return static_cast<std::uint16_t> (static_cast<std::int16_t> (juce::jlimit (-32768L, 32767L, scaled)));
+}
+
+std::uint16_t SampleBuffer::floatToFloat16 (float value) noexcept
+{
+    std::uint32_t bits;
+    std::memcpy (&bits, &value, sizeof (bits));
+    const auto sign = static_cast<std::uint16_t> ((bits >> 16) & 0x8000u);
+    const float magnitude = std::abs (value);
+
+    // NaN becomes silence and anything past the largest half saturates
+    if (! (magnitude == magnitude))
+        return 0;
+    if (magnitude >= 65504.0f)
+        return static_cast<std::uint16_t> (sign | 0x7bffu);
+    // below the smallest half subnormal's midpoint rounds to zero
+    if (magnitude < 2.98023224e-08f) // 2^-25
+        return sign;
+
+    int exponent = 0;
+    const float mantissa = std::frexp (magnitude, &exponent); // magnitude = mantissa * 2^exponent, mantissa in [0.5, 1)
+    if (exponent < -13)
+    {
+        // subnormal: units of 2^-24
+        const auto units = static_cast<std::uint32_t> (std::nearbyint (std::ldexp (magnitude, 24)));
+        return static_cast<std::uint16_t> (sign | units);
+    }
+
+    // normal: 11 significant bits, rounding may carry into the next exponent
+    auto significand = static_cast<std::uint32_t> (std::nearbyint (std::ldexp (mantissa, 11)));
+    if (significand == 2048)
+    {
+        significand = 1024;
+        ++exponent;
+    }
+    const std::uint32_t biased = static_cast<std::uint32_t> (exponent - 1 + 15);
+    if (biased >= 31)
+        return static_cast<std::uint16_t> (sign | 0x7bffu);
+    return static_cast<std::uint16_t> (sign | (biased << 10) | (significand - 1024));
+}
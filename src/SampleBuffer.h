@@ -0,0 +1,64 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <cstdint>
+#include <vector>
+
+/** How a sample's frames are held in RAM. */
+enum class SampleFormat
+{
+    /** 32-bit float, as decoded. Voices read it in place. */
+    float32 = 0,
+    /** 16-bit integer. Lossless for 16-bit files; clips past full scale. */
+    int16 = 1,
+    /** IEEE half float. About 11 bits of precision at any level and no clipping. */
+    float16 = 2
+};
+
+/**
+ * Immutable resident frames of a sample in one of the SampleFormats. The 16-bit formats halve the
+ * memory a sample takes and the bandwidth a voice reads it with; voices convert the frames they
+ * need back to float as they render.
+ */
+class SampleBuffer
+{
+public:
+    /** Creates an empty buffer. */
+    SampleBuffer() = default;
+    /** Takes decoded audio and packs it into format. float32 keeps the buffer as it is. */
+    SampleBuffer (juce::AudioBuffer<float>&& audio, SampleFormat format);
+
+    /** Returns how the frames are held. */
+    SampleFormat getFormat() const noexcept { return format; }
+    /** Returns the number of channels. */
+    int getNumChannels() const noexcept { return numChannels; }
+    /** Returns the number of frames per channel. */
+    int getNumSamples() const noexcept { return numSamples; }
+    /** Returns a channel's frames when they are float32, or null when they are packed. */
+    const float* getFloatPointer (int channel) const noexcept;
+    /** Converts count frames of a channel, from start onwards, into dest. Safe on the audio thread. */
+    void readFrames (int channel, int start, float* dest, int count) const noexcept;
+    /** Returns the bytes the frames take. */
+    juce::int64 getSizeInBytes() const noexcept;
+
+    /** Converts count int16 frames to float. Written for the compiler to vectorise. */
+    static void int16ToFloat (const std::uint16_t* source, float* dest, int count) noexcept;
+    /** Converts count half-float frames to float without branches, so it vectorises too. */
+    static void float16ToFloat (const std::uint16_t* source, float* dest, int count) noexcept;
+    /** Packs one frame as int16, rounding to nearest and clipping at full scale. */
+    static std::uint16_t floatToInt16 (float value) noexcept;
+    /** Packs one frame as a half float, rounding to nearest even. */
+    static std::uint16_t floatToFloat16 (float value) noexcept;
+
+private:
+    /** How the frames are held. */
+    SampleFormat format { SampleFormat::float32 };
+    /** Channel count. */
+    int numChannels { 0 };
+    /** Frames per channel. */
+    int numSamples { 0 };
+    /** The frames when format is float32. */
+    juce::AudioBuffer<float> floats;
+    /** The frames one channel after another when format is 16-bit. */
+    std::vector<std::uint16_t> packed;
+};
@@ -0,0 +1,85 @@
+#include "SampleCache.h"
+
+std::shared_ptr<const SampleData> SampleCache::find (const Key& key)
+{
+    const std::lock_guard<std::mutex> lock (mutex);
+    auto it = entries.find (key);
+    if (it == entries.end())
+    {
+        ++stats.misses;
+        return nullptr;
+    }
+
+    ++stats.hits;
+    recency.splice (recency.end(), recency, it->second.recency);
+    return it->second.data;
+}
+
+std::shared_ptr<const SampleData> SampleCache::insert (const Key& key, std::shared_ptr<const SampleData> data)
+{
+    if (data == nullptr)
+        return data;
+
+    std::vector<std::shared_ptr<const SampleData>> evicted;
+    std::shared_ptr<const SampleData> result;
+    {
+        const std::lock_guard<std::mutex> lock (mutex);
+        auto it = entries.find (key);
+        if (it != entries.end())
+        {
+            // another load of the same file finished first; share its copy and drop this one
+            recency.splice (recency.end(), recency, it->second.recency);
+            evicted.push_back (std::move (data));
+            result = it->second.data;
+        }
+        else
+        {
+            Entry entry;
+            entry.bytes = data->getSizeInBytes();
+            entry.data = data;
+            entry.recency = recency.insert (recency.end(), key);
+            stats.bytes += entry.bytes;
+            entries.emplace (key, std::move (entry));
+            result = std::move (data);
+            evictUnused (evicted);
+        }
+        stats.entries = (int) entries.size();
+    }
+    return result;
+}
+
+void SampleCache::setBudgetBytes (juce::int64 newBudget)
+{
+    std::vector<std::shared_ptr<const SampleData>> evicted;
+    const std::lock_guard<std::mutex> lock (mutex);
+    stats.budgetBytes = juce::jmax ((juce::int64) 0, newBudget);
+    evictUnused (evicted);
+}
+
+SampleCache::Stats SampleCache::getStats() const
+{
+    const std::lock_guard<std::mutex> lock (mutex);
+    return stats;
+}
+
+void SampleCache::evictUnused (std::vector<std::shared_ptr<const SampleData>>& evicted)
+{
+    for (auto key = recency.begin(); key != recency.end() && stats.bytes > stats.budgetBytes;)
+    {
+        auto it = entries.find (*key);
+        // only the cache holds it, and nobody can take a new reference without the lock
+        if (it->second.data.use_count() == 1)
+        {
+            stats.bytes -= it->second.bytes;
+            ++stats.evictions;
+            evicted.push_back (std::move (it->second.data));
+            entries.erase (it);
+            key = recency.erase (key);
+        }
+        else
+        {
+            ++key;
+        }
+    }
+    stats.entries = (int) entries.size();
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include "SampleData.h"
+
+/**
+ * Decoded samples shared by every sampler in the process, so a file loaded into several players or
+ * stacks, or restored again from state, is decoded once. Entries are keyed by the file and by the
+ * form the data was built in, and hold the same immutable SampleData the players do. Once no player
+ * holds an entry any more it stays cached until the cache is over budget, least recently used first.
+ * Hold it through juce::SharedResourcePointer.
+ */
+class SampleCache
+{
+public:
+    /** Bytes of sample data the cache keeps before it evicts entries no player is using. */
+    static constexpr juce::int64 kDefaultBudgetBytes = (juce::int64) 1024 * 1024 * 1024;
+
+    /** Identifies one decoded form of one version of a file. */
+    struct Key
+    {
+        /** Full path of the file. */
+        juce::String path;
+        /** Modification time of the file in milliseconds, so an edited file is decoded again. */
+        juce::int64 modificationTime { 0 };
+        /** Frames decoded into RAM: the whole file, a preview's first seconds or a streamed head. */
+        juce::int64 residentFrames { 0 };
+        /** True when the frames past the resident ones stream from disk. */
+        bool streamed { false };
+        /** True when the data carries mip levels. */
+        bool withMipLevels { false };
+        /** True when the frames are read from a memory mapping of the file. */
+        bool memoryMapped { false };
+        /** How the resident frames are held. */
+        SampleFormat format { SampleFormat::float32 };
+
+        bool operator< (const Key& other) const noexcept
+        {
+            return std::tie (path, modificationTime, residentFrames, streamed, withMipLevels, memoryMapped, format)
+                 < std::tie (other.path, other.modificationTime, other.residentFrames, other.streamed, other.withMipLevels, other.memoryMapped, other.format);
+        }
+    };
+
+    /** Counters for the cache since it was created. */
+    struct Stats
+    {
+        /** Lookups that found their sample. */
+        std::uint64_t hits { 0 };
+        /** Lookups that had to decode. */
+        std::uint64_t misses { 0 };
+        /** Entries dropped to stay within budget. */
+        std::uint64_t evictions { 0 };
+        /** Entries held now. */
+        int entries { 0 };
+        /** Bytes held now, in use or not. */
+        juce::int64 bytes { 0 };
+        /** Current budget. */
+        juce::int64 budgetBytes { 0 };
+    };
+
+    /** Returns the cached data for key, or null on a miss. Counts the lookup either way. */
+    std::shared_ptr<const SampleData> find (const Key& key);
+    /** Caches data under key and returns what callers should use: data, or the copy another load
+     *  cached first. Evicts unused entries past the budget. */
+    std::shared_ptr<const SampleData> insert (const Key& key, std::shared_ptr<const SampleData> data);
+    /** Changes the budget, evicting unused entries at once if it shrank. */
+    void setBudgetBytes (juce::int64 newBudget);
+    /** Returns the hit, miss and size counters. */
+    Stats getStats() const;
+
+private:
+    /** One cached sample and its place in the recency list. */
+    struct Entry
+    {
+        std::shared_ptr<const SampleData> data;
+        juce::int64 bytes { 0 };
+        std::list<Key>::iterator recency;
+    };
+
+    /** Drops unused entries, oldest first, until the cache fits its budget. Call with mutex held.
+     *  The evicted data is moved into evicted so it is freed after the lock is released. */
+    void evictUnused (std::vector<std::shared_ptr<const SampleData>>& evicted);
+
+    /** Cached samples. */
+    std::map<Key, Entry> entries;
+    /** Keys from least to most recently used. */
+    std::list<Key> recency;
+    /** Counters reported by getStats. */
+    Stats stats { 0, 0, 0, 0, 0, kDefaultBudgetBytes };
+    /** Protects everything above. */
+    mutable std::mutex mutex;
+};
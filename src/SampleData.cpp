@@ -0,0 +1,127 @@
+#include "SampleData.h"
+#include "SampleResampler.h"
+#include "SampleStreamer.h"
+#include "WaveformSVGRenderer.h"
+#include <algorithm>
+#include <limits>
+
+std::shared_ptr<const SampleData> SampleData::createResident (juce::AudioBuffer<float>&& audio,
+                                                              double sampleRate,
+                                                              bool withMipLevels,
+                                                              SampleFormat format)
+{
+    auto data = std::make_shared<SampleData>();
+    // everything derived from the audio is built from the float frames, before they are packed
+    if (withMipLevels)
+    {
+        for (auto& level : buildMipLevels (audio))
+            data->mipLevels.emplace_back (std::move (level), format);
+    }
+    data->lengthInFrames = audio.getNumSamples();
+    data->sampleRate = sampleRate > 0.0 ? sampleRate : 44100.0;
+    data->waveformPoints = buildWaveformPoints (audio);
+    data->waveformSVG = WaveformSVGRenderer::generateWaveformSVG (audio, 320);
+    data->audio = SampleBuffer (std::move (audio), format);
+    return data;
+}
+
+std::shared_ptr<const SampleData> SampleData::createStreamed (juce::AudioBuffer<float>&& head,
+                                                              std::shared_ptr<SampleStreamSource> source,
+                                                              std::vector<float> overview,
+                                                              double sampleRate,
+                                                              SampleFormat format)
+{
+    auto data = std::make_shared<SampleData>();
+    data->streamSource = std::move (source);
+    data->lengthInFrames = data->streamSource != nullptr ? data->streamSource->lengthInFrames : head.getNumSamples();
+    data->sampleRate = sampleRate > 0.0 ? sampleRate : 44100.0;
+    data->waveformPoints = std::move (overview);
+    if (data->waveformPoints.size() != static_cast<size_t> (kWaveformPoints) * 2)
+        data->waveformPoints = buildWaveformPoints (head);
+    data->waveformSVG = WaveformSVGRenderer::generateWaveformSVG (head, 320);
+    data->audio = SampleBuffer (std::move (head), format);
+    return data;
+}
+
+juce::int64 SampleData::getSizeInBytes() const noexcept
+{
+    juce::int64 bytes = audio.getSizeInBytes();
+    for (const auto& level : mipLevels)
+        bytes += level.getSizeInBytes();
+    return bytes;
+}
+
+std::vector<juce::AudioBuffer<float>> SampleData::buildMipLevels (const juce::AudioBuffer<float>& sample)
+{
+    std::vector<juce::AudioBuffer<float>> levels;
+    levels.reserve ((size_t) kMaxMipLevels);
+    const juce::AudioBuffer<float>* previous = &sample;
+    // stop once a level is too short to be worth filtering again
+    while ((int) levels.size() < kMaxMipLevels && previous->getNumSamples() > SampleResampler::kHalfRateTaps)
+    {
+        juce::AudioBuffer<float> level (previous->getNumChannels(), (previous->getNumSamples() + 1) / 2);
+        for (int chan = 0; chan < level.getNumChannels(); ++chan)
+            SampleResampler::halveRate (previous->getReadPointer (chan), previous->getNumSamples(), level.getWritePointer (chan));
+        levels.push_back (std::move (level));
+        previous = &levels.back();
+    }
+    return levels;
+}
+
+std::vector<float> SampleData::buildWaveformPoints (const juce::AudioBuffer<float>& buffer)
+{
+    const int numPoints = kWaveformPoints;
+    std::vector<float> points;
+
+    points.reserve(static_cast<size_t>(numPoints) * 2);
+
+    if (buffer.getNumSamples() == 0 || buffer.getNumChannels() == 0)
+    {
+        for (int i = 0; i < numPoints; ++i)
+        {
+            points.push_back(0.0f);
+            points.push_back(0.0f);
+        }
+        return points;
+    }
+
+    const int totalSamples = buffer.getNumSamples();
+    const int samplesPerPoint = std::max(1, totalSamples / numPoints);
+
+    for (int start = 0; start < totalSamples; start += samplesPerPoint)
+    {
+        const int end = std::min(totalSamples, start + samplesPerPoint);
+        float localMin = std::numeric_limits<float>::max();
+        float localMax = std::numeric_limits<float>::lowest();
+        bool hasSample = false;
+
+        for (int chan = 0; chan < buffer.getNumChannels(); ++chan)
+        {
+            const float* data = buffer.getReadPointer(chan);
+            for (int i = start; i < end; ++i)
+            {
+                const float sample = data[i];
+                hasSample = true;
+                localMin = std::min(localMin, sample);
+                localMax = std::max(localMax, sample);
+            }
+        }
+
+        if (!hasSample)
+        {
+            localMin = 0.0f;
+            localMax = 0.0f;
+        }
+
+        points.push_back(localMin);
+        points.push_back(localMax);
+    }
+
+    if (points.size() < static_cast<size_t>(numPoints) * 2)
+    {
+        const size_t missing = static_cast<size_t>(numPoints) * 2 - points.size();
+        points.insert(points.end(), missing, 0.0f);
+    }
+
+    return points;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+#include <vector>
+
+#include "SampleBuffer.h"
+
+struct SampleStreamSource;
+
+/**
+ * Everything a player needs from one loaded sample file, built in full on the loading thread and
+ * never changed once it is handed to a player. Players hold it through a shared_ptr, so replacing a
+ * sample is a pointer swap and the old data is freed by whoever lets go of it last.
+ */
+struct SampleData
+{
+    /** Min/max pairs in the waveform overview. */
+    static constexpr int kWaveformPoints = 128;
+    /** Most prefiltered half-rate copies kept of a sample, enough for five octaves up. */
+    static constexpr int kMaxMipLevels = 5;
+
+    /** Audio held in RAM: the whole sample, or the head of a streamed one. */
+    SampleBuffer audio;
+    /** Band-limited copies of audio at successively halved rates, in the same format. Empty for streamed samples. */
+    std::vector<SampleBuffer> mipLevels;
+    /** The file the frames past audio stream from, or null when the sample is fully resident. */
+    std::shared_ptr<SampleStreamSource> streamSource;
+    /** Length of the whole sample in frames, streamed part included. */
+    juce::int64 lengthInFrames { 0 };
+    /** Sample rate of the file. */
+    double sampleRate { 44100.0 };
+    /** Waveform overview of the whole sample as kWaveformPoints min/max pairs. */
+    std::vector<float> waveformPoints;
+    /** Waveform preview SVG for the UI. */
+    juce::String waveformSVG;
+
+    /** Builds data for a sample decoded whole into audio, kept in format. Slow when withMipLevels is set. */
+    static std::shared_ptr<const SampleData> createResident (juce::AudioBuffer<float>&& audio,
+                                                             double sampleRate,
+                                                             bool withMipLevels,
+                                                             SampleFormat format = SampleFormat::float32);
+    /** Builds data for a sample whose head is in RAM, kept in format, and the rest streams from source.
+     *  The overview covers the whole file, see kWaveformPoints; if it is the wrong size the head's is used. */
+    static std::shared_ptr<const SampleData> createStreamed (juce::AudioBuffer<float>&& head,
+                                                             std::shared_ptr<SampleStreamSource> source,
+                                                             std::vector<float> overview,
+                                                             double sampleRate,
+                                                             SampleFormat format = SampleFormat::float32);
+
+    /** Returns the bytes of audio held in RAM, mip levels included. */
+    juce::int64 getSizeInBytes() const noexcept;
+
+    /** Returns band-limited copies of the sample at half, quarter and lower rates, which voices
+     *  transposed up by more than an octave read instead of aliasing. */
+    static std::vector<juce::AudioBuffer<float>> buildMipLevels (const juce::AudioBuffer<float>& sample);
+    /** Returns kWaveformPoints min/max pairs spread over the buffer, all zero when it is empty. */
+    static std::vector<float> buildWaveformPoints (const juce::AudioBuffer<float>& buffer);
+};
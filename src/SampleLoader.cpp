@@ -0,0 +1,130 @@
+#include "SampleLoader.h"
+#include <algorithm>
+
+void SampleLoader::Job::cancel() noexcept
+{
+    cancelled.store (true, std::memory_order_release);
+    // wake a job waiting for memory so it can see it has been cancelled
+    if (loader != nullptr)
+    {
+        const std::lock_guard<std::mutex> lock (loader->mutex);
+        loader->changed.notify_all();
+    }
+}
+
+bool SampleLoader::Job::reserveMemory (juce::int64 bytes)
+{
+    std::unique_lock<std::mutex> lock (loader->mutex);
+    // a load bigger than the whole budget still runs once nothing else holds memory
+    loader->changed.wait (lock, [this, bytes]
+    {
+        return isCancelled()
+            || loader->bytesInFlight == 0
+            || loader->bytesInFlight + bytes <= kMaxBytesInFlight;
+    });
+
+    if (isCancelled())
+        return false;
+
+    reservedBytes += bytes;
+    loader->bytesInFlight += bytes;
+    return true;
+}
+
+//==============================================================================
+SampleLoader::SampleLoader()
+{
+    for (int i = 0; i < kNumThreads; ++i)
+        threads.emplace_back ([this]() { run(); });
+}
+
+SampleLoader::~SampleLoader()
+{
+    {
+        const std::lock_guard<std::mutex> lock (mutex);
+        running = false;
+        for (auto& job : runningJobs)
+            job->cancelled.store (true, std::memory_order_release);
+        changed.notify_all();
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
+std::shared_ptr<SampleLoader::Job> SampleLoader::submit (const void* owner, SampleLoadPriority priority, std::function<void (Job&)> task)
+{
+    auto job = std::make_shared<Job>();
+    job->loader = this;
+    job->owner = owner;
+    job->priority = priority;
+    job->task = std::move (task);
+
+    const std::lock_guard<std::mutex> lock (mutex);
+    job->sequence = nextSequence++;
+    queue.push (job);
+    changed.notify_all();
+    return job;
+}
+
+void SampleLoader::cancelAll (const void* owner)
+{
+    std::unique_lock<std::mutex> lock (mutex);
+
+    // the queue cannot be searched, so rebuild it without the owner's jobs
+    std::vector<std::shared_ptr<Job>> kept;
+    while (! queue.empty())
+    {
+        auto job = queue.top();
+        queue.pop();
+        if (job->owner == owner)
+            job->cancelled.store (true, std::memory_order_release);
+        else
+            kept.push_back (std::move (job));
+    }
+    for (auto& job : kept)
+        queue.push (std::move (job));
+
+    for (auto& job : runningJobs)
+    {
+        if (job->owner == owner)
+            job->cancelled.store (true, std::memory_order_release);
+    }
+    changed.notify_all();
+
+    changed.wait (lock, [this, owner]
+    {
+        return std::none_of (runningJobs.begin(), runningJobs.end(),
+            [owner] (const std::shared_ptr<Job>& job) { return job->owner == owner; });
+    });
+}
+
+void SampleLoader::run()
+{
+    std::unique_lock<std::mutex> lock (mutex);
+
+    while (running)
+    {
+        changed.wait (lock, [this] { return ! running || ! queue.empty(); });
+        if (! running)
+            break;
+
+        auto job = queue.top();
+        queue.pop();
+        // jobs cancelled while queued are dropped without running
+        if (job->isCancelled())
+            continue;
+
+        runningJobs.push_back (job);
+        lock.unlock();
+        job->task (*job);
+        // the task's captures are released here, off the lock
+        job->task = nullptr;
+        lock.lock();
+
+        bytesInFlight -= job->reservedBytes;
+        job->reservedBytes = 0;
+        runningJobs.erase (std::find (runningJobs.begin(), runningJobs.end(), job));
+        changed.notify_all();
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/** Which queued load runs first when the pool is busy. */
+enum class SampleLoadPriority
+{
+    /** Browser previews, which are thrown away as soon as the user moves on. */
+    preview = 0,
+    /** Loads into a player. */
+    foreground = 1
+};
+
+/**
+ * A small pool of threads, shared by every sampler in the process, that decodes sample files.
+ * Loads queue by priority and then by age, no more than kNumThreads run at once, and together
+ * they hold at most kMaxBytesInFlight of decoded audio that no player has taken yet.
+ * Hold it through juce::SharedResourcePointer; the threads run while anyone does.
+ */
+class SampleLoader
+{
+public:
+    /** Decodes that may run at once. */
+    static constexpr int kNumThreads = 2;
+    /** Decoded bytes that running loads may hold between them. A single load larger than this still runs, alone. */
+    static constexpr juce::int64 kMaxBytesInFlight = (juce::int64) 512 * 1024 * 1024;
+
+    /** One queued or running load. Its task polls isCancelled between chunks of work. */
+    class Job
+    {
+    public:
+        /** Asks the job to stop. A queued job never starts; a running one stops at its next check. */
+        void cancel() noexcept;
+        /** Returns true once the job has been cancelled. */
+        bool isCancelled() const noexcept { return cancelled.load (std::memory_order_acquire); }
+        /** Waits until bytes more fit in the in-flight budget. Returns false if the job is cancelled first. */
+        bool reserveMemory (juce::int64 bytes);
+
+    private:
+        friend class SampleLoader;
+
+        /** Pool that owns the job. */
+        SampleLoader* loader { nullptr };
+        /** Identifies who submitted the job, for cancelAll. */
+        const void* owner { nullptr };
+        /** Queue priority. */
+        SampleLoadPriority priority { SampleLoadPriority::foreground };
+        /** Submission order, so equal priorities run first come first served. */
+        std::uint64_t sequence { 0 };
+        /** The work itself. */
+        std::function<void (Job&)> task;
+        /** Set by cancel. */
+        std::atomic<bool> cancelled { false };
+        /** Bytes this job has reserved from the in-flight budget. Guarded by the loader's mutex. */
+        juce::int64 reservedBytes { 0 };
+    };
+
+    /** Starts the pool's threads. */
+    SampleLoader();
+    /** Cancels everything and joins the threads. */
+    ~SampleLoader();
+
+    /** Queues a task and returns its job, which the caller may keep to cancel it. */
+    std::shared_ptr<Job> submit (const void* owner, SampleLoadPriority priority, std::function<void (Job&)> task);
+    /** Cancels every job from owner and waits until none of them is running. */
+    void cancelAll (const void* owner);
+
+private:
+    /** Orders the queue: higher priority first, then older first. */
+    struct RunsLater
+    {
+        bool operator() (const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b) const noexcept
+        {
+            if (a->priority != b->priority)
+                return a->priority < b->priority;
+            return a->sequence > b->sequence;
+        }
+    };
+
+    /** Thread body: runs the most urgent job until the pool shuts down. */
+    void run();
+
+    /** Jobs waiting for a thread. */
+    std::priority_queue<std::shared_ptr<Job>, std::vector<std::shared_ptr<Job>>, RunsLater> queue;
+    /** Jobs being run right now. */
+    std::vector<std::shared_ptr<Job>> runningJobs;
+    /** Decoded bytes reserved by running jobs. */
+    juce::int64 bytesInFlight { 0 };
+    /** Next submission number. */
+    std::uint64_t nextSequence { 0 };
+    /** Protects everything above. */
+    std::mutex mutex;
+    /** Signalled when a job is queued, finishes, releases memory or is cancelled. */
+    std::condition_variable changed;
+    /** Cleared to stop the threads. */
+    bool running { true };
+    /** The decode threads. */
+    std::vector<std::thread> threads;
+
+    JUCE_DECLARE_NON_COPYABLE (SampleLoader)
+};
@@ -0,0 +1,244 @@
+#include "SampleResampler.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+namespace
+{
+constexpr int kSincTaps = SampleResampler::kFramesBefore + SampleResampler::kFramesAfter + 1;
+/** Fractional positions the sinc table is computed at; positions between them blend the two nearest. */
+constexpr int kSincPhases = 256;
+/** Passband edge as a fraction of the source Nyquist, leaving room for the window's transition band. */
+constexpr double kSincCutoff = 0.9;
+/** Sinc tables per unit of increment above one. Table n has its cutoff lowered by 1 / (1 + n / kSincCutoffSteps),
+ *  so increments up to two, the most a voice reads a mip level at, stay below the output Nyquist. */
+constexpr int kSincCutoffSteps = 8;
+constexpr double kKaiserBeta = 8.0;
+/** Cutoff of the rate-halving low-pass as a fraction of the source Nyquist. With 63 taps it is flat
+ *  to within 0.02 dB up to 0.4 and down more than 80 dB from 0.55, so nothing folds into the band
+ *  the sinc kernel passes when the halved level is played. */
+constexpr double kHalfRateCutoff = 0.47;
+/** kHalfRateTaps rounded up to a multiple of four; the padding tap is zero. */
+constexpr int kHalfRatePaddedTaps = (SampleResampler::kHalfRateTaps + 3) & ~3;
+
+static_assert (kSincTaps % 4 == 0, "tap loops are unrolled by four");
+static_assert (SampleResampler::kHalfRateTaps % 2 == 1, "the rate-halving filter must be centred on a frame");
+
+double besselI0 (double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; ++k)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+/** Windowed sinc through the given cutoff, at a distance in frames from the filter centre. */
+double kaiserSinc (double distance, double cutoff, double halfWidth)
+{
+    const double pi = 3.14159265358979323846;
+    const double x = pi * cutoff * distance;
+    const double sinc = std::abs (x) < 1.0e-9 ? 1.0 : std::sin (x) / x;
+    const double edge = distance / halfWidth;
+    const double window = std::abs (edge) >= 1.0 ? 0.0 : besselI0 (kKaiserBeta * std::sqrt (1.0 - edge * edge)) / besselI0 (kKaiserBeta);
+    return sinc * window;
+}
+
+/** One row of kSincTaps coefficients per phase, plus a last row for a fraction of exactly one. */
+struct SincTable
+{
+    alignas (16) std::array<float, (kSincPhases + 1) * kSincTaps> coefficients {};
+
+    explicit SincTable (double cutoff)
+    {
+        const double halfWidth = SampleResampler::kFramesAfter;
+        for (int phase = 0; phase <= kSincPhases; ++phase)
+        {
+            const double fraction = static_cast<double> (phase) / kSincPhases;
+            double rowSum = 0.0;
+            std::array<double, kSincTaps> row {};
+            for (int tap = 0; tap < kSincTaps; ++tap)
+            {
+                // distance from the playback position to the frame this tap reads
+                const double distance = static_cast<double> (tap - SampleResampler::kFramesBefore) - fraction;
+                row[(size_t) tap] = kaiserSinc (distance, cutoff, halfWidth);
+                rowSum += row[(size_t) tap];
+            }
+            // unity gain at DC for every phase, so held notes do not ripple in level
+            for (int tap = 0; tap < kSincTaps; ++tap)
+                coefficients[(size_t) (phase * kSincTaps + tap)] = static_cast<float> (row[(size_t) tap] / rowSum);
+        }
+    }
+};
+
+/** Returns the table for a voice reading at increment, rounding the increment up so the cutoff is never too high. */
+const SincTable& getSincTable (double increment)
+{
+    struct SincTables
+    {
+        std::array<std::unique_ptr<SincTable>, kSincCutoffSteps + 1> tables;
+
+        SincTables()
+        {
+            for (int step = 0; step <= kSincCutoffSteps; ++step)
+                tables[(size_t) step] = std::make_unique<SincTable> (kSincCutoff / (1.0 + static_cast<double> (step) / kSincCutoffSteps));
+        }
+    };
+
+    static const SincTables sincTables;
+    const int step = static_cast<int> (std::ceil ((increment - 1.0) * kSincCutoffSteps - 1.0e-9));
+    return *sincTables.tables[(size_t) std::clamp (step, 0, kSincCutoffSteps)];
+}
+
+/** Coefficients of the rate-halving low-pass, unity gain at DC. */
+struct HalfRateFilter
+{
+    alignas (16) std::array<float, kHalfRatePaddedTaps> coefficients {};
+
+    HalfRateFilter()
+    {
+        constexpr int centre = SampleResampler::kHalfRateTaps / 2;
+        double sum = 0.0;
+        std::array<double, SampleResampler::kHalfRateTaps> taps {};
+        for (int tap = 0; tap < SampleResampler::kHalfRateTaps; ++tap)
+        {
+            taps[(size_t) tap] = kaiserSinc (tap - centre, kHalfRateCutoff, centre + 1.0);
+            sum += taps[(size_t) tap];
+        }
+        for (int tap = 0; tap < SampleResampler::kHalfRateTaps; ++tap)
+            coefficients[(size_t) tap] = static_cast<float> (taps[(size_t) tap] / sum);
+    }
+};
+
+const HalfRateFilter& getHalfRateFilter()
+{
+    static const HalfRateFilter filter;
+    return filter;
+}
+
+template <int numTaps>
+inline float dotTaps (const float* frames, const float* taps) noexcept
+{
+    static_assert (numTaps % 4 == 0, "tap loops are unrolled by four");
+    float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+    for (int tap = 0; tap < numTaps; tap += 4)
+    {
+        sum0 += frames[tap] * taps[tap];
+        sum1 += frames[tap + 1] * taps[tap + 1];
+        sum2 += frames[tap + 2] * taps[tap + 2];
+        sum3 += frames[tap + 3] * taps[tap + 3];
+    }
+    return (sum0 + sum1) + (sum2 + sum3);
+}
+} // namespace
+
+void SampleResampler::prepareTables()
+{
+    getSincTable (1.0);
+    getHalfRateFilter();
+}
+
+double SampleResampler::render (ResampleQuality quality,
+                                const float* const* sources,
+                                int numChannels,
+                                double position,
+                                double increment,
+                                float* const* dests,
+                                int numFrames) noexcept
+{
+    if (numFrames <= 0)
+        return position;
+
+    // unpitched playback at the device rate lands on whole frames: no kernel can improve on a copy
+    if (increment == 1.0 && position == std::floor (position))
+    {
+        const auto first = static_cast<long long> (position);
+        for (int channel = 0; channel < numChannels; ++channel)
+            std::memcpy (dests[channel], sources[channel] + first, sizeof (float) * static_cast<size_t> (numFrames));
+        return position + numFrames;
+    }
+
+    switch (quality)
+    {
+        case ResampleQuality::linear:
+            for (int frame = 0; frame < numFrames; ++frame, position += increment)
+            {
+                const auto index = static_cast<long long> (position);
+                const float fraction = static_cast<float> (position - static_cast<double> (index));
+                for (int channel = 0; channel < numChannels; ++channel)
+                {
+                    const float* x = sources[channel] + index;
+                    dests[channel][frame] = x[0] + fraction * (x[1] - x[0]);
+                }
+            }
+            break;
+
+        case ResampleQuality::cubic:
+            for (int frame = 0; frame < numFrames; ++frame, position += increment)
+            {
+                const auto index = static_cast<long long> (position);
+                const float t = static_cast<float> (position - static_cast<double> (index));
+                for (int channel = 0; channel < numChannels; ++channel)
+                {
+                    const float* x = sources[channel] + index;
+                    const float c1 = 0.5f * (x[1] - x[-1]);
+                    const float c2 = x[-1] - 2.5f * x[0] + 2.0f * x[1] - 0.5f * x[2];
+                    const float c3 = 0.5f * (x[2] - x[-1]) + 1.5f * (x[0] - x[1]);
+                    dests[channel][frame] = ((c3 * t + c2) * t + c1) * t + x[0];
+                }
+            }
+            break;
+
+        case ResampleQuality::sinc:
+        {
+            const float* table = getSincTable (increment).coefficients.data();
+            alignas (16) float taps[kSincTaps];
+            for (int frame = 0; frame < numFrames; ++frame, position += increment)
+            {
+                const auto index = static_cast<long long> (position);
+                const double phasePosition = (position - static_cast<double> (index)) * kSincPhases;
+                const int phase = static_cast<int> (phasePosition);
+                const float blend = static_cast<float> (phasePosition - phase);
+                const float* row = table + phase * kSincTaps;
+                for (int tap = 0; tap < kSincTaps; ++tap)
+                    taps[tap] = row[tap] + blend * (row[tap + kSincTaps] - row[tap]);
+
+                for (int channel = 0; channel < numChannels; ++channel)
+                    dests[channel][frame] = dotTaps<kSincTaps> (sources[channel] + index - kFramesBefore, taps);
+            }
+            break;
+        }
+    }
+
+    return position;
+}
+
+void SampleResampler::halveRate (const float* source, int numFrames, float* dest) noexcept
+{
+    const float* taps = getHalfRateFilter().coefficients.data();
+    constexpr int centre = kHalfRateTaps / 2;
+    const int numOutput = (numFrames + 1) / 2;
+
+    for (int frame = 0; frame < numOutput; ++frame)
+    {
+        const int first = frame * 2 - centre;
+        if (first >= 0 && first + kHalfRatePaddedTaps <= numFrames)
+        {
+            dest[frame] = dotTaps<kHalfRatePaddedTaps> (source + first, taps);
+            continue;
+        }
+
+        // the first and last few frames: only the taps that land inside the source
+        float sum = 0.0f;
+        const int from = std::max (0, -first);
+        const int to = std::min (kHalfRateTaps, numFrames - first);
+        for (int tap = from; tap < to; ++tap)
+            sum += source[first + tap] * taps[tap];
+        dest[frame] = sum;
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+/** Interpolation a voice uses to read its sample between source frames. */
+enum class ResampleQuality
+{
+    /** Two-point linear interpolation. Cheapest, dulls and aliases when repitched. */
+    linear,
+    /** Four-point cubic Hermite interpolation. */
+    cubic,
+    /** 16-tap windowed sinc from precomputed polyphase tables, its cutoff lowered as the increment rises above one. */
+    sinc
+};
+
+/**
+ * Block resampling kernels for sampler voices. The kernels read raw channel pointers with no
+ * bounds checks: the caller guarantees the source holds every frame they can touch, see render.
+ * Tap loops keep four independent sums so the compiler can vectorise them.
+ */
+namespace SampleResampler
+{
+    /** Source frames any kernel reads before the frame under the playback position. */
+    constexpr int kFramesBefore = 7;
+    /** Source frames any kernel reads after the frame under the playback position. */
+    constexpr int kFramesAfter = 8;
+
+    /** Taps of the low-pass run before each halving of the rate. Odd, so output frames line up with source frames. */
+    constexpr int kHalfRateTaps = 63;
+
+    /** Builds the shared filter tables. Call off the audio thread before the first render. */
+    void prepareTables();
+
+    /**
+     * Writes numFrames frames per channel into dests, reading sources from position onwards in
+     * steps of increment, and returns the position after the last frame. Every source must hold
+     * the frames from floor (position) - kFramesBefore to floor (last position) + kFramesAfter.
+     */
+    double render (ResampleQuality quality,
+                   const float* const* sources,
+                   int numChannels,
+                   double position,
+                   double increment,
+                   float* const* dests,
+                   int numFrames) noexcept;
+
+    /**
+     * Low-passes numFrames frames of source below half its Nyquist and writes every second frame,
+     * (numFrames + 1) / 2 in all, to dest: dest frame n lines up with source frame 2n. Frames
+     * outside the source count as silence. Too slow for the audio thread; run it when loading.
+     */
+    void halveRate (const float* source, int numFrames, float* dest) noexcept;
+}
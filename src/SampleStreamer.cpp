@@ -0,0 +1,173 @@
+#include "SampleStreamer.h"
+#include <algorithm>
+#include <chrono>
+
+void SampleStreamSource::touchMappedPages (juce::int64 from, juce::int64 end) const noexcept
+{
+    if (mappedReader == nullptr || from >= end)
+        return;
+
+    const auto bytesPerFrame = juce::jmax ((juce::int64) 1, mappedReader->sampleToFilePos (1) - mappedReader->sampleToFilePos (0));
+    const auto framesPerPage = juce::jmax ((juce::int64) 1, kPageBytes / bytesPerFrame);
+    for (auto frame = from; frame < end; frame += framesPerPage)
+        mappedReader->touchSample (frame);
+    mappedReader->touchSample (end - 1);
+}
+
+//==============================================================================
+SampleStream::SampleStream (std::shared_ptr<SampleStreamSource> streamSource)
+    : source (std::move (streamSource)),
+      ring (juce::jmax (1, source->numChannels), source->mappedReader != nullptr ? 0 : kCapacityFrames)
+{
+    ring.clear();
+    filledToFrame.store (source->firstStreamedFrame, std::memory_order_relaxed);
+    neededFromFrame.store (source->firstStreamedFrame, std::memory_order_relaxed);
+}
+
+void SampleStream::restart() noexcept
+{
+    neededFromFrame.store (source->firstStreamedFrame, std::memory_order_relaxed);
+    requestedGeneration.fetch_add (1, std::memory_order_release);
+    wanted.store (true, std::memory_order_release);
+}
+
+void SampleStream::stop() noexcept
+{
+    wanted.store (false, std::memory_order_release);
+}
+
+juce::int64 SampleStream::getFilledEnd() const noexcept
+{
+    // a mapped file can always be read; at worst the audio thread waits for a page
+    if (source->mappedReader != nullptr)
+        return source->lengthInFrames;
+    if (filledGeneration.load (std::memory_order_acquire) != requestedGeneration.load (std::memory_order_relaxed))
+        return source->firstStreamedFrame;
+    return filledToFrame.load (std::memory_order_acquire);
+}
+
+void SampleStream::copyFrames (int channel, juce::int64 frame, float* dest, int count) const noexcept
+{
+    if (source->mappedReader != nullptr)
+    {
+        // other channels are left null, which the reader skips
+        float* dests[2] {};
+        dests[juce::jlimit (0, 1, channel)] = dest;
+        source->mappedReader->read (dests, juce::jlimit (0, 1, channel) + 1, frame, count);
+        return;
+    }
+
+    const int start = static_cast<int> (frame & (kCapacityFrames - 1));
+    const int firstPart = juce::jmin (count, kCapacityFrames - start);
+    const float* samples = ring.getReadPointer (channel);
+    juce::FloatVectorOperations::copy (dest, samples + start, firstPart);
+    if (count > firstPart)
+        juce::FloatVectorOperations::copy (dest + firstPart, samples, count - firstPart);
+}
+
+void SampleStream::releaseFramesBefore (juce::int64 frame) noexcept
+{
+    neededFromFrame.store (juce::jmax (frame, source->firstStreamedFrame), std::memory_order_release);
+}
+
+bool SampleStream::service (juce::AudioBuffer<float>& scratch)
+{
+    if (! wanted.load (std::memory_order_acquire))
+        return false;
+
+    const auto generation = requestedGeneration.load (std::memory_order_acquire);
+    if (generation != servedGeneration)
+    {
+        // a new hit: everything in the ring belongs to the last one
+        servedGeneration = generation;
+        filledToFrame.store (source->firstStreamedFrame, std::memory_order_relaxed);
+        filledGeneration.store (generation, std::memory_order_release);
+    }
+
+    const auto needed = neededFromFrame.load (std::memory_order_acquire);
+    // after an underrun the reader is ahead of the ring, so skip what it has already passed
+    const auto from = juce::jmax (filledToFrame.load (std::memory_order_relaxed), needed);
+    const auto end = source->lengthInFrames;
+    if (from >= end)
+        return false;
+
+    const auto space = needed + kCapacityFrames - from;
+    const auto count = static_cast<int> (std::min<juce::int64> ({ space, (juce::int64) kReadChunkFrames, end - from }));
+    // wait for room for a whole chunk rather than trickling in small reads
+    if (count < kReadChunkFrames && count < end - from)
+        return false;
+
+    if (source->mappedReader != nullptr)
+    {
+        source->touchMappedPages (from, from + count);
+        filledToFrame.store (from + count, std::memory_order_release);
+        return true;
+    }
+
+    source->reader->read (&scratch, 0, count, from, true, true);
+
+    const int start = static_cast<int> (from & (kCapacityFrames - 1));
+    const int firstPart = juce::jmin (count, kCapacityFrames - start);
+    for (int channel = 0; channel < ring.getNumChannels(); ++channel)
+    {
+        const int scratchChannel = juce::jmin (channel, scratch.getNumChannels() - 1);
+        ring.copyFrom (channel, start, scratch, scratchChannel, 0, firstPart);
+        if (count > firstPart)
+            ring.copyFrom (channel, 0, scratch, scratchChannel, firstPart, count - firstPart);
+    }
+
+    filledToFrame.store (from + count, std::memory_order_release);
+    return true;
+}
+
+//==============================================================================
+SampleStreamer::SampleStreamer()
+{
+    thread = std::thread ([this]() { run(); });
+}
+
+SampleStreamer::~SampleStreamer()
+{
+    running.store (false, std::memory_order_release);
+    if (thread.joinable())
+        thread.join();
+}
+
+std::shared_ptr<SampleStream> SampleStreamer::createStream (std::shared_ptr<SampleStreamSource> source)
+{
+    auto stream = std::make_shared<SampleStream> (std::move (source));
+    const std::lock_guard<std::mutex> lock (streamsMutex);
+    streams.push_back (stream);
+    return stream;
+}
+
+void SampleStreamer::run()
+{
+    juce::AudioBuffer<float> scratch (2, SampleStream::kReadChunkFrames);
+    std::vector<std::shared_ptr<SampleStream>> serviced;
+
+    while (running.load (std::memory_order_acquire))
+    {
+        {
+            const std::lock_guard<std::mutex> lock (streamsMutex);
+            serviced.assign (streams.begin(), streams.end());
+        }
+
+        bool readAny = false;
+        for (auto& stream : serviced)
+            readAny = stream->service (scratch) || readAny;
+        serviced.clear();
+
+        {
+            // streams whose player let go are freed here, never on the audio thread
+            const std::lock_guard<std::mutex> lock (streamsMutex);
+            streams.erase (std::remove_if (streams.begin(), streams.end(),
+                [] (const std::shared_ptr<SampleStream>& stream) { return stream.use_count() == 1; }),
+                streams.end());
+        }
+
+        // short sleeps keep a restarted voice's ring filling well inside its resident head
+        if (! readAny)
+            std::this_thread::sleep_for (std::chrono::milliseconds (2));
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** A sample file that is played from disk past its resident head. */
+struct SampleStreamSource
+{
+    /** Bytes the streamer assumes per page when it touches a mapped file ahead of playback. */
+    static constexpr int kPageBytes = 4096;
+
+    /** Reader for the file. Only the streamer thread reads from it once the source is shared,
+     *  unless it is memory mapped. */
+    std::unique_ptr<juce::AudioFormatReader> reader;
+    /** The reader again when it maps the whole file, or null. Voices then convert frames straight
+     *  from the mapping on the audio thread, and their streams only touch pages ahead of them. */
+    juce::MemoryMappedAudioFormatReader* mappedReader { nullptr };
+    /** Channels streamed from the file, at most two. */
+    int numChannels { 0 };
+    /** Length of the whole file in frames. */
+    juce::int64 lengthInFrames { 0 };
+    /** First frame that is not held in RAM. */
+    juce::int64 firstStreamedFrame { 0 };
+
+    /** Faults in the mapped pages holding frames from to end, so the audio thread finds them resident. */
+    void touchMappedPages (juce::int64 from, juce::int64 end) const noexcept;
+};
+
+/**
+ * Read-ahead ring for one playing voice of a streamed sample. For a memory-mapped sample there is
+ * no ring: the voice reads the mapping directly and the streamer only pages the file in ahead of it.
+ * The audio thread restarts, stops and reads it; the streamer thread fills it. Neither side
+ * blocks: frames are indexed by their position in the file, the reader publishes how far it
+ * has got and the streamer publishes how far it has filled, and a restart bumps a generation
+ * so frames read ahead for the previous hit are never played.
+ */
+class SampleStream
+{
+public:
+    /** Frames held per channel. A power of two so positions wrap with a mask. */
+    static constexpr int kCapacityFrames = 1 << 16;
+    /** Most frames the streamer reads for one stream before moving on to the next. */
+    static constexpr int kReadChunkFrames = 8192;
+
+    /** Creates an empty ring for the source. Allocates, so call it off the audio thread. */
+    explicit SampleStream (std::shared_ptr<SampleStreamSource> streamSource);
+
+    /** Audio thread: starts reading ahead from the end of the resident head. */
+    void restart() noexcept;
+    /** Audio thread: stops reading ahead until the next restart. */
+    void stop() noexcept;
+    /** Audio thread: returns the file position up to which copyFrames is valid for the current hit. */
+    juce::int64 getFilledEnd() const noexcept;
+    /** Audio thread: copies count streamed frames from one channel. They must all lie below getFilledEnd. */
+    void copyFrames (int channel, juce::int64 frame, float* dest, int count) const noexcept;
+    /** Audio thread: lets the streamer reuse ring space for frames before this one. */
+    void releaseFramesBefore (juce::int64 frame) noexcept;
+    /** Audio thread: counts a block that needed frames the streamer had not read yet. */
+    void noteUnderrun() noexcept { underruns.fetch_add (1, std::memory_order_relaxed); }
+    /** Returns how many blocks needed frames before the streamer had read them. */
+    std::uint32_t getUnderrunCount() const noexcept { return underruns.load (std::memory_order_relaxed); }
+
+    /** Streamer thread: reads the next chunk into the ring. Returns true if it read anything. */
+    bool service (juce::AudioBuffer<float>& scratch);
+
+private:
+    /** The file being streamed. */
+    std::shared_ptr<SampleStreamSource> source;
+    /** Ring storage, one channel per source channel. */
+    juce::AudioBuffer<float> ring;
+    /** Bumped by the audio thread on every restart. */
+    std::atomic<std::uint32_t> requestedGeneration { 0 };
+    /** The generation the frames below filledToFrame belong to. */
+    std::atomic<std::uint32_t> filledGeneration { 0 };
+    /** File position the ring has been filled up to. */
+    std::atomic<juce::int64> filledToFrame { 0 };
+    /** Oldest file position the audio thread still needs. */
+    std::atomic<juce::int64> neededFromFrame { 0 };
+    /** False while stopped, so the streamer skips the stream. */
+    std::atomic<bool> wanted { false };
+    /** Blocks that needed frames before they were read. */
+    std::atomic<std::uint32_t> underruns { 0 };
+    /** Streamer-side copy of the generation it is filling for. */
+    std::uint32_t servedGeneration { 0 };
+};
+
+/**
+ * One background thread, shared by every sampler in the process, that keeps the
+ * streams of playing voices read ahead of their playback position.
+ * Hold it through juce::SharedResourcePointer; the thread runs while anyone does.
+ */
+class SampleStreamer
+{
+public:
+    /** Starts the read-ahead thread. */
+    SampleStreamer();
+    /** Stops and joins the read-ahead thread. */
+    ~SampleStreamer();
+
+    /** Creates a stream for one voice and starts servicing it. It is dropped once only the streamer holds it. */
+    std::shared_ptr<SampleStream> createStream (std::shared_ptr<SampleStreamSource> source);
+
+private:
+    /** Thread body: services every stream, sleeping briefly when none needed reading. */
+    void run();
+
+    /** Streams being serviced. */
+    std::vector<std::shared_ptr<SampleStream>> streams;
+    /** Protects streams between createStream and the thread. Never taken on the audio thread. */
+    std::mutex streamsMutex;
+    /** Cleared to stop the thread. */
+    std::atomic<bool> running { true };
+    /** The read-ahead thread. */
+    std::thread thread;
+
+    JUCE_DECLARE_NON_COPYABLE (SampleStreamer)
+};
@@ -5,37 +5,67 @@
 #include <iomanip>
 #include <cmath>
 #include <limits>
+#include <numeric>
 
 Step::Step() : rw_mutex{std::make_unique<std::shared_mutex>()}, active{true}
 
 {
-  data.push_back(std::vector<double>());
+  auto rows = std::make_shared<Rows>();
+  rows->push_back(std::vector<double>());
   for (std::size_t i=0;i<=Step::maxInd;++i){
-    data[0].push_back(0.0);
+    (*rows)[0].push_back(0.0);
   }
-  data[0][Step::cmdInd] = static_cast<double>(CommandType::MidiNote);
+  (*rows)[0][Step::cmdInd] = static_cast<double>(CommandType::MidiNote);
+  data = std::move(rows);
 }
 /** returns a copy of the data stored in this step*/
 std::vector<std::vector<double>> Step::getData() const
 {
   // std::shared_lock<std::shared_mutex> lock(*rw_mutex);
+  return *data;
+}
+Step::SharedRows Step::getSharedData() const
+{
   return data;
 }
+void Step::setSharedData(SharedRows sharedData)
+{
+  if (sharedData != nullptr && !sharedData->empty())
+    data = std::move(sharedData);
+}
+Step Step::clone() const
+{
+  Step copy;
+  copy.data = data;
+  copy.active = active;
+  copy.stepCallback = stepCallback;
+  return copy;
+}
+Step::Rows& Step::editData()
+{
+  // someone else (another sequence set, a playback snapshot) can see this block, so
+  // take a private copy before writing
+  if (data.use_count() != 1)
+    data = std::make_shared<Rows>(*data);
+  // every block is allocated as a mutable Rows (see SharedRows), so with no other owner
+  // casting the const away is safe
+  return const_cast<Rows&>(*data);
+}
 double Step::getDataAt(std::size_t row, std::size_t col) const
 {
   // this lock allows multiple concorrent reads
   // std::shared_lock<std::shared_mutex> lock(*rw_mutex);
-  return data[row][col];
+  return (*data)[row][col];
 }
 std::size_t Step::howManyDataRows() const 
 {
   // std::shared_lock<std::shared_mutex> lock(*rw_mutex);
-  return data.size();
+  return data->size();
 }
 std::size_t Step::howManyDataCols() const
 {
   // std::shared_lock<std::shared_mutex> lock(*rw_mutex);
-  return data[0].size();
+  return (*data)[0].size();
 }
 
 // std::vector<std::vector<double>>* Step::getDataDirect()
@@ -48,12 +78,20 @@ std::string Step::toStringFlat(const SequenceReadOnly* sequenceContext) const
   if (sequenceContext == nullptr)
     return "----";
 
-  if (std::abs(this->data[0][Step::noteInd]) < std::numeric_limits<double>::epsilon()){
+  const Rows& rows = *data;
+  if (std::abs(rows[0][Step::noteInd]) < std::numeric_limits<double>::epsilon()){
     return "----";
   }
+  if (isModulatorRow(rows[0])){
+    // amount then target sequence, e.g. +3>2
+    const int amount = static_cast<int>(rows[0][Step::noteInd]);
+    const bool signedAmount = rows[0][Step::cmdInd] != static_cast<double>(CommandType::TickMod);
+    return (signedAmount && amount > 0 ? "+" : "") + std::to_string(amount)
+        + ">" + std::to_string(static_cast<int>(rows[0][Step::velInd]));
+  }
 
-  std::string disp = CommandProcessor::describeStepNote(sequenceContext, this->data[0][Step::noteInd]);
-  int velInt = static_cast<int>(this->data[0][Step::velInd]);
+  std::string disp = CommandProcessor::describeStepNote(sequenceContext, rows[0][Step::noteInd]);
+  int velInt = static_cast<int>(rows[0][Step::velInd]);
   if (velInt < 0)
     velInt = 0;
   std::size_t power = static_cast<std::size_t>(velInt / 32);
@@ -71,6 +109,7 @@ std::vector<std::vector<std::string>> Step::toStringGrid(const SequenceReadOnly*
   // each data sub vector should be on its own row
   //
   std::vector<std::vector<std::string>> grid;
+  const Rows& data = *this->data;
   // assert (data.size() > 0);
   // a row is
   for (std::size_t col = 0; col < data[0].size(); ++col)
@@ -98,6 +137,10 @@ std::vector<std::vector<std::string>> Step::toStringGrid(const SequenceReadOnly*
           }
           colData.push_back(cmd.parameters[col - 1].shortName + Step::dblToString(probValue, 2));
         }
+        else if (cmd.parameters[col - 1].isGridTickLength && data[row][col] != std::floor(data[row][col])){
+          // a length between grid ticks, set at a finer tick resolution
+          colData.push_back(cmd.parameters[col - 1].shortName + Step::dblToString(data[row][col], 2));
+        }
         else{
           colData.push_back(cmd.parameters[col - 1].shortName + std::to_string((int)data[row][col]));
         }
@@ -124,16 +167,17 @@ void Step::setData(const std::vector<std::vector<double>> &_data)
 {
   // uni lock as writing data
   // std::unique_lock<std::shared_mutex> lock(*rw_mutex);
-  this->data = std::move(_data); // copy it over
+  this->data = std::make_shared<Rows>(_data); // copy it over into a fresh block
 }
 
 void Step::resetRow(std::size_t row)
 {
   // std::unique_lock<std::shared_mutex> lock(*rw_mutex);
-  assert(row < data.size());
-  for (std::size_t col = 0; col < data[row].size(); ++col)
+  assert(row < data->size());
+  Rows& rows = editData();
+  for (std::size_t col = 0; col < rows[row].size(); ++col)
   {
-    data[row][col] = 0;
+    rows[row][col] = 0;
   }
 }
 
@@ -142,21 +186,24 @@ void Step::setDataAt(std::size_t row, std::size_t col, double value)
 {
   // uni lock as writing data
   // std::unique_lock<std::shared_mutex> lock(*rw_mutex);
-  assert(row < data.size());
-  assert(col < data[row].size());
+  assert(row < data->size());
+  assert(col < (*data)[row].size());
 
   // apply data constraints based on current command
   if (col == Step::cmdInd)
-  { // changing the command - only allowed a value 0->no. commands
+  { // changing the command - only allowed a value 0->no. commands, or a step-only command such as a parameter lock
     const std::size_t maxCmds = static_cast<std::size_t>(CommandProcessor::countCommands());
-    if (value >= maxCmds)
-      value = maxCmds - 1;
-    if (value < 0)
-      value = 0;
+    if (!CommandProcessor::hasCommand(value))
+    {
+      if (value >= maxCmds)
+        value = maxCmds - 1;
+      if (value < 0)
+        value = 0;
+    }
   }
   else if (col > Step::cmdInd)
   { // it is one of the parameter columns - use parameter spec constraints
-    Command cmd = CommandProcessor::getCommand(data[row][Step::cmdInd]);
+    Command cmd = CommandProcessor::getCommand((*data)[row][Step::cmdInd]);
     std::size_t pInd = col - 1;
     Parameter &p = cmd.parameters[pInd];
     // now constrain the value to the range of the parameter
@@ -165,8 +212,9 @@ void Step::setDataAt(std::size_t row, std::size_t col, double value)
     if (value < p.min)
       value = p.min;
   }
-  if (col < data[row].size())
-    data[row][col] = value;
+  // unchanged values leave a shared block shared
+  if (col < (*data)[row].size() && (*data)[row][col] != value)
+    editData()[row][col] = value;
 }
 /** set the callback function called when this step is triggered*/
 void Step::setCallback(std::function<void(std::vector<std::vector<double>> *)> callback)
@@ -186,6 +234,7 @@ void Step::trigger(std::size_t row, const SequenceReadOnly* sequenceContext)
   // std::cout << "Step::trigger" << std::endl;
   if (active)
   {
+    const Rows& data = *this->data;
     if (row < data.size())
     { // only trigger one row
       // note that the command decides if 
@@ -194,7 +243,7 @@ void Step::trigger(std::size_t row, const SequenceReadOnly* sequenceContext)
     }
     else
     {
-      for (std::vector<double> &dataRow : data)
+      for (const std::vector<double> &dataRow : data)
       {
       // note that the command decides if 
       // the data is valid and therefore, if it should do anything, not the step 
@@ -203,6 +252,20 @@ void Step::trigger(std::size_t row, const SequenceReadOnly* sequenceContext)
     }
   }
 }
+bool Step::isParameterLockRow(const std::vector<double>& row)
+{
+  return row.size() > Step::cmdInd && row[Step::cmdInd] == static_cast<double>(CommandType::ParamLock);
+}
+bool Step::isModulatorRow(const std::vector<double>& row)
+{
+  if (row.size() <= Step::cmdInd)
+    return false;
+  const double cmd = row[Step::cmdInd];
+  return cmd == static_cast<double>(CommandType::Transpose)
+      || cmd == static_cast<double>(CommandType::LengthMod)
+      || cmd == static_cast<double>(CommandType::TickMod);
+}
+
 /** toggle the activity status of this step*/
 void Step::toggleActive()
 {
@@ -242,7 +305,10 @@ Sequence::Sequence(Sequencer *_sequencer,
       ticksElapsed{0},
       tickOfFour{0},
       muted{false},
-      rw_mutex{std::make_unique<std::shared_mutex>()}
+      random{1u},
+      stepsPlayed{0},
+      rw_mutex{std::make_unique<std::shared_mutex>()},
+      patternExchange{std::make_unique<SnapshotExchange<SequencePattern>>()}
 // , midiScaleToDrum{MachineUtilsAbs::getScaleMidiToDrumMidi()}
 {
   for (std::size_t i = 0; i < seqLength; i++)
@@ -255,20 +321,158 @@ Sequence::Sequence(Sequencer *_sequencer,
       } });
     steps.push_back(std::move(s));
   }
+  transposedRow.reserve(Step::maxInd + 1);
+  playbackPattern = buildPattern();
 }
 
-/** go to the next step */
-void Sequence::tick(bool trigger)
+std::unique_ptr<SequencePattern> Sequence::buildPattern() const
 {
-  // write lock
-  // std::unique_lock<std::shared_mutex> lock(*rw_mutex);
+  auto pattern = std::make_unique<SequencePattern>();
+  pattern->stepData.reserve(steps.size());
+  pattern->stepActive.reserve(steps.size());
+  for (const Step& step : steps)
+  {
+    pattern->stepData.push_back(step.getSharedData());
+    pattern->stepActive.push_back(step.isActive());
+  }
+  pattern->length = currentLength;
+  pattern->type = type;
+  pattern->machineType = machineType;
+  pattern->machineId = machineId;
+  pattern->triggerProbability = triggerProbability;
+  pattern->muted = muted;
+  return pattern;
+}
+
+Sequence Sequence::cloneFor(Sequencer* owner) const
+{
+  Sequence copy{owner, 0, static_cast<unsigned short>(machineId)};
+  copy.steps.reserve(steps.size());
+  for (const Step& step : steps)
+    copy.steps.push_back(step.clone());
+  copy.currentLength = currentLength.load();
+  copy.machineId = machineId;
+  copy.type = type;
+  copy.machineType = machineType;
+  copy.triggerProbability = triggerProbability;
+  copy.ticksPerStep = originalTicksPerStep;
+  copy.originalTicksPerStep = originalTicksPerStep;
+  copy.nextTicksPerStep = nextTicksPerStep;
+  copy.muted = muted;
+  copy.random.seed(random.getSeed());
+  copy.playbackPattern = copy.buildPattern();
+  return copy;
+}
+
+std::uint64_t Sequence::getContentHash() const
+{
+  // FNV-1a over the saved fields
+  std::uint64_t hash = 14695981039346656037ULL;
+  auto mix = [&hash](const void* bytes, std::size_t count)
+  {
+    const auto* data = static_cast<const unsigned char*>(bytes);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      hash ^= data[i];
+      hash *= 1099511628211ULL;
+    }
+  };
+  auto mixValue = [&mix](auto value) { mix(&value, sizeof(value)); };
+
+  mixValue(currentLength.load());
+  mixValue(static_cast<int>(type));
+  mixValue(originalTicksPerStep);
+  mixValue(muted);
+  mixValue(machineId);
+  mixValue(machineType);
+  mixValue(triggerProbability);
+  mixValue(random.getSeed());
+  const std::size_t stepCount = std::min<std::size_t>(currentLength, steps.size());
+  for (std::size_t step = 0; step < stepCount; ++step)
+  {
+    mixValue(steps[step].isActive());
+    for (const std::vector<double>& row : *steps[step].getSharedData())
+      mix(row.data(), row.size() * sizeof(double));
+  }
+  return hash;
+}
+
+bool Sequence::hasSameContent(const Sequence& other) const
+{
+  if (currentLength != other.currentLength
+      || type != other.type
+      || originalTicksPerStep != other.originalTicksPerStep
+      || muted != other.muted
+      || machineId != other.machineId
+      || machineType != other.machineType
+      || triggerProbability != other.triggerProbability
+      || random.getSeed() != other.random.getSeed())
+    return false;
+  if (currentLength > steps.size() || currentLength > other.steps.size())
+    return false;
+  for (std::size_t step = 0; step < currentLength; ++step)
+  {
+    if (steps[step].isActive() != other.steps[step].isActive())
+      return false;
+    const auto mine = steps[step].getSharedData();
+    const auto theirs = other.steps[step].getSharedData();
+    if (mine != theirs && *mine != *theirs)
+      return false;
+  }
+  return true;
+}
+
+void Sequence::publishPattern()
+{
+  // moved-from sequences have no exchange
+  if (patternExchange == nullptr)
+    return;
+  if (publishHolds > 0)
+  {
+    publishPending = true;
+    return;
+  }
+  patternExchange->publish(buildPattern());
+}
+
+void Sequence::holdPublishing()
+{
+  ++publishHolds;
+}
+
+void Sequence::releasePublishing()
+{
+  if (publishHolds == 0 || --publishHolds > 0 || !publishPending)
+    return;
+  publishPending = false;
+  publishPattern();
+}
+
+bool Sequence::acquirePattern()
+{
+  // no locks here: pick up the latest published pattern, if there is one
+  patternExchange->acquire(playbackPattern);
+  return isModulatorType(playbackPattern->type);
+}
+
+const SequencePattern& Sequence::getPlaybackPattern() const
+{
+  return *playbackPattern;
+}
+
+/** move on one engine tick */
+void Sequence::tick(Sequencer& host, bool trigger)
+{
+  SequencePattern& pattern = *playbackPattern;
+  const std::size_t ticksPerGridTick = CommandProcessor::getTicksPerGridTick();
+
   ++ticksElapsed;
-  tickOfFour = (tickOfFour + 1) % 4;
+  tickOfFour = (tickOfFour + 1) % (4 * ticksPerGridTick);
   
   // jump to the top 
   if (rewindAtNextZeroTick && tickOfFour == 0){
     tickOfFour = 0;
-    ticksElapsed = ticksPerStep;
+    ticksElapsed = CommandProcessor::toEngineTicks(ticksPerStep);
     currentStep = 0; 
     rewindAtNextZeroTick = false; 
   }
@@ -276,7 +480,7 @@ void Sequence::tick(bool trigger)
   if (nextTicksPerStep  > 0 && tickOfFour == 0){// update to this tps on next zero of tickOfFour
       // std::cout << "changing tps " << nextTicksPerStep << std::endl;
       this->originalTicksPerStep = this->nextTicksPerStep;
-      this->ticksElapsed = ticksPerStep;
+      this->ticksElapsed = CommandProcessor::toEngineTicks(ticksPerStep);
       currentStep = 0;
       deactivateProcessors();
 
@@ -286,17 +490,46 @@ void Sequence::tick(bool trigger)
       nextTicksPerStep = 0;// don't trigger it again
   }
 
-  if (ticksElapsed == ticksPerStep)
+  // >= rather than == as a tick changer can shorten the step we are part way through
+  if (ticksElapsed >= CommandProcessor::toEngineTicks(ticksPerStep))
   {
     ticksElapsed = 0;
-    if (trigger && !muted)
+    if (currentStep >= pattern.stepData.size())
+      currentStep = 0;
+    random.restartAt(stepsPlayed++);
+    if (trigger && !pattern.muted && currentStep < pattern.stepData.size() && pattern.stepActive[currentStep])
     {
-      SequenceReadOnly context = getReadOnlyContext();
-      steps[currentStep].trigger(steps[currentStep].howManyDataRows(), &context);
+      if (isModulatorType(pattern.type))
+      {
+        for (const std::vector<double>& dataRow : *pattern.stepData[currentStep])
+          modulate(host, pattern.type, pattern.triggerProbability, dataRow);
+      }
+      else
+      {
+        SequenceReadOnly context{pattern.triggerProbability, pattern.machineType, pattern.machineId};
+        context.random = &random;
+        context.ticksPerStep = ticksPerStep;
+        // note that the command decides if 
+        // the data is valid and therefore, if it should do anything, not the step 
+        for (const std::vector<double>& dataRow : *pattern.stepData[currentStep])
+        {
+          if (transpose == 0 || Step::isParameterLockRow(dataRow) || dataRow.size() <= Step::noteInd || dataRow[Step::noteInd] <= 0)
+          {
+            CommandProcessor::executeCommand(dataRow[Step::cmdInd], &dataRow, &context);
+            continue;
+          }
+          // rows are maxInd + 1 wide, so this reuses the reserved storage
+          transposedRow.assign(dataRow.begin(), dataRow.end());
+          transposedRow[Step::noteInd] = std::clamp(dataRow[Step::noteInd] + transpose, 1.0, 127.0);
+          CommandProcessor::executeCommand(transposedRow[Step::cmdInd], &transposedRow, &context);
+        }
+      }
     }
 
-    const long long adjustedLength =
-        static_cast<long long>(currentLength) + static_cast<long long>(lengthAdjustment);
+    // a length changer can ask for more steps than we have, so stop at the last one
+    const long long adjustedLength = std::min(
+        static_cast<long long>(pattern.length) + static_cast<long long>(lengthAdjustment),
+        static_cast<long long>(pattern.stepData.size()));
     if (adjustedLength < 1)
     {
       currentStep = 0;
@@ -306,9 +539,8 @@ void Sequence::tick(bool trigger)
       const std::size_t lengthSize = static_cast<std::size_t>(adjustedLength);
       currentStep = (currentStep + 1) % lengthSize;
     }
-    if (currentStep >= steps.size())
+    if (currentStep >= pattern.stepData.size())
       currentStep = 0;
-    assert(currentStep < steps.size());
     // switch off any adjusters when we are at step 0
     if (currentStep == 0)
       deactivateProcessors();
@@ -316,6 +548,20 @@ void Sequence::tick(bool trigger)
 
 }
 
+void Sequence::modulate(Sequencer& host, SequenceType modulatorType, double sequenceProbability, const std::vector<double>& row)
+{
+  if (row.size() <= Step::probInd)
+    return;
+  // a zero amount is an empty row, like a zero note
+  const double amount = row[Step::noteInd];
+  if (amount == 0)
+    return;
+  const double probability = sequenceProbability > 0 ? sequenceProbability : row[Step::probInd];
+  if (random.nextDouble() >= probability)
+    return;
+  host.modulateSequence(static_cast<std::size_t>(std::max(0.0, row[Step::velInd])), modulatorType, amount);
+}
+
 std::size_t Sequence::getTicksElapsed() const
 {
   return ticksElapsed;
@@ -326,6 +572,16 @@ std::size_t Sequence::getTickOfFour() const
   return tickOfFour;
 }
 
+void Sequence::setRandomSeed(std::uint32_t seed)
+{
+  random.seed(seed);
+}
+
+std::uint32_t Sequence::getRandomSeed() const
+{
+  return random.getSeed();
+}
+
 void Sequence::triggerStep(std::size_t step, std::size_t row)
 {
   SequenceReadOnly context = getReadOnlyContext();
@@ -344,45 +600,43 @@ void Sequence::deactivateProcessors()
 void Sequence::resetStepRow(std::size_t step, std::size_t row)
 {
   steps[step].resetRow(row);
+  publishPattern();
 }
 
 
-void Sequence::setLengthAdjustment(std::size_t lenAdjust)
+void Sequence::setLengthAdjustment(int lenAdjust)
 {
-  // make sure we have enough steps
-  this->ensureEnoughStepsForLength(currentLength + lenAdjust);
-  const auto clamped = std::min<std::size_t>(lenAdjust,
-                                             static_cast<std::size_t>(std::numeric_limits<int>::max()));
-  this->lengthAdjustment = static_cast<int>(clamped);
+  // no ensureEnoughStepsForLength here as it allocates: tick stops at the last step instead
+  this->lengthAdjustment = lenAdjust;
 }
 
-void Sequence::setTicksPerStep(std::size_t tps)
+void Sequence::setTicksPerStep(double tps)
 {
   // std::unique_lock<std::shared_mutex> lock(*rw_mutex);
   this->originalTicksPerStep = tps;
   this->ticksElapsed = 0;
 }
 
-void Sequence::onZeroSetTicksPerStep(std::size_t _nextTicksPerStep)
+void Sequence::onZeroSetTicksPerStep(double _nextTicksPerStep)
 {
   // std::unique_lock<std::shared_mutex> lock(*rw_mutex);
   this->nextTicksPerStep = _nextTicksPerStep;
 }
 
-void Sequence::setTicksPerStepAdjustment(std::size_t tps)
+void Sequence::setTicksPerStepAdjustment(double tps)
 {
   if (tps < 1 || tps > 16)
     return;
   this->ticksPerStep = tps;
 }
 
-std::size_t Sequence::getTicksPerStep() const
+double Sequence::getTicksPerStep() const
 {
   // std::shared_lock<std::shared_mutex> lock(*rw_mutex);
   return this->originalTicksPerStep;
 }
 
-std::size_t Sequence::getNextTicksPerStep() const
+double Sequence::getNextTicksPerStep() const
 {
   // std::shared_lock<std::shared_mutex> lock(*rw_mutex);
   if (this->nextTicksPerStep == 0){
@@ -444,9 +698,10 @@ void Sequence::ensureEnoughStepsForLength(std::size_t length)
       Step s;
       s.setCallback(
           steps[0].getCallback());
-      s.setDataAt(0, Step::cmdInd, machineType);
+      s.setDataAt(0, Step::cmdInd, getRowCommand());
       steps.push_back(std::move(s));
     }
+    publishPattern();
   }
 }
 void Sequence::setLength(std::size_t length)
@@ -458,16 +713,30 @@ void Sequence::setLength(std::size_t length)
     return;
 
   currentLength = length;
+  publishPattern();
 }
 
 void Sequence::setStepData(std::size_t step, std::vector<std::vector<double>> data)
 {
   steps[step].setData(data);
+  publishPattern();
+}
+
+void Sequence::setSharedStepData(std::size_t step, Step::SharedRows data)
+{
+  steps[step].setSharedData(std::move(data));
+  publishPattern();
+}
+
+Step::SharedRows Sequence::getSharedStepData(std::size_t step) const
+{
+  return steps[step].getSharedData();
 }
 /** update a single data value in a given step*/
 void Sequence::setStepDataAt(std::size_t step, std::size_t row, std::size_t col, double value)
 {
   steps[step].setDataAt(row, col, value);
+  publishPattern();
 }
 
 void Sequence::setStepCallback(std::size_t step,
@@ -491,8 +760,9 @@ std::size_t Sequence::howManySteps() const
   //  case where length adjust is too high
   // if (currentLength + lengthAdjustment >= steps.size()) return currentLength;
 
-  const long long adjustedLength =
-      static_cast<long long>(currentLength) + static_cast<long long>(lengthAdjustment);
+  const long long adjustedLength = std::min(
+      static_cast<long long>(currentLength) + static_cast<long long>(lengthAdjustment),
+      static_cast<long long>(steps.size()));
   return adjustedLength > 0 ? static_cast<std::size_t>(adjustedLength) : 1u;
 }
 
@@ -508,6 +778,7 @@ std::size_t Sequence::howManyStepDataCols(std::size_t step)
 void Sequence::toggleActive(std::size_t step)
 {
   steps[step].toggleActive();
+  publishPattern();
 }
 bool Sequence::isStepActive(std::size_t step) const
 {
@@ -515,31 +786,68 @@ bool Sequence::isStepActive(std::size_t step) const
 }
 void Sequence::setType(SequenceType _type)
 {
+  if (this->type == _type)
+    return;
   this->type = _type;
+  // modulator rows and note rows read their columns differently
+  setRowCommands(getRowCommand(), isModulatorType(_type));
+  publishPattern();
 }
 SequenceType Sequence::getType() const
 {
   return this->type;
 }
 
-void Sequence::setMachineType(double newMachineType)
+bool Sequence::isModulatorType(SequenceType type)
 {
-  int maxCommands = CommandProcessor::countCommands();
-  if (maxCommands > 0)
+  return type == SequenceType::transposer
+      || type == SequenceType::lengthChanger
+      || type == SequenceType::tickChanger;
+}
+
+double Sequence::getRowCommand() const
+{
+  switch (type)
   {
-    if (newMachineType < 0) newMachineType = 0;
-    if (newMachineType >= maxCommands) newMachineType = maxCommands - 1;
+  case SequenceType::transposer: return static_cast<double>(CommandType::Transpose);
+  case SequenceType::lengthChanger: return static_cast<double>(CommandType::LengthMod);
+  case SequenceType::tickChanger: return static_cast<double>(CommandType::TickMod);
+  default: return machineType;
   }
-  this->machineType = newMachineType;
+}
+
+void Sequence::setRowCommands(double command, bool dropLockRows)
+{
   for (std::size_t step = 0; step < steps.size(); ++step)
   {
     for (std::size_t row = 0; row < steps[step].howManyDataRows(); ++row)
     {
-      steps[step].setDataAt(row, Step::cmdInd, newMachineType);
+      const double current = steps[step].getDataAt(row, Step::cmdInd);
+      // parameter lock rows keep targeting the stack whatever plays on it
+      if (current == command || (!dropLockRows && current == static_cast<double>(CommandType::ParamLock)))
+        continue;
+      steps[step].setDataAt(row, Step::cmdInd, command);
+      // setDataAt clamps to the new command's parameter ranges
+      for (std::size_t col = Step::cmdInd + 1; col < steps[step].howManyDataCols(); ++col)
+        steps[step].setDataAt(row, col, steps[step].getDataAt(row, col));
     }
   }
 }
 
+void Sequence::setMachineType(double newMachineType)
+{
+  int maxCommands = CommandProcessor::countCommands();
+  if (maxCommands > 0)
+  {
+    if (newMachineType < 0) newMachineType = 0;
+    if (newMachineType >= maxCommands) newMachineType = maxCommands - 1;
+  }
+  this->machineType = newMachineType;
+  // modulator rows keep their command, see getRowCommand
+  setRowCommands(getRowCommand(), isModulatorType(type));
+  publishPattern();
+}
+
 double Sequence::getMachineType() const
 {
   return this->machineType;
@@ -550,6 +858,7 @@ void Sequence::setMachineId(double newMachineId)
   if (newMachineId < 0) newMachineId = 0;
   if (newMachineId > 31) newMachineId = 31;
   this->machineId = newMachineId;
+  publishPattern();
 }
 
 double Sequence::getMachineId() const
@@ -562,6 +871,7 @@ void Sequence::setTriggerProbability(double newTriggerProbability)
   if (newTriggerProbability < 0) newTriggerProbability = 0;
   if (newTriggerProbability > 1) newTriggerProbability = 1;
   this->triggerProbability = newTriggerProbability;
+  publishPattern();
 }
 
 double Sequence::getTriggerProbability() const
@@ -571,7 +881,9 @@ double Sequence::getTriggerProbability() const
 
 SequenceReadOnly Sequence::getReadOnlyContext() const
 {
-  return SequenceReadOnly{triggerProbability, machineType, machineId};
+  SequenceReadOnly context{triggerProbability, machineType, machineId};
+  context.ticksPerStep = ticksPerStep;
+  return context;
 }
 
 void Sequence::setTranspose(double _transpose)
@@ -598,8 +910,9 @@ void Sequence::reset()
     // reset the data
     Step cleanStep{};
     step.setData(cleanStep.getData());
-    step.setDataAt(0, Step::cmdInd, machineType);
+    step.setDataAt(0, Step::cmdInd, getRowCommand());
   }
+  publishPattern();
 }
 std::vector<std::vector<std::string>> Sequence::stepAsGridOfStrings(std::size_t step)
 {
@@ -617,6 +930,7 @@ void Sequence::toggleMuteState()
 {
   // std::unique_lock<std::shared_mutex> lock(*rw_mutex);
   muted = !muted;
+  publishPattern();
 }
 
 void Sequence::rewindAtNextZero()
@@ -630,29 +944,142 @@ void Sequence::primeForImmediateTrigger()
   currentStep = 0;
   rewindAtNextZeroTick = false;
   nextTicksPerStep = 0;
-  tickOfFour = 3;
-  ticksElapsed = ticksPerStep > 0 ? ticksPerStep - 1 : 0;
+  tickOfFour = 4 * CommandProcessor::getTicksPerGridTick() - 1;
+  ticksElapsed = CommandProcessor::toEngineTicks(ticksPerStep) - 1;
 }
 
 void Sequence::resetForTransportStart()
 {
   deactivateProcessors();
+  random.reseed();
   currentStep = 0;
   rewindAtNextZeroTick = false;
   nextTicksPerStep = 0;
-  tickOfFour = 3;
-  ticksElapsed = ticksPerStep > 0 ? ticksPerStep - 1 : 0;
+  tickOfFour = 4 * CommandProcessor::getTicksPerGridTick() - 1;
+  ticksElapsed = CommandProcessor::toEngineTicks(ticksPerStep) - 1;
+  stepsPlayed = 0;
+}
+
+void Sequence::seekTo(std::uint64_t ticksSinceTransportStart)
+{
+  resetForTransportStart();
+  const std::uint64_t ticks = ticksSinceTransportStart;
+  if (ticks == 0)
+    return;
+  const std::uint64_t ticksPerFour = 4u * CommandProcessor::getTicksPerGridTick();
+  tickOfFour = static_cast<std::size_t>((ticksPerFour - 1u + ticks) % ticksPerFour);
+  // first tick triggers step 0, then one step every ticksPerStep ticks
+  const std::uint64_t stepTicks = CommandProcessor::toEngineTicks(ticksPerStep);
+  const std::uint64_t triggers = (ticks - 1u) / stepTicks + 1u;
+  ticksElapsed = static_cast<std::size_t>((ticks - 1u) % stepTicks);
+  stepsPlayed = triggers;
+  // the editor may be changing the length, so go by the pattern playback has
+  const SequencePattern& pattern = *playbackPattern;
+  if (pattern.length < 1 || pattern.length > pattern.stepData.size())
+    currentStep = 0;
+  else
+    currentStep = static_cast<std::size_t>(triggers % pattern.length);
+}
+
+bool Sequence::PlaybackPosition::samePlaceAs(const PlaybackPosition& other) const
+{
+  return currentStep == other.currentStep && ticksElapsed == other.ticksElapsed
+      && tickOfFour == other.tickOfFour && transpose == other.transpose
+      && lengthAdjustment == other.lengthAdjustment && ticksPerStep == other.ticksPerStep
+      && originalTicksPerStep == other.originalTicksPerStep && nextTicksPerStep == other.nextTicksPerStep
+      && rewindAtNextZeroTick == other.rewindAtNextZeroTick;
+}
+
+Sequence::PlaybackPosition Sequence::getPlaybackPosition() const
+{
+  PlaybackPosition position;
+  position.currentStep = currentStep;
+  position.ticksElapsed = ticksElapsed;
+  position.tickOfFour = tickOfFour;
+  position.transpose = transpose;
+  position.lengthAdjustment = lengthAdjustment;
+  position.ticksPerStep = ticksPerStep;
+  position.originalTicksPerStep = originalTicksPerStep;
+  position.nextTicksPerStep = nextTicksPerStep;
+  position.rewindAtNextZeroTick = rewindAtNextZeroTick;
+  position.stepsPlayed = stepsPlayed;
+  return position;
+}
+
+void Sequence::setStepsPlayed(std::uint64_t steps)
+{
+  // tick restarts random at stepsPlayed before any roll, so this is all it needs
+  stepsPlayed = steps;
+}
+
+void Sequence::rescaleTicks(std::size_t fromTicksPerGridTick, std::size_t toTicksPerGridTick)
+{
+  if (fromTicksPerGridTick == 0 || toTicksPerGridTick == 0)
+    return;
+  // the engine ticks left in the current grid tick are dropped, so count it as gone by
+  tickOfFour = ((tickOfFour / fromTicksPerGridTick + 1) * toTicksPerGridTick - 1) % (4 * toTicksPerGridTick);
+  ticksElapsed = (ticksElapsed / fromTicksPerGridTick + 1) * toTicksPerGridTick - 1;
+}
+
+std::uint64_t Sequence::getLoopTicks() const
+{
+  const SequencePattern& pattern = *playbackPattern;
+  const std::size_t length = std::max<std::size_t>(1, std::min(pattern.length, pattern.stepData.size()));
+  return static_cast<std::uint64_t>(length) * CommandProcessor::toEngineTicks(originalTicksPerStep);
+}
+
+bool Sequence::hasModulationRolls() const
+{
+  const SequencePattern& pattern = *playbackPattern;
+  if (!isModulatorType(pattern.type) || pattern.muted)
+    return false;
+  for (std::size_t step = 0; step < pattern.stepData.size(); ++step)
+  {
+    if (!pattern.stepActive[step])
+      continue;
+    for (const std::vector<double>& row : *pattern.stepData[step])
+    {
+      // same check as modulate: certain rows always or never fire
+      if (row.size() <= Step::probInd || row[Step::noteInd] == 0)
+        continue;
+      const double probability = pattern.triggerProbability > 0 ? pattern.triggerProbability : row[Step::probInd];
+      if (probability > 0 && probability < 1)
+        return true;
+    }
+  }
+  return false;
 }
 
 
 /////////////////////// Sequencer
 
+namespace
+{
+std::string sequenceTypeLabel(SequenceType type)
+{
+  switch (type)
+  {
+  case SequenceType::midiNote: return "NOTE";
+  case SequenceType::drumMidi: return "DRUM";
+  case SequenceType::chordMidi: return "CHRD";
+  case SequenceType::samplePlayer: return "SAMP";
+  case SequenceType::transposer: return "TRN";
+  case SequenceType::lengthChanger: return "LEN";
+  case SequenceType::tickChanger: return "TPS";
+  }
+  return "?";
+}
+}
+
 Sequencer::Sequencer(std::size_t seqCount, std::size_t seqLength) : rw_mutex{std::make_unique<std::shared_mutex>()}, playing{true}, triggerOnTick{true}, stringUpdateRequested{false}
 {
+  assert(seqCount <= maxSequences);
   for (std::size_t i = 0; i < seqCount; ++i)
   {
     sequences.push_back(Sequence{this, seqLength});
+    sequences.back().setRandomSeed(FastRandom::seedForIndex(0u, static_cast<std::uint32_t>(i)));
   }
+  sequenceSources.assign(sequences.size(), SequenceSource{});
 
   
   updateSeqStringGrid();
@@ -679,6 +1106,85 @@ Sequencer::~Sequencer()
 {
 }
 
+void Sequencer::copyPatternsFrom(const Sequencer& otherSeq)
+{
+  std::unique_lock<std::shared_mutex> lock(*rw_mutex);
+  std::shared_lock<std::shared_mutex> otherLock(*otherSeq.rw_mutex);
+
+  std::vector<Sequence> clones;
+  clones.reserve(otherSeq.sequences.size());
+  for (const Sequence& seq : otherSeq.sequences)
+    clones.push_back(seq.cloneFor(this));
+  sequences = std::move(clones);
+  sequenceSources.assign(sequences.size(), SequenceSource{});
+  stringUpdateRequested = true;
+}
+
+void Sequencer::copySequenceFrom(const Sequencer& otherSeq, std::size_t otherSequence, std::size_t sequence)
+{
+  if (&otherSeq == this)
+  {
+    std::unique_lock<std::shared_mutex> lock(*rw_mutex);
+    if (!assertSequence(sequence) || !assertSequence(otherSequence) || sequence == otherSequence)
+      return;
+    sequences[sequence] = sequences[otherSequence].cloneFor(this);
+    stringUpdateRequested = true;
+    return;
+  }
+
+  std::unique_lock<std::shared_mutex> lock(*rw_mutex);
+  std::shared_lock<std::shared_mutex> otherLock(*otherSeq.rw_mutex);
+  if (!assertSequence(sequence) || !otherSeq.assertSequence(otherSequence))
+    return;
+  sequences[sequence] = otherSeq.sequences[otherSequence].cloneFor(this);
+  stringUpdateRequested = true;
+}
+
+void Sequencer::setSequenceSource(std::size_t sequence, Sequencer* sourceSet, std::size_t sourceTrack)
+{
+  if (!assertSequence(sequence))
+    return;
+  // pointing a track back at itself is the same as having no source
+  if (sourceSet == nullptr || (sourceSet == this && sourceTrack == sequence))
+    sequenceSources[sequence] = SequenceSource{};
+  else
+    sequenceSources[sequence] = SequenceSource{sourceSet, sourceTrack};
+}
+
+void Sequencer::clearSequenceSources()
+{
+  std::fill(sequenceSources.begin(), sequenceSources.end(), SequenceSource{});
+}
+
+bool Sequencer::playsSequence(const Sequencer& set, std::size_t track) const
+{
+  if (track >= set.sequences.size())
+    return false;
+  for (std::size_t i = 0; i < sequences.size(); ++i)
+  {
+    if (&playingSequence(i) == &set.sequences[track])
+      return true;
+  }
+  return false;
+}
+
+Sequence& Sequencer::playingSequence(std::size_t sequence)
+{
+  // a source that has since lost the track falls back to our own
+  const SequenceSource& source = sequenceSources[sequence];
+  if (source.set != nullptr && source.track < source.set->sequences.size())
+    return source.set->sequences[source.track];
+  return sequences[sequence];
+}
+
+const Sequence& Sequencer::playingSequence(std::size_t sequence) const
+{
+  const SequenceSource& source = sequenceSources[sequence];
+  if (source.set != nullptr && source.track < source.set->sequences.size())
+    return source.set->sequences[source.track];
+  return sequences[sequence];
+}
+
 void Sequencer::copyChannelAndTypeSettings(Sequencer *otherSeq)
 {
   std::unique_lock<std::shared_mutex> lock(*rw_mutex);
@@ -709,7 +1215,7 @@ std::size_t Sequencer::howManySteps(std::size_t sequence) const
 }
 std::size_t Sequencer::getCurrentStep(std::size_t sequence) const
 {
-  return sequences[sequence].getCurrentStep();
+  return playingSequence(sequence).getCurrentStep();
 }
 
 SequenceType Sequencer::getSequenceType(std::size_t sequence) const
@@ -717,12 +1223,12 @@ SequenceType Sequencer::getSequenceType(std::size_t sequence) const
   return sequences[sequence].getType();
 }
 
-std::size_t Sequencer::getSequenceTicksPerStep(std::size_t sequence) const
+double Sequencer::getSequenceTicksPerStep(std::size_t sequence) const
 {
   return sequences[sequence].getTicksPerStep();
 }
 
-std::size_t Sequencer::getSequencerNextTicksPerStep(std::size_t sequence) const
+double Sequencer::getSequencerNextTicksPerStep(std::size_t sequence) const
 {
   return sequences[sequence].getNextTicksPerStep();
 }
@@ -731,22 +1237,67 @@ std::size_t Sequencer::getSequencerNextTicksPerStep(std::size_t sequence) const
 /** move the sequencer along by one tick */
 void Sequencer::tick()
 {
-  bool updateStrings = false;
+  // deliberately lock free: each sequence plays from its own published pattern snapshot,
+  // so edits made through the rw_mutex never hold up the audio thread
+  if (playing)
   {
-    std::unique_lock<std::shared_mutex> lock(*rw_mutex);
-
-    updateStrings = stringUpdateRequested;
-    stringUpdateRequested = false;
-    if (playing)
+    // modulators go first so a transpose, length or speed change lands on the step
+    // its target plays in this same tick
+    modulatorTracks.reset();
+    for (std::size_t i = 0; i < sequences.size(); ++i)
     {
-      for (auto& seq : sequences)
-      {
-        seq.tick(triggerOnTick);
-      }
+      if (playingSequence(i).acquirePattern())
+        modulatorTracks.set(i);
     }
+    tickPlayingSequences(triggerOnTick, triggerOnTick);
+  }
+}
+
+void Sequencer::tickPlayingSequences(bool triggerModulators, bool triggerNotes)
+{
+  for (std::size_t i = 0; i < sequences.size(); ++i)
+  {
+    if (modulatorTracks.test(i))
+      playingSequence(i).tick(*this, triggerModulators);
+  }
+  for (std::size_t i = 0; i < sequences.size(); ++i)
+  {
+    if (!modulatorTracks.test(i))
+      playingSequence(i).tick(*this, triggerNotes);
+  }
+}
+
+bool Sequencer::getPlayingMachineId(std::size_t sequence, std::size_t& machineId) const
+{
+  if (!assertSequence(sequence))
+    return false;
+  const SequencePattern& pattern = playingSequence(sequence).getPlaybackPattern();
+  if (pattern.muted || Sequence::isModulatorType(pattern.type) || pattern.machineId < 0)
+    return false;
+  machineId = static_cast<std::size_t>(pattern.machineId);
+  return true;
+}
+
+void Sequencer::modulateSequence(std::size_t sequence, SequenceType type, double amount)
+{
+  // a modulator modulating a modulator would depend on which one ticked first
+  if (!assertSequence(sequence) || modulatorTracks.test(sequence))
+    return;
+  Sequence& target = playingSequence(sequence);
+  switch (type)
+  {
+  case SequenceType::transposer:
+    target.setTranspose(amount);
+    break;
+  case SequenceType::lengthChanger:
+    target.setLengthAdjustment(static_cast<int>(amount));
+    break;
+  case SequenceType::tickChanger:
+    target.setTicksPerStepAdjustment(amount);
+    break;
+  default:
+    break;
   }
-  if (updateStrings)
-    updateSeqStringGrid();
 }
 
 void Sequencer::triggerStep(std::size_t seq, std::size_t step, std::size_t row)
@@ -796,12 +1347,14 @@ void Sequencer::setStepData(std::size_t sequence, std::size_t step, std::vector<
 
   if (!assertSeqAndStep(sequence, step))
     return;
-  double machineType = sequences[sequence].getMachineType();
+  const double rowCommand = sequences[sequence].getRowCommand();
+  const bool modulator = Sequence::isModulatorType(sequences[sequence].getType());
   for (auto& row : data)
   {
     if (row.size() < Step::maxInd + 1)
       row.resize(Step::maxInd + 1, 0.0);
-    row[Step::cmdInd] = machineType;
+    if (modulator || !Step::isParameterLockRow(row))
+      row[Step::cmdInd] = rowCommand;
   }
   sequences[sequence].setStepData(step, data);
 }
@@ -813,9 +1366,24 @@ void Sequencer::setStepDataAt(std::size_t sequence, std::size_t step, std::size_
 
   if (!assertSeqAndStep(sequence, step))
     return;
-  if (col == Step::cmdInd)
-    value = sequences[sequence].getMachineType();
-  sequences[sequence].setStepDataAt(step, row, col, value);
+  if (col != Step::cmdInd)
+  {
+    sequences[sequence].setStepDataAt(step, row, col, value);
+    return;
+  }
+  // a row either plays the sequence's machine or holds a parameter lock. Modulator rows have no choice
+  if (value != static_cast<double>(CommandType::ParamLock) || Sequence::isModulatorType(sequences[sequence].getType()))
+    value = sequences[sequence].getRowCommand();
+  if (row >= sequences[sequence].howManyStepDataRows(step)
+      || sequences[sequence].getStepDataAt(step, row, Step::cmdInd) == value)
+    return;
+  // the columns mean different things to the new command, so start them from its defaults
+  std::vector<std::vector<double>> data = sequences[sequence].getStepData(step);
+  const Command& cmd = CommandProcessor::getCommand(value);
+  data[row][Step::cmdInd] = value;
+  for (std::size_t p = 0; p < cmd.parameters.size() && p + 1 < data[row].size(); ++p)
+    data[row][p + 1] = cmd.parameters[p].defaultValue;
+  sequences[sequence].setStepData(step, data);
 }
 
 std::size_t Sequencer::howManyStepDataRows(std::size_t seq, std::size_t step)
@@ -838,6 +1406,22 @@ std::vector<std::vector<double>> Sequencer::getStepData(std::size_t sequence, st
   return sequences[sequence].getStepData(step);
 }
 
+Step::SharedRows Sequencer::getSharedStepData(std::size_t sequence, std::size_t step) const
+{
+  std::shared_lock<std::shared_mutex> lock(*rw_mutex);
+  if (!assertSeqAndStep(sequence, step))
+    return nullptr;
+  return sequences[sequence].getSharedStepData(step);
+}
+
+void Sequencer::setSharedStepData(std::size_t sequence, std::size_t step, Step::SharedRows data)
+{
+  std::unique_lock<std::shared_mutex> lock(*rw_mutex);
+  if (!assertSeqAndStep(sequence, step) || data == nullptr)
+    return;
+  sequences[sequence].setSharedStepData(step, std::move(data));
+}
+
 // /** retrieve the data for a specific step */
 // std::vector<std::vector<double>>* Sequencer::getStepDataDirect(std::size_t sequence, std::size_t step)
 // {
@@ -947,6 +1531,15 @@ void Sequencer::updateSeqStringGrid()
 
 std::vector<std::vector<std::string>> &Sequencer::getSequenceAsGridOfStrings()
 {
+  bool updateStrings = false;
+  {
+    std::unique_lock<std::shared_mutex> lock(*rw_mutex);
+    updateStrings = stringUpdateRequested;
+    stringUpdateRequested = false;
+  }
+  // rebuilt here on the reading thread rather than in tick, which must not allocate
+  if (updateStrings)
+    updateSeqStringGrid();
   std::shared_lock<std::shared_mutex> lock(*rw_mutex);// read lock
   return seqAsStringGrid;
 }
@@ -984,11 +1577,16 @@ std::vector<std::vector<std::string>> Sequencer::getSequenceConfigsAsGridOfStrin
         confGrid[seq].push_back(p.shortName + ":" + Step::dblToString(sequence->getMachineId(), decPlaces));
       }
       else if (paramIndex == Sequence::tpsConfig){
-        confGrid[seq].push_back(p.shortName + ":" + std::to_string(getSequencerNextTicksPerStep(seq)));    
+        // a step length between grid ticks, set at a finer tick resolution
+        const double tps = getSequencerNextTicksPerStep(seq);
+        confGrid[seq].push_back(p.shortName + ":" + Step::dblToString(tps, tps != std::floor(tps) ? 2u : 0u));
       }
       else if (paramIndex == Sequence::probConfig){
         confGrid[seq].push_back(p.shortName + ":" + Step::dblToString(sequence->getTriggerProbability(), decPlaces));
       }
+      else if (paramIndex == Sequence::typeConfig){
+        confGrid[seq].push_back(p.shortName + ":" + sequenceTypeLabel(sequence->getType()));
+      }
     }
   }    
   return confGrid;
@@ -1007,10 +1605,12 @@ std::vector<Parameter>& Sequencer::getSeqConfigSpecs()
 }
 void Sequencer::setupSeqConfigSpecs()
 {
-  seqConfigSpecs.resize(3);
+  seqConfigSpecs.resize(4);
   seqConfigSpecs[Sequence::machineIdConfig] = Parameter("Machine ID", "ID", 0, 31, 1, 1, -1);
-  seqConfigSpecs[Sequence::tpsConfig] = Parameter("Quarter beats per step", "QBS", 1, 16, 1, 4, -1);
+  seqConfigSpecs[Sequence::tpsConfig] = Parameter("Quarter beats per step", "QBS", 1, 16, 1, 4, -1, 0, true);
   seqConfigSpecs[Sequence::probConfig] = Parameter("Trig Prob", "P", 0.0, 1.0, 0.1, 0.0, -1, 2);
+  // stepped by SequencerEditor::nextSequenceType rather than by value
+  seqConfigSpecs[Sequence::typeConfig] = Parameter("Sequence type", "T", 0, 6, 1, 0, -1);
   // TODO
   // seqParamSpecs.push_back(Parameter("Velocity variation plus/minus %", "velvary", 0.0, 1.0, 0.1, 0.0));
   // seqParamSpecs.push_back(Parameter("Shuffle +/- ticks", "shuf", 0, 3, 1, 0.0));
@@ -1048,11 +1648,11 @@ void Sequencer::incrementSeqParam(std::size_t seq, std::size_t paramIndex)
     sequence->setTriggerProbability(val);
   }
   if (paramIndex == Sequence::tpsConfig){
-    double tps = static_cast<double>(sequences[seq].getTicksPerStep());
-    tps += p.step;
+    double tps = sequences[seq].getTicksPerStep();
+    tps = CommandProcessor::roundToEngineTicks(tps + p.step * CommandProcessor::getEngineTickInGridTicks());
     if (tps > p.max) tps = p.max;
     if (tps < p.min) tps = p.min;
-    sequences[seq].onZeroSetTicksPerStep(static_cast<std::size_t>(tps));
+    sequences[seq].onZeroSetTicksPerStep(tps);
   }
 
 }
@@ -1086,11 +1686,11 @@ void Sequencer::decrementSeqParam(std::size_t seq, std::size_t paramIndex)
     sequence->setTriggerProbability(val);
   }
   if (paramIndex == Sequence::tpsConfig){
-    double tps = static_cast<double>(sequences[seq].getTicksPerStep());
-    tps -= p.step;
+    double tps = sequences[seq].getTicksPerStep();
+    tps = CommandProcessor::roundToEngineTicks(tps - p.step * CommandProcessor::getEngineTickInGridTicks());
     if (tps < p.min) tps = p.min;
     if (tps > p.max) tps = p.max;
-    sequences[seq].onZeroSetTicksPerStep(static_cast<std::size_t>(tps));
+    sequences[seq].onZeroSetTicksPerStep(tps);
   }
 }
 
@@ -1101,15 +1701,21 @@ void Sequencer::incrementStepDataAt(std::size_t sequence, std::size_t step, std:
   double val = getStepDataAt(sequence, step, row, col);
 
   // check if they are changing the step command. 
-  // if so, do not use param config stuff to edit. 
+  // if so, do not use param config stuff to edit - flip between
+  // the sequence's machine and a parameter lock
   if (col == Step::cmdInd) {
-    val = sequences[sequence].getMachineType();
+    val = val == static_cast<double>(CommandType::ParamLock)
+        ? sequences[sequence].getRowCommand()
+        : static_cast<double>(CommandType::ParamLock);
   }
   else {
     double stepCmd = getStepDataAt(sequence, step, row, Step::cmdInd);
     // param dictates the step, min and max for this column
     Parameter param = CommandProcessor::getCommand(stepCmd).parameters[col-1]; // -1 as the first col is the command which has no parameter
-    val += param.step;
+    if (param.isGridTickLength)
+      val = CommandProcessor::roundToEngineTicks(val + param.step * CommandProcessor::getEngineTickInGridTicks());
+    else
+      val += param.step;
     if (val > param.max) val = param.max;
   }
   setStepDataAt(sequence, step, row, col, val);
@@ -1119,14 +1725,19 @@ void Sequencer::decrementStepDataAt(std::size_t sequence, std::size_t step, std:
 {
   double val = getStepDataAt(sequence, step, row, col);
   if (col == Step::cmdInd) {
-    val = sequences[sequence].getMachineType();
+    val = val == static_cast<double>(CommandType::ParamLock)
+        ? sequences[sequence].getRowCommand()
+        : static_cast<double>(CommandType::ParamLock);
   }
   else {
     // get the step param config for the step's 
     double stepCmd = getStepDataAt(sequence, step, row, Step::cmdInd);
     // param dictates the step, min and max for this column
     Parameter param = CommandProcessor::getCommand(stepCmd).parameters[col-1]; // -1 as the first col is the command which has no parameter
-    val -= param.step;
+    if (param.isGridTickLength)
+      val = CommandProcessor::roundToEngineTicks(val - param.step * CommandProcessor::getEngineTickInGridTicks());
+    else
+      val -= param.step;
     if (val < param.min) val = param.min;
   }
   setStepDataAt(sequence, step, row, col, val);
@@ -1168,29 +1779,169 @@ bool Sequencer::isPlaying() const
   return playing; 
 }
 
+void Sequencer::holdPatternPublishing()
+{
+  for (Sequence& seq : sequences)
+    seq.holdPublishing();
+}
+
+void Sequencer::releasePatternPublishing()
+{
+  for (Sequence& seq : sequences)
+    seq.releasePublishing();
+}
+
 void Sequencer::rewindAtNextZero()
 {
-  for (Sequence& seq : sequences){seq.rewindAtNextZero();}
+  for (std::size_t i = 0; i < sequences.size(); ++i){playingSequence(i).rewindAtNextZero();}
 }
 
 void Sequencer::primeForImmediateTrigger()
 {
-  for (Sequence& seq : sequences){seq.primeForImmediateTrigger();}
+  for (std::size_t i = 0; i < sequences.size(); ++i){playingSequence(i).primeForImmediateTrigger();}
 }
 
 void Sequencer::resetForTransportStart()
 {
-  for (Sequence& seq : sequences){seq.resetForTransportStart();}
+  for (std::size_t i = 0; i < sequences.size(); ++i){playingSequence(i).resetForTransportStart();}
+}
+
+void Sequencer::resetSequenceForTransportStart(std::size_t sequence)
+{
+  if (assertSequence(sequence))
+    sequences[sequence].resetForTransportStart();
+}
+
+void Sequencer::rescaleTicks(std::size_t fromTicksPerGridTick, std::size_t toTicksPerGridTick)
+{
+  for (auto& sequence : sequences)
+    sequence.rescaleTicks(fromTicksPerGridTick, toTicksPerGridTick);
+}
+
+void Sequencer::seekTo(std::uint64_t ticksSinceTransportStart)
+{
+  modulatorTracks.reset();
+  for (std::size_t i = 0; i < sequences.size(); ++i)
+  {
+    if (playingSequence(i).acquirePattern())
+      modulatorTracks.set(i);
+  }
+  if (modulatorTracks.none())
+  {
+    for (std::size_t i = 0; i < sequences.size(); ++i){playingSequence(i).seekTo(ticksSinceTransportStart);}
+    return;
+  }
+  // adjusters move where later steps land, so replay the ticks in tick's order.
+  // Only modulators trigger, and all they do is set adjusters, so nothing sounds.
+  // The modulators come round every loopTicks, so once every sequence is back where it was a
+  // whole number of loops ago, playback repeats from there and the repeats can be skipped.
+  // Brent's cycle search: compare against a reference that moves on after 1, 2, 4... loops
+  resetForTransportStart();
+  const std::uint64_t loopTicks = getModulatorLoopTicks();
+  const std::uint64_t maxReplayTicks = getMaxSeekReplayTicks();
+  bool repeatsExactly = true;
+  for (std::size_t i = 0; i < sequences.size(); ++i)
+  {
+    if (modulatorTracks.test(i) && playingSequence(i).hasModulationRolls())
+      repeatsExactly = false;
+  }
+  std::uint64_t tick = 0;
+  std::uint64_t referenceTick = 0;
+  std::uint64_t loopsPerReference = 1;
+  std::uint64_t loopsSinceReference = 0;
+  for (std::size_t i = 0; i < sequences.size(); ++i){seekReference[i] = playingSequence(i).getPlaybackPosition();}
+  while (ticksSinceTransportStart - tick >= loopTicks)
+  {
+    if (tick >= maxReplayTicks)
+    {
+      // nothing repeated in time, e.g. modulators that roll: treat the last stretch as the repeat
+      tick = skipSeekRepeats(tick, tick - referenceTick, ticksSinceTransportStart);
+      break;
+    }
+    if (loopsSinceReference == loopsPerReference)
+    {
+      for (std::size_t i = 0; i < sequences.size(); ++i){seekReference[i] = playingSequence(i).getPlaybackPosition();}
+      referenceTick = tick;
+      loopsPerReference *= 2;
+      loopsSinceReference = 0;
+    }
+    for (std::uint64_t t = 0; t < loopTicks; ++t){tickPlayingSequences(true, false);}
+    tick += loopTicks;
+    ++loopsSinceReference;
+
+    bool repeated = repeatsExactly;
+    for (std::size_t i = 0; i < sequences.size() && repeated; ++i)
+      repeated = playingSequence(i).getPlaybackPosition().samePlaceAs(seekReference[i]);
+    if (repeated)
+    {
+      tick = skipSeekRepeats(tick, tick - referenceTick, ticksSinceTransportStart);
+      break;
+    }
+  }
+  for (; tick < ticksSinceTransportStart; ++tick){tickPlayingSequences(true, false);}
+}
+
+std::uint64_t Sequencer::getMaxSeekReplayTicks()
+{
+  return maxSeekReplayGridTicks * CommandProcessor::getTicksPerGridTick();
+}
+
+std::uint64_t Sequencer::getModulatorLoopTicks() const
+{
+  // a multiple of four grid ticks keeps tickOfFour in step too
+  std::uint64_t loopTicks = 4u * CommandProcessor::getTicksPerGridTick();
+  for (std::size_t i = 0; i < sequences.size(); ++i)
+  {
+    if (!modulatorTracks.test(i))
+      continue;
+    const std::uint64_t next = std::lcm(loopTicks, playingSequence(i).getLoopTicks());
+    // loops that line up this rarely are not worth the wait: the search gives up on them anyway
+    if (next > getMaxSeekReplayTicks())
+      break;
+    loopTicks = next;
+  }
+  return loopTicks;
+}
+
+std::uint64_t Sequencer::skipSeekRepeats(std::uint64_t tick, std::uint64_t cycleTicks, std::uint64_t untilTick)
+{
+  if (cycleTicks == 0)
+    return tick;
+  const std::uint64_t repeats = (untilTick - tick) / cycleTicks;
+  // work out every count first: two tracks can play the same source sequence
+  for (std::size_t i = 0; i < sequences.size(); ++i)
+  {
+    const std::uint64_t stepsPlayed = playingSequence(i).getPlaybackPosition().stepsPlayed;
+    seekReference[i].stepsPlayed = stepsPlayed + (stepsPlayed - seekReference[i].stepsPlayed) * repeats;
+  }
+  for (std::size_t i = 0; i < sequences.size(); ++i){playingSequence(i).setStepsPlayed(seekReference[i].stepsPlayed);}
+  return tick + repeats * cycleTicks;
 }
 
 std::size_t Sequencer::getTicksElapsed(std::size_t sequence) const
 {
-  return sequences[sequence].getTicksElapsed();
+  return playingSequence(sequence).getTicksElapsed();
 }
 
 std::size_t Sequencer::getTickOfFour(std::size_t sequence) const
 {
-  return sequences[sequence].getTickOfFour();
+  return playingSequence(sequence).getTickOfFour();
+}
+
+void Sequencer::setSequenceRandomSeed(std::size_t sequence, std::uint32_t seed)
+{
+  std::unique_lock<std::shared_mutex> lock(*rw_mutex);
+  if (!assertSequence(sequence))
+    return;
+  sequences[sequence].setRandomSeed(seed);
+}
+
+std::uint32_t Sequencer::getSequenceRandomSeed(std::size_t sequence) const
+{
+  std::shared_lock<std::shared_mutex> lock(*rw_mutex);
+  if (!assertSequence(sequence))
+    return 0u;
+  return sequences[sequence].getRandomSeed();
 }
 
 
@@ -17,10 +17,16 @@
 #include <shared_mutex>
 #include <memory>
 #include <unordered_map>
+#include <cstdint>
+#include <bitset>
+#include <array>
+#include <atomic>
 
 
 #include "SequencerEditor.h"
 #include "SequencerCommands.h"
+#include "FastRandom.h"
+#include "SnapshotExchange.h"
 //#include "ChordUtils.h"
 // #include "SequencerUtils.h"
 // #include "MachineUtils.h"
@@ -32,6 +38,24 @@
  * and data[2] is the first note
  * 
 */
+/** an atomic value that can still be moved along with the object holding it.
+ * Loads and stores are relaxed: use it for single values one thread writes while
+ * another only displays them, not to order other memory */
+template <typename T>
+class RelaxedAtomic
+{
+  public:
+    RelaxedAtomic(T initial = T{}) : value{initial} {}
+    RelaxedAtomic(RelaxedAtomic&& other) noexcept : value{other.load()} {}
+    RelaxedAtomic& operator=(RelaxedAtomic&& other) noexcept { store(other.load()); return *this; }
+    RelaxedAtomic& operator=(T newValue) { store(newValue); return *this; }
+    operator T() const { return load(); }
+    T load() const { return value.load(std::memory_order_relaxed); }
+    void store(T newValue) { value.store(newValue, std::memory_order_relaxed); }
+  private:
+    std::atomic<T> value;
+};
+
 // Single sequencer step with data rows and a trigger callback.
 class Step{
   
@@ -45,7 +69,11 @@ class Step{
     /** when populating an empty step, use this */
     const static std::size_t maxInd{4};
 
-    
+    /** a step's data rows. Blocks are immutable once shared, see getSharedData */
+    using Rows = std::vector<std::vector<double>>;
+    /** a shared block. Always allocate it as a (non-const) Rows and convert, because
+     * editData writes a block in place once it is the only owner */
+    using SharedRows = std::shared_ptr<const Rows>;
     
     Step();
 
@@ -60,6 +88,14 @@ class Step{
 
     /** returns a copy of the data stored in this step*/
     std::vector<std::vector<double>> getData() const;
+    /** returns the step's data block without copying it. Other steps (e.g. in cloned
+     * sequence sets) may share the same block - it is copied on the next write to either step
+    */
+    SharedRows getSharedData() const;
+    /** point this step at an existing data block instead of copying it */
+    void setSharedData(SharedRows sharedData);
+    /** returns a new step that shares this step's data block, activity and callback */
+    Step clone() const;
     /** get the memory address of the data in this step for direct access*/
     // std::vector<std::vector<double>>* getDataDirect();
     /** returns a one line string representation of the step's data */
@@ -93,17 +129,25 @@ class Step{
     bool isActive() const;
     /** convert double to string with sent no. decimal places*/
       static std::string dblToString(double val, std::size_t dps);
+    /** true if the row holds a machine parameter lock rather than playing the sequence's machine */
+    static bool isParameterLockRow(const std::vector<double>& row);
+    /** true if the row is a transposer, length or tick changer row rather than a note */
+    static bool isModulatorRow(const std::vector<double>& row);
   private: 
 
   // clever mutex that allows multiple concurrent reads but a block-all write 
   // it has to be a shared pointer as the mutex constrains how this object can be used
   // which is also why I have set the constructors up how I have above.
     std::unique_ptr<std::shared_mutex> rw_mutex;
-    /** the data for the step: rows and columns*/
-    std::vector<std::vector<double>> data;
+    /** the data for the step: rows and columns. Copy on write, so never edit it in place -
+     * go through editData */
+    SharedRows data;
     bool active;
     std::function<void(std::vector<std::vector<double>>*)> stepCallback;
 
+    /** returns the data for writing, first taking a private copy if the block is shared */
+    Rows& editData();
+
 };
 
 /** need this so can have a Sequencer data member in Sequence*/
@@ -113,9 +157,31 @@ class Sequencer;
  * midiNote sends midi notes out
  * samplePlayer triggers internal samples
  * transposer transposes another sequence 
+ * lengthChanger lengthens or shortens another sequence
+ * tickChanger changes another sequence's ticks per step
+ * The last three are modulators: their rows target another sequence and
+ * are applied before any notes play in the same tick. Modulations last until
+ * the target gets back to step 0.
  **/
 enum class SequenceType {midiNote, drumMidi, chordMidi, samplePlayer, transposer, lengthChanger, tickChanger};
 
+/** immutable copy of everything Sequence::tick reads from the editable pattern.
+ * The editor builds a new one after each edit and the audio thread swaps it in
+ * at the start of a tick, so playback never waits on an editor lock.
+*/
+struct SequencePattern {
+  /** data rows for each step. Shares the editor's blocks, see Step::getSharedData */
+  std::vector<Step::SharedRows> stepData;
+  /** activity status of each step */
+  std::vector<bool> stepActive;
+  std::size_t length;
+  SequenceType type;
+  double machineType;
+  double machineId;
+  double triggerProbability;
+  bool muted;
+};
+
 // Sequencer track with steps, playback state, and machine config.
 class Sequence{
   public:
@@ -123,7 +189,8 @@ class Sequence{
     const static std::size_t machineIdConfig{0}; 
     const static std::size_t tpsConfig{1};
     const static std::size_t probConfig{2};
-    const static std::size_t machineTypeConfig{3};
+    const static std::size_t typeConfig{3};
+    const static std::size_t machineTypeConfig{4};
      
     
 
@@ -136,9 +203,27 @@ class Sequence{
     Sequence(Sequence&& other) noexcept = default;
     Sequence& operator=(Sequence&& other) noexcept = default;
 
-
-    /** go to the next step. If trigger is false, just move along without triggering. */
-    void tick(bool trigger = true);
+    /** returns a copy of this sequence owned by the sent sequencer. Step data blocks are
+     * shared with this sequence rather than copied, so the clone costs one pointer per step
+     * until one of them is edited. Playback state starts from the top.
+    */
+    Sequence cloneFor(Sequencer* owner) const;
+    /** hash of everything that is saved for this sequence: settings, step activity and step data.
+     * Equal sequences always hash the same. Use hasSameContent to rule out collisions.
+    */
+    std::uint64_t getContentHash() const;
+    /** true if the sent sequence would save identically to this one */
+    bool hasSameContent(const Sequence& other) const;
+
+
+    /** pick up the latest published pattern. Returns true if it plays as a modulator.
+     * Call from the ticking thread before tick */
+    bool acquirePattern();
+    /** the pattern tick last acquired. Only read it where tick could run, as it is swapped there */
+    const SequencePattern& getPlaybackPattern() const;
+    /** move on one engine tick through the acquired pattern. If trigger is false, just move along without triggering.
+     * Modulator rows act on host's sequences */
+    void tick(Sequencer& host, bool trigger = true);
     /** trigger a step's callback right now */
     void triggerStep(std::size_t step, std::size_t row);
     /** which step are you on? */
@@ -158,6 +243,10 @@ class Sequence{
     // Step* getStep(std::size_t step);
     /** set the data for the sent step */
     void setStepData(std::size_t step, std::vector<std::vector<double>> data);
+    /** point the sent step at an existing shared data block */
+    void setSharedStepData(std::size_t step, Step::SharedRows data);
+    /** get the sent step's shared data block */
+    Step::SharedRows getSharedStepData(std::size_t step) const;
     /** retrieve a copy of the step data for the current step */
     std::vector<std::vector<double>> getCurrentStepData();
     /** what is the length of the sequence? Length is a temporary property used
@@ -177,25 +266,28 @@ class Sequence{
   
     /**
      * Set the permanent tick per step. To apply a temporary
-     * change, call setTicksPerStepAdjustment
+     * change, call setTicksPerStepAdjustment.
+     * Ticks per step count grid ticks, so saved songs keep their timing at any resolution,
+     * but tick runs on engine ticks: at finer resolutions a step can be a fraction of a
+     * grid tick longer or shorter, rounded to whole engine ticks
      */
-    void setTicksPerStep(std::size_t ticksPerStep);
-    void onZeroSetTicksPerStep(std::size_t nextTicksPerStep);
-    /** set a new ticks per step until the sequence hits step 0*/
-    void setTicksPerStepAdjustment(std::size_t ticksPerStep);
+    void setTicksPerStep(double ticksPerStep);
+    void onZeroSetTicksPerStep(double nextTicksPerStep);
+    /** set a new ticks per step until the sequence hits step 0. Values outside 1-16 are ignored */
+    void setTicksPerStepAdjustment(double ticksPerStep);
     /** return my permanent ticks per step (not the adjusted one)*/
-    std::size_t getTicksPerStep() const;
+    double getTicksPerStep() const;
     /** returns the upcoming ticks per step, in case you want the value sent to onZeroSetTicksPerStep */
-    std::size_t getNextTicksPerStep() const;
+    double getNextTicksPerStep() const;
     /** apply a transpose to the sequence, which is reset when the sequence
      * hits step 0 again
      */
     void setTranspose(double _transpose);
     /** apply a length adjustment to the sequence. This immediately changes the length.
      * It is reset when the sequence
-     * hits step 0 again
+     * hits step 0 again. Safe on the audio thread: the length never goes past the steps that exist
      */
-    void setLengthAdjustment(std::size_t lengthAdjust);
+    void setLengthAdjustment(int lengthAdjust);
 
     /** how many steps does this sequence have it total. This is independent of the length. Length can be lower than how many steps*/
     std::size_t howManySteps() const ;
@@ -213,6 +305,10 @@ class Sequence{
     /** set the sequence type */
     void setType(SequenceType _type);
     SequenceType getType() const;
+    /** true for the sequence types that modulate other sequences rather than playing notes */
+    static bool isModulatorType(SequenceType type);
+    /** the command plain rows of this sequence run: the modulator command for modulator types, otherwise the machine type */
+    double getRowCommand() const;
     void setMachineType(double machineType);
     double getMachineType() const;
     void setMachineId(double machineId);
@@ -237,49 +333,114 @@ class Sequence{
     bool isMuted() const;
     /** change mote state to its opposite */
     void toggleMuteState();
+    /** keep edits from reaching the audio thread until releasePublishing, so a burst of edits
+     * hands over one pattern rather than one per edit. Holds nest */
+    void holdPublishing();
+    /** end a holdPublishing, publishing the pattern once if anything changed while it was held */
+    void releasePublishing();
     /** tell the sequence to reset its position counter at next tick. Useful for rewinding*/
     void rewindAtNextZero();
     /** prime this sequence so the next tick triggers step zero immediately */
     void primeForImmediateTrigger();
     /** reset transport counters so the next tick triggers step zero, then resumes normal spacing */
     void resetForTransportStart();
+    /** jump straight to where the sent number of engine ticks after a transport start would leave us,
+     * without replaying them. Only right when no length or tps adjusters fire on the way:
+     * Sequencer::seekTo replays the ticks instead when a modulator is playing */
+    void seekTo(std::uint64_t ticksSinceTransportStart);
+    /** carry the engine tick counters over to a new tick resolution, keeping the grid ticks gone by.
+     * The next tick must be a grid tick */
+    void rescaleTicks(std::size_t fromTicksPerGridTick, std::size_t toTicksPerGridTick);
+    /** where tick has got to. Two sequences in the same place play on the same from there,
+     * apart from their probability rolls, which follow stepsPlayed */
+    struct PlaybackPosition
+    {
+      std::size_t currentStep{0};
+      std::size_t ticksElapsed{0};
+      std::size_t tickOfFour{0};
+      double transpose{0};
+      int lengthAdjustment{0};
+      double ticksPerStep{0};
+      double originalTicksPerStep{0};
+      double nextTicksPerStep{0};
+      bool rewindAtNextZeroTick{false};
+      std::uint64_t stepsPlayed{0};
+      /** true if everything but stepsPlayed matches */
+      bool samePlaceAs(const PlaybackPosition& other) const;
+    };
+    PlaybackPosition getPlaybackPosition() const;
+    /** move the probability rolls on as if the sent number of steps had played, e.g. after
+     * skipping whole repeats of playback that end up back in the same place */
+    void setStepsPlayed(std::uint64_t steps);
+    /** ticks the acquired pattern takes to come round to its first step when nothing adjusts it */
+    std::uint64_t getLoopTicks() const;
+    /** true if the acquired pattern is a modulator with rows that only fire some of the time */
+    bool hasModulationRolls() const;
     std::size_t getTicksElapsed() const;
     std::size_t getTickOfFour() const;
+    /** set the seed for this sequence's probability generator and restart it from that seed */
+    void setRandomSeed(std::uint32_t seed);
+    /** the seed this sequence's probability generator restarts from on transport start */
+    std::uint32_t getRandomSeed() const;
     /**  when creating new notes, set the channel to this one*/
     // void setDefaulyChannel();
   private:
+    /** copy the editable pattern into a new playback snapshot */
+    std::unique_ptr<SequencePattern> buildPattern() const;
+    /** hand the audio thread a fresh snapshot. Call after any edit that tick needs to see */
+    void publishPattern();
+    /** point every row at the sent command, clamping values to its parameters. Lock rows stay put unless dropLockRows */
+    void setRowCommands(double command, bool dropLockRows);
+    /** apply one modulator row to its target in host, if it passes its probability check */
+    void modulate(Sequencer& host, SequenceType modulatorType, double sequenceProbability, const std::vector<double>& row);
 
     /** provides access to the sequencer so this sequence can change things*/
     Sequencer* sequencer;
-    /** current length. This is a std::size_tas we apply length adjustments to it that might be negative*/
-    std::size_t currentLength;
-    /** Current seq length. This is signed in case we are computing current step using currentLength*/
-    std::size_t currentStep;
+    /** current length. This is a std::size_tas we apply length adjustments to it that might be negative.
+     * Live recording reads it on the audio thread */
+    RelaxedAtomic<std::size_t> currentLength;
+    /** the step tick is on. Written by tick, read by the editor for display */
+    RelaxedAtomic<std::size_t> currentStep;
     double machineId;
     std::vector<Step> steps;
     SequenceType type;
     double machineType;
     double triggerProbability;
-    // temporary sequencer adjustment parameters that get reset at step 0
-    double transpose; 
-    signed int lengthAdjustment;
-    std::size_t ticksPerStep;
+    // temporary sequencer adjustment parameters that get reset at step 0.
+    // Modulators write them on the audio thread while the UI reads them for display
+    RelaxedAtomic<double> transpose;
+    RelaxedAtomic<int> lengthAdjustment;
+    RelaxedAtomic<double> ticksPerStep;
     /** stores the current default for this sequence, whereas ticksperstep 
      * is the temporarily adjusted one 
      */
-    std::size_t originalTicksPerStep;
+    double originalTicksPerStep;
     /** used to store a ticks per step update that will be applied next time tickoffour == 0*/
-    std::size_t nextTicksPerStep; 
+    double nextTicksPerStep; 
     bool rewindAtNextZeroTick; 
     
+    /** engine ticks since the current step started */
     std::size_t ticksElapsed;
-    /** used to keep in sync with the '1'*/
+    /** used to keep in sync with the '1'. Counts engine ticks, wrapping every four grid ticks */
     std::size_t tickOfFour;
     bool muted; 
+    /** drives probability checks for this sequence. Reseeded on transport start so renders repeat */
+    FastRandom random;
+    /** steps triggered since transport start. Each step restarts random at this position so seeks land on the same rolls */
+    std::uint64_t stepsPlayed;
+    /** scratch copy of a row with the transpose applied. Reserved up front so tick does not allocate */
+    std::vector<double> transposedRow;
     /** maps from linear midi scale to general midi drum notes*/
     std::map<int,int> midiScaleToDrum;
 
     std::unique_ptr<std::shared_mutex> rw_mutex;
+    /** the snapshot tick plays from. Only touched by the thread calling tick */
+    std::unique_ptr<SequencePattern> playbackPattern;
+    /** passes snapshots from the editing thread to the ticking thread */
+    std::unique_ptr<SnapshotExchange<SequencePattern>> patternExchange;
+    /** open holdPublishing calls, and whether an edit was held back by them */
+    int publishHolds = 0;
+    bool publishPending = false;
 
 };
 
@@ -320,6 +481,8 @@ class Sequencer : public SequencerAbs {
     public:
     /** armed (MIDI recording) channel will be set to this if nothing is armed */
     const static std::size_t notArmed{SequencerAbs::notArmed};
+    /** most sequences a sequencer can hold */
+    static constexpr std::size_t maxSequences{128};
     
     
       /** create a sequencer: channels,stepsPerChannel*/
@@ -330,19 +493,42 @@ class Sequencer : public SequencerAbs {
 
       /** set seq channels and seq types of this sequence to the same as the sent sequence*/
       void copyChannelAndTypeSettings(Sequencer* otherSeq);
+      /** replace all sequences with copies of the sent sequencer's, sharing step data
+       * blocks until they are edited. See Sequence::cloneFor
+      */
+      void copyPatternsFrom(const Sequencer& otherSeq);
+      /** replace one sequence with a copy of one of the sent sequencer's, sharing step data blocks */
+      void copySequenceFrom(const Sequencer& otherSeq, std::size_t otherSequence, std::size_t sequence);
+      /** play sourceSet's sequence at sourceTrack in place of our own one at the sent index, e.g. a
+       * pattern from another sequence set referenced by a song row. nullptr goes back to our own.
+       * The track is looked up on every use, so copyPatternsFrom on the source set is safe, but the
+       * set itself is not owned: call clearSequenceSources before it goes away.
+      */
+      void setSequenceSource(std::size_t sequence, Sequencer* sourceSet, std::size_t sourceTrack);
+      /** go back to playing our own sequences on every track */
+      void clearSequenceSources();
+      /** true if one of our tracks plays the sent set's sequence at the sent track, our own included */
+      bool playsSequence(const Sequencer& set, std::size_t track) const;
       std::size_t howManySequences() const ;
       std::size_t howManySteps(std::size_t sequence) const ;
       std::size_t getCurrentStep(std::size_t sequence) const;
       SequenceType getSequenceType(std::size_t sequence) const;
-      std::size_t getSequenceTicksPerStep(std::size_t sequence) const;
-      std::size_t getSequencerNextTicksPerStep(std::size_t sequence) const;
+      double getSequenceTicksPerStep(std::size_t sequence) const;
+      double getSequencerNextTicksPerStep(std::size_t sequence) const;
 
-      /** go to the next step. if disableAllTriggers has been called, will send false trigger to 
+      /** move on one engine tick. if disableAllTriggers has been called, will send false trigger to 
        * sequence objects, meaning they step without firing. 
       */
       void tick();
       /** trigger a step's callback right now */
       void triggerStep(std::size_t seq, std::size_t step, std::size_t row);
+      /** the machine the sent track plays its notes on, from the pattern it last ticked so it agrees with
+       * what tick plays. False for muted and modulator tracks. Call it where tick could run */
+      bool getPlayingMachineId(std::size_t sequence, std::size_t& machineId) const;
+      /** apply a modulator row's amount to the sent sequence: semitones, steps or ticks per step depending on type.
+       * Called from tick, so it must not allocate. Modulators cannot target other modulators
+      */
+      void modulateSequence(std::size_t sequence, SequenceType type, double amount);
       /** return a pointer to the sequence with sent id*/
       Sequence* getSequence(std::size_t sequence);
       /** the the type of sequence to type*/
@@ -368,6 +554,10 @@ class Sequencer : public SequencerAbs {
       void resetStepRow(std::size_t sequence, std::size_t step, std::size_t row);
       /** retrieve a copy of the data for a specific step */
       std::vector<std::vector<double>> getStepData(std::size_t sequence, std::size_t step);
+      /** retrieve the shared data block for a specific step without copying it */
+      Step::SharedRows getSharedStepData(std::size_t sequence, std::size_t step) const;
+      /** point a step at an existing shared data block, e.g. when restoring deduplicated state */
+      void setSharedStepData(std::size_t sequence, std::size_t step, Step::SharedRows data);
       /** set the sent seq, sent step, sent row, sent col's value */
       // void setStepDataAt(std::size_t seq, std::size_t step, std::size_t row, std::size_t col, double val);
       
@@ -387,8 +577,20 @@ class Sequencer : public SequencerAbs {
       void primeForImmediateTrigger();
       /** reset all sequences so the next tick triggers step zero, then resumes normal spacing */
     void resetForTransportStart();
+      /** reset our own sequence at the sent index, ignoring any source, so its next tick triggers step zero */
+      void resetSequenceForTransportStart(std::size_t sequence);
+      /** move all sequences to where the sent number of engine ticks after a transport start would leave them.
+       * When a modulator is playing the ticks are replayed silently so its adjusters are applied, a
+       * modulator loop at a time until playback repeats itself, then the repeats are jumped over */
+      void seekTo(std::uint64_t ticksSinceTransportStart);
+      /** carry our own sequences' engine tick counters over to a new tick resolution. The next tick must be a grid tick */
+      void rescaleTicks(std::size_t fromTicksPerGridTick, std::size_t toTicksPerGridTick);
     std::size_t getTicksElapsed(std::size_t sequence) const;
     std::size_t getTickOfFour(std::size_t sequence) const;
+      /** set the probability generator seed for the sent sequence */
+      void setSequenceRandomSeed(std::size_t sequence, std::uint32_t seed);
+      /** get the probability generator seed for the sent sequence */
+      std::uint32_t getSequenceRandomSeed(std::size_t sequence) const;
       
       /** allows a 'keep stepping but do not trigger' when tick is called*/
       void disableAllTriggers();
@@ -433,8 +635,10 @@ class Sequencer : public SequencerAbs {
       void decrementStepDataAt(std::size_t sequence, std::size_t step, std::size_t row, std::size_t col);
       /** reads default value for this step data col from commands and sets it to that */
       void setStepDataToDefault(std::size_t sequence, std::size_t step, std::size_t row, std::size_t col);
-      /** request that the sequence updates its string on next tick  */
+      /** request that the sequence updates its string grid next time it is read  */
       void requestStrUpdate();
+      void holdPatternPublishing() override;
+      void releasePatternPublishing() override;
       /** Configures the sequence with tracks->channels 1,1,2,2,3,3 */
       void setDefaultMIDIChannels();
 
@@ -445,17 +649,44 @@ class Sequencer : public SequencerAbs {
       bool assertSeqAndStep(std::size_t sequence, std::size_t step) const;
         
       bool assertSequence(std::size_t sequence) const;
+      /** the sequence that actually plays at the sent index: a source if one is set, otherwise our own */
+      Sequence& playingSequence(std::size_t sequence);
+      const Sequence& playingSequence(std::size_t sequence) const;
+      /** tick every playing sequence once, modulators first. Patterns must already be acquired */
+      void tickPlayingSequences(bool triggerModulators, bool triggerNotes);
+      /** ticks until all the modulators are back on their first steps together, capped at getMaxSeekReplayTicks */
+      std::uint64_t getModulatorLoopTicks() const;
+      /** skip over whole repeats of cycleTicks, which left every sequence where seekReference has it,
+       * for as long as they fit before untilTick. Returns the tick we end up on */
+      std::uint64_t skipSeekRepeats(std::uint64_t tick, std::uint64_t cycleTicks, std::uint64_t untilTick);
       /// class data members 
       /** makes reads and writes thread safe */
       std::unique_ptr<std::shared_mutex> rw_mutex;
-      /** if false, ignore ticks. If true, do not ignore ticks */
-      bool playing; 
+      /** if false, ignore ticks. If true, do not ignore ticks. The audio thread can stop a
+       * sequencer while the editor reads it */
+      RelaxedAtomic<bool> playing;
       /** this value is sent to the tick call on our sequences. Allows 'step without triggering' behaviour  */
       bool triggerOnTick;
       /** if this is true, update my display string on next tick  */
       bool stringUpdateRequested;
 
       std::vector<Sequence> sequences;
+      /** a track of another sequencer to play instead of one of ours */
+      struct SequenceSource
+      {
+        Sequencer* set{nullptr};
+        std::size_t track{0};
+      };
+      /** per track, where to play from instead of ours. A null set plays our own. See setSequenceSource */
+      std::vector<SequenceSource> sequenceSources;
+      /** tracks that played as modulators in the current tick. Set at the start of each tick */
+      std::bitset<maxSequences> modulatorTracks;
+      /** most grid ticks seekTo replays looking for playback to repeat. Past that it assumes it does */
+      static constexpr std::uint64_t maxSeekReplayGridTicks{16384};
+      /** maxSeekReplayGridTicks in engine ticks at the current resolution */
+      static std::uint64_t getMaxSeekReplayTicks();
+      /** where the playing sequences were at the start of the repeat seekTo is testing for */
+      std::array<Sequence::PlaybackPosition, maxSequences> seekReference;
     /** representation of the sequences as a string grid, pulled from the steps' flat string representations */
       std::vector<std::vector<std::string>> seqAsStringGrid;
       std::vector<Parameter> seqConfigSpecs; 
@@ -4,44 +4,46 @@
 #include <iostream>
 #include <assert.h>
 #include <random>
+#include <algorithm>
+#include <cmath>
 #include "MachineUtilsAbs.h"
 #include "Sequencer.h"
 
 // Constructor definitions
 Parameter::Parameter(){}
-Parameter::Parameter(const std::string& _name, const std::string& _shortName, double _min, double _max, double _step, double _defaultValue, int _stepCol, int _dps)
-    : name(_name), shortName(_shortName), min(_min), max(_max), step(_step), defaultValue(_defaultValue), stepCol{_stepCol}, decPlaces{_dps} {}
+Parameter::Parameter(const std::string& _name, const std::string& _shortName, double _min, double _max, double _step, double _defaultValue, int _stepCol, int _dps, bool _isGridTickLength)
+    : name(_name), shortName(_shortName), min(_min), max(_max), step(_step), defaultValue(_defaultValue), stepCol{_stepCol}, decPlaces{_dps}, isGridTickLength{_isGridTickLength} {}
 
 Command::Command(const std::string& _name, const std::string& _shortName, const std::string& _description, const std::vector<Parameter>& _parameters,
                  int _noteEditGoesToParam, int _numberEditGoesToParam, int _lengthEditGoesToParam,
-                 std::function<void(std::vector<double>*, const SequenceReadOnly*)> _execute)
+                 std::function<void(const std::vector<double>*, const SequenceReadOnly*)> _execute)
     : name(_name), shortName(_shortName), description(_description), parameters(_parameters), 
     noteEditGoesToParam{_noteEditGoesToParam}, numberEditGoesToParam{_numberEditGoesToParam}, lengthEditGoesToParam{_lengthEditGoesToParam}, execute(std::move(_execute)) {}
 
 
 /** handy wrapper for generating random numbers */
-// Simple RNG wrapper for sequencer command probability checks.
+// Probability draws come from the triggering sequence's own seeded generator so that
+// playback is reproducible; contexts without one (e.g. editor auditions) use a shared fallback.
 class RandomNumberGenerator {
 private:
-    static std::mt19937 gen; // Mersenne Twister random number generator
-    static std::uniform_real_distribution<> dis; // Uniform real distribution between 0 and 1
+    static FastRandom fallback;
 
 public:
-    // Static function to get a random number between 0 and 1
-    static double getRandomNumber() {
-        return dis(gen);
+    // Returns a number between 0 and 1 from the sequence's generator if it has one
+    static double getRandomNumber(const SequenceReadOnly* sequenceContext) {
+        if (sequenceContext != nullptr && sequenceContext->random != nullptr)
+            return sequenceContext->random->nextDouble();
+        return fallback.nextDouble();
     }
 
-    // Initialize the random number generator and the distribution
+    // Seed the fallback generator from the system so auditions still vary
     static void initialize() {
         std::random_device rd; // Non-deterministic random device for seeding
-        gen = std::mt19937(rd()); // Seed the generator
-        dis = std::uniform_real_distribution<>(0.0, 1.0); // Define the range
+        fallback.seed(static_cast<std::uint32_t>(rd()));
     }
 };
 // Definition of static members
-std::mt19937 RandomNumberGenerator::gen;
-std::uniform_real_distribution<> RandomNumberGenerator::dis;
+FastRandom RandomNumberGenerator::fallback;
 
 // namespaced global vars used in the command processing lambdas
 // for speed / avoiding passing around objects too much
@@ -67,6 +69,32 @@ void CommandProcessor::assignMasterClock(ClockAbs* masterClock)
     CommandData::masterClock = masterClock;
 }
 
+double CommandProcessor::getEngineTickInGridTicks()
+{
+    if (CommandData::masterClock == nullptr)
+        return 1.0;
+    return 1.0 / static_cast<double>(CommandData::masterClock->getTicksPerGridTick());
+}
+
+std::size_t CommandProcessor::getTicksPerGridTick()
+{
+    if (CommandData::masterClock == nullptr)
+        return 1;
+    return static_cast<std::size_t>(std::max(1, CommandData::masterClock->getTicksPerGridTick()));
+}
+
+std::size_t CommandProcessor::toEngineTicks(double gridTicks)
+{
+    const double engineTicks = std::round(gridTicks * static_cast<double>(getTicksPerGridTick()));
+    return engineTicks < 1.0 ? 1u : static_cast<std::size_t>(engineTicks);
+}
+
+double CommandProcessor::roundToEngineTicks(double gridTicks)
+{
+    const double engineTick = getEngineTickInGridTicks();
+    return std::round(gridTicks / engineTick) * engineTick;
+}
+
 std::string CommandProcessor::describeStepNote(const SequenceReadOnly* sequenceContext, double noteValue)
 {
     if (sequenceContext == nullptr || CommandData::machineUtils == nullptr)
@@ -97,13 +125,13 @@ void CommandProcessor::initialiseCommands() {
               // long, short, min, max, step,default
             { Parameter("Note", "N", 0, 127, 1, 32, Step::noteInd), 
               Parameter("Vel", "V", 0, 127, 4, 64, Step::velInd), 
-              Parameter("Dur", "D", 0, 8, 1, 1, Step::lengthInd),
+              Parameter("Dur", "D", 0, 32, 1, 1, Step::lengthInd, 0, true),
               Parameter("Prob", "%", 0, 1, 0.1, 1.0, Step::probInd, 2)},
               
             Step::noteInd, // int noteEditGoesToParam;
             Step::velInd, // int numberEditGoesToParam;
             Step::lengthInd, // int lengthEditGoesToParam;  
-            [](std::vector<double>* stepData, const SequenceReadOnly* sequenceContext) {
+            [](const std::vector<double>* stepData, const SequenceReadOnly* sequenceContext) {
                 assert(stepData->size() == Step::maxInd + 1);// need +1 params as we also get sent the cmd index as a param
                 assert(sequenceContext != nullptr);
                 if ((*stepData)[Step::noteInd] > 0) {// there is a valid note
@@ -111,7 +139,7 @@ void CommandProcessor::initialiseCommands() {
                     if (sequenceContext->triggerProbability > 0){
                         triggerProbability = sequenceContext->triggerProbability;
                     }
-                    double random_number = RandomNumberGenerator::getRandomNumber();
+                    double random_number = RandomNumberGenerator::getRandomNumber(sequenceContext);
                     if (random_number < triggerProbability){ 
                         // double now = CommandData::masterClock->getCurrentTick();
                         
@@ -123,7 +151,7 @@ void CommandProcessor::initialiseCommands() {
                             static_cast<unsigned short> ((*stepData)[Step::noteInd]), 
                             static_cast<unsigned short> ((*stepData)[Step::velInd]), 
                             // (long) ((*stepData)[Step::lengthInd]+now)
-                            static_cast<unsigned short> ((*stepData)[Step::lengthInd])
+                            CommandData::masterClock->gridToEngineTicks((*stepData)[Step::lengthInd])
                         );
                     }
                 }
@@ -134,19 +162,19 @@ void CommandProcessor::initialiseCommands() {
             "Log", "Log", "Prints step data to the console",
             { Parameter("Note", "N", 0, 127, 1, 32, Step::noteInd), 
               Parameter("Vel", "V", 0, 127, 4, 64, Step::velInd), 
-              Parameter("Dur", "D", 0, 8, 1, 1, Step::lengthInd),
+              Parameter("Dur", "D", 0, 32, 1, 1, Step::lengthInd, 0, true),
               Parameter("Prob", "%", 0, 1, 0.1, 1.0, Step::probInd, 2)},
             Step::noteInd,
             Step::velInd,
             Step::lengthInd,
-            [](std::vector<double>* stepData, const SequenceReadOnly* sequenceContext) {
+            [](const std::vector<double>* stepData, const SequenceReadOnly* sequenceContext) {
                 assert(stepData->size() == Step::maxInd + 1);
                 assert(sequenceContext != nullptr);
                 double triggerProbability = (*stepData)[Step::probInd];
                 if (sequenceContext->triggerProbability > 0){
                     triggerProbability = sequenceContext->triggerProbability;
                 }
-                double random_number = RandomNumberGenerator::getRandomNumber();
+                double random_number = RandomNumberGenerator::getRandomNumber(sequenceContext);
                 if (random_number < triggerProbability){
                     std::cout << "Log command: machineId=" << sequenceContext->machineId
                               << " triggerProb=" << triggerProbability
@@ -165,26 +193,26 @@ void CommandProcessor::initialiseCommands() {
             "Sampler", "Samp", "Plays a sampler voice",
             { Parameter("Note", "N", 0, 127, 1, 32, Step::noteInd), 
               Parameter("Vel", "V", 0, 127, 4, 64, Step::velInd), 
-              Parameter("Dur", "D", 0, 8, 1, 1, Step::lengthInd),
+              Parameter("Dur", "D", 0, 32, 1, 1, Step::lengthInd, 0, true),
               Parameter("Prob", "%", 0, 1, 0.1, 1.0, Step::probInd, 2)},
             Step::noteInd,
             Step::velInd,
             Step::lengthInd,
-            [](std::vector<double>* stepData, const SequenceReadOnly* sequenceContext) {
+            [](const std::vector<double>* stepData, const SequenceReadOnly* sequenceContext) {
                 assert(stepData->size() == Step::maxInd + 1);
                 assert(sequenceContext != nullptr);
                 double triggerProbability = (*stepData)[Step::probInd];
                 if (sequenceContext->triggerProbability > 0){
                     triggerProbability = sequenceContext->triggerProbability;
                 }
-                double random_number = RandomNumberGenerator::getRandomNumber();
+                double random_number = RandomNumberGenerator::getRandomNumber(sequenceContext);
                 if (random_number < triggerProbability){ 
                     CommandData::machineUtils->sendMessageToMachine(
                         static_cast<CommandType>(static_cast<std::size_t>(sequenceContext->machineType)),
                         static_cast<unsigned short> (sequenceContext->machineId),
                         static_cast<unsigned short> ((*stepData)[Step::noteInd]), 
                         static_cast<unsigned short> ((*stepData)[Step::velInd]), 
-                        static_cast<unsigned short> ((*stepData)[Step::lengthInd])
+                        CommandData::masterClock->gridToEngineTicks((*stepData)[Step::lengthInd])
                     );
                 }
             }
@@ -193,26 +221,26 @@ void CommandProcessor::initialiseCommands() {
             "Arpeggiator", "Arp", "Feeds notes into an arpeggiator buffer",
             { Parameter("Note", "N", 0, 127, 1, 32, Step::noteInd), 
               Parameter("Vel", "V", 0, 127, 4, 64, Step::velInd), 
-              Parameter("Dur", "D", 0, 8, 1, 1, Step::lengthInd),
+              Parameter("Dur", "D", 0, 32, 1, 1, Step::lengthInd, 0, true),
               Parameter("Prob", "%", 0, 1, 0.1, 1.0, Step::probInd, 2)},
             Step::noteInd,
             Step::velInd,
             Step::lengthInd,
-            [](std::vector<double>* stepData, const SequenceReadOnly* sequenceContext) {
+            [](const std::vector<double>* stepData, const SequenceReadOnly* sequenceContext) {
                 assert(stepData->size() == Step::maxInd + 1);
                 assert(sequenceContext != nullptr);
                 double triggerProbability = (*stepData)[Step::probInd];
                 if (sequenceContext->triggerProbability > 0){
                     triggerProbability = sequenceContext->triggerProbability;
                 }
-                double random_number = RandomNumberGenerator::getRandomNumber();
+                double random_number = RandomNumberGenerator::getRandomNumber(sequenceContext);
                 if (random_number < triggerProbability){ 
                     CommandData::machineUtils->sendMessageToMachine(
                         CommandType::Arpeggiator,
                         static_cast<unsigned short> (sequenceContext->machineId),
                         static_cast<unsigned short> ((*stepData)[Step::noteInd]), 
                         static_cast<unsigned short> ((*stepData)[Step::velInd]), 
-                        static_cast<unsigned short> ((*stepData)[Step::lengthInd])
+                        CommandData::masterClock->gridToEngineTicks((*stepData)[Step::lengthInd])
                     );
                 }
             }
@@ -221,26 +249,26 @@ void CommandProcessor::initialiseCommands() {
             "WavetableSynth", "Wave", "Plays the internal wavetable synth",
             { Parameter("Note", "N", 0, 127, 1, 32, Step::noteInd),
               Parameter("Vel", "V", 0, 127, 4, 64, Step::velInd),
-              Parameter("Dur", "D", 0, 8, 1, 1, Step::lengthInd),
+              Parameter("Dur", "D", 0, 32, 1, 1, Step::lengthInd, 0, true),
               Parameter("Prob", "%", 0, 1, 0.1, 1.0, Step::probInd, 2)},
             Step::noteInd,
             Step::velInd,
             Step::lengthInd,
-            [](std::vector<double>* stepData, const SequenceReadOnly* sequenceContext) {
+            [](const std::vector<double>* stepData, const SequenceReadOnly* sequenceContext) {
                 assert(stepData->size() == Step::maxInd + 1);
                 assert(sequenceContext != nullptr);
                 double triggerProbability = (*stepData)[Step::probInd];
                 if (sequenceContext->triggerProbability > 0){
                     triggerProbability = sequenceContext->triggerProbability;
                 }
-                double random_number = RandomNumberGenerator::getRandomNumber();
+                double random_number = RandomNumberGenerator::getRandomNumber(sequenceContext);
                 if (random_number < triggerProbability){
                     CommandData::machineUtils->sendMessageToMachine(
                         CommandType::WavetableSynth,
                         static_cast<unsigned short> (sequenceContext->machineId),
                         static_cast<unsigned short> ((*stepData)[Step::noteInd]),
                         static_cast<unsigned short> ((*stepData)[Step::velInd]),
-                        static_cast<unsigned short> ((*stepData)[Step::lengthInd])
+                        CommandData::masterClock->gridToEngineTicks((*stepData)[Step::lengthInd])
                     );
                 }
             }
@@ -249,30 +277,99 @@ void CommandProcessor::initialiseCommands() {
             "PolyArpeggiator", "PArp", "Feeds notes into a polyphonic arpeggiator buffer",
             { Parameter("Note", "N", 0, 127, 1, 32, Step::noteInd),
               Parameter("Vel", "V", 0, 127, 4, 64, Step::velInd),
-              Parameter("Dur", "D", 0, 8, 1, 1, Step::lengthInd),
+              Parameter("Dur", "D", 0, 32, 1, 1, Step::lengthInd, 0, true),
               Parameter("Prob", "%", 0, 1, 0.1, 1.0, Step::probInd, 2)},
             Step::noteInd,
             Step::velInd,
             Step::lengthInd,
-            [](std::vector<double>* stepData, const SequenceReadOnly* sequenceContext) {
+            [](const std::vector<double>* stepData, const SequenceReadOnly* sequenceContext) {
                 assert(stepData->size() == Step::maxInd + 1);
                 assert(sequenceContext != nullptr);
                 double triggerProbability = (*stepData)[Step::probInd];
                 if (sequenceContext->triggerProbability > 0){
                     triggerProbability = sequenceContext->triggerProbability;
                 }
-                const double random_number = RandomNumberGenerator::getRandomNumber();
+                const double random_number = RandomNumberGenerator::getRandomNumber(sequenceContext);
                 if (random_number < triggerProbability){
                     CommandData::machineUtils->sendMessageToMachine(
                         CommandType::PolyArpeggiator,
                         static_cast<unsigned short> (sequenceContext->machineId),
                         static_cast<unsigned short> ((*stepData)[Step::noteInd]),
                         static_cast<unsigned short> ((*stepData)[Step::velInd]),
-                        static_cast<unsigned short> ((*stepData)[Step::lengthInd])
+                        CommandData::masterClock->gridToEngineTicks((*stepData)[Step::lengthInd])
                     );
                 }
             }
     };
+    Command paramLockCommand{
+            "ParamLock", "PLck", "Holds a machine parameter on the sequence's stack until the next step",
+            { Parameter("Value", "V", 0, 127, 4, 64, Step::noteInd),
+              Parameter("Param", "P", 0, 15, 1, 0, Step::velInd),
+              Parameter("Slot", "S", 0, 15, 1, 0, Step::lengthInd),
+              Parameter("Prob", "%", 0, 1, 0.1, 1.0, Step::probInd, 2)},
+            Step::noteInd,
+            Step::velInd,
+            Step::lengthInd,
+            [](const std::vector<double>* stepData, const SequenceReadOnly* sequenceContext) {
+                assert(stepData->size() == Step::maxInd + 1);
+                assert(sequenceContext != nullptr);
+                double triggerProbability = (*stepData)[Step::probInd];
+                if (sequenceContext->triggerProbability > 0){
+                    triggerProbability = sequenceContext->triggerProbability;
+                }
+                const double random_number = RandomNumberGenerator::getRandomNumber(sequenceContext);
+                if (random_number < triggerProbability){
+                    // the lock lets go where the sequence's next step begins
+                    const double stepTicks = std::max(CommandProcessor::getEngineTickInGridTicks(), sequenceContext->ticksPerStep);
+                    CommandData::machineUtils->sendParameterLock(
+                        static_cast<unsigned short> (sequenceContext->machineId),
+                        static_cast<unsigned short> ((*stepData)[Step::lengthInd]),
+                        static_cast<unsigned short> ((*stepData)[Step::velInd]),
+                        static_cast<unsigned short> ((*stepData)[Step::noteInd]),
+                        CommandData::masterClock->gridToEngineTicks(stepTicks)
+                    );
+                }
+            }
+    };
+    // modulator rows target another sequence, so Sequence::tick hands them to the sequencer
+    // instead of executing them. Triggering one by hand has nothing to play
+    auto appliedBySequencer = [](const std::vector<double>* stepData, const SequenceReadOnly* sequenceContext) {
+        (void)stepData;
+        (void)sequenceContext;
+    };
+    Command transposeCommand{
+            "Transpose", "Trns", "Transposes the target sequence's notes until it gets back to step 0",
+            { Parameter("Semitones", "St", -24, 24, 1, 0, Step::noteInd),
+              Parameter("Target", "Sq", 0, 15, 1, 0, Step::velInd),
+              Parameter("Unused", "-", 0, 0, 0, 0, Step::lengthInd),
+              Parameter("Prob", "%", 0, 1, 0.1, 1.0, Step::probInd, 2)},
+            Step::noteInd,
+            Step::velInd,
+            Step::lengthInd,
+            appliedBySequencer
+    };
+    Command lengthModCommand{
+            "LengthMod", "LenM", "Adds steps to or removes steps from the target sequence until it gets back to step 0",
+            { Parameter("Steps", "St", -8, 8, 1, 0, Step::noteInd),
+              Parameter("Target", "Sq", 0, 15, 1, 0, Step::velInd),
+              Parameter("Unused", "-", 0, 0, 0, 0, Step::lengthInd),
+              Parameter("Prob", "%", 0, 1, 0.1, 1.0, Step::probInd, 2)},
+            Step::noteInd,
+            Step::velInd,
+            Step::lengthInd,
+            appliedBySequencer
+    };
+    Command tickModCommand{
+            "TickMod", "TpsM", "Sets the target sequence's ticks per step until it gets back to step 0",
+            { Parameter("Ticks", "Tk", 0, 16, 1, 0, Step::noteInd),
+              Parameter("Target", "Sq", 0, 15, 1, 0, Step::velInd),
+              Parameter("Unused", "-", 0, 0, 0, 0, Step::lengthInd),
+              Parameter("Prob", "%", 0, 1, 0.1, 1.0, Step::probInd, 2)},
+            Step::noteInd,
+            Step::velInd,
+            Step::lengthInd,
+            appliedBySequencer
+    };
     // Command sample{
     //         "Sample", "Samp", "Plays a Sample",
     //         { Parameter("Sound", "Bank", 0, 16, 1, 0, Step::chanInd), 
@@ -299,12 +396,20 @@ void CommandProcessor::initialiseCommands() {
     CommandData::commands[arpeggiatorCommand.shortName] = arpeggiatorCommand;
     CommandData::commands[wavetableSynthCommand.shortName] = wavetableSynthCommand;
     CommandData::commands[polyArpeggiatorCommand.shortName] = polyArpeggiatorCommand;
+    CommandData::commands[paramLockCommand.shortName] = paramLockCommand;
+    CommandData::commands[transposeCommand.shortName] = transposeCommand;
+    CommandData::commands[lengthModCommand.shortName] = lengthModCommand;
+    CommandData::commands[tickModCommand.shortName] = tickModCommand;
     CommandData::commandsDouble[static_cast<double>(CommandType::MidiNote)] = midiNote;
     CommandData::commandsDouble[static_cast<double>(CommandType::Log)] = logCommand;
     CommandData::commandsDouble[static_cast<double>(CommandType::Sampler)] = samplerCommand;
     CommandData::commandsDouble[static_cast<double>(CommandType::Arpeggiator)] = arpeggiatorCommand;
     CommandData::commandsDouble[static_cast<double>(CommandType::WavetableSynth)] = wavetableSynthCommand;
     CommandData::commandsDouble[static_cast<double>(CommandType::PolyArpeggiator)] = polyArpeggiatorCommand;
+    CommandData::commandsDouble[static_cast<double>(CommandType::ParamLock)] = paramLockCommand;
+    CommandData::commandsDouble[static_cast<double>(CommandType::Transpose)] = transposeCommand;
+    CommandData::commandsDouble[static_cast<double>(CommandType::LengthMod)] = lengthModCommand;
+    CommandData::commandsDouble[static_cast<double>(CommandType::TickMod)] = tickModCommand;
     // CommandData::commands[sample.shortName] = sample;
     // CommandData::commandsDouble[2] = sample;
 }
@@ -323,6 +428,14 @@ Command& CommandProcessor::getCommand(double commandInd) {
     throw std::runtime_error("Command not found: " + std::to_string(commandInd));
 }
 
+bool CommandProcessor::hasCommand(double commandInd)
+{
+    if (CommandData::commands.size() == 0){
+        CommandProcessor::initialiseCommands();
+    }
+    return CommandData::commandsDouble.find(commandInd) != CommandData::commandsDouble.end();
+}
+
 // // Get a command by name
 Command& CommandProcessor::getCommand(const std::string& commandName) {
     if (CommandData::commands.size() == 0){
@@ -336,7 +449,7 @@ Command& CommandProcessor::getCommand(const std::string& commandName) {
 }
 
 
-void CommandProcessor::executeCommand(double cmdInd, std::vector<double>* params, const SequenceReadOnly* sequenceContext)
+void CommandProcessor::executeCommand(double cmdInd, const std::vector<double>* params, const SequenceReadOnly* sequenceContext)
 {
     if (CommandData::commands.size() == 0){
         CommandProcessor::initialiseCommands();
@@ -351,7 +464,13 @@ int CommandProcessor::countCommands()
     if (CommandData::commands.size() == 0){
         CommandProcessor::initialiseCommands();
     }
-    return static_cast<int>(CommandData::commands.size());
+    // step-only commands such as parameter locks and modulator rows cannot be a sequence's machine type
+    int count = 0;
+    for (const auto& entry : CommandData::commandsDouble){
+        if (entry.first < static_cast<double>(CommandType::ParamLock))
+            ++count;
+    }
+    return count;
 }
 
 void CommandProcessor::assignMachineUtils(MachineUtilsAbs* _machineUtils)
@@ -6,6 +6,7 @@
 #include <tuple>
 #include <functional>
 #include "ClockAbs.h"
+#include "FastRandom.h"
 #include "MachineUtilsAbs.h"
 
 /** Define the structure for a parameter 
@@ -27,14 +28,21 @@ struct Parameter {
     int stepCol;
     /** how many decimal places to display on the UI?*/
     int decPlaces;
+    /** true for a note length in grid ticks, which edits in engine ticks so finer tick resolutions can reach between grid ticks */
+    bool isGridTickLength = false;
     Parameter();
-    Parameter(const std::string& _name, const std::string& _shortName, double _min, double _max, double _step, double _defaultValue, int _stepCol, int _dps=0);
+    Parameter(const std::string& _name, const std::string& _shortName, double _min, double _max, double _step, double _defaultValue, int _stepCol, int _dps=0, bool _isGridTickLength=false);
 };
 
 struct SequenceReadOnly {
     double triggerProbability;
     double machineType;
     double machineId;
+    /** the owning sequence's generator for probability checks. If null, commands use a shared fallback */
+    FastRandom* random = nullptr;
+    /** grid ticks until the owning sequence's next step, so parameter locks know when to let go.
+     * Fractional at finer tick resolutions */
+    double ticksPerStep = 1;
 };
 
 /** Commands are the main things that are executed by the sequencer when triggering a step 
@@ -52,11 +60,11 @@ struct Command {
     int numberEditGoesToParam;
     /** when user sends length input during editing, which param to send it to? */
     int lengthEditGoesToParam;
-    std::function<void(std::vector<double>*, const SequenceReadOnly*)> execute;
+    std::function<void(const std::vector<double>*, const SequenceReadOnly*)> execute;
     Command(){}
     Command(const std::string& _name, const std::string& _shortName, const std::string& _description, const std::vector<Parameter>& _parameters,
             int _noteEditGoesToParam, int _numberEditGoesToParam, int _lengthEditGoesToParam,
-            std::function<void(std::vector<double>*, const SequenceReadOnly*)> _execute);
+            std::function<void(const std::vector<double>*, const SequenceReadOnly*)> _execute);
 };
 
 // Stable identifiers for command slots in CommandProcessor::commandsDouble.
@@ -72,6 +80,12 @@ enum class CommandType : std::size_t {
     ChannelStripFx = 8,
     AuxSend1Fx = 9,
     AuxSend2Fx = 10,
+    /** not a machine: a step row that holds a machine parameter on the sequence's stack until the next step */
+    ParamLock = 11,
+    /** rows of modulator sequences, applied by the sequencer to another sequence rather than executed */
+    Transpose = 12,
+    LengthMod = 13,
+    TickMod = 14,
 };
 
 
@@ -87,11 +101,22 @@ public:
     static void sendAllNotesOff();
     static void sendQueuedMIDI(long tick);
     static std::string describeStepNote(const SequenceReadOnly* sequenceContext, double noteValue);
+    /** one engine tick as a fraction of a grid tick, 1 at the coarsest resolution */
+    static double getEngineTickInGridTicks();
+    /** how many engine ticks make up a grid tick, 1 at the coarsest resolution */
+    static std::size_t getTicksPerGridTick();
+    /** a step length in grid ticks as whole engine ticks. Always at least one */
+    static std::size_t toEngineTicks(double gridTicks);
+    /** rounds a length in grid ticks to the nearest whole number of engine ticks */
+    static double roundToEngineTicks(double gridTicks);
 
     static Command& getCommand(double commandInd);
     static Command& getCommand(const std::string& commandName);
+    /** true if there is a command registered under the sent index */
+    static bool hasCommand(double commandInd);
     // static void executeCommand(const std::string& commandName, std::vector<double>* params);
-    static void executeCommand(double cmdInd, std::vector<double>* params, const SequenceReadOnly* sequenceContext);
+    static void executeCommand(double cmdInd, const std::vector<double>* params, const SequenceReadOnly* sequenceContext);
+    /** how many commands a sequence can use as its machine type, indexed from 0 */
     static int countCommands();
 private: 
 /** populates the commands variable */
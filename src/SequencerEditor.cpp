@@ -5,6 +5,7 @@
 #include "SequencerCommands.h"
 #include <JuceHeader.h>
 #include <algorithm>
+#include <array>
 #include <cmath> // fmod
 #include <limits>
 #include <assert.h>
@@ -12,7 +13,7 @@
 namespace
 {
 constexpr int kMachineStackCount = 16;
-constexpr std::size_t kSeqConfigBaseRows = 3;
+constexpr std::size_t kSeqConfigBaseRows = 4;
 constexpr std::size_t kSeqConfigMixerRows = 8;
 constexpr float kSeqConfigMinGainDb = -48.0f;
 constexpr float kSeqConfigMaxGainDb = 6.0f;
@@ -118,7 +119,7 @@ bool normalizeEditableStepData(SequencerAbs* sequencer,
   if (sequencer != nullptr)
   {
     if (auto* sequence = sequencer->getSequence(sequenceIndex))
-      defaultCommandValue = sequence->getMachineType();
+      defaultCommandValue = sequence->getRowCommand();
   }
 
   if (data.empty())
@@ -150,8 +151,477 @@ bool normalizeEditableStepData(SequencerAbs* sequencer,
 
   return changed;
 }
+
+/** the parts of a sequence an editor action can change. Step blocks are shared rather than
+ * copied, and copy on write keeps them as they were while the action edits the steps */
+struct SequenceEditState
+{
+  bool valid = false;
+  std::size_t sequence = 0;
+  std::size_t length = 0;
+  /** indexed by the Sequence config ids */
+  std::array<double, Sequence::machineTypeConfig + 1> settings{};
+  std::vector<Step::SharedRows> steps;
+  std::vector<bool> active;
+};
+
+SequenceEditState captureSequenceEditState(SequencerAbs* sequencer, std::size_t sequenceIndex)
+{
+  SequenceEditState state;
+  if (sequencer == nullptr || sequenceIndex >= sequencer->howManySequences())
+    return state;
+  const Sequence* sequence = sequencer->getSequence(sequenceIndex);
+  if (sequence == nullptr)
+    return state;
+
+  state.valid = true;
+  state.sequence = sequenceIndex;
+  state.length = sequence->getLength();
+  state.settings[Sequence::machineIdConfig] = sequence->getMachineId();
+  state.settings[Sequence::tpsConfig] = sequence->getNextTicksPerStep();
+  state.settings[Sequence::probConfig] = sequence->getTriggerProbability();
+  state.settings[Sequence::typeConfig] = static_cast<double>(sequence->getType());
+  state.settings[Sequence::machineTypeConfig] = sequence->getMachineType();
+  state.steps.reserve(state.length);
+  state.active.reserve(state.length);
+  for (std::size_t step = 0; step < state.length; ++step)
+  {
+    state.steps.push_back(sequence->getSharedStepData(step));
+    state.active.push_back(sequence->isStepActive(step));
+  }
+  return state;
+}
+
+EditDelta makeEditDelta(EditDelta::Kind kind, std::size_t target, std::size_t index)
+{
+  EditDelta delta;
+  delta.kind = kind;
+  delta.target = static_cast<std::uint32_t>(target);
+  delta.index = static_cast<std::uint32_t>(index);
+  return delta;
+}
+
+void appendRowValues(const std::vector<double>& row, std::vector<double>& values)
+{
+  values.push_back(static_cast<double>(row.size()));
+  values.insert(values.end(), row.begin(), row.end());
+}
+
+/** the smallest description of a step's rows going from before to after: single cells when the
+ * shape is unchanged, one row when a row was added or taken away, otherwise both sets of rows */
+void appendStepDeltas(std::size_t sequence, std::size_t step, const Step::Rows& before, const Step::Rows& after, std::vector<EditDelta>& deltas)
+{
+  bool sameShape = before.size() == after.size();
+  for (std::size_t row = 0; sameShape && row < before.size(); ++row)
+    sameShape = before[row].size() == after[row].size();
+  if (sameShape)
+  {
+    for (std::size_t row = 0; row < before.size(); ++row)
+    {
+      for (std::size_t col = 0; col < before[row].size(); ++col)
+      {
+        if (before[row][col] == after[row][col])
+          continue;
+        auto delta = makeEditDelta(EditDelta::Kind::cell, sequence, step);
+        delta.row = static_cast<std::uint32_t>(row);
+        delta.col = static_cast<std::uint32_t>(col);
+        delta.before = before[row][col];
+        delta.after = after[row][col];
+        deltas.push_back(std::move(delta));
+      }
+    }
+    return;
+  }
+
+  const bool inserted = after.size() == before.size() + 1;
+  const bool removed = before.size() == after.size() + 1;
+  if (inserted || removed)
+  {
+    const auto& longer = inserted ? after : before;
+    const auto& shorter = inserted ? before : after;
+    const auto split = static_cast<std::size_t>(std::mismatch(shorter.begin(), shorter.end(), longer.begin()).first - shorter.begin());
+    if (std::equal(shorter.begin() + static_cast<std::ptrdiff_t>(split), shorter.end(), longer.begin() + static_cast<std::ptrdiff_t>(split + 1)))
+    {
+      auto delta = makeEditDelta(inserted ? EditDelta::Kind::rowInsert : EditDelta::Kind::rowRemove, sequence, step);
+      delta.row = static_cast<std::uint32_t>(split);
+      delta.values = longer[split];
+      deltas.push_back(std::move(delta));
+      return;
+    }
+  }
+
+  auto delta = makeEditDelta(EditDelta::Kind::stepRows, sequence, step);
+  delta.row = static_cast<std::uint32_t>(before.size());
+  delta.col = static_cast<std::uint32_t>(after.size());
+  for (const auto& row : before)
+    appendRowValues(row, delta.values);
+  for (const auto& row : after)
+    appendRowValues(row, delta.values);
+  deltas.push_back(std::move(delta));
+}
+
+/** reads one side of a stepRows delta back. Returns false if the values do not add up */
+bool unpackStepRows(const EditDelta& delta, bool beforeSide, Step::Rows& rows)
+{
+  std::size_t position = 0;
+  for (int side = 0; side < 2; ++side)
+  {
+    const bool wanted = (side == 0) == beforeSide;
+    const std::size_t rowCount = side == 0 ? delta.row : delta.col;
+    for (std::size_t row = 0; row < rowCount; ++row)
+    {
+      if (position >= delta.values.size())
+        return false;
+      const auto width = static_cast<std::size_t>(delta.values[position++]);
+      if (width > delta.values.size() - position)
+        return false;
+      if (wanted)
+        rows.emplace_back(delta.values.begin() + static_cast<std::ptrdiff_t>(position),
+                          delta.values.begin() + static_cast<std::ptrdiff_t>(position + width));
+      position += width;
+    }
+  }
+  return !rows.empty();
+}
+
+/** settings first: changing the type or machine type rewrites row commands, which the
+ * step deltas that follow then put right */
+void appendSequenceDeltas(const SequenceEditState& before, const SequenceEditState& after, std::vector<EditDelta>& deltas)
+{
+  for (const std::size_t setting : {Sequence::typeConfig, Sequence::machineTypeConfig, Sequence::machineIdConfig, Sequence::tpsConfig, Sequence::probConfig})
+  {
+    if (before.settings[setting] == after.settings[setting])
+      continue;
+    auto delta = makeEditDelta(EditDelta::Kind::sequenceSetting, before.sequence, setting);
+    delta.before = before.settings[setting];
+    delta.after = after.settings[setting];
+    deltas.push_back(std::move(delta));
+  }
+  if (before.length != after.length)
+  {
+    auto delta = makeEditDelta(EditDelta::Kind::sequenceLength, before.sequence, 0);
+    delta.before = static_cast<double>(before.length);
+    delta.after = static_cast<double>(after.length);
+    deltas.push_back(std::move(delta));
+  }
+
+  const auto steps = std::min(before.length, after.length);
+  for (std::size_t step = 0; step < steps; ++step)
+  {
+    if (before.steps[step] != after.steps[step] && before.steps[step] != nullptr && after.steps[step] != nullptr)
+      appendStepDeltas(before.sequence, step, *before.steps[step], *after.steps[step], deltas);
+    if (before.active[step] != after.active[step])
+    {
+      auto delta = makeEditDelta(EditDelta::Kind::stepActive, before.sequence, step);
+      delta.before = before.active[step] ? 1.0 : 0.0;
+      delta.after = after.active[step] ? 1.0 : 0.0;
+      deltas.push_back(std::move(delta));
+    }
+  }
+}
+
+bool isStepDelta(EditDelta::Kind kind)
+{
+  return kind == EditDelta::Kind::cell
+      || kind == EditDelta::Kind::rowInsert
+      || kind == EditDelta::Kind::rowRemove
+      || kind == EditDelta::Kind::stepRows
+      || kind == EditDelta::Kind::stepActive;
+}
+
+/** changes that only reach playback through the patterns the sequences publish */
+bool isPatternDelta(EditDelta::Kind kind)
+{
+  return isStepDelta(kind) || kind == EditDelta::Kind::sequenceLength;
+}
+
+bool isSongRowDelta(EditDelta::Kind kind)
+{
+  return kind == EditDelta::Kind::songRowInsert
+      || kind == EditDelta::Kind::songRowSet
+      || kind == EditDelta::Kind::songRowBeats
+      || kind == EditDelta::Kind::songRowTrackPattern;
+}
+
+std::vector<std::uint8_t> toJsonBytes(const juce::var& value)
+{
+  const auto json = juce::JSON::toString(value, true);
+  const auto* text = json.toRawUTF8();
+  return std::vector<std::uint8_t>(text, text + json.getNumBytesAsUTF8());
+}
+
+juce::var parseJsonState(const juce::MemoryBlock& state)
+{
+  if (state.getSize() == 0 || !juce::CharPointer_UTF8::isValidString(static_cast<const char*>(state.getData()), static_cast<int>(state.getSize())))
+    return {};
+  return juce::JSON::parse(juce::String::fromUTF8(static_cast<const char*>(state.getData()), static_cast<int>(state.getSize())));
+}
+
+/** one machineState delta per value that differs, down to the deepest object property or
+ * array element both sides still have, so undo only touches what the edit changed */
+void appendJsonDeltas(const juce::var& before, const juce::var& after, const std::string& path,
+                      CommandType machineType, std::size_t machineIndex, std::vector<EditDelta>& deltas)
+{
+  auto* beforeObject = before.getDynamicObject();
+  auto* afterObject = after.getDynamicObject();
+  if (beforeObject != nullptr && afterObject != nullptr
+      && beforeObject->getProperties().size() == afterObject->getProperties().size())
+  {
+    bool sameNames = true;
+    for (const auto& property : beforeObject->getProperties())
+      sameNames = sameNames && afterObject->hasProperty(property.name);
+    if (sameNames)
+    {
+      for (const auto& property : beforeObject->getProperties())
+        appendJsonDeltas(property.value, afterObject->getProperty(property.name),
+                         path + "/" + property.name.toString().toStdString(), machineType, machineIndex, deltas);
+      return;
+    }
+  }
+  const auto* beforeArray = before.getArray();
+  const auto* afterArray = after.getArray();
+  if (beforeArray != nullptr && afterArray != nullptr && beforeArray->size() == afterArray->size())
+  {
+    for (int i = 0; i < beforeArray->size(); ++i)
+      appendJsonDeltas(beforeArray->getReference(i), afterArray->getReference(i),
+                       path + "/" + std::to_string(i), machineType, machineIndex, deltas);
+    return;
+  }
+
+  auto beforeBytes = toJsonBytes(before);
+  auto afterBytes = toJsonBytes(after);
+  if (beforeBytes == afterBytes)
+    return;
+  auto delta = makeEditDelta(EditDelta::Kind::machineState, static_cast<std::size_t>(machineType), machineIndex);
+  // the root itself is written as "/" so an empty path still means a byte range
+  delta.path = path.empty() ? "/" : path;
+  delta.beforeBytes = std::move(beforeBytes);
+  delta.afterBytes = std::move(afterBytes);
+  deltas.push_back(std::move(delta));
+}
+
+/** replace the value at a path appendJsonDeltas wrote. False if the state no longer has it */
+bool setJsonValueAtPath(juce::var& root, const std::string& path, const juce::var& value)
+{
+  if (path == "/")
+  {
+    root = value;
+    return true;
+  }
+  juce::var* node = &root;
+  std::size_t start = 1;
+  while (start <= path.size())
+  {
+    const auto end = std::min(path.find('/', start), path.size());
+    const std::string name = path.substr(start, end - start);
+    if (name.empty())
+      return false;
+    juce::var* child = nullptr;
+    if (auto* object = node->getDynamicObject())
+      child = object->getProperties().getVarPointer(juce::Identifier(name));
+    else if (auto* array = node->getArray())
+    {
+      const int index = name.size() > 9 || name.find_first_not_of("0123456789") != std::string::npos ? -1 : std::stoi(name);
+      if (index >= 0 && index < array->size())
+        child = &array->getReference(index);
+    }
+    if (child == nullptr)
+      return false;
+    node = child;
+    start = end + 1;
+  }
+  *node = value;
+  return true;
+}
+
+/** work out the state each machine the action touches should end up with. False if a machine
+ * is gone or its state no longer fits the action */
+bool prepareMachineStates(MachineHost* machineHost, const EditJournal::Action& action, bool undoing,
+                          std::vector<std::pair<MachineInterface*, juce::MemoryBlock>>& states)
+{
+  for (const auto& delta : action.deltas)
+  {
+    if (delta.kind != EditDelta::Kind::machineState)
+      continue;
+    auto* machine = machineHost != nullptr ? machineHost->getMachine(static_cast<CommandType>(delta.target), delta.index) : nullptr;
+    if (machine == nullptr)
+      return false;
+    auto found = std::find_if(states.begin(), states.end(), [machine](const auto& entry) { return entry.first == machine; });
+    if (found == states.end())
+    {
+      states.emplace_back(machine, juce::MemoryBlock{});
+      machine->getStateInformation(states.back().second);
+      found = states.end() - 1;
+    }
+    juce::MemoryBlock& state = found->second;
+    const auto& current = undoing ? delta.afterBytes : delta.beforeBytes;
+    const auto& wanted = undoing ? delta.beforeBytes : delta.afterBytes;
+
+    if (!delta.path.empty())
+    {
+      auto root = parseJsonState(state);
+      // fromString rather than parse, as a single value need not be an object or array
+      const auto value = juce::JSON::fromString(juce::String::fromUTF8(reinterpret_cast<const char*>(wanted.data()), static_cast<int>(wanted.size())));
+      if (!root.isObject() || !setJsonValueAtPath(root, delta.path, value))
+        return false;
+      const auto json = toJsonBytes(root);
+      state.reset();
+      state.append(json.data(), json.size());
+      continue;
+    }
+
+    // only the changed middle was kept, so it has to be where the state has it now
+    const auto* bytes = static_cast<const std::uint8_t*>(state.getData());
+    if (state.getSize() != std::size_t{delta.row} + current.size() + delta.col
+        || !std::equal(current.begin(), current.end(), bytes + delta.row))
+      return false;
+    juce::MemoryBlock restored(bytes, delta.row);
+    restored.append(wanted.data(), wanted.size());
+    restored.append(bytes + delta.row + current.size(), delta.col);
+    state = std::move(restored);
+  }
+  return true;
+}
 } // namespace
 
+/**
+ * Records what one editor action changes as a single undo step: the current sequence, the gain
+ * of the stack it plays on, the machine open on the machine page and any stack slot, song row
+ * or mute changes the action reports. Open one at the top of each editing entry point; nested ones fold into the
+ * outermost, which compares before and after when it closes.
+ */
+class SequencerEditor::UndoableEdit
+{
+public:
+  explicit UndoableEdit(SequencerEditor& _editor) : editor{_editor},
+                                                   outermost{editor.undoableEditDepth++ == 0}
+  {
+    if (!outermost)
+      return;
+    editor.pendingEdits.clear();
+    generation = editor.undoHistoryGeneration;
+    sequencer = editor.sequencer;
+    sequenceSet = editor.songHost != nullptr ? editor.songHost->getViewedSequenceSetIndex() : 0;
+    sequenceBefore = captureSequenceEditState(sequencer, editor.currentSequence);
+    if (sequenceBefore.valid && editor.machineHost != nullptr)
+    {
+      stackIndex = static_cast<std::size_t>(juce::jmax(0, static_cast<int>(sequenceBefore.settings[Sequence::machineIdConfig])));
+      gainBefore = editor.machineHost->getStackGainDb(stackIndex);
+    }
+    hasMachine = captureMachine();
+  }
+
+  ~UndoableEdit()
+  {
+    --editor.undoableEditDepth;
+    if (!outermost)
+      return;
+    // a reset, load or set change swapped the sequences out from under the edit
+    if (generation != editor.undoHistoryGeneration || sequencer != editor.sequencer)
+      return;
+
+    EditJournal::Action action;
+    action.sequenceSet = sequenceSet;
+    if (sequenceBefore.valid)
+      appendSequenceDeltas(sequenceBefore, captureSequenceEditState(sequencer, sequenceBefore.sequence), action.deltas);
+    if (sequenceBefore.valid && editor.machineHost != nullptr)
+    {
+      const float gainAfter = editor.machineHost->getStackGainDb(stackIndex);
+      if (gainAfter != gainBefore)
+      {
+        auto delta = makeEditDelta(EditDelta::Kind::stackGain, stackIndex, 0);
+        delta.before = gainBefore;
+        delta.after = gainAfter;
+        action.deltas.push_back(std::move(delta));
+      }
+    }
+    appendMachineDelta(action.deltas);
+    for (auto& delta : editor.pendingEdits)
+      action.deltas.push_back(std::move(delta));
+    editor.pendingEdits.clear();
+
+    if (!action.deltas.empty())
+      editor.editJournal.record(action);
+  }
+
+  UndoableEdit(const UndoableEdit&) = delete;
+  UndoableEdit& operator=(const UndoableEdit&) = delete;
+
+private:
+  /** keep the state of the machine open on the machine page, if there is one */
+  bool captureMachine()
+  {
+    if (!editor.machineStackDetailMode || editor.machineHost == nullptr)
+      return false;
+    const auto selectedType = editor.getSelectedStackMachineType();
+    if (!selectedType.has_value() || selectedType.value() == CommandType::MidiNote)
+      return false;
+    machineType = selectedType.value();
+    machineIndex = editor.getActiveMachineIndex(machineType);
+    auto* machine = editor.machineHost->getMachine(machineType, machineIndex);
+    if (machine == nullptr)
+      return false;
+    machine->getStateInformation(machineBefore);
+    return true;
+  }
+
+  /** records what changed in the machine's state: changed values for JSON states, otherwise
+   * the bytes between what the two states share at either end */
+  void appendMachineDelta(std::vector<EditDelta>& deltas) const
+  {
+    if (!hasMachine)
+      return;
+    auto* machine = editor.machineHost->getMachine(machineType, machineIndex);
+    if (machine == nullptr)
+      return;
+    juce::MemoryBlock machineAfter;
+    machine->getStateInformation(machineAfter);
+    if (machineAfter == machineBefore)
+      return;
+
+    // the state also carries playback fields such as an arp's play head, so journal only the
+    // values that changed rather than a byte range that stops matching once playback moves on
+    const auto beforeJson = parseJsonState(machineBefore);
+    const auto afterJson = parseJsonState(machineAfter);
+    if (beforeJson.isObject() && afterJson.isObject())
+    {
+      appendJsonDeltas(beforeJson, afterJson, {}, machineType, machineIndex, deltas);
+      return;
+    }
+
+    const auto* before = static_cast<const std::uint8_t*>(machineBefore.getData());
+    const auto* after = static_cast<const std::uint8_t*>(machineAfter.getData());
+    const std::size_t shorter = std::min(machineBefore.getSize(), machineAfter.getSize());
+    std::size_t prefix = 0;
+    while (prefix < shorter && before[prefix] == after[prefix])
+      ++prefix;
+    std::size_t suffix = 0;
+    while (suffix < shorter - prefix
+           && before[machineBefore.getSize() - 1 - suffix] == after[machineAfter.getSize() - 1 - suffix])
+      ++suffix;
+
+    auto delta = makeEditDelta(EditDelta::Kind::machineState, static_cast<std::size_t>(machineType), machineIndex);
+    delta.row = static_cast<std::uint32_t>(prefix);
+    delta.col = static_cast<std::uint32_t>(suffix);
+    delta.beforeBytes.assign(before + prefix, before + machineBefore.getSize() - suffix);
+    delta.afterBytes.assign(after + prefix, after + machineAfter.getSize() - suffix);
+    deltas.push_back(std::move(delta));
+  }
+
+  SequencerEditor& editor;
+  const bool outermost;
+  std::uint64_t generation = 0;
+  SequencerAbs* sequencer = nullptr;
+  std::size_t sequenceSet = 0;
+  SequenceEditState sequenceBefore;
+  std::size_t stackIndex = 0;
+  float gainBefore = 0.0f;
+  bool hasMachine = false;
+  CommandType machineType = CommandType::MidiNote;
+  std::size_t machineIndex = 0;
+  juce::MemoryBlock machineBefore;
+};
+
 SequencerEditor::SequencerEditor(SequencerAbs *_sequencer) : sequencer{_sequencer},
                                                          songHost{nullptr},
                                                          currentSequence{0},
@@ -189,6 +659,10 @@ void SequencerEditor::setQuitConfirmationHandler(std::function<void()> handler)
 {
   quitConfirmationHandler = std::move(handler);
 }
+void SequencerEditor::setArmedSequenceChangedHandler(std::function<void()> handler)
+{
+  armedSequenceChangedHandler = std::move(handler);
+}
 SequencerAbs *SequencerEditor::getSequencer()
 {
   return this->sequencer;
@@ -337,6 +811,7 @@ void SequencerEditor::cycleEditMode()
  */
 void SequencerEditor::cycleAtCursor()
 {
+  const UndoableEdit edit{*this};
   switch (editMode)
   {
   case SequencerEditorMode::arrangingSong:
@@ -369,6 +844,7 @@ void SequencerEditor::cycleAtCursor()
 
 void SequencerEditor::click()
 {
+  const UndoableEdit edit{*this};
   switch (getCurrentPage())
   {
   case SequencerEditorPage::song:
@@ -393,6 +869,7 @@ void SequencerEditor::click()
 /** mode dependent reset function. Might reset */
 void SequencerEditor::resetAtCursor()
 {
+  const UndoableEdit edit{*this};
   switch (getCurrentPage())
   {
   case SequencerEditorPage::song:
@@ -444,6 +921,7 @@ void SequencerEditor::enterAtCursor()
 
 void SequencerEditor::enterStepData(double value, int column, bool applyOctave)
 {
+  const UndoableEdit edit{*this};
   if (editMode == SequencerEditorMode::editingStep ||
       editMode == SequencerEditorMode::selectingSeqAndStep)
   {
@@ -600,6 +1078,7 @@ void SequencerEditor::decrementOctave()
  */
 void SequencerEditor::enterDataAtCursor(double inValue)
 {
+  const UndoableEdit edit{*this};
   if (editMode == SequencerEditorMode::editingStep ||
       editMode == SequencerEditorMode::selectingSeqAndStep)
   {
@@ -655,11 +1134,11 @@ void SequencerEditor::enterDataAtCursor(double inValue)
       sequence->setMachineId(machineId);
     }
     else if (currentSeqParam == Sequence::tpsConfig){
-      int tps = static_cast<int>(inValue);
+      double tps = CommandProcessor::roundToEngineTicks(inValue);
       if (tps < 1) tps = 1;
       if (tps > 16) tps = 16;
-      sequence->setTicksPerStep(static_cast<std::size_t>(tps));
-      sequence->onZeroSetTicksPerStep(static_cast<std::size_t>(tps));
+      sequence->setTicksPerStep(tps);
+      sequence->onZeroSetTicksPerStep(tps);
     }
     else if (currentSeqParam == Sequence::probConfig){
       double prob = inValue;
@@ -770,6 +1249,7 @@ void SequencerEditor::moveCursorDown()
 /** increase the value at the cursor */
 void SequencerEditor::addRow()
 {
+  const UndoableEdit edit{*this};
   switch (getCurrentPage())
   {
   case SequencerEditorPage::song:
@@ -793,6 +1273,7 @@ void SequencerEditor::addRow()
 /** decreae the value at the cursor */
 void SequencerEditor::removeRow()
 {
+  const UndoableEdit edit{*this};
   switch (getCurrentPage())
   {
   case SequencerEditorPage::song:
@@ -816,6 +1297,7 @@ void SequencerEditor::removeRow()
 /** increase the value at the current cursor position, e.g. increasing note number */
 void SequencerEditor::incrementAtCursor()
 {
+  const UndoableEdit edit{*this};
   switch (getCurrentPage())
   {
   case SequencerEditorPage::song:
@@ -837,9 +1319,46 @@ void SequencerEditor::incrementAtCursor()
     break;
   }
 }
+void SequencerEditor::adjustAtCursor(int amount)
+{
+  const UndoableEdit edit{*this};
+  sequencer->holdPatternPublishing();
+  for (int i = 0; i < std::abs(amount); ++i)
+  {
+    if (amount > 0)
+      incrementAtCursor();
+    else
+      decrementAtCursor();
+  }
+  sequencer->releasePatternPublishing();
+}
+
+bool SequencerEditor::editsOnlyPatterns() const
+{
+  const auto page = getCurrentPage();
+  return page == SequencerEditorPage::sequence || page == SequencerEditorPage::step;
+}
+
+bool SequencerEditor::isPatternEditKey(char key) const
+{
+  if (!editsOnlyPatterns())
+    return false;
+  if (getCurrentPage() == SequencerEditorPage::step)
+    for (const auto& shortcut : kChordShortcuts)
+      if (shortcut.key == key)
+        return true;
+  return isNoteKey(key) && isSequencerPlaying(sequencer);
+}
+
+bool SequencerEditor::isNoteKey(char key) const
+{
+  return lookupKeyboardMidiNote(key).has_value();
+}
+
 /** decrease the value at the current cursor position, e.g. increasing note number */
 void SequencerEditor::decrementAtCursor()
 {
+  const UndoableEdit edit{*this};
   switch (getCurrentPage())
   {
   case SequencerEditorPage::song:
@@ -1041,6 +1560,7 @@ void SequencerEditor::incrementStepData(std::vector<std::vector<double>> &data,
  */
 void SequencerEditor::incrementSeqConfigParam()
 {
+  const UndoableEdit edit{*this};
   incrementOnSequenceConfigPage();
 }
 
@@ -1049,11 +1569,13 @@ void SequencerEditor::incrementSeqConfigParam()
  */
 void SequencerEditor::decrementSeqConfigParam()
 {
+  const UndoableEdit edit{*this};
   decrementOnSequenceConfigPage();
 }
 
 void SequencerEditor::incrementChannel()
 {
+  const UndoableEdit edit{*this};
   Sequence* sequence = sequencer->getSequence(currentSequence);
   int machineId = static_cast<int>(sequence->getMachineId());
   machineId = (machineId + 1) % kMachineStackCount;
@@ -1061,6 +1583,7 @@ void SequencerEditor::incrementChannel()
 }
 void SequencerEditor::decrementChannel()
 {
+  const UndoableEdit edit{*this};
   Sequence* sequence = sequencer->getSequence(currentSequence);
   int machineId = static_cast<int>(sequence->getMachineId());
   machineId = (machineId - 1);
@@ -1071,25 +1594,28 @@ void SequencerEditor::decrementChannel()
 
 void SequencerEditor::incrementTicksPerStep()
 {
-  std::size_t tps = sequencer->getSequence(currentSequence)->getTicksPerStep();
+  const UndoableEdit edit{*this};
+  double tps = sequencer->getSequence(currentSequence)->getTicksPerStep();
   if (tps >= 8)
     tps = 1;
   else
-    ++tps;
+    tps = std::floor(tps) + 1;
   sequencer->getSequence(currentSequence)->setTicksPerStep(tps);
 }
 void SequencerEditor::decrementTicksPerStep()
 {
-  std::size_t tps = sequencer->getSequence(currentSequence)->getTicksPerStep();
+  const UndoableEdit edit{*this};
+  double tps = sequencer->getSequence(currentSequence)->getTicksPerStep();
   if (tps <= 1)
     tps = 1;
   else
-    --tps;
+    tps = std::ceil(tps) - 1;
   sequencer->getSequence(currentSequence)->setTicksPerStep(tps);
 }
 
 void SequencerEditor::shiftCurrentSequenceStepNote(int semitones)
 {
+  const UndoableEdit edit{*this};
   if (sequencer == nullptr)
     return;
 
@@ -1133,6 +1659,33 @@ void SequencerEditor::nextSequenceType(SequencerAbs *seqr, unsigned int sequence
   }
 }
 
+void SequencerEditor::previousSequenceType(SequencerAbs *seqr, unsigned int sequence)
+{
+  SequenceType type = seqr->getSequenceType(sequence);
+  switch (type)
+  {
+  case SequenceType::midiNote:
+    seqr->setSequenceType(sequence, SequenceType::tickChanger);
+    break;
+  case SequenceType::drumMidi:
+    seqr->setSequenceType(sequence, SequenceType::midiNote);
+    break;
+  case SequenceType::chordMidi:
+  case SequenceType::samplePlayer:
+    seqr->setSequenceType(sequence, SequenceType::drumMidi);
+    break;
+  case SequenceType::transposer:
+    seqr->setSequenceType(sequence, SequenceType::drumMidi);
+    break;
+  case SequenceType::lengthChanger:
+    seqr->setSequenceType(sequence, SequenceType::transposer);
+    break;
+  case SequenceType::tickChanger:
+    seqr->setSequenceType(sequence, SequenceType::lengthChanger);
+    break;
+  }
+}
+
 size_t SequencerEditor::getCurrentSequence() const
 {
   return currentSequence;
@@ -1187,10 +1740,16 @@ void SequencerEditor::moveCursorLeftOnSongPage()
     --currentSongCol;
 }
 
+std::size_t SequencerEditor::getLastSongCol() const
+{
+  if (currentSongRow == 0)
+    return 1u;
+  return songTrackFirstCol - 1 + sequencer->howManySequences();
+}
+
 void SequencerEditor::moveCursorRightOnSongPage()
 {
-  const std::size_t maxCol = currentSongRow == 0 ? 1u : 3u;
-  if (currentSongCol < maxCol)
+  if (currentSongCol < getLastSongCol())
     ++currentSongCol;
 }
 
@@ -1200,7 +1759,7 @@ void SequencerEditor::moveCursorUpOnSongPage()
     return;
 
   --currentSongRow;
-  currentSongCol = std::min<std::size_t>(currentSongCol, currentSongRow == 0 ? 1u : 3u);
+  currentSongCol = std::min<std::size_t>(currentSongCol, getLastSongCol());
   if (songHost != nullptr)
     songHost->setSelectedSongRow(currentSongRow == 0 ? 0u : currentSongRow - 1);
 }
@@ -1212,7 +1771,7 @@ void SequencerEditor::moveCursorDownOnSongPage()
     return;
 
   ++currentSongRow;
-  currentSongCol = std::min<std::size_t>(currentSongCol, currentSongRow == 0 ? 1u : 3u);
+  currentSongCol = std::min<std::size_t>(currentSongCol, getLastSongCol());
   if (songHost != nullptr && currentSongRow > 0)
     songHost->setSelectedSongRow(currentSongRow - 1);
 }
@@ -1395,7 +1954,10 @@ void SequencerEditor::addRowOnSongPage()
 {
   if (songHost == nullptr)
     return;
+  const std::size_t setCount = songHost->getSequenceSetCount();
   const std::size_t newRow = songHost->addSongRowByCloningViewedSet();
+  if (songHost->getSequenceSetCount() != setCount)
+    recordEdit(makeEditDelta(EditDelta::Kind::songRowInsert, setCount, newRow));
   currentSongRow = newRow + 1;
   currentSongCol = 0;
   songHost->setSelectedSongRow(newRow);
@@ -1410,7 +1972,7 @@ void SequencerEditor::addRowOnStepPage()
 {
   std::vector<std::vector<double>> data = sequencer->getStepData(currentSequence, currentStep);
   std::vector<double> newRow(data[0].size(), 0.0);
-  newRow[Step::cmdInd] = sequencer->getSequence(currentSequence)->getMachineType();
+  newRow[Step::cmdInd] = sequencer->getSequence(currentSequence)->getRowCommand();
   data.push_back(newRow);
   writeStepData(data);
 }
@@ -1471,8 +2033,12 @@ void SequencerEditor::clickOnSongPage()
   }
   if (currentSongCol == 3)
   {
+    const std::size_t setCount = songHost->getSequenceSetCount();
     songHost->removeSongRow(songRowIndex);
     currentSongRow = std::min<std::size_t>(currentSongRow, songHost->getSongRowCount());
+    // removing a row can take its sequence set with it, which renumbers the sets the history refers to
+    if (songHost->getSequenceSetCount() != setCount)
+      clearUndoHistory();
   }
 }
 
@@ -1530,19 +2096,53 @@ void SequencerEditor::incrementOnStepPage()
 }
 
 void SequencerEditor::incrementOnSongPage()
+{
+  adjustSongRowAtCursor(1);
+}
+
+void SequencerEditor::adjustSongRowAtCursor(int direction)
 {
   if (songHost == nullptr || currentSongRow == 0)
     return;
 
   const std::size_t songRowIndex = currentSongRow - 1;
+  EditDelta delta;
   if (currentSongCol == 0)
-    songHost->adjustSongRowSequenceSetId(songRowIndex, 1);
+  {
+    delta = makeEditDelta(EditDelta::Kind::songRowSet, 0, songRowIndex);
+    delta.before = static_cast<double>(songHost->getSongRowSequenceSetId(songRowIndex));
+    songHost->adjustSongRowSequenceSetId(songRowIndex, direction);
+    delta.after = static_cast<double>(songHost->getSongRowSequenceSetId(songRowIndex));
+  }
   else if (currentSongCol == 1)
-    songHost->adjustSongRowBeatCount(songRowIndex, 1);
+  {
+    delta = makeEditDelta(EditDelta::Kind::songRowBeats, 0, songRowIndex);
+    delta.before = songHost->getSongRowBeatCount(songRowIndex);
+    songHost->adjustSongRowBeatCount(songRowIndex, direction);
+    delta.after = songHost->getSongRowBeatCount(songRowIndex);
+  }
+  else if (currentSongCol >= songTrackFirstCol)
+  {
+    const std::size_t track = currentSongCol - songTrackFirstCol;
+    delta = makeEditDelta(EditDelta::Kind::songRowTrackPattern, 0, songRowIndex);
+    delta.row = static_cast<std::uint32_t>(track);
+    delta.before = static_cast<double>(songHost->getSongRowTrackPattern(songRowIndex, track));
+    songHost->adjustSongRowTrackPattern(songRowIndex, track, direction);
+    delta.after = static_cast<double>(songHost->getSongRowTrackPattern(songRowIndex, track));
+  }
+  else
+    return;
+  if (delta.after != delta.before)
+    recordEdit(std::move(delta));
 }
 
 void SequencerEditor::incrementOnSequenceConfigPage()
 {
+  if (currentSeqParam == Sequence::typeConfig)
+  {
+    nextSequenceType(sequencer, static_cast<unsigned int>(currentSequence));
+    return;
+  }
   if (currentSeqParam < sequencer->getSeqConfigSpecs().size())
   {
     sequencer->incrementSeqParam(currentSequence, currentSeqParam);
@@ -1574,18 +2174,16 @@ void SequencerEditor::decrementOnStepPage()
 
 void SequencerEditor::decrementOnSongPage()
 {
-  if (songHost == nullptr || currentSongRow == 0)
-    return;
-
-  const std::size_t songRowIndex = currentSongRow - 1;
-  if (currentSongCol == 0)
-    songHost->adjustSongRowSequenceSetId(songRowIndex, -1);
-  else if (currentSongCol == 1)
-    songHost->adjustSongRowBeatCount(songRowIndex, -1);
+  adjustSongRowAtCursor(-1);
 }
 
 void SequencerEditor::decrementOnSequenceConfigPage()
 {
+  if (currentSeqParam == Sequence::typeConfig)
+  {
+    previousSequenceType(sequencer, static_cast<unsigned int>(currentSequence));
+    return;
+  }
   if (currentSeqParam < sequencer->getSeqConfigSpecs().size())
   {
     sequencer->decrementSeqParam(currentSequence, currentSeqParam);
@@ -1821,6 +2419,26 @@ void SequencerEditor::rewindTransport()
   }
 }
 
+void SequencerEditor::playFromCursor()
+{
+  if (songHost == nullptr || songHost->getSongRowCount() == 0)
+    return;
+  if (getCurrentPage() == SequencerEditorPage::song)
+  {
+    const std::size_t row = currentSongRow == 0 ? 0u : currentSongRow - 1;
+    songHost->seekSongPosition(std::min(row, songHost->getSongRowCount() - 1), 0, 0, true);
+    return;
+  }
+  // the cursor sequence triggers step n once n steps of engine ticks have gone by in the row.
+  // Steps between grid ticks start from the grid tick before, so the step still plays
+  std::size_t ticks = 0;
+  if (auto* impl = getSequencerImpl())
+    if (currentSequence < impl->howManySequences())
+      ticks = currentStep * CommandProcessor::toEngineTicks(impl->getSequence(currentSequence)->getTicksPerStep())
+        / CommandProcessor::getTicksPerGridTick();
+  songHost->seekSongPosition(songHost->getSelectedSongRow(), static_cast<int>(ticks / 4), static_cast<int>(ticks % 4), true);
+}
+
 void SequencerEditor::toggleArmCurrentSequence()
 {
   setArmedSequence(getCurrentSequence());
@@ -1828,8 +2446,16 @@ void SequencerEditor::toggleArmCurrentSequence()
 
 void SequencerEditor::toggleMuteCurrentSequence()
 {
-  if (auto* impl = getSequencerImpl())
-    impl->toggleSequenceMute(getCurrentSequence());
+  const UndoableEdit edit{*this};
+  auto* impl = getSequencerImpl();
+  const auto* sequence = impl != nullptr ? impl->getSequence(getCurrentSequence()) : nullptr;
+  if (sequence == nullptr)
+    return;
+  auto delta = makeEditDelta(EditDelta::Kind::sequenceMute, getCurrentSequence(), 0);
+  delta.before = sequence->isMuted() ? 1.0 : 0.0;
+  impl->toggleSequenceMute(getCurrentSequence());
+  delta.after = sequence->isMuted() ? 1.0 : 0.0;
+  recordEdit(std::move(delta));
 }
 
 bool SequencerEditor::handleChordKey(char key)
@@ -1846,7 +2472,7 @@ bool SequencerEditor::handleChordKey(char key)
   return false;
 }
 
-bool SequencerEditor::handleNoteKey(char key)
+bool SequencerEditor::handleNoteKey(char key, bool preview)
 {
   if (getCurrentPage() == SequencerEditorPage::resetConfirmation
       || getCurrentPage() == SequencerEditorPage::song)
@@ -1855,9 +2481,11 @@ bool SequencerEditor::handleNoteKey(char key)
   const auto midiNote = lookupKeyboardMidiNote(key);
   if (!midiNote.has_value())
     return false;
+  const UndoableEdit edit{*this};
 
   const double note = midiNote.value() + (12 * getCurrentOctave());
-  previewEnteredNote(note);
+  if (preview)
+    previewEnteredNote(note);
 
   if (getCurrentPage() == SequencerEditorPage::machine)
     return machineInsertCurrentCell(note);
@@ -1868,6 +2496,7 @@ bool SequencerEditor::handleNoteKey(char key)
 
 bool SequencerEditor::applyChordToCurrentStep(const std::vector<int>& intervals)
 {
+  const UndoableEdit edit{*this};
   if (editMode != SequencerEditorMode::editingStep || intervals.empty())
     return false;
 
@@ -1952,33 +2581,338 @@ void SequencerEditor::requestApplicationQuit()
 
 void SequencerEditor::setArmedSequence(const size_t sequence)
 {
-  if (this->armedSequence == sequence)
+  // only the editor writes it, so the load and store cannot be split by another write
+  if (armedSequence.load(std::memory_order_relaxed) == sequence)
   {
     // switch it off
-    this->armedSequence = SequencerAbs::notArmed;
+    armedSequence.store(SequencerAbs::notArmed, std::memory_order_release);
   }
   else
   {
-    this->armedSequence = sequence;
+    armedSequence.store(sequence, std::memory_order_release);
   }
+  if (armedSequenceChangedHandler)
+    armedSequenceChangedHandler();
 }
 size_t SequencerEditor::getArmedSequence()
 {
-  return this->armedSequence;
+  return armedSequence.load(std::memory_order_acquire);
 }
 
 void SequencerEditor::unarmSequence()
 {
-  this->armedSequence = SequencerAbs::notArmed;
+  armedSequence.store(SequencerAbs::notArmed, std::memory_order_release);
+  if (armedSequenceChangedHandler)
+    armedSequenceChangedHandler();
 }
 
 bool SequencerEditor::isArmedForLiveMIDI()
 {
-  if (this->armedSequence == SequencerAbs::notArmed)
+  return armedSequence.load(std::memory_order_acquire) != SequencerAbs::notArmed;
+}
+
+std::size_t SequencerEditor::recordLiveNote(SequencerAbs* target, std::size_t sequence, std::size_t step, double note, double velocity)
+{
+  if (target == nullptr || sequence >= target->howManySequences() || step >= target->howManySteps(sequence))
+    return 0;
+
+  // modulator sequences hold amounts, not notes
+  if (Sequence::isModulatorType(target->getSequenceType(sequence)))
+    return 0;
+
+  std::vector<std::vector<double>> data = target->getStepData(sequence, step);
+  normalizeEditableStepData(target, sequence, 0, data);
+
+  // parameter lock rows keep their values; notes only land on rows that play the machine
+  std::size_t row = data.size();
+  for (std::size_t i = 0; i < data.size() && row == data.size(); ++i)
+    if (!Step::isParameterLockRow(data[i]) && std::abs(data[i][Step::noteInd] - note) < std::numeric_limits<double>::epsilon())
+      row = i;
+  for (std::size_t i = 0; i < data.size() && row == data.size(); ++i)
+    if (!Step::isParameterLockRow(data[i]) && data[i][Step::noteInd] <= 0)
+      row = i;
+  for (std::size_t i = 0; i < data.size() && row == data.size(); ++i)
+    if (!Step::isParameterLockRow(data[i]))
+      row = i;
+  if (row == data.size())
+    data.push_back(std::vector<double>(Step::maxInd + 1, 0.0));
+
+  // same defaults as typed entry so the new note plays straight away
+  const std::size_t cols[] = {Step::lengthInd, Step::probInd};
+  for (std::size_t col : cols)
+  {
+    if (std::abs(data[row][col]) < std::numeric_limits<double>::epsilon())
+      data[row][col] = CommandProcessor::getCommand(data[row][Step::cmdInd]).parameters[col - 1].defaultValue;
+  }
+  data[row][Step::noteInd] = note;
+  data[row][Step::velInd] = velocity;
+  target->setStepData(sequence, step, std::move(data));
+  requestStringRefresh();
+  return row;
+}
+
+void SequencerEditor::recordLiveNoteLength(SequencerAbs* target, std::size_t sequence, std::size_t step, std::size_t row, double lengthTicks)
+{
+  if (target == nullptr || sequence >= target->howManySequences() || step >= target->howManySteps(sequence))
+    return;
+  if (Sequence::isModulatorType(target->getSequenceType(sequence)))
+    return;
+
+  std::vector<std::vector<double>> data = target->getStepData(sequence, step);
+  if (row >= data.size() || data[row].size() <= Step::lengthInd)
+    return;
+  const Parameter& lengthParam = CommandProcessor::getCommand(data[row][Step::cmdInd]).parameters[Step::lengthInd - 1];
+  // held lengths keep the engine's resolution, so a finer tick setting records between grid ticks
+  const double shortest = std::max(CommandProcessor::getEngineTickInGridTicks(), lengthParam.min);
+  data[row][Step::lengthInd] = std::clamp(CommandProcessor::roundToEngineTicks(lengthTicks), shortest, std::max(shortest, lengthParam.max));
+  target->setStepData(sequence, step, std::move(data));
+  requestStringRefresh();
+}
+
+bool SequencerEditor::undo()
+{
+  EditJournal::Action action;
+  if (!editJournal.undo(action))
+    return false;
+  if (applyEditAction(action, true))
+    return true;
+  // leave the entry in place so a later undo can try it again
+  editJournal.redo(action);
+  return false;
+}
+
+bool SequencerEditor::redo()
+{
+  EditJournal::Action action;
+  if (!editJournal.redo(action))
     return false;
+  if (applyEditAction(action, false))
+    return true;
+  editJournal.undo(action);
+  return false;
+}
+
+bool SequencerEditor::undoEditsOnlyPatterns() const
+{
+  EditJournal::Action action;
+  return editJournal.peekUndo(action) && editsOnlyPatterns(action);
+}
+
+bool SequencerEditor::redoEditsOnlyPatterns() const
+{
+  EditJournal::Action action;
+  return editJournal.peekRedo(action) && editsOnlyPatterns(action);
+}
+
+bool SequencerEditor::editsOnlyPatterns(const EditJournal::Action& action) const
+{
+  // switching sets and refreshing the machine page both reach past the viewed set's patterns
+  if (songHost != nullptr && action.sequenceSet != songHost->getViewedSequenceSetIndex())
+    return false;
+  if (getCurrentPage() == SequencerEditorPage::machine)
+    return false;
+  return std::all_of(action.deltas.begin(), action.deltas.end(),
+                     [](const EditDelta& delta) { return isPatternDelta(delta.kind); });
+}
+
+void SequencerEditor::clearUndoHistory()
+{
+  editJournal.clear();
+  pendingEdits.clear();
+  ++undoHistoryGeneration;
+}
+
+void SequencerEditor::recordEdit(EditDelta delta)
+{
+  if (undoableEditDepth > 0)
+    pendingEdits.push_back(std::move(delta));
+}
+
+bool SequencerEditor::applyEditAction(const EditJournal::Action& action, bool undoing)
+{
+  if (songHost != nullptr && action.sequenceSet != songHost->getViewedSequenceSetIndex())
+  {
+    if (action.sequenceSet >= songHost->getSequenceSetCount())
+    {
+      clearUndoHistory();
+      return false;
+    }
+    songHost->setViewedSequenceSetIndex(action.sequenceSet);
+  }
+  if (sequencer == nullptr)
+    return false;
+
+  std::vector<std::pair<MachineInterface*, juce::MemoryBlock>> machineStates;
+  if (!prepareMachineStates(machineHost, action, undoing, machineStates))
+    return false;
+  // playback picks up each changed pattern once, with the whole action applied
+  sequencer->holdPatternPublishing();
+  for (const auto& delta : action.deltas)
+    applyEditDelta(delta, undoing);
+  sequencer->releasePatternPublishing();
+  for (auto& [machine, state] : machineStates)
+    machine->setStateInformation(state.getData(), static_cast<int>(state.getSize()));
+
+  // bring the cursor to the change so it can be seen
+  for (const auto& delta : action.deltas)
+  {
+    if (isSongRowDelta(delta.kind) && songHost != nullptr)
+    {
+      currentSongRow = std::min<std::size_t>(delta.index + 1, songHost->getSongRowCount());
+      break;
+    }
+    if (delta.kind != EditDelta::Kind::sequenceSetting && delta.kind != EditDelta::Kind::sequenceLength
+        && delta.kind != EditDelta::Kind::sequenceMute && !isStepDelta(delta.kind))
+      continue;
+    if (delta.target >= sequencer->howManySequences())
+      break;
+    currentSequence = delta.target;
+    if (isStepDelta(delta.kind))
+    {
+      currentStep = delta.index;
+      if (delta.kind == EditDelta::Kind::cell)
+        currentStepRow = delta.row;
+    }
+    break;
+  }
+  const std::size_t stepCount = sequencer->howManySteps(currentSequence);
+  if (stepCount > 0 && currentStep >= stepCount)
+    currentStep = stepCount - 1;
+  clampStepCursorToCurrentStep();
+
+  requestStringRefresh();
+  if (getCurrentPage() == SequencerEditorPage::machine)
+    refreshMachineStateForCurrentSequence();
   return true;
 }
 
+void SequencerEditor::applyEditDelta(const EditDelta& delta, bool undoing)
+{
+  const double value = undoing ? delta.before : delta.after;
+  Sequence* sequence = nullptr;
+  if (delta.target < sequencer->howManySequences())
+    sequence = sequencer->getSequence(delta.target);
+  // steps past the length were out of the editor's reach when the change was made
+  const bool stepInRange = sequence != nullptr && delta.index < sequence->getLength();
+
+  switch (delta.kind)
+  {
+  case EditDelta::Kind::cell:
+  {
+    if (!stepInRange)
+      break;
+    // written back whole, as setStepDataAt would re-clamp the row to a restored command
+    auto data = sequencer->getStepData(delta.target, delta.index);
+    if (delta.row >= data.size() || delta.col >= data[delta.row].size())
+      break;
+    data[delta.row][delta.col] = value;
+    sequencer->setStepData(delta.target, delta.index, std::move(data));
+    break;
+  }
+  case EditDelta::Kind::rowInsert:
+  case EditDelta::Kind::rowRemove:
+  {
+    if (!stepInRange)
+      break;
+    auto data = sequencer->getStepData(delta.target, delta.index);
+    const bool insert = (delta.kind == EditDelta::Kind::rowInsert) != undoing;
+    if (insert && delta.row <= data.size())
+      data.insert(data.begin() + static_cast<std::ptrdiff_t>(delta.row), delta.values);
+    else if (!insert && delta.row < data.size() && data.size() > 1)
+      data.erase(data.begin() + static_cast<std::ptrdiff_t>(delta.row));
+    else
+      break;
+    sequencer->setStepData(delta.target, delta.index, std::move(data));
+    break;
+  }
+  case EditDelta::Kind::stepRows:
+  {
+    Step::Rows rows;
+    if (stepInRange && unpackStepRows(delta, undoing, rows))
+      sequencer->setStepData(delta.target, delta.index, std::move(rows));
+    break;
+  }
+  case EditDelta::Kind::stepActive:
+    if (stepInRange && sequence->isStepActive(delta.index) != (value != 0.0))
+      sequencer->toggleStepActive(delta.target, delta.index);
+    break;
+  case EditDelta::Kind::sequenceLength:
+    if (sequence != nullptr && value >= 1.0)
+    {
+      sequence->ensureEnoughStepsForLength(static_cast<std::size_t>(value));
+      sequence->setLength(static_cast<std::size_t>(value));
+    }
+    break;
+  case EditDelta::Kind::sequenceSetting:
+    if (sequence == nullptr)
+      break;
+    if (delta.index == Sequence::typeConfig)
+    {
+      if (value >= 0.0 && value <= static_cast<double>(SequenceType::tickChanger))
+        sequencer->setSequenceType(delta.target, static_cast<SequenceType>(static_cast<int>(value)));
+    }
+    else if (delta.index == Sequence::machineTypeConfig)
+      sequence->setMachineType(value);
+    else if (delta.index == Sequence::machineIdConfig)
+      sequence->setMachineId(value);
+    else if (delta.index == Sequence::tpsConfig)
+      sequence->onZeroSetTicksPerStep(juce::jmax(1.0, value));
+    else if (delta.index == Sequence::probConfig)
+      sequence->setTriggerProbability(value);
+    break;
+  case EditDelta::Kind::stackGain:
+    if (machineHost != nullptr)
+      machineHost->setStackGainDb(delta.target, static_cast<float>(value));
+    break;
+  case EditDelta::Kind::slotMove:
+  {
+    if (machineHost == nullptr)
+      break;
+    const std::size_t from = undoing ? delta.row : delta.index;
+    const std::size_t to = undoing ? delta.index : delta.row;
+    const auto slotCount = machineHost->getMachineStackTypes(delta.target).size();
+    if (from < slotCount && to < slotCount && from != to)
+      machineHost->moveMachineInStack(delta.target, from, to > from ? 1 : -1);
+    break;
+  }
+  case EditDelta::Kind::slotEnabled:
+    if (machineHost != nullptr
+        && delta.index < machineHost->getMachineStackTypes(delta.target).size()
+        && machineHost->isMachineEnabledInStack(delta.target, delta.index) != (value != 0.0))
+      machineHost->toggleMachineEnabledInStack(delta.target, delta.index);
+    break;
+  case EditDelta::Kind::machineState:
+    // applied as a whole by applyEditAction once prepareMachineStates has checked it fits
+    break;
+  case EditDelta::Kind::songRowInsert:
+    if (songHost == nullptr)
+      break;
+    // the row and the set cloned for it come and go together, last in both lists
+    if (undoing && delta.index + 1 == songHost->getSongRowCount() && delta.target + 1 == songHost->getSequenceSetCount())
+      songHost->removeSongRow(delta.index);
+    else if (!undoing && delta.index == songHost->getSongRowCount() && delta.target == songHost->getSequenceSetCount())
+      songHost->addSongRowByCloningViewedSet();
+    break;
+  case EditDelta::Kind::songRowSet:
+    if (songHost != nullptr && delta.index < songHost->getSongRowCount())
+      songHost->adjustSongRowSequenceSetId(delta.index, static_cast<int>(value) - static_cast<int>(songHost->getSongRowSequenceSetId(delta.index)));
+    break;
+  case EditDelta::Kind::songRowBeats:
+    if (songHost != nullptr && delta.index < songHost->getSongRowCount())
+      songHost->adjustSongRowBeatCount(delta.index, static_cast<int>(value) - songHost->getSongRowBeatCount(delta.index));
+    break;
+  case EditDelta::Kind::songRowTrackPattern:
+    if (songHost != nullptr && delta.index < songHost->getSongRowCount())
+      songHost->adjustSongRowTrackPattern(delta.index, delta.row,
+                                          static_cast<int>(value) - static_cast<int>(songHost->getSongRowTrackPattern(delta.index, delta.row)));
+    break;
+  case EditDelta::Kind::sequenceMute:
+    if (auto* impl = getSequencerImpl(); impl != nullptr && sequence != nullptr && sequence->isMuted() != (value != 0.0))
+      impl->toggleSequenceMute(delta.target);
+    break;
+  }
+}
+
 bool SequencerEditor::isMachineUiForCurrentSequence() const
 {
   return sequencer != nullptr && sequencer->getSequence(currentSequence) != nullptr;
@@ -2049,8 +2983,13 @@ std::vector<std::vector<UIBox>> SequencerEditor::buildMachineStackCells(std::siz
     enabledCell.text = machineHost->isMachineEnabledInStack(stackIndex, slotIndex) ? "ON" : "OFF";
     enabledCell.onActivate = [this, stackIndex, slotIndex]()
     {
-      if (machineHost != nullptr)
-        machineHost->toggleMachineEnabledInStack(stackIndex, slotIndex);
+      if (machineHost == nullptr)
+        return;
+      auto delta = makeEditDelta(EditDelta::Kind::slotEnabled, stackIndex, slotIndex);
+      delta.before = machineHost->isMachineEnabledInStack(stackIndex, slotIndex) ? 1.0 : 0.0;
+      machineHost->toggleMachineEnabledInStack(stackIndex, slotIndex);
+      delta.after = machineHost->isMachineEnabledInStack(stackIndex, slotIndex) ? 1.0 : 0.0;
+      recordEdit(std::move(delta));
     };
     boxes[1].push_back(std::move(enabledCell));
 
@@ -2092,8 +3031,12 @@ std::vector<std::vector<UIBox>> SequencerEditor::buildMachineStackCells(std::siz
     {
       upCell.onActivate = [this, stackIndex, slotIndex]()
       {
-        if (machineHost != nullptr)
-          machineHost->moveMachineInStack(stackIndex, slotIndex, -1);
+        if (machineHost == nullptr)
+          return;
+        machineHost->moveMachineInStack(stackIndex, slotIndex, -1);
+        auto delta = makeEditDelta(EditDelta::Kind::slotMove, stackIndex, slotIndex);
+        delta.row = static_cast<std::uint32_t>(slotIndex - 1);
+        recordEdit(std::move(delta));
       };
     }
     boxes[4].push_back(std::move(upCell));
@@ -2106,8 +3049,12 @@ std::vector<std::vector<UIBox>> SequencerEditor::buildMachineStackCells(std::siz
     {
       downCell.onActivate = [this, stackIndex, slotIndex]()
       {
-        if (machineHost != nullptr)
-          machineHost->moveMachineInStack(stackIndex, slotIndex, 1);
+        if (machineHost == nullptr)
+          return;
+        machineHost->moveMachineInStack(stackIndex, slotIndex, 1);
+        auto delta = makeEditDelta(EditDelta::Kind::slotMove, stackIndex, slotIndex);
+        delta.row = static_cast<std::uint32_t>(slotIndex + 1);
+        recordEdit(std::move(delta));
       };
     }
     boxes[5].push_back(std::move(downCell));
@@ -2233,6 +3180,7 @@ const std::vector<std::vector<UIBox>>& SequencerEditor::getMachineCells() const
 
 void SequencerEditor::machineAddEntry()
 {
+  const UndoableEdit edit{*this};
   if (!isMachineUiForCurrentSequence())
     return;
   if (!machineStackDetailMode)
@@ -2249,6 +3197,7 @@ void SequencerEditor::machineAddEntry()
 
 void SequencerEditor::machineRemoveEntry()
 {
+  const UndoableEdit edit{*this};
   if (!isMachineUiForCurrentSequence())
     return;
   if (!machineStackDetailMode)
@@ -2267,6 +3216,7 @@ void SequencerEditor::machineRemoveEntry()
 
 void SequencerEditor::machineActivateCurrentCell()
 {
+  const UndoableEdit edit{*this};
   if (!isMachineUiForCurrentSequence())
     return;
   if (machineCells.empty() || machineCells[0].empty())
@@ -2281,6 +3231,7 @@ void SequencerEditor::machineActivateCurrentCell()
 
 bool SequencerEditor::machineInsertCurrentCell(double value)
 {
+  const UndoableEdit edit{*this};
   if (!isMachineUiForCurrentSequence())
     return false;
   if (machineCells.empty() || machineCells[0].empty())
@@ -2317,6 +3268,7 @@ bool SequencerEditor::machinePreviewCurrentCell()
 
 bool SequencerEditor::machineHandleTextInput(char character)
 {
+  const UndoableEdit edit{*this};
   if (!isMachineUiForCurrentSequence() || !machineStackDetailMode)
     return false;
 
@@ -2346,6 +3298,7 @@ bool SequencerEditor::machineHandleTextInput(char character)
 
 bool SequencerEditor::machineHandleTextBackspace()
 {
+  const UndoableEdit edit{*this};
   if (!isMachineUiForCurrentSequence() || !machineStackDetailMode)
     return false;
 
@@ -2373,6 +3326,7 @@ bool SequencerEditor::machineHandleTextBackspace()
 
 bool SequencerEditor::machineShiftNoteCurrentCell(int semitones)
 {
+  const UndoableEdit edit{*this};
   if (!isMachineUiForCurrentSequence() || !machineStackDetailMode)
     return false;
 
@@ -2419,6 +3373,7 @@ bool SequencerEditor::dismissCurrentTransientUi()
 
 void SequencerEditor::machineAdjustCurrentCell(int direction)
 {
+  const UndoableEdit edit{*this};
   if (!isMachineUiForCurrentSequence())
     return;
   if (machineCells.empty() || machineCells[0].empty())
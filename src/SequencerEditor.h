@@ -1,11 +1,14 @@
 #pragma once
 
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <optional>
 #include <string>
 #include <vector>
 
+#include "EditJournal.h"
 #include "UIBox.h"
 
 // todo: remove this and just include the juce header instead 
@@ -73,9 +76,15 @@ public:
   virtual std::size_t addSongRowByCloningViewedSet() = 0;
   virtual void removeSongRow(std::size_t row) = 0;
   virtual void adjustSongRowSequenceSetId(std::size_t row, int direction) = 0;
+  /** which sequence set's pattern plays on the sent track during the sent song row */
+  virtual std::size_t getSongRowTrackPattern(std::size_t row, std::size_t track) const = 0;
+  /** step the sent track of the sent song row to the next/previous sequence set's pattern */
+  virtual void adjustSongRowTrackPattern(std::size_t row, std::size_t track, int direction) = 0;
   virtual void adjustSongRowBeatCount(std::size_t row, int direction) = 0;
   virtual void toggleSongPlayback() = 0;
   virtual void rewindSongTransport() = 0;
+  /** jump playback straight to the sent beat and tick of the sent song row, optionally starting playback there */
+  virtual void seekSongPosition(std::size_t row, int beat, int tick, bool startPlaying) = 0;
 };
 
 // Abstract interface for editor-facing sequencer access.
@@ -107,6 +116,9 @@ class SequencerAbs{
     virtual void incrementSeqParam(std::size_t seq, std::size_t paramIndex) = 0;
     virtual void decrementSeqParam(std::size_t seq, std::size_t paramIndex) = 0;
     virtual void toggleStepActive(std::size_t sequence, std::size_t step) = 0;
+    /** hold back every sequence's pattern until releasePatternPublishing, see Sequence::holdPublishing */
+    virtual void holdPatternPublishing() = 0;
+    virtual void releasePatternPublishing() = 0;
 };
 
 /**
@@ -163,6 +175,8 @@ public:
   void setSongHost(SongHost *host);
   void setResetConfirmationHandler(std::function<void()> handler);
   void setQuitConfirmationHandler(std::function<void()> handler);
+  /** called whenever a sequence is armed or disarmed for live MIDI recording */
+  void setArmedSequenceChangedHandler(std::function<void()> handler);
   SequencerAbs *getSequencer();
   /** resets editor, e.g. when changing sequence*/
   void resetCursor();
@@ -221,6 +235,17 @@ public:
   void incrementAtCursor();
   /** decrease the value at the current cursor position, e.g. increasing note number */
   void decrementAtCursor();
+  /** increment (positive amount) or decrement the value at the cursor amount times as one edit,
+   * handing playback each changed pattern once rather than once per step */
+  void adjustAtCursor(int amount);
+  /** true on the sequence and step pages. Cursor moves and cell edits there only change the
+   * viewed set's patterns, which playback picks up from their published snapshots */
+  bool editsOnlyPatterns() const;
+  /** true if the key would enter a chord or note without touching anything but the patterns.
+   * Notes typed while stopped are previewed through the machines, so they do not count */
+  bool isPatternEditKey(char key) const;
+  /** true if handleNoteKey would take the key as a note */
+  bool isNoteKey(char key) const;
   void gotoSongPage();
   /** enter sequence configuration page */
   void gotoSequenceConfigPage();
@@ -235,10 +260,13 @@ public:
   void click();
   void togglePlayback();
   void rewindTransport();
+  /** start playback from the cursor: the selected song row on the song page, the cursor step elsewhere */
+  void playFromCursor();
   void toggleArmCurrentSequence();
   void toggleMuteCurrentSequence();
   bool handleChordKey(char key);
-  bool handleNoteKey(char key);
+  /** enter the note the key maps to. With preview, a stopped sequencer also plays it */
+  bool handleNoteKey(char key, bool preview = true);
   bool enterSelectedMachineDetail();
   bool enterMachineDetailFromAnywhere();
   bool cycleMachineDetailNext();
@@ -289,6 +317,7 @@ public:
   void decrementTicksPerStep();
   void shiftCurrentSequenceStepNote(int semitones);
   static void nextSequenceType(SequencerAbs *seqr, unsigned int sequence);
+  static void previousSequenceType(SequencerAbs *seqr, unsigned int sequence);
   /** returns the index of the sequence that the editor is currently focused on*/
   size_t getCurrentSequence() const;
   /** returns the index of the step that the editor is currently focused on*/
@@ -302,6 +331,8 @@ public:
   std::size_t getCurrentSongRow() const;
   std::size_t getCurrentSongCol() const;
   void setSelectedSongCursor(std::size_t row, std::size_t col);
+  /** song page columns are set, beats, edit, delete, then one pattern column per track from here */
+  static constexpr std::size_t songTrackFirstCol{4};
   /** returns the current edit octave */
   double getCurrentOctave() const;
   /** move the cursor to a specific sequence*/
@@ -322,8 +353,35 @@ public:
   size_t getArmedSequence();
   /** return true if you have armed a sequence  */
   bool isArmedForLiveMIDI();
+  /** write a live-recorded note into the sent step of the sent sequence of target, which is the
+   * set that is playing and need not be the one being edited.
+   * Same pitch overdubs in place, otherwise the first empty row is used. Returns the row written */
+  std::size_t recordLiveNote(SequencerAbs* target, std::size_t sequence, std::size_t step, double note, double velocity);
+  /** set the length of a live-recorded note once its note-off has arrived */
+  void recordLiveNoteLength(SequencerAbs* target, std::size_t sequence, std::size_t step, std::size_t row, double lengthTicks);
+  /** revert the last recorded edit, moving the cursor to it. Returns false if there is nothing to undo */
+  bool undo();
+  /** apply the last undone edit again. Returns false if there is nothing to redo */
+  bool redo();
+  /** true if undo, or redo, would only change the viewed set's patterns, so it can run while
+   * playback carries on as other pattern edits do */
+  bool undoEditsOnlyPatterns() const;
+  bool redoEditsOnlyPatterns() const;
+  /** forget every recorded edit, e.g. when the sequences are replaced */
+  void clearUndoHistory();
   
 private:
+  /** records everything one editor action changes as a single undo step, see UndoableEdit in the .cpp */
+  class UndoableEdit;
+  /** queue a change for the enclosing UndoableEdit, if there is one: stack, song row and mute
+   * changes, which it does not find by comparing state */
+  void recordEdit(EditDelta delta);
+  /** apply one side of a recorded change through the same calls a normal edit uses */
+  void applyEditDelta(const EditDelta& delta, bool undoing);
+  /** run one journal action in either direction. Returns false, changing nothing, if a machine
+   * it touches is gone or its state no longer fits the action */
+  bool applyEditAction(const EditJournal::Action& action, bool undoing);
+  bool editsOnlyPatterns(const EditJournal::Action& action) const;
   Sequencer* getSequencerImpl() const;
   void requestStringRefresh();
   std::optional<double> lookupKeyboardMidiNote(char key) const;
@@ -335,6 +393,8 @@ private:
   std::optional<CommandType> getSelectedStackMachineType() const;
   void leaveMachineDetail();
 
+  /** rightmost column the song page cursor can reach on the current row */
+  std::size_t getLastSongCol() const;
   void moveCursorLeftOnSongPage();
   void moveCursorLeftOnSequencePage();
   void moveCursorLeftOnStepPage();
@@ -374,6 +434,8 @@ private:
   void resetOnStepPage();
   void resetOnResetConfirmationPage();
   void incrementOnSongPage();
+  /** step the song row value under the cursor, recording the change for undo */
+  void adjustSongRowAtCursor(int direction);
   void incrementOnStepPage();
   void incrementOnSequenceConfigPage();
   void incrementOnMachinePage();
@@ -393,6 +455,7 @@ private:
   SongHost *songHost = nullptr;
   std::function<void()> resetConfirmationHandler;
   std::function<void()> quitConfirmationHandler;
+  std::function<void()> armedSequenceChangedHandler;
   /** which sequence*/
   size_t currentSequence;
   /** which step */
@@ -407,8 +470,9 @@ private:
   std::size_t currentSongRow;
   /** which song page column is selected */
   std::size_t currentSongCol;
-  /** one sequence can be armed for live MIDI recording */
-  size_t armedSequence;
+  /** one sequence can be armed for live MIDI recording. Written by the editor, read by the
+   * audio and recorder threads without the editor lock */
+  std::atomic<std::size_t> armedSequence;
 
   SequencerEditorMode editMode;
   SequencerEditorSubMode editSubMode;
@@ -424,4 +488,12 @@ private:
   std::size_t machineSelectedStackSlot = 0;
   bool resetConfirmationYesSelected = true;
   ConfirmationAction pendingConfirmationAction = ConfirmationAction::resetTracker;
+  /** undo and redo history of the edits made through this editor */
+  EditJournal editJournal;
+  /** how many UndoableEdits are open. Only the outermost one records */
+  int undoableEditDepth = 0;
+  /** bumped whenever the history is cleared, so an edit that spans a reset or load records nothing */
+  std::uint64_t undoHistoryGeneration = 0;
+  /** changes reported inside the open UndoableEdit, see recordEdit */
+  std::vector<EditDelta> pendingEdits;
 };
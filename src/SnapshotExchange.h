@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+/**
+ * Hands immutable snapshots from one writer thread (the editor) to one reader thread
+ * (the audio thread) without either side blocking.
+ * The writer publishes freshly built snapshots; the reader swaps the newest one in
+ * when it is ready for it. Old snapshots are always freed on the writer's side,
+ * so the reader never allocates or deletes.
+ */
+template <typename T>
+class SnapshotExchange
+{
+public:
+    SnapshotExchange() = default;
+    ~SnapshotExchange()
+    {
+        delete pending.exchange(nullptr, std::memory_order_acq_rel);
+        delete retired.exchange(nullptr, std::memory_order_acq_rel);
+    }
+
+    SnapshotExchange(const SnapshotExchange&) = delete;
+    SnapshotExchange& operator=(const SnapshotExchange&) = delete;
+
+    /** writer side: queue a new snapshot, replacing any the reader has not picked up yet */
+    void publish(std::unique_ptr<T> snapshot)
+    {
+        delete pending.exchange(snapshot.release(), std::memory_order_acq_rel);
+        // reclaim after queueing so the reader is never left waiting on a stale retired slot
+        collectGarbage();
+    }
+
+    /** writer side: free the snapshot the reader last swapped out, if any */
+    void collectGarbage()
+    {
+        delete retired.exchange(nullptr, std::memory_order_acq_rel);
+    }
+
+    /** reader side, wait-free: swap the newest published snapshot into current.
+     * returns true if current changed.
+    */
+    bool acquire(std::unique_ptr<T>& current) noexcept
+    {
+        // only take a new snapshot once the writer has reclaimed the last one we gave back
+        if (retired.load(std::memory_order_acquire) != nullptr)
+            return false;
+        T* fresh = pending.exchange(nullptr, std::memory_order_acq_rel);
+        if (fresh == nullptr)
+            return false;
+        retired.store(current.release(), std::memory_order_release);
+        current.reset(fresh);
+        return true;
+    }
+
+private:
+    std::atomic<T*> pending { nullptr };
+    std::atomic<T*> retired { nullptr };
+};
@@ -1,92 +1,79 @@
 #include "SuperSamplePlayer.h"
+#include "SampleStreamer.h"
 #include "WaveformSVGRenderer.h"
 #include <algorithm>
 #include <cmath>
 #include <limits>
 
-namespace
+SuperSamplePlayer::SuperSamplePlayer (int newId)
+    : voiceOutput (2, kVuChunkFrames),
+      window (2, kWindowFrames)
 {
-constexpr int kWaveformPlotPoints = 128;
+    SampleResampler::prepareTables();
+    state.id = newId;
+    vuBuffer.assign ((size_t) vuBufferSize, 0.0f);
+    // nothing renders yet, so the first setup can be set directly
+    playback = std::make_unique<Playback>();
+    playback->settings = state;
+}
 
-std::vector<float> buildWaveformPoints(const juce::AudioBuffer<float>& buffer, int numPoints)
+void SuperSamplePlayer::setMidiRange (int low, int high)
 {
-    std::vector<float> points;
-    if (numPoints < 2)
-        numPoints = 2;
-
-    points.reserve(static_cast<size_t>(numPoints) * 2);
-
-    if (buffer.getNumSamples() == 0 || buffer.getNumChannels() == 0)
-    {
-        for (int i = 0; i < numPoints; ++i)
-        {
-            points.push_back(0.0f);
-            points.push_back(0.0f);
-        }
-        return points;
-    }
-
-    const int totalSamples = buffer.getNumSamples();
-    const int samplesPerPoint = std::max(1, totalSamples / numPoints);
-
-    for (int start = 0; start < totalSamples; start += samplesPerPoint)
-    {
-        const int end = std::min(totalSamples, start + samplesPerPoint);
-        float localMin = std::numeric_limits<float>::max();
-        float localMax = std::numeric_limits<float>::lowest();
-        bool hasSample = false;
+    low = juce::jlimit (0, 127, low);
+    high = juce::jlimit (0, 127, high);
+    state.midiLow = juce::jmin (low, high);
+    state.midiHigh = juce::jmax (low, high);
+    publish();
+}
 
-        for (int chan = 0; chan < buffer.getNumChannels(); ++chan)
-        {
-            const float* data = buffer.getReadPointer(chan);
-            for (int i = start; i < end; ++i)
-            {
-                const float sample = data[i];
-                hasSample = true;
-                localMin = std::min(localMin, sample);
-                localMax = std::max(localMax, sample);
-            }
-        }
+void SuperSamplePlayer::setGain (float g)
+{
+    state.gain = juce::jlimit (0.0f, 2.0f, g);
+    publish();
+}
 
-        if (!hasSample)
-        {
-            localMin = 0.0f;
-            localMax = 0.0f;
-        }
+void SuperSamplePlayer::setPolyphony (int numVoices)
+{
+    state.polyphony = juce::jlimit (1, kMaxVoices, numVoices);
+    // the render silences the voices past the new polyphony when it swaps this setup in
+    updateVoiceStreams();
+    publish();
+}
 
-        points.push_back(localMin);
-        points.push_back(localMax);
-    }
+void SuperSamplePlayer::setVoiceStealMode (VoiceStealMode mode)
+{
+    state.stealMode = mode;
+    publish();
+}
 
-    if (points.size() < static_cast<size_t>(numPoints) * 2)
-    {
-        const size_t missing = static_cast<size_t>(numPoints) * 2 - points.size();
-        points.insert(points.end(), missing, 0.0f);
-    }
+void SuperSamplePlayer::setChokeGroup (int group)
+{
+    state.chokeGroup = juce::jlimit (0, kMaxChokeGroups, group);
+    publish();
+}
 
-    return points;
+void SuperSamplePlayer::setKeyTracking (bool shouldTrack)
+{
+    state.keyTracking = shouldTrack;
+    publish();
 }
-} // namespace
 
-SuperSamplePlayer::SuperSamplePlayer (int newId)
+void SuperSamplePlayer::setRootNote (int note)
 {
-    state.id = newId;
-    state.waveformSVG = WaveformSVGRenderer::generateBlankWaveformSVG();
-    vuBuffer.assign ((size_t) vuBufferSize, 0.0f);
-    waveformPoints = buildWaveformPoints(sampleBuffer, kWaveformPlotPoints);
+    state.rootNote = juce::jlimit (0, 127, note);
+    publish();
 }
 
-void SuperSamplePlayer::setMidiRange (int low, int high) noexcept
+void SuperSamplePlayer::setFineTune (int cents)
 {
-    low = juce::jlimit (0, 127, low);
-    high = juce::jlimit (0, 127, high);
-    state.midiLow = juce::jmin (low, high);
-    state.midiHigh = juce::jmax (low, high);
+    state.fineTuneCents = juce::jlimit (-kMaxFineTuneCents, kMaxFineTuneCents, cents);
+    publish();
 }
 
-void SuperSamplePlayer::setGain (float g) noexcept
+void SuperSamplePlayer::setResampleQuality (ResampleQuality newQuality)
 {
-    state.gain = juce::jlimit (0.0f, 2.0f, g);
+    quality = newQuality;
+    publish();
 }
 
 void SuperSamplePlayer::setFilePathAndStatus (const juce::String& path, const juce::String& statusLabel, const juce::String& displayName)
@@ -99,37 +86,49 @@ void SuperSamplePlayer::setFilePathAndStatus (const juce::String& path, const ju
 SuperSamplePlayer::State SuperSamplePlayer::getState() const noexcept
 {
     auto snapshot = state;
-    snapshot.vuDb = lastVuDb;
+    snapshot.vuDb = getLastVuDb();
+    snapshot.waveformSVG = getWaveformSVG();
+    snapshot.isStreamed = sample != nullptr && sample->streamSource != nullptr;
+    snapshot.isMemoryMapped = snapshot.isStreamed && sample->streamSource->mappedReader != nullptr;
+    snapshot.activeVoices = activeVoiceCount.load (std::memory_order_relaxed);
+    snapshot.isPlaying = snapshot.activeVoices > 0;
+    snapshot.streamUnderruns = 0;
+    for (const auto& stream : voiceStreams)
+    {
+        if (stream != nullptr)
+            snapshot.streamUnderruns += stream->getUnderrunCount();
+    }
     return snapshot;
 }
 
 bool SuperSamplePlayer::acceptsNote (int midiNote) const noexcept
 {
-    return midiNote >= state.midiLow && midiNote <= state.midiHigh && sampleBuffer.getNumSamples() > 0;
+    return midiNote >= state.midiLow && midiNote <= state.midiHigh && sample != nullptr && sample->lengthInFrames > 0;
 }
 
-void SuperSamplePlayer::trigger()
+bool SuperSamplePlayer::playsNote (int midiNote) const noexcept
 {
-    if (sampleBuffer.getNumSamples() > 0)
-    {
-        velocityGain = 1.0f;
-        resetPlaybackState (true);
-    }
+    const auto& settings = playback->settings;
+    return midiNote >= settings.midiLow && midiNote <= settings.midiHigh && sampleLengthFrames > 0;
 }
 
-void SuperSamplePlayer::triggerNote (int midiNote, int velocity)
+void SuperSamplePlayer::trigger() noexcept
 {
-    juce::ignoreUnused (midiNote);
-    if (sampleBuffer.getNumSamples() > 0)
-    {
-        velocityGain = juce::jlimit(0.0f, 1.0f, static_cast<float>(velocity) / 127.0f);
-        resetPlaybackState (true);
-    }
+    if (sampleLengthFrames > 0)
+        startVoice (playback->settings.gain, 0);
+}
+
+void SuperSamplePlayer::triggerNote (int midiNote, int velocity) noexcept
+{
+    const auto& settings = playback->settings;
+    if (sampleLengthFrames > 0)
+        startVoice (settings.gain * juce::jlimit(0.0f, 1.0f, static_cast<float>(velocity) / 127.0f),
+                    settings.keyTracking ? midiNote - settings.rootNote : 0);
 }
 
 void SuperSamplePlayer::stop() noexcept
 {
-    resetPlaybackState (false);
+    stopAllVoices();
 }
 
 void SuperSamplePlayer::prepareToPlay (double sampleRate, int samplesPerBlock)
@@ -142,107 +141,321 @@ void SuperSamplePlayer::prepareToPlay (double sampleRate, int samplesPerBlock)
 
     outputSampleRate = nextOutputRate;
     updatePlaybackRatio();
-    resetPlaybackState (false);
+    stopAllVoices();
 }
 
 void SuperSamplePlayer::renderToBuffer (juce::AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept
 {
-    if (! state.isPlaying || sampleBuffer.getNumSamples() == 0 || numSamples <= 0)
+    if (! anyVoiceActive || sampleLengthFrames == 0 || numSamples <= 0)
         return;
 
-    const int totalSourceSamples = sampleBuffer.getNumSamples();
-    const int numSourceChans = sampleBuffer.getNumChannels();
-    const int numOutputChans = buffer.getNumChannels();
-    const float gain = state.gain * velocityGain;
+    for (int offset = 0; offset < numSamples; offset += kVuChunkFrames)
+    {
+        const int chunk = juce::jmin (kVuChunkFrames, numSamples - offset);
+        std::fill (vuMix.begin(), vuMix.begin() + chunk, 0.0f);
+        for (int i = 0; i < kMaxVoices; ++i)
+        {
+            if (voices[(size_t) i].active)
+                renderVoice (i, buffer, startSample + offset, chunk);
+        }
+        for (int i = 0; i < chunk; ++i)
+            pushVuSample (vuMix[(size_t) i]);
+    }
+
+    const auto numActive = std::count_if (voices.begin(), voices.end(), [] (const Voice& voice) { return voice.active; });
+    anyVoiceActive = numActive > 0;
+    activeVoiceCount.store (static_cast<int> (numActive), std::memory_order_relaxed);
+}
 
-    for (int sampleOffset = 0; sampleOffset < numSamples; ++sampleOffset)
+void SuperSamplePlayer::renderVoice (int voiceIndex, juce::AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept
+{
+    auto& voice = voices[(size_t) voiceIndex];
+    const auto& played = *playback->sample;
+    // mip levels only exist for resident samples, so a voice reading one never streams
+    const auto& resident = voice.mipLevel > 0 ? played.mipLevels[(size_t) (voice.mipLevel - 1)] : played.audio;
+    auto* stream = voice.mipLevel > 0 ? nullptr : playback->streams[(size_t) voiceIndex].get();
+    const int residentSamples = resident.getNumSamples();
+    const int numSourceChans = juce::jmin (resident.getNumChannels(), voiceOutput.getNumChannels());
+    // packed samples are converted a window at a time; float ones are read in place
+    const bool readsInPlace = resident.getFormat() == SampleFormat::float32;
+    // frames past the head are only read up to what the streamer had filled when the segment began
+    const juce::int64 streamedEnd = stream != nullptr ? stream->getFilledEnd() : residentSamples;
+    const double increment = voice.increment;
+
+    // the last output frame is the last one whose position still lies inside the sample
+    const double levelLength = std::ldexp (static_cast<double> (sampleLengthFrames), -voice.mipLevel);
+    const double framesLeft = std::ceil ((levelLength - voice.position) / increment);
+    const int framesToRender = static_cast<int> (juce::jlimit (0.0, static_cast<double> (numSamples), framesLeft));
+
+    const float* sources[2] {};
+    float* dests[2] {};
+    bool underran = false;
+    for (int done = 0; done < framesToRender;)
     {
-        if (fractionalPlaybackPosition >= static_cast<double> (totalSourceSamples))
+        int count = framesToRender - done;
+        const auto first = static_cast<juce::int64> (voice.position) - SampleResampler::kFramesBefore;
+        auto last = static_cast<juce::int64> (voice.position + (count - 1) * increment) + SampleResampler::kFramesAfter;
+        double base = 0.0;
+
+        if (readsInPlace && first >= 0 && last < residentSamples)
         {
-            state.isPlaying = false;
-            break;
+            for (int chan = 0; chan < numSourceChans; ++chan)
+                sources[chan] = resident.getFloatPointer (chan);
         }
+        else
+        {
+            // near the ends, in the streamed part or packed: gather what the kernel reads as float, padded with silence
+            const int spanLimit = kWindowFrames - SampleResampler::kFramesBefore - SampleResampler::kFramesAfter - 1;
+            count = juce::jlimit (1, count, static_cast<int> (spanLimit / increment));
+            last = static_cast<juce::int64> (voice.position + (count - 1) * increment) + SampleResampler::kFramesAfter;
+            underran = ! gatherWindow (resident, stream, streamedEnd, first, static_cast<int> (last - first + 1)) || underran;
+            for (int chan = 0; chan < numSourceChans; ++chan)
+                sources[chan] = window.getReadPointer (chan);
+            base = static_cast<double> (first);
+        }
+
+        for (int chan = 0; chan < numSourceChans; ++chan)
+            dests[chan] = voiceOutput.getWritePointer (chan, done);
+        voice.position = base + SampleResampler::render (playback->quality, sources, numSourceChans, voice.position - base,
+                                                         increment, dests, count);
+        done += count;
+    }
 
-        const int sourceIndex = juce::jlimit (0, totalSourceSamples - 1, static_cast<int> (fractionalPlaybackPosition));
-        const int nextSourceIndex = juce::jmin (sourceIndex + 1, totalSourceSamples - 1);
-        const float fractionalPart = static_cast<float> (fractionalPlaybackPosition - static_cast<double> (sourceIndex));
-        float firstOutputSample = 0.0f;
+    const int numOutputChans = buffer.getNumChannels();
+    for (int outputChannel = 0; outputChannel < numOutputChans && framesToRender > 0; ++outputChannel)
+    {
+        const int sourceChannel = juce::jmin (outputChannel, numSourceChans - 1);
+        juce::FloatVectorOperations::addWithMultiply (buffer.getWritePointer (outputChannel, startSample),
+                                                      voiceOutput.getReadPointer (sourceChannel), voice.gain, framesToRender);
+    }
 
-        for (int sourceChannel = 0; sourceChannel < numSourceChans; ++sourceChannel)
+    if (framesToRender > 0)
+    {
+        juce::FloatVectorOperations::addWithMultiply (vuMix.data(), voiceOutput.getReadPointer (0), voice.gain, framesToRender);
+        const auto range = juce::FloatVectorOperations::findMinAndMax (voiceOutput.getReadPointer (0), framesToRender);
+        voice.level = juce::jmax (-range.getStart(), range.getEnd()) * voice.gain;
+    }
+
+    if (framesToRender < numSamples)
+    {
+        voice.active = false;
+        if (stream != nullptr)
+            stream->stop();
+    }
+    else if (stream != nullptr)
+    {
+        if (underran)
+            stream->noteUnderrun();
+        stream->releaseFramesBefore (static_cast<juce::int64> (voice.position) - SampleResampler::kFramesBefore);
+    }
+}
+
+bool SuperSamplePlayer::gatherWindow (const SampleBuffer& resident, SampleStream* stream,
+                                      juce::int64 streamedEnd, juce::int64 first, int count) noexcept
+{
+    const juce::int64 end = first + count;
+    const juce::int64 residentEnd = resident.getNumSamples();
+    // the frames of the window that come from RAM, from the stream, and that the stream has not reached yet
+    const juce::int64 residentFrom = juce::jlimit (first, end, (juce::int64) 0);
+    const juce::int64 residentTo = juce::jlimit (first, end, residentEnd);
+    const juce::int64 streamedTo = stream != nullptr ? juce::jlimit (residentTo, end, streamedEnd) : residentTo;
+    const juce::int64 missingTo = stream != nullptr ? juce::jlimit (streamedTo, end, sampleLengthFrames) : streamedTo;
+
+    for (int chan = 0; chan < juce::jmin (resident.getNumChannels(), window.getNumChannels()); ++chan)
+    {
+        float* dest = window.getWritePointer (chan);
+        juce::FloatVectorOperations::clear (dest, count);
+        if (residentTo > residentFrom)
+            resident.readFrames (chan, (int) residentFrom, dest + (residentFrom - first), (int) (residentTo - residentFrom));
+        if (streamedTo > residentTo)
+            stream->copyFrames (chan, residentTo, dest + (residentTo - first), (int) (streamedTo - residentTo));
+    }
+
+    return missingTo == streamedTo;
+}
+
+void SuperSamplePlayer::startVoice (float gain, int semitones) noexcept
+{
+    const auto& settings = playback->settings;
+    int index = -1;
+    for (int i = 0; i < settings.polyphony; ++i)
+    {
+        if (! voices[(size_t) i].active)
         {
-            const float* samples = sampleBuffer.getReadPointer (sourceChannel);
-            const float current = samples[sourceIndex];
-            const float next = samples[nextSourceIndex];
-            const float rendered = juce::jmap (fractionalPart, current, next) * gain;
-
-            if (sourceChannel == 0)
-                firstOutputSample = rendered;
-
-            for (int outputChannel = 0; outputChannel < numOutputChans; ++outputChannel)
-            {
-                if (juce::jmin (outputChannel, numSourceChans - 1) == sourceChannel)
-                    buffer.addSample (outputChannel, startSample + sampleOffset, rendered);
-            }
+            index = i;
+            break;
         }
+    }
+    if (index < 0)
+        index = pickVoiceToSteal();
+
+    auto& voice = voices[(size_t) index];
+    const double cents = semitones * 100.0 + settings.fineTuneCents;
+    double increment = playbackRatio * std::exp2 (cents / 1200.0);
+    // from an octave up, read the copy whose rate keeps the increment below two; the sinc kernel
+    // narrows its cutoff for the rest, so the full band survives anything less than an octave
+    const auto& mipLevels = playback->sample->mipLevels;
+    int mipLevel = 0;
+    if (increment >= 2.0 && ! mipLevels.empty())
+        mipLevel = juce::jlimit (0, (int) mipLevels.size(), static_cast<int> (std::floor (std::log2 (increment) + 1.0e-9)));
+
+    voice.position = 0.0;
+    voice.increment = std::ldexp (increment, -mipLevel);
+    voice.mipLevel = mipLevel;
+    voice.gain = gain;
+    // a fresh hit counts as loud until it has rendered, so it is not the first to be stolen
+    voice.level = gain;
+    voice.startOrder = ++voiceStartCounter;
+    voice.active = true;
+    if (auto* stream = playback->streams[(size_t) index].get())
+        stream->restart();
+    anyVoiceActive = true;
+}
+
+int SuperSamplePlayer::pickVoiceToSteal() const noexcept
+{
+    const auto& settings = playback->settings;
+    int victim = 0;
+    for (int i = 1; i < settings.polyphony; ++i)
+    {
+        const auto& candidate = voices[(size_t) i];
+        const auto& current = voices[(size_t) victim];
+        // start orders are compared as distances so the counter may wrap
+        const bool older = static_cast<std::int32_t> (candidate.startOrder - current.startOrder) < 0;
+        const bool better = settings.stealMode == VoiceStealMode::quietest
+            ? candidate.level < current.level || (candidate.level == current.level && older)
+            : older;
+        if (better)
+            victim = i;
+    }
+    return victim;
+}
 
-        pushVuSample (firstOutputSample);
-        fractionalPlaybackPosition += playbackRatio;
-        sourceReadIndex = static_cast<int> (fractionalPlaybackPosition);
+void SuperSamplePlayer::stopAllVoices() noexcept
+{
+    for (int i = 0; i < kMaxVoices; ++i)
+    {
+        voices[(size_t) i].active = false;
+        if (auto* stream = playback->streams[(size_t) i].get())
+            stream->stop();
     }
+    anyVoiceActive = false;
+    activeVoiceCount.store (0, std::memory_order_relaxed);
 }
 
-bool SuperSamplePlayer::setLoadedBuffer (juce::AudioBuffer<float>&& newBuffer, const juce::String& name, double newSourceSampleRate)
+void SuperSamplePlayer::updateVoiceStreams()
 {
-    sampleBuffer = std::move (newBuffer);
-    sourceSampleRate = newSourceSampleRate > 0.0 ? newSourceSampleRate : 44100.0;
-    updatePlaybackRatio();
-    state.status = "loaded";
+    const bool streamed = sample != nullptr && sample->streamSource != nullptr && streamer != nullptr;
+    for (int i = 0; i < kMaxVoices; ++i)
+    {
+        auto& stream = voiceStreams[(size_t) i];
+        if (! streamed || i >= state.polyphony)
+            stream.reset();
+        else if (stream == nullptr)
+            stream = streamer->createStream (sample->streamSource);
+    }
+}
+
+SuperSamplePlayer::VoiceStreams SuperSamplePlayer::createVoiceStreams (SampleStreamer& streamer,
+                                                                       const std::shared_ptr<SampleStreamSource>& source,
+                                                                       int numVoices)
+{
+    VoiceStreams streams;
+    if (source != nullptr)
+    {
+        for (int i = 0; i < juce::jlimit (0, kMaxVoices, numVoices); ++i)
+            streams[(size_t) i] = streamer.createStream (source);
+    }
+    return streams;
+}
+
+void SuperSamplePlayer::setSample (std::shared_ptr<const SampleData> newSample,
+                                   VoiceStreams newStreams,
+                                   SampleStreamer& newStreamer,
+                                   const juce::String& name)
+{
+    sample = std::move (newSample);
+    streamer = &newStreamer;
+    // the old streams belong to the old source; the streamer frees them once they are let go
+    voiceStreams = std::move (newStreams);
+    updateVoiceStreams();
+    ++sampleGeneration;
+    state.status = sample != nullptr && sample->streamSource != nullptr ? "streaming" : "loaded";
     state.fileName = name;
     // Preserve path if already set, otherwise infer from name.
     if (state.filePath.isEmpty())
         state.filePath = name;
-    velocityGain = 1.0f;
-    resetPlaybackState (false);
-    state.waveformSVG = WaveformSVGRenderer::generateWaveformSVG (sampleBuffer, 320);
-    waveformPoints = buildWaveformPoints(sampleBuffer, kWaveformPlotPoints);
-    vuBuffer.assign ((size_t) vuBufferSize, 0.0f);
-    vuWritePos = 0;
-    vuSum = 0.0f;
-    lastVuDb = -60.0f;
-    return true;
+    publish();
 }
 
 void SuperSamplePlayer::markError (const juce::String& path, const juce::String& message)
 {
-    sampleBuffer.setSize (0, 0);
-    sourceSampleRate = 44100.0;
-    updatePlaybackRatio();
+    sample.reset();
+    updateVoiceStreams();
+    ++sampleGeneration;
     state.status = "error";
     state.filePath = path;
     state.fileName = message.isNotEmpty() ? message : juce::File (path).getFileName();
-    state.waveformSVG = WaveformSVGRenderer::generateBlankWaveformSVG();
-    waveformPoints = buildWaveformPoints(sampleBuffer, kWaveformPlotPoints);
-    vuBuffer.assign ((size_t) vuBufferSize, 0.0f);
-    vuWritePos = 0;
-    vuSum = 0.0f;
-    lastVuDb = -60.0f;
-    velocityGain = 1.0f;
-    resetPlaybackState (false);
+    publish();
+}
+
+void SuperSamplePlayer::publish()
+{
+    auto next = std::make_unique<Playback>();
+    next->settings = state;
+    next->sample = sample;
+    next->streams = voiceStreams;
+    next->quality = quality;
+    next->sampleGeneration = sampleGeneration;
+    playbackExchange.publish (std::move (next));
+}
+
+juce::String SuperSamplePlayer::getWaveformSVG() const
+{
+    return sample != nullptr ? sample->waveformSVG : WaveformSVGRenderer::generateBlankWaveformSVG();
+}
+
+const std::vector<float>& SuperSamplePlayer::getWaveformPoints() const
+{
+    static const std::vector<float> blank = SampleData::buildWaveformPoints ({});
+    return sample != nullptr ? sample->waveformPoints : blank;
 }
 
 void SuperSamplePlayer::beginBlock() noexcept
 {
-    // no-op for now; samples are pushed per-sample
+    const auto playedGeneration = playback->sampleGeneration;
+    if (playbackExchange.acquire (playback))
+    {
+        if (playback->sampleGeneration != playedGeneration)
+        {
+            // the voices were reading the old sample and its streams, which the setup just retired still holds
+            sampleLengthFrames = playback->sample != nullptr ? playback->sample->lengthInFrames : 0;
+            updatePlaybackRatio();
+            stopAllVoices();
+            resetVu();
+        }
+        else
+        {
+            for (int i = playback->settings.polyphony; i < kMaxVoices; ++i)
+                voices[(size_t) i].active = false;
+        }
+    }
+
+    if (stopRequested.exchange (false, std::memory_order_acq_rel))
+        stopAllVoices();
+    if (triggerRequested.exchange (false, std::memory_order_acq_rel))
+        trigger();
 }
 
 void SuperSamplePlayer::endBlock() noexcept
 {
     const float average = vuBufferSize > 0 ? (vuSum / (float) vuBufferSize) : 0.0f;
     float db = juce::Decibels::gainToDecibels (average + 1.0e-6f, -80.0f);
-    if (db < lastVuDb) {// hold peaks a bit
-        db = (lastVuDb + db) / 2.0f; 
+    const float previousDb = getLastVuDb();
+    if (db < previousDb) {// hold peaks a bit
+        db = (previousDb + db) / 2.0f; 
     }
-    lastVuDb = juce::jlimit (-60.0f, 6.0f, db);
+    lastVuDb.store (juce::jlimit (-60.0f, 6.0f, db), std::memory_order_relaxed);
 }
 
 void SuperSamplePlayer::pushVuSample (float sample) noexcept
@@ -257,16 +470,18 @@ void SuperSamplePlayer::pushVuSample (float sample) noexcept
     vuWritePos = (vuWritePos + 1) % vuBufferSize;
 }
 
-void SuperSamplePlayer::resetPlaybackState (bool keepPlaying) noexcept
+void SuperSamplePlayer::resetVu() noexcept
 {
-    sourceReadIndex = 0;
-    fractionalPlaybackPosition = 0.0;
-    state.isPlaying = keepPlaying && sampleBuffer.getNumSamples() > 0;
+    std::fill (vuBuffer.begin(), vuBuffer.end(), 0.0f);
+    vuWritePos = 0;
+    vuSum = 0.0f;
+    lastVuDb.store (-60.0f, std::memory_order_relaxed);
 }
 
 void SuperSamplePlayer::updatePlaybackRatio() noexcept
 {
     const double safeOutputRate = outputSampleRate > 0.0 ? outputSampleRate : 44100.0;
-    const double safeSourceRate = sourceSampleRate > 0.0 ? sourceSampleRate : safeOutputRate;
+    const auto* played = playback->sample.get();
+    const double safeSourceRate = played != nullptr && played->sampleRate > 0.0 ? played->sampleRate : safeOutputRate;
     playbackRatio = safeSourceRate / safeOutputRate;
 }
@@ -1,12 +1,46 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <vector>
 
-// A lightweight sample player placeholder that will later own audio data.
+#include "SampleData.h"
+#include "SampleResampler.h"
+#include "SnapshotExchange.h"
+
+class SampleStream;
+class SampleStreamer;
+struct SampleStreamSource;
+
+/**
+ * Plays one sample across a MIDI note range with a pool of voices.
+ * The setters run off the audio thread under the sampler's player lock. They never touch the
+ * voices: each publishes the player's whole setup, sample and streams included, and the render
+ * swaps the newest one in at the start of a block, so the audio thread never waits on a lock.
+ */
 class SuperSamplePlayer
 {
 public:
+    /** Most voices one player can sound at once. */
+    static constexpr int kMaxVoices = 16;
+    /** Highest choke group; 0 means the player is in none. */
+    static constexpr int kMaxChokeGroups = 8;
+    /** Fine tune range either side of the root, in cents. */
+    static constexpr int kMaxFineTuneCents = 100;
+
+    /** Which voice a new note takes when every voice is busy. */
+    enum class VoiceStealMode
+    {
+        /** The voice that started first. */
+        oldest,
+        /** The voice with the lowest output level over its last block. */
+        quietest
+    };
+
     /** Runtime state exposed to the sampler UI. */
     struct State
     {
@@ -18,8 +52,24 @@ public:
         int midiHigh { 60 };  // default C4
         /** Static gain applied to playback from this player. */
         float gain { 1.0f };
-        /** True while the player is actively playing its buffer. */
+        /** True while any voice of the player is sounding. */
         bool isPlaying { false };
+        /** Voices the player may sound at once. */
+        int polyphony { 8 };
+        /** How a new note finds a voice when all are busy. */
+        VoiceStealMode stealMode { VoiceStealMode::oldest };
+        /** Choke group, 1 to kMaxChokeGroups, or 0 for none. */
+        int chokeGroup { 0 };
+        /** True when notes play at their pitch relative to rootNote; false plays every note as recorded. */
+        bool keyTracking { false };
+        /** MIDI note at which the sample plays at its recorded pitch. */
+        int rootNote { 60 };
+        /** Tuning offset applied to every hit, in cents. */
+        int fineTuneCents { 0 };
+        /** Format the player's sample is loaded in, or none to follow the sampler's default. */
+        std::optional<SampleFormat> sampleFormat;
+        /** Voices sounding right now. */
+        int activeVoices { 0 };
         /** Most recent block VU reading in decibels. */
         float vuDb { -60.0f };
         /** Short status string shown in the UI. */
@@ -30,8 +80,17 @@ public:
         juce::String filePath;
         /** Cached waveform preview SVG string. */
         juce::String waveformSVG;
+        /** True when the sample plays from disk past its resident head. */
+        bool isStreamed { false };
+        /** True when the sample plays straight from a memory mapping of its file. */
+        bool isMemoryMapped { false };
+        /** Blocks that ran ahead of the disk stream and played silence. */
+        std::uint32_t streamUnderruns { 0 };
     };
 
+    /** A disk stream per voice, or none, for a streamed sample. */
+    using VoiceStreams = std::array<std::shared_ptr<SampleStream>, kMaxVoices>;
+
     /** Creates a sample player with a fixed player id. */
     explicit SuperSamplePlayer (int newId);
 
@@ -39,9 +98,31 @@ public:
     int getId() const noexcept { return state.id; }
 
     /** Sets the MIDI note range that will trigger this player. */
-    void setMidiRange (int low, int high) noexcept;
+    void setMidiRange (int low, int high);
     /** Sets the static gain multiplier for this player. */
-    void setGain (float g) noexcept;
+    void setGain (float g);
+    /** Sets how many voices may sound at once. Creates disk streams for streamed samples, so call it off the audio thread. */
+    void setPolyphony (int voices);
+    /** Returns how many voices may sound at once. */
+    int getPolyphony() const noexcept { return state.polyphony; }
+    /** Sets how a new note finds a voice when all are busy. */
+    void setVoiceStealMode (VoiceStealMode mode);
+    /** Sets the choke group, 0 for none. */
+    void setChokeGroup (int group);
+    /** Audio thread: returns the choke group of the setup being played, 0 for none. */
+    int getChokeGroup() const noexcept { return playback->settings.chokeGroup; }
+    /** Turns key tracking on or off. */
+    void setKeyTracking (bool shouldTrack);
+    /** Sets the MIDI note that plays the sample at its recorded pitch. */
+    void setRootNote (int note);
+    /** Sets the fine tune in cents, limited to kMaxFineTuneCents either way. */
+    void setFineTune (int cents);
+    /** Sets the format later loads keep the sample in, or none to follow the sampler's default. */
+    void setSampleFormat (std::optional<SampleFormat> format) noexcept { state.sampleFormat = format; }
+    /** Returns the player's own sample format, or none when it follows the sampler's default. */
+    std::optional<SampleFormat> getSampleFormat() const noexcept { return state.sampleFormat; }
+    /** Sets the interpolation voices use between source frames. */
+    void setResampleQuality (ResampleQuality newQuality);
     /** Updates the file metadata and status shown in the UI. */
     void setFilePathAndStatus (const juce::String& path, const juce::String& statusLabel, const juce::String& displayName = {});
     /** Returns the current UI-facing player state. */
@@ -49,54 +130,158 @@ public:
 
     /** Returns true when the player should respond to the given MIDI note. */
     bool acceptsNote (int midiNote) const noexcept;
-    /** Starts playback from the start of the buffer. */
-    void trigger();
-    /** Starts playback and applies the note velocity as gain. */
-    void triggerNote (int midiNote, int velocity);
-    /** Stops playback immediately. */
+    /** Audio thread: returns true when the setup being played responds to the given MIDI note. */
+    bool playsNote (int midiNote) const noexcept;
+    /** Audio thread: starts a voice from the start of the buffer. */
+    void trigger() noexcept;
+    /** Audio thread: starts a voice, pitched by the note when key tracking is on, and applies the note velocity as gain. */
+    void triggerNote (int midiNote, int velocity) noexcept;
+    /** Audio thread: stops every voice immediately. */
     void stop() noexcept;
-    /** Updates the player for the current output sample rate. */
+    /** Asks the render to start a voice from the start of the buffer at its next block. */
+    void requestTrigger() noexcept { triggerRequested.store (true, std::memory_order_release); }
+    /** Asks the render to stop every voice at its next block, before any requested trigger. */
+    void requestStop() noexcept { stopRequested.store (true, std::memory_order_release); }
+    /** Updates the player for the current output sample rate. Call while the render is not running. */
     void prepareToPlay (double sampleRate, int samplesPerBlock);
-    /** Adds the next segment of playback into the destination buffer. */
+    /** Audio thread: adds the next segment of playback into the destination buffer. */
     void renderToBuffer (juce::AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept;
 
-    /** Replaces the loaded sample buffer and metadata. */
-    bool setLoadedBuffer (juce::AudioBuffer<float>&& newBuffer, const juce::String& name, double newSourceSampleRate);
-    /** Marks the player as having failed to load a sample. */
+    /** Creates disk streams for the first numVoices voices of a streamed sample. They allocate
+     *  their read-ahead rings, so make them before taking any lock the audio thread waits on. */
+    static VoiceStreams createVoiceStreams (SampleStreamer& streamer, const std::shared_ptr<SampleStreamSource>& source, int numVoices);
+    /**
+     * Publishes a new sample; the render stops every voice when it swaps it in. newSample must be
+     * fully built, and streams made by createVoiceStreams for a streamed one, with any voices it
+     * lacks created here. The replaced sample is freed by collectGarbage, never on the audio thread.
+     */
+    void setSample (std::shared_ptr<const SampleData> newSample,
+                    VoiceStreams newStreams,
+                    SampleStreamer& newStreamer,
+                    const juce::String& name);
+    /** Marks the player as having failed to load a sample and publishes it empty. */
     void markError (const juce::String& path, const juce::String& message);
-    /** Returns the cached waveform SVG string. */
-    juce::String getWaveformSVG() const noexcept { return state.waveformSVG; }
-    /** Returns the cached waveform points used by the UI. */
-    const std::vector<float>& getWaveformPoints() const noexcept { return waveformPoints; }
-    /** Starts VU accumulation for the next audio block. */
+    /** Returns the loaded sample's waveform SVG, or a blank one. */
+    juce::String getWaveformSVG() const;
+    /** Returns the loaded sample's waveform points, or all zeros. */
+    const std::vector<float>& getWaveformPoints() const;
+    /** Audio thread: swaps in the newest published setup, runs any requested stop and trigger,
+     *  and starts VU accumulation for the block. */
     void beginBlock() noexcept;
-    /** Finishes VU accumulation for the current audio block. */
+    /** Audio thread: finishes VU accumulation for the current audio block. */
     void endBlock() noexcept;
     /** Returns the last computed block VU value in decibels. */
-    float getLastVuDb() const noexcept { return lastVuDb; }
+    float getLastVuDb() const noexcept { return lastVuDb.load (std::memory_order_relaxed); }
+    /** Frees the setup the render last swapped out, with any sample only it still held. Call off the audio thread. */
+    void collectGarbage() { playbackExchange.collectGarbage(); }
 
 private:
+    /** Everything the render reads of the player's setup, published whole by the setters. */
+    struct Playback
+    {
+        /** The settings when it was published; the strings are not read. */
+        State settings;
+        /** The sample, or null when there is none. */
+        std::shared_ptr<const SampleData> sample;
+        /** Disk stream per voice while the sample is streamed. */
+        VoiceStreams streams;
+        /** Interpolation used by every voice. */
+        ResampleQuality quality { ResampleQuality::cubic };
+        /** Changes whenever a sample is set or dropped, so the render knows to stop its voices. */
+        std::uint32_t sampleGeneration { 0 };
+    };
+
+    /** Playback state of one voice, kept small so the pool stays within a few cache lines. */
+    struct Voice
+    {
+        /** Fractional playback position in frames of the voice's mip level. */
+        double position { 0.0 };
+        /** Frames of the mip level advanced per output frame. */
+        double increment { 1.0 };
+        /** Which copy of the sample the voice reads: 0 for the sample itself, n for the one at 1 / 2^n of its rate. */
+        int mipLevel { 0 };
+        /** Player gain times velocity, fixed when the voice starts. */
+        float gain { 1.0f };
+        /** Peak output over the voice's last block, used to find the quietest. */
+        float level { 0.0f };
+        /** Start order, used to find the oldest. */
+        std::uint32_t startOrder { 0 };
+        /** True while the voice is sounding. */
+        bool active { false };
+    };
+
+    /** Frames mixed for the VU per pass over the voices. */
+    static constexpr int kVuChunkFrames = 256;
+    /** Source frames a voice can gather at once when it reads across the edges of the resident audio
+     *  or converts a packed sample to float. */
+    static constexpr int kWindowFrames = 4096;
+
     /** Adds a sample to the running VU calculation. */
     void pushVuSample (float sample) noexcept;
-    /** Resets playback and interpolation state after discontinuities. */
-    void resetPlaybackState (bool keepPlaying = false) noexcept;
+    /** Starts a voice transposed by the given semitones, stealing one if every voice is busy. */
+    void startVoice (float gain, int semitones) noexcept;
+    /** Returns the voice a new note should take from the busy ones. */
+    int pickVoiceToSteal() const noexcept;
+    /** Adds one voice's next segment into the buffer and its first channel into vuMix. */
+    void renderVoice (int voiceIndex, juce::AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept;
+    /** Copies frames of resident, converted to float, followed by the stream if there is one, from
+     *  first onwards into window, as silence outside the sample. Returns false on an underrun. */
+    bool gatherWindow (const SampleBuffer& resident, SampleStream* stream,
+                       juce::int64 streamedEnd, juce::int64 first, int count) noexcept;
+    /** Silences every voice. */
+    void stopAllVoices() noexcept;
+    /** Gives each voice up to the polyphony its own disk stream, or none for a resident sample. */
+    void updateVoiceStreams();
+    /** Copies the setup into a Playback for the render to swap in. */
+    void publish();
     /** Recomputes the source-to-output playback ratio. */
     void updatePlaybackRatio() noexcept;
+    /** Clears the VU history. */
+    void resetVu() noexcept;
 
-    /** UI-facing player state. */
+    /** UI-facing player state. The live fields are filled in by getState. */
     State state;
-    /** Loaded sample audio buffer. */
-    juce::AudioBuffer<float> sampleBuffer;
-    /** Original sample rate of the loaded file. */
-    double sourceSampleRate { 44100.0 };
+    /** The loaded sample, or null when there is none. */
+    std::shared_ptr<const SampleData> sample;
+    /** Streamer that creates the voices' streams. */
+    SampleStreamer* streamer { nullptr };
+    /** Disk stream per voice while the sample is streamed. */
+    VoiceStreams voiceStreams;
+    /** Interpolation given to the next published setup. */
+    ResampleQuality quality { ResampleQuality::cubic };
+    /** Bumped by setSample and markError. */
+    std::uint32_t sampleGeneration { 0 };
+    /** Hands published setups to the render. */
+    SnapshotExchange<Playback> playbackExchange;
+    /** Set by requestTrigger and cleared by the render when it starts the voice. */
+    std::atomic<bool> triggerRequested { false };
+    /** Set by requestStop and cleared by the render when it stops the voices. */
+    std::atomic<bool> stopRequested { false };
+    /** Voices sounding after the last rendered segment, for getState. */
+    std::atomic<int> activeVoiceCount { 0 };
+
+    // Everything below belongs to the audio thread, or to prepareToPlay while the render is stopped.
+
+    /** The setup being played. */
+    std::unique_ptr<Playback> playback;
+    /** The voice pool. Voices at or past the polyphony stay silent. */
+    std::array<Voice, kMaxVoices> voices;
+    /** Counts voice starts, to order voices by age. */
+    std::uint32_t voiceStartCounter { 0 };
+    /** First channel of all voices mixed, for the VU. */
+    std::array<float, kVuChunkFrames> vuMix {};
+    /** One voice's resampled output before gain. */
+    juce::AudioBuffer<float> voiceOutput;
+    /** Source frames gathered for a voice reading across the resident edges or from a packed sample. */
+    juce::AudioBuffer<float> window;
+    /** True while any voice is sounding. */
+    bool anyVoiceActive { false };
+    /** Length of the played sample in frames, 0 when there is none. */
+    juce::int64 sampleLengthFrames { 0 };
     /** Current device/output sample rate. */
     double outputSampleRate { 44100.0 };
-    /** Number of source samples consumed per output sample. */
+    /** Number of source samples consumed per output sample at the recorded pitch. */
     double playbackRatio { 1.0 };
-    /** Fractional playback position in source-sample units. */
-    double fractionalPlaybackPosition { 0.0 };
-    /** Current integer source read position. */
-    int sourceReadIndex { 0 };
     /** Rolling VU analysis window. */
     std::vector<float> vuBuffer;
     /** Write position into the rolling VU window. */
@@ -106,9 +291,5 @@ private:
     /** Number of frames retained for VU analysis. */
     int vuBufferSize { 1024 };
     /** Last reported block VU value in decibels. */
-    float lastVuDb { -60.0f };
-    /** Velocity-derived gain applied on the next trigger. */
-    float velocityGain { 1.0f };
-    /** Cached waveform points for UI rendering. */
-    std::vector<float> waveformPoints;
+    std::atomic<float> lastVuDb { -60.0f };
 };
@@ -6,6 +6,7 @@
 #include <array>
 #include <sstream>
 #include <thread>
+#include <utility>
 
 namespace
 {
@@ -68,6 +69,123 @@ bool isPreviewableAudioFile(const juce::File& file)
 {
     return file.existsAsFile() && file.hasFileExtension(".wav");
 }
+
+/** Seconds of a streamed sample kept in RAM, long enough to cover the first reads after a trigger. */
+constexpr double kStreamHeadSeconds = 2.0;
+/** Step and upper limit of the streaming threshold on the machine page. */
+constexpr float kStreamThresholdStepSeconds = 5.0f;
+constexpr float kMaxStreamThresholdSeconds = 600.0f;
+
+std::string formatStreamThreshold(float seconds)
+{
+    if (seconds <= 0.0f)
+        return "STROFF";
+    return "STR" + std::to_string(static_cast<int>(seconds));
+}
+
+std::string formatFineTune(int cents)
+{
+    if (cents == 0)
+        return "T0";
+    return (cents > 0 ? "T+" : "T") + std::to_string(cents);
+}
+
+/** Share of sample loads the shared cache served without decoding, or "HIT-" before the first load. */
+std::string formatCacheHitRate(const SampleCache::Stats& stats)
+{
+    const auto lookups = stats.hits + stats.misses;
+    if (lookups == 0)
+        return "HIT-";
+    return "HIT" + std::to_string(static_cast<int>((stats.hits * 100) / lookups));
+}
+
+std::string formatSampleFormat(SampleFormat format)
+{
+    switch (format)
+    {
+        case SampleFormat::float32: return "F32";
+        case SampleFormat::int16: return "I16";
+        case SampleFormat::float16: return "F16";
+    }
+    return "F32";
+}
+
+/** Steps through the formats, with -1 standing for the default when allowDefault is set. */
+int nextSampleFormat(int current, int direction, bool allowDefault)
+{
+    const int first = allowDefault ? -1 : 0;
+    const int count = static_cast<int>(SampleFormat::float16) + 1 - first;
+    return first + ((current - first + (direction >= 0 ? 1 : count - 1)) % count);
+}
+
+std::string formatResampleQuality(ResampleQuality quality)
+{
+    switch (quality)
+    {
+        case ResampleQuality::linear: return "LIN";
+        case ResampleQuality::cubic: return "CUB";
+        case ResampleQuality::sinc: return "SINC";
+    }
+    return "CUB";
+}
+
+/** Frames decoded between checks for a cancelled load. */
+constexpr int kDecodeChunkFrames = 1 << 16;
+
+/** Decodes the first numFrames frames into buffer a chunk at a time. Returns false if the job is cancelled part way. */
+bool readUnlessCancelled(juce::AudioFormatReader& reader, juce::AudioBuffer<float>& buffer, int numFrames, const SampleLoader::Job* job)
+{
+    for (int done = 0; done < numFrames; done += kDecodeChunkFrames)
+    {
+        if (job != nullptr && job->isCancelled())
+            return false;
+        reader.read(&buffer, done, juce::jmin(kDecodeChunkFrames, numFrames - done), done, true, true);
+    }
+    return true;
+}
+
+/** Maps the whole of an uncompressed WAV or AIFF file, or returns null for anything it cannot map. */
+std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapWholeFile(juce::AudioFormatManager& formats, const juce::File& file)
+{
+    auto* format = formats.findFormatForFileExtension(file.getFileExtension());
+    if (format == nullptr)
+        return nullptr;
+
+    std::unique_ptr<juce::MemoryMappedAudioFormatReader> reader(format->createMemoryMappedReader(file));
+    if (reader == nullptr || reader->lengthInSamples <= 0 || ! reader->mapEntireFile())
+        return nullptr;
+    return reader;
+}
+
+/** Min/max pairs for a waveform overview of a file too long to decode, from a short window at each point. */
+std::vector<float> readWaveformOverview(juce::AudioFormatReader& reader, int numChannels, juce::int64 lengthInFrames, int numPoints)
+{
+    constexpr int windowFrames = 256;
+    std::vector<float> points;
+    points.reserve(static_cast<size_t>(numPoints) * 2);
+    juce::AudioBuffer<float> window(numChannels, windowFrames);
+
+    for (int point = 0; point < numPoints; ++point)
+    {
+        const auto start = lengthInFrames * point / numPoints;
+        const int count = static_cast<int>(juce::jmin((juce::int64) windowFrames, lengthInFrames - start));
+        float localMin = 0.0f;
+        float localMax = 0.0f;
+        if (count > 0)
+        {
+            reader.read(&window, 0, count, start, true, true);
+            for (int chan = 0; chan < numChannels; ++chan)
+            {
+                const auto range = juce::FloatVectorOperations::findMinAndMax(window.getReadPointer(chan), count);
+                localMin = juce::jmin(localMin, range.getStart());
+                localMax = juce::jmax(localMax, range.getEnd());
+            }
+        }
+        points.push_back(localMin);
+        points.push_back(localMax);
+    }
+    return points;
+}
 } // namespace
 
 //==============================================================================
@@ -82,11 +200,15 @@ SuperSamplerProcessor::SuperSamplerProcessor()
 {
     formatManager.registerBasicFormats();
     previewPlayer = std::make_unique<SuperSamplePlayer>(-1);
+    previewPlayer->setPolyphony(1);
+    renderSet = std::make_unique<PlayerSet>();
     vuJson = "{\"dB_out\":[]}";
 }
 
 SuperSamplerProcessor::~SuperSamplerProcessor()
 {
+    // loads capture this processor, so none may still be running once it is gone
+    loader->cancelAll (this);
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout SuperSamplerProcessor::createParameterLayout()
@@ -243,6 +365,12 @@ std::vector<std::vector<UIBox>> SuperSamplerProcessor::getUIBoxes(const MachineU
 {
     juce::ignoreUnused(context);
 
+    {
+        // samples the render has let go of are freed as the UI redraws, off the audio thread
+        const std::lock_guard<std::mutex> lock(playerMutex);
+        collectRetiredPlayback();
+    }
+
     if (isBrowsingFiles())
         return buildBrowserUi();
 
@@ -283,6 +411,13 @@ std::vector<std::vector<UIBox>> SuperSamplerProcessor::getUIBoxes(const MachineU
         st.midiLow = static_cast<int>(playerObj->getProperty("midiLow"));
         st.midiHigh = static_cast<int>(playerObj->getProperty("midiHigh"));
         st.gain = static_cast<float>(double(playerObj->getProperty("gain")));
+        st.polyphony = static_cast<int>(playerObj->getProperty("polyphony"));
+        st.stealsQuietest = static_cast<bool>(playerObj->getProperty("stealsQuietest"));
+        st.chokeGroup = static_cast<int>(playerObj->getProperty("chokeGroup"));
+        st.keyTracking = static_cast<bool>(playerObj->getProperty("keyTracking"));
+        st.rootNote = static_cast<int>(playerObj->getProperty("rootNote"));
+        st.fineTuneCents = static_cast<int>(playerObj->getProperty("fineTuneCents"));
+        st.sampleFormat = static_cast<int>(playerObj->getProperty("sampleFormat"));
         st.isPlaying = static_cast<bool>(playerObj->getProperty("isPlaying"));
         const auto vuVar = playerObj->getProperty("vuDb");
         st.vuDb = vuVar.isVoid() ? -60.0f : static_cast<float>(double(vuVar));
@@ -315,7 +450,7 @@ std::vector<std::vector<UIBox>> SuperSamplerProcessor::getUIBoxes(const MachineU
     uiGlowLevels = std::move(nextGlow);
 
     const std::size_t rows = uiPlayers.size() + 1;
-    const std::size_t cols = 6;
+    const std::size_t cols = 12;
     if (rows == 0 || cols == 0)
         return { { UIBox{} } };
 
@@ -336,6 +471,59 @@ std::vector<std::vector<UIBox>> SuperSamplerProcessor::getUIBoxes(const MachineU
                         addEntry();
                     };
                 }
+                else if (col == 1)
+                {
+                    cell.kind = UIBox::Kind::SamplerValue;
+                    cell.text = formatStreamThreshold(getStreamThresholdSeconds());
+                    cell.onAdjust = [this](int direction)
+                    {
+                        setStreamThresholdSeconds(getStreamThresholdSeconds() + static_cast<float>(direction) * kStreamThresholdStepSeconds);
+                    };
+                }
+                else if (col == 2)
+                {
+                    cell.kind = UIBox::Kind::SamplerValue;
+                    cell.text = formatResampleQuality(getResampleQuality());
+                    cell.onAdjust = [this](int direction)
+                    {
+                        const int count = static_cast<int>(ResampleQuality::sinc) + 1;
+                        const int next = (static_cast<int>(getResampleQuality()) + (direction > 0 ? 1 : count - 1)) % count;
+                        setResampleQuality(static_cast<ResampleQuality>(next));
+                    };
+                }
+                else if (col == 3)
+                {
+                    cell.kind = UIBox::Kind::SamplerValue;
+                    cell.text = getMipLevelsEnabled() ? "MIP" : "MIPOFF";
+                    cell.onAdjust = [this](int)
+                    {
+                        setMipLevelsEnabled(!getMipLevelsEnabled());
+                    };
+                }
+                else if (col == 4)
+                {
+                    cell.kind = UIBox::Kind::SamplerValue;
+                    cell.text = formatCacheHitRate(sampleCache->getStats());
+                }
+                else if (col == 5)
+                {
+                    cell.kind = UIBox::Kind::SamplerValue;
+                    cell.text = getMemoryMappingEnabled() ? "MAP" : "MAPOFF";
+                    cell.onAdjust = [this](int)
+                    {
+                        setMemoryMappingEnabled(!getMemoryMappingEnabled());
+                    };
+                }
+                else if (col == 6)
+                {
+                    cell.kind = UIBox::Kind::SamplerValue;
+                    cell.text = formatSampleFormat(getDefaultSampleFormat());
+                    cell.onAdjust = [this](int direction)
+                    {
+                        const int next = nextSampleFormat(static_cast<int>(getDefaultSampleFormat()), direction, false);
+                        setDefaultSampleFormat(static_cast<SampleFormat>(next));
+                    };
+                }
                 else
                 {
                     cell.kind = UIBox::Kind::None;
@@ -400,7 +588,78 @@ std::vector<std::vector<UIBox>> SuperSamplerProcessor::getUIBoxes(const MachineU
                     };
                     break;
                 case 5:
+                    cell.kind = UIBox::Kind::SamplerValue;
+                    cell.text = "P" + std::to_string(player.polyphony);
+                    cell.onAdjust = [this, playerId, voices = player.polyphony](int direction)
+                    {
+                        setPolyphonyFromUI(playerId, voices + direction);
+                    };
+                    cell.onInsert = [this, playerId](double value)
+                    {
+                        setPolyphonyFromUI(playerId, static_cast<int>(value));
+                    };
+                    break;
+                case 6:
+                    cell.kind = UIBox::Kind::SamplerValue;
+                    cell.text = player.stealsQuietest ? "QUIET" : "OLD";
+                    cell.onAdjust = [this, playerId, quietest = player.stealsQuietest](int)
+                    {
+                        setVoiceStealModeFromUI(playerId, quietest ? SuperSamplePlayer::VoiceStealMode::oldest
+                                                                   : SuperSamplePlayer::VoiceStealMode::quietest);
+                    };
+                    break;
+                case 7:
+                    cell.kind = UIBox::Kind::SamplerValue;
+                    cell.text = player.chokeGroup > 0 ? "CH" + std::to_string(player.chokeGroup) : "CH-";
+                    cell.onAdjust = [this, playerId, group = player.chokeGroup](int direction)
+                    {
+                        setChokeGroupFromUI(playerId, group + direction);
+                    };
+                    cell.onInsert = [this, playerId](double value)
+                    {
+                        setChokeGroupFromUI(playerId, static_cast<int>(value));
+                    };
+                    break;
+                case 8:
+                    cell.kind = UIBox::Kind::SamplerValue;
+                    cell.text = player.keyTracking ? "R" + std::to_string(player.rootNote) : "FIX";
+                    cell.onActivate = [this, playerId, st = player]()
+                    {
+                        setPitchFromUI(playerId, !st.keyTracking, st.rootNote, st.fineTuneCents);
+                    };
+                    cell.onAdjust = [this, playerId, st = player](int direction)
+                    {
+                        setPitchFromUI(playerId, true, st.rootNote + direction, st.fineTuneCents);
+                    };
+                    cell.onInsert = [this, playerId, st = player](double value)
+                    {
+                        setPitchFromUI(playerId, true, static_cast<int>(value), st.fineTuneCents);
+                    };
+                    break;
+                case 9:
+                    cell.kind = UIBox::Kind::SamplerValue;
+                    cell.text = formatFineTune(player.fineTuneCents);
+                    cell.onAdjust = [this, playerId, st = player](int direction)
+                    {
+                        setPitchFromUI(playerId, st.keyTracking, st.rootNote, st.fineTuneCents + direction);
+                    };
+                    cell.onInsert = [this, playerId, st = player](double value)
+                    {
+                        setPitchFromUI(playerId, st.keyTracking, st.rootNote, static_cast<int>(value));
+                    };
+                    break;
+                case 10:
+                    cell.kind = UIBox::Kind::SamplerValue;
+                    cell.text = player.sampleFormat < 0 ? "DEF" : formatSampleFormat(static_cast<SampleFormat>(player.sampleFormat));
+                    cell.onAdjust = [this, playerId, current = player.sampleFormat](int direction)
+                    {
+                        const int next = nextSampleFormat(current, direction, true);
+                        setSampleFormatFromUI(playerId, next < 0 ? std::nullopt : std::optional<SampleFormat>(static_cast<SampleFormat>(next)));
+                    };
+                    break;
+                case 11:
                     cell.kind = UIBox::Kind::SamplerWaveform;
+                    cell.width = 2.0f;
                     if (!player.fileName.empty())
                         cell.text = sanitizeLabel(juce::String(player.fileName), 18);
                     else
@@ -616,6 +875,56 @@ void SuperSamplerProcessor::setGainFromUI (int playerId, float gain)
         broadcastMessage ("Failed to set gain for player " + juce::String (playerId));
 }
 
+void SuperSamplerProcessor::setPolyphonyFromUI (int playerId, int voices)
+{
+    if (setPolyphony (playerId, voices))
+        sendSamplerStateToUI();
+}
+
+void SuperSamplerProcessor::setVoiceStealModeFromUI (int playerId, SuperSamplePlayer::VoiceStealMode mode)
+{
+    if (setVoiceStealMode (playerId, mode))
+        sendSamplerStateToUI();
+}
+
+void SuperSamplerProcessor::setChokeGroupFromUI (int playerId, int group)
+{
+    if (setChokeGroup (playerId, group))
+        sendSamplerStateToUI();
+}
+
+void SuperSamplerProcessor::setPitchFromUI (int playerId, bool keyTracking, int rootNote, int fineTuneCents)
+{
+    if (setPitch (playerId, keyTracking, rootNote, fineTuneCents))
+        sendSamplerStateToUI();
+}
+
+void SuperSamplerProcessor::setSampleFormatFromUI (int playerId, std::optional<SampleFormat> format)
+{
+    if (! setSampleFormat (playerId, format))
+        return;
+
+    juce::String path;
+    {
+        const std::lock_guard<std::mutex> lock (playerMutex);
+        if (auto* player = getPlayer (playerId))
+            path = player->getState().filePath;
+    }
+
+    // the new format only takes effect when the sample is loaded again
+    if (path.isNotEmpty() && juce::File (path).existsAsFile())
+    {
+        loadSampleAsync (playerId, juce::File (path), [this] (bool ok, juce::String error)
+        {
+            if (! ok)
+                broadcastMessage ("Load failed: " + error);
+
+            sendSamplerStateToUI();
+        });
+    }
+    sendSamplerStateToUI();
+}
+
 void SuperSamplerProcessor::sendSamplerStateToUI()
 {
     // DBG("sendSamplerStateToUI");
@@ -665,6 +974,62 @@ bool SuperSamplerProcessor::isBrowsingFiles() const
     return browsingPlayerId >= 0;
 }
 
+void SuperSamplerProcessor::setStreamThresholdSeconds (float seconds)
+{
+    streamThresholdSeconds.store (juce::jlimit (0.0f, kMaxStreamThresholdSeconds, seconds), std::memory_order_relaxed);
+}
+
+float SuperSamplerProcessor::getStreamThresholdSeconds() const noexcept
+{
+    return streamThresholdSeconds.load (std::memory_order_relaxed);
+}
+
+void SuperSamplerProcessor::setResampleQuality (ResampleQuality newQuality)
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    resampleQuality = newQuality;
+    for (auto& player : players)
+        player->setResampleQuality (newQuality);
+    if (previewPlayer != nullptr)
+        previewPlayer->setResampleQuality (newQuality);
+}
+
+ResampleQuality SuperSamplerProcessor::getResampleQuality() const
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    return resampleQuality;
+}
+
+void SuperSamplerProcessor::setMipLevelsEnabled (bool shouldBuild) noexcept
+{
+    mipLevelsEnabled.store (shouldBuild, std::memory_order_relaxed);
+}
+
+bool SuperSamplerProcessor::getMipLevelsEnabled() const noexcept
+{
+    return mipLevelsEnabled.load (std::memory_order_relaxed);
+}
+
+void SuperSamplerProcessor::setMemoryMappingEnabled (bool shouldMap) noexcept
+{
+    memoryMappingEnabled.store (shouldMap, std::memory_order_relaxed);
+}
+
+bool SuperSamplerProcessor::getMemoryMappingEnabled() const noexcept
+{
+    return memoryMappingEnabled.load (std::memory_order_relaxed);
+}
+
+void SuperSamplerProcessor::setDefaultSampleFormat (SampleFormat format) noexcept
+{
+    defaultSampleFormat.store (format, std::memory_order_relaxed);
+}
+
+SampleFormat SuperSamplerProcessor::getDefaultSampleFormat() const noexcept
+{
+    return defaultSampleFormat.load (std::memory_order_relaxed);
+}
+
 std::string SuperSamplerProcessor::getVuStateJson() const
 {
     auto ptr = getVuJson();
@@ -693,67 +1058,38 @@ void SuperSamplerProcessor::processSamplerBlock (juce::AudioBuffer<float>& buffe
     if (numSamples <= 0)
         return;
 
-    struct NoteOnEvent
-    {
-        int note = 0;
-        int velocity = 127;
-    };
-    std::vector<std::vector<NoteOnEvent>> noteOns ((size_t) numSamples);
-
-    for (const auto meta : midi)
-    {
-        const auto msg = meta.getMessage();
-        if (msg.isNoteOn())
-        {
-            auto pos = juce::jlimit (0, numSamples - 1, meta.samplePosition);
-            noteOns[(size_t) pos].push_back ({ msg.getNoteNumber(), msg.getVelocity() });
-        }
-    }
-    const std::lock_guard<std::mutex> lock (playerMutex);
-
-    for (auto& player : players)
+    // swap in what the UI and loader threads published since the last block; nothing here waits on them
+    playerSetExchange.acquire (renderSet);
+    for (auto& player : renderSet->players)
         player->beginBlock();
     if (previewPlayer != nullptr)
         previewPlayer->beginBlock();
 
+    // events arrive in time order, so each note-on closes the segment before it
     int renderedUpToSample = 0;
-    for (int sample = 0; sample < numSamples; ++sample)
+    for (const auto meta : midi)
     {
-        const auto& eventsAtSample = noteOns[(size_t) sample];
-        if (eventsAtSample.empty())
+        // a note-on is three bytes; anything longer is sysex, which getMessage would copy to the heap
+        if (meta.numBytes > 3)
             continue;
 
-        const int segmentLength = sample - renderedUpToSample;
-        if (segmentLength > 0)
-        {
-            for (auto& player : players)
-                player->renderToBuffer (buffer, renderedUpToSample, segmentLength);
-            if (previewPlayer != nullptr)
-                previewPlayer->renderToBuffer (buffer, renderedUpToSample, segmentLength);
-        }
+        const auto msg = meta.getMessage();
+        if (! msg.isNoteOn())
+            continue;
 
-        for (const auto& event : eventsAtSample)
+        const int sample = juce::jlimit (renderedUpToSample, numSamples - 1, meta.samplePosition);
+        if (sample > renderedUpToSample)
         {
-            for (auto& player : players)
-            {
-                if (player->acceptsNote (event.note))
-                    player->triggerNote (event.note, event.velocity);
-            }
+            renderPlayers (buffer, renderedUpToSample, sample - renderedUpToSample);
+            renderedUpToSample = sample;
         }
-
-        renderedUpToSample = sample;
+        triggerPlayersForNote (msg.getNoteNumber(), msg.getVelocity());
     }
 
     if (renderedUpToSample < numSamples)
-    {
-        const int segmentLength = numSamples - renderedUpToSample;
-        for (auto& player : players)
-            player->renderToBuffer (buffer, renderedUpToSample, segmentLength);
-        if (previewPlayer != nullptr)
-            previewPlayer->renderToBuffer (buffer, renderedUpToSample, segmentLength);
-    }
+        renderPlayers (buffer, renderedUpToSample, numSamples - renderedUpToSample);
 
-    for (auto& player : players)
+    for (auto& player : renderSet->players)
         player->endBlock();
     if (previewPlayer != nullptr)
         previewPlayer->endBlock();
@@ -775,27 +1111,81 @@ void SuperSamplerProcessor::processSamplerBlock (juce::AudioBuffer<float>& buffe
     // }
 }
 
+void SuperSamplerProcessor::renderPlayers (juce::AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept
+{
+    for (auto& player : renderSet->players)
+        player->renderToBuffer (buffer, startSample, numSamples);
+    if (previewPlayer != nullptr)
+        previewPlayer->renderToBuffer (buffer, startSample, numSamples);
+}
+
+void SuperSamplerProcessor::triggerPlayersForNote (int midiNote, int velocity) noexcept
+{
+    if (midiNote < 0 || midiNote > 127)
+        return;
+
+    // the index was built from the published ranges, which the players may not have swapped in yet
+    const auto& candidates = renderSet->playersForNote[(size_t) midiNote];
+    for (auto* player : candidates)
+    {
+        if (player->getChokeGroup() > 0 && player->playsNote (midiNote))
+            chokeGroupForNote (player->getChokeGroup(), midiNote);
+    }
+    for (auto* player : candidates)
+    {
+        if (player->playsNote (midiNote))
+            player->triggerNote (midiNote, velocity);
+    }
+}
+
+void SuperSamplerProcessor::publishPlayerSet()
+{
+    auto next = std::make_unique<PlayerSet>();
+    next->players = players;
+    for (auto& player : players)
+    {
+        const auto st = player->getState();
+        for (int note = st.midiLow; note <= st.midiHigh; ++note)
+            next->playersForNote[(size_t) note].push_back (player.get());
+    }
+    playerSetExchange.publish (std::move (next));
+}
+
+void SuperSamplerProcessor::collectRetiredPlayback()
+{
+    // the set goes first, as it may hold the last reference to a removed player
+    playerSetExchange.collectGarbage();
+    for (auto& player : players)
+        player->collectGarbage();
+    if (previewPlayer != nullptr)
+        previewPlayer->collectGarbage();
+}
+
 int SuperSamplerProcessor::addSamplePlayer()
 {
     const std::lock_guard<std::mutex> lock (playerMutex);
     auto id = nextId++;
-    auto player = std::make_unique<SuperSamplePlayer> (id);
+    auto player = std::make_shared<SuperSamplePlayer> (id);
+    player->setResampleQuality (resampleQuality);
     player->prepareToPlay (currentOutputSampleRate, currentBlockSize);
     players.push_back (std::move (player));
+    publishPlayerSet();
     return id;
 }
 
 bool SuperSamplerProcessor::removeSamplePlayerInternal (int playerId)
 {
+    // the render holds the player until it swaps in the set without it, which is then freed off the audio thread
     const std::lock_guard<std::mutex> lock (playerMutex);
     auto it = std::find_if (players.begin(), players.end(),
-        [playerId](const std::unique_ptr<SuperSamplePlayer>& player)
+        [playerId](const std::shared_ptr<SuperSamplePlayer>& player)
         {
             return player->getId() == playerId;
         });
     if (it == players.end())
         return false;
     players.erase (it);
+    publishPlayerSet();
     return true;
 }
 
@@ -812,36 +1202,68 @@ juce::var SuperSamplerProcessor::toVar() const
         obj->setProperty ("midiLow", st.midiLow);
         obj->setProperty ("midiHigh", st.midiHigh);
         obj->setProperty ("gain", st.gain);
+        obj->setProperty ("polyphony", st.polyphony);
+        obj->setProperty ("stealsQuietest", st.stealMode == SuperSamplePlayer::VoiceStealMode::quietest);
+        obj->setProperty ("chokeGroup", st.chokeGroup);
+        obj->setProperty ("keyTracking", st.keyTracking);
+        obj->setProperty ("rootNote", st.rootNote);
+        obj->setProperty ("fineTuneCents", st.fineTuneCents);
+        obj->setProperty ("sampleFormat", st.sampleFormat.has_value() ? static_cast<int> (*st.sampleFormat) : -1);
+        obj->setProperty ("activeVoices", st.activeVoices);
         obj->setProperty ("isPlaying", st.isPlaying);
         obj->setProperty ("vuDb", st.vuDb);
         obj->setProperty ("status", st.status);
         obj->setProperty ("fileName", st.fileName);
         obj->setProperty ("filePath", st.filePath);
         obj->setProperty ("waveformSVG", st.waveformSVG);
+        obj->setProperty ("isStreamed", st.isStreamed);
+        obj->setProperty ("isMemoryMapped", st.isMemoryMapped);
+        obj->setProperty ("streamUnderruns", (int) st.streamUnderruns);
         arr.add (juce::var (obj));
     }
 
     juce::DynamicObject::Ptr root = new juce::DynamicObject();
     root->setProperty ("players", juce::var (arr));
     root->setProperty ("count", (int) players.size());
+
+    const auto cacheStats = sampleCache->getStats();
+    juce::DynamicObject::Ptr cache = new juce::DynamicObject();
+    cache->setProperty ("hits", (juce::int64) cacheStats.hits);
+    cache->setProperty ("misses", (juce::int64) cacheStats.misses);
+    cache->setProperty ("evictions", (juce::int64) cacheStats.evictions);
+    cache->setProperty ("entries", cacheStats.entries);
+    cache->setProperty ("bytes", cacheStats.bytes);
+    cache->setProperty ("budgetBytes", cacheStats.budgetBytes);
+    root->setProperty ("sampleCache", juce::var (cache));
     return juce::var (root);
 }
 
 void SuperSamplerProcessor::loadSampleAsync (int playerId, const juce::File& file, std::function<void (bool, juce::String)> onComplete)
 {
-    std::thread ([this, playerId, file, cb = std::move (onComplete)]() mutable
+    const auto priority = playerId == -1 ? SampleLoadPriority::preview : SampleLoadPriority::foreground;
+    auto job = loader->submit (this, priority, [this, playerId, file, cb = std::move (onComplete)] (SampleLoader::Job& self) mutable
     {
         juce::String error;
-        const bool ok = loadSampleInternal (playerId, file, error);
+        const bool ok = loadSampleInternal (playerId, file, error, &self);
 
-        if (cb != nullptr)
+        // a load cancelled before it installed anything has nobody left to tell
+        if (cb != nullptr && (ok || ! self.isCancelled()))
         {
             juce::MessageManager::callAsync ([cbLocal = std::move (cb), ok, error]() mutable
             {
                 cbLocal (ok, error);
             });
         }
-    }).detach();
+    });
+
+    std::shared_ptr<SampleLoader::Job> superseded;
+    {
+        const std::lock_guard<std::mutex> lock (loadJobsMutex);
+        superseded = std::exchange (loadJobs[playerId], job);
+    }
+    // whatever the player was loading before is no longer wanted
+    if (superseded != nullptr)
+        superseded->cancel();
 }
 
 bool SuperSamplerProcessor::setMidiRange (int playerId, int low, int high)
@@ -850,6 +1272,7 @@ bool SuperSamplerProcessor::setMidiRange (int playerId, int low, int high)
     if (auto* player = getPlayer (playerId))
     {
         player->setMidiRange (low, high);
+        publishPlayerSet();
         return true;
     }
     return false;
@@ -866,13 +1289,79 @@ bool SuperSamplerProcessor::setGain (int playerId, float gain)
     return false;
 }
 
+bool SuperSamplerProcessor::setPolyphony (int playerId, int voices)
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    if (auto* player = getPlayer (playerId))
+    {
+        player->setPolyphony (voices);
+        return true;
+    }
+    return false;
+}
+
+bool SuperSamplerProcessor::setVoiceStealMode (int playerId, SuperSamplePlayer::VoiceStealMode mode)
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    if (auto* player = getPlayer (playerId))
+    {
+        player->setVoiceStealMode (mode);
+        return true;
+    }
+    return false;
+}
+
+bool SuperSamplerProcessor::setChokeGroup (int playerId, int group)
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    if (auto* player = getPlayer (playerId))
+    {
+        player->setChokeGroup (group);
+        return true;
+    }
+    return false;
+}
+
+bool SuperSamplerProcessor::setPitch (int playerId, bool keyTracking, int rootNote, int fineTuneCents)
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    if (auto* player = getPlayer (playerId))
+    {
+        player->setKeyTracking (keyTracking);
+        player->setRootNote (rootNote);
+        player->setFineTune (fineTuneCents);
+        return true;
+    }
+    return false;
+}
+
+bool SuperSamplerProcessor::setSampleFormat (int playerId, std::optional<SampleFormat> format)
+{
+    const std::lock_guard<std::mutex> lock (playerMutex);
+    if (auto* player = getPlayer (playerId))
+    {
+        player->setSampleFormat (format);
+        return true;
+    }
+    return false;
+}
+
+void SuperSamplerProcessor::chokeGroupForNote (int group, int midiNote) noexcept
+{
+    for (auto& player : renderSet->players)
+    {
+        if (player->getChokeGroup() == group && ! player->playsNote (midiNote))
+            player->stop();
+    }
+}
+
 bool SuperSamplerProcessor::trigger (int playerId)
 {
     const std::lock_guard<std::mutex> lock (playerMutex);
     if (auto* player = getPlayer (playerId))
     {
         // DBG("SuperSamplerProcessor::trigger: playing sampler " << playerId);
-        player->trigger();
+        player->requestTrigger();
         return true;
     }
     return false;
@@ -908,6 +1397,11 @@ juce::ValueTree SuperSamplerProcessor::exportToValueTree() const
     juce::ValueTree root ("SamplerState");
     root.setProperty ("count", (int) players.size(), nullptr);
     root.setProperty ("lastSampleDirectory", lastSampleDirectory.getFullPathName(), nullptr);
+    root.setProperty ("streamThresholdSeconds", getStreamThresholdSeconds(), nullptr);
+    root.setProperty ("resampleQuality", static_cast<int> (resampleQuality), nullptr);
+    root.setProperty ("buildMipLevels", getMipLevelsEnabled(), nullptr);
+    root.setProperty ("mapUncompressed", getMemoryMappingEnabled(), nullptr);
+    root.setProperty ("sampleFormat", static_cast<int> (getDefaultSampleFormat()), nullptr);
 
     for (const auto& p : players)
     {
@@ -917,6 +1411,13 @@ juce::ValueTree SuperSamplerProcessor::exportToValueTree() const
         child.setProperty ("midiLow", st.midiLow, nullptr);
         child.setProperty ("midiHigh", st.midiHigh, nullptr);
         child.setProperty ("gain", st.gain, nullptr);
+        child.setProperty ("polyphony", st.polyphony, nullptr);
+        child.setProperty ("stealsQuietest", st.stealMode == SuperSamplePlayer::VoiceStealMode::quietest, nullptr);
+        child.setProperty ("chokeGroup", st.chokeGroup, nullptr);
+        child.setProperty ("keyTracking", st.keyTracking, nullptr);
+        child.setProperty ("rootNote", st.rootNote, nullptr);
+        child.setProperty ("fineTuneCents", st.fineTuneCents, nullptr);
+        child.setProperty ("sampleFormat", st.sampleFormat.has_value() ? static_cast<int> (*st.sampleFormat) : -1, nullptr);
         child.setProperty ("filePath", st.filePath, nullptr);
         child.setProperty ("status", st.status, nullptr);
         root.addChild (child, -1, nullptr);
@@ -935,6 +1436,15 @@ void SuperSamplerProcessor::importFromValueTree (const juce::ValueTree& tree)
 
     std::vector<PendingPlayer> pending;
     const auto restoredLastDirectory = tree.getProperty("lastSampleDirectory").toString();
+    // before any file loads, so restored samples stream or not as they did when saved
+    setStreamThresholdSeconds ((float) tree.getProperty ("streamThresholdSeconds", 30.0f));
+    const int restoredQuality = juce::jlimit (0, static_cast<int> (ResampleQuality::sinc),
+                                              (int) tree.getProperty ("resampleQuality", static_cast<int> (ResampleQuality::cubic)));
+    setResampleQuality (static_cast<ResampleQuality> (restoredQuality));
+    setMipLevelsEnabled ((bool) tree.getProperty ("buildMipLevels", true));
+    setMemoryMappingEnabled ((bool) tree.getProperty ("mapUncompressed", false));
+    const int restoredFormat = juce::jlimit (0, static_cast<int> (SampleFormat::float16), (int) tree.getProperty ("sampleFormat", 0));
+    setDefaultSampleFormat (static_cast<SampleFormat> (restoredFormat));
 
     for (int i = 0; i < tree.getNumChildren(); ++i)
     {
@@ -947,30 +1457,59 @@ void SuperSamplerProcessor::importFromValueTree (const juce::ValueTree& tree)
         p.state.midiLow = (int) child.getProperty ("midiLow", 36);
         p.state.midiHigh = (int) child.getProperty ("midiHigh", 60);
         p.state.gain = (float) child.getProperty ("gain", 1.0f);
+        p.state.polyphony = (int) child.getProperty ("polyphony", 8);
+        p.state.stealMode = (bool) child.getProperty ("stealsQuietest", false) ? SuperSamplePlayer::VoiceStealMode::quietest
+                                                                               : SuperSamplePlayer::VoiceStealMode::oldest;
+        p.state.chokeGroup = (int) child.getProperty ("chokeGroup", 0);
+        p.state.keyTracking = (bool) child.getProperty ("keyTracking", false);
+        p.state.rootNote = (int) child.getProperty ("rootNote", 60);
+        p.state.fineTuneCents = (int) child.getProperty ("fineTuneCents", 0);
+        const int format = (int) child.getProperty ("sampleFormat", -1);
+        if (format >= 0 && format <= static_cast<int> (SampleFormat::float16))
+            p.state.sampleFormat = static_cast<SampleFormat> (format);
         p.path = child.getProperty ("filePath").toString();
         pending.push_back (p);
     }
 
+    // the new players are built before taking the lock; only the swap happens under it
+    const auto quality = getResampleQuality();
+    std::vector<std::shared_ptr<SuperSamplePlayer>> restoredPlayers;
+    int restoredNextId = 1;
+    for (const auto& p : pending)
+    {
+        auto player = std::make_shared<SuperSamplePlayer> (p.state.id);
+        player->setMidiRange (p.state.midiLow, p.state.midiHigh);
+        player->setGain (p.state.gain);
+        player->setPolyphony (p.state.polyphony);
+        player->setVoiceStealMode (p.state.stealMode);
+        player->setChokeGroup (p.state.chokeGroup);
+        player->setKeyTracking (p.state.keyTracking);
+        player->setRootNote (p.state.rootNote);
+        player->setFineTune (p.state.fineTuneCents);
+        player->setSampleFormat (p.state.sampleFormat);
+        player->setResampleQuality (quality);
+        player->setFilePathAndStatus (p.path, p.path.isNotEmpty() ? "pending" : "empty");
+
+        restoredNextId = std::max (restoredNextId, p.state.id + 1);
+        restoredPlayers.push_back (std::move (player));
+    }
+
     {
         const std::lock_guard<std::mutex> lock (playerMutex);
-        players.clear();
-        nextId = 1;
+        players.swap (restoredPlayers);
+        nextId = restoredNextId;
         if (restoredLastDirectory.isNotEmpty())
             lastSampleDirectory = juce::File(restoredLastDirectory);
         else
             lastSampleDirectory = juce::File();
 
-        for (const auto& p : pending)
-        {
-            auto player = std::make_unique<SuperSamplePlayer> (p.state.id);
-            player->setMidiRange (p.state.midiLow, p.state.midiHigh);
-            player->setGain (p.state.gain);
-            player->setFilePathAndStatus (p.path, p.path.isNotEmpty() ? "pending" : "empty");
-
-            nextId = std::max (nextId, p.state.id + 1);
-            players.push_back (std::move (player));
-        }
+        // prepared before the render can see them
+        for (auto& player : players)
+            player->prepareToPlay (currentOutputSampleRate, currentBlockSize);
+        publishPlayerSet();
     }
+    // the replaced players outlive this only in the set the render is still playing
+    restoredPlayers.clear();
 
     for (const auto& p : pending)
     {
@@ -979,13 +1518,16 @@ void SuperSamplerProcessor::importFromValueTree (const juce::ValueTree& tree)
             juce::String error;
             auto ok = loadSampleInternal (p.state.id, juce::File (p.path), error);
             if (! ok)
+            {
+                const std::lock_guard<std::mutex> lock (playerMutex);
                 if (auto* player = getPlayer (p.state.id))
                     player->markError (p.path, error.isNotEmpty() ? error : "missing");
+            }
         }
     }
 }
 
-bool SuperSamplerProcessor::loadSampleInternal (int playerId, const juce::File& file, juce::String& error)
+bool SuperSamplerProcessor::loadSampleInternal (int playerId, const juce::File& file, juce::String& error, SampleLoader::Job* job)
 {
     if (! file.existsAsFile())
     {
@@ -1011,23 +1553,119 @@ bool SuperSamplerProcessor::loadSampleInternal (int playerId, const juce::File&
     }
 
     const int64 maxPreviewSamples = static_cast<int64>(reader->sampleRate * 10.0);
-    const int64 samplesToRead = playerId == -1
-        ? juce::jmin(totalSamples, maxPreviewSamples)
+    const double sampleRate = reader->sampleRate;
+    const float thresholdSeconds = getStreamThresholdSeconds();
+    const int64 headSamples = static_cast<int64>(sampleRate * kStreamHeadSeconds);
+    // an uncompressed file can play straight from a mapping, leaving the OS page cache to hold it
+    std::unique_ptr<juce::MemoryMappedAudioFormatReader> mappedReader;
+    if (playerId != -1 && getMemoryMappingEnabled())
+        mappedReader = mapWholeFile (formatManager, file);
+    const bool shouldMap = mappedReader != nullptr;
+    const bool shouldStream = ! shouldMap
+        && playerId != -1
+        && thresholdSeconds > 0.0f
+        && totalSamples > static_cast<int64>(sampleRate * thresholdSeconds)
+        && totalSamples > headSamples;
+
+    const int64 samplesToRead = shouldMap ? 0
+        : shouldStream ? headSamples
+        : playerId == -1 ? juce::jmin(totalSamples, maxPreviewSamples)
         : totalSamples;
+    const bool withMipLevels = ! shouldMap && ! shouldStream && playerId != -1 && getMipLevelsEnabled();
+    // the preview is short-lived and stays float; players use their own format or the default
+    auto format = SampleFormat::float32;
+    if (playerId != -1 && ! shouldMap)
+    {
+        const std::lock_guard<std::mutex> lock (playerMutex);
+        auto* player = getPlayer (playerId);
+        format = player != nullptr && player->getSampleFormat().has_value() ? *player->getSampleFormat() : getDefaultSampleFormat();
+    }
+
+    SampleCache::Key cacheKey;
+    cacheKey.path = file.getFullPathName();
+    cacheKey.modificationTime = file.getLastModificationTime().toMilliseconds();
+    cacheKey.residentFrames = samplesToRead;
+    cacheKey.streamed = shouldStream;
+    cacheKey.withMipLevels = withMipLevels;
+    cacheKey.memoryMapped = shouldMap;
+    cacheKey.format = format;
+    if (auto cached = sampleCache->find (cacheKey))
+        return installSample (playerId, file, std::move (cached), error);
+
+    // mip levels add up to about the size of the sample again
+    const int64 bytesNeeded = samplesToRead * numChannels * (int64) sizeof (float) * (withMipLevels ? 2 : 1);
+    if (job != nullptr && ! job->reserveMemory (bytesNeeded))
+    {
+        error = "Cancelled";
+        return false;
+    }
 
     juce::AudioBuffer<float> tempBuffer (numChannels, (int) samplesToRead);
-    reader->read (&tempBuffer, 0, (int) samplesToRead, 0, true, true);
+    if (! readUnlessCancelled (*reader, tempBuffer, (int) samplesToRead, job))
+    {
+        error = "Cancelled";
+        return false;
+    }
+
+    if (shouldMap || shouldStream)
+    {
+        auto overview = readWaveformOverview (shouldMap ? *mappedReader : *reader, numChannels, totalSamples, SampleData::kWaveformPoints);
+
+        auto source = std::make_shared<SampleStreamSource>();
+        source->mappedReader = mappedReader.get();
+        if (shouldMap)
+            source->reader = std::move (mappedReader);
+        else
+            source->reader = std::move (reader);
+        source->numChannels = numChannels;
+        source->lengthInFrames = totalSamples;
+        source->firstStreamedFrame = samplesToRead;
+        // page in the start now so the first hit does not wait on the disk
+        source->touchMappedPages (0, juce::jmin (totalSamples, headSamples));
+        auto data = SampleData::createStreamed (std::move (tempBuffer), std::move (source), std::move (overview), sampleRate, format);
+        return installSample (playerId, file, sampleCache->insert (cacheKey, std::move (data)), error);
+    }
+
+    // the preview always plays at its recorded pitch, so only real players need the transposed copies
+    auto data = SampleData::createResident (std::move (tempBuffer), sampleRate, withMipLevels, format);
+    if (job != nullptr && job->isCancelled())
+    {
+        error = "Cancelled";
+        return false;
+    }
+    return installSample (playerId, file, sampleCache->insert (cacheKey, std::move (data)), error);
+}
+
+bool SuperSamplerProcessor::installSample (int playerId,
+                                           const juce::File& file,
+                                           std::shared_ptr<const SampleData> data,
+                                           juce::String& error)
+{
+    // cached streamed data is shared, but every player reads ahead through rings of its own
+    SuperSamplePlayer::VoiceStreams streams;
+    if (data->streamSource != nullptr)
+    {
+        int voices = 0;
+        {
+            const std::lock_guard<std::mutex> lock (playerMutex);
+            if (auto* player = getPlayer (playerId))
+                voices = player->getPolyphony();
+        }
+        streams = SuperSamplePlayer::createVoiceStreams (*streamer, data->streamSource, voices);
+    }
 
     const std::lock_guard<std::mutex> lock (playerMutex);
-    if (auto* player = getPlayer (playerId))
+    auto* player = getPlayer (playerId);
+    if (player == nullptr)
     {
-        player->setFilePathAndStatus (file.getFullPathName(), "loading", file.getFileName());
-        player->setLoadedBuffer (std::move (tempBuffer), file.getFileName(), reader->sampleRate);
-        return true;
+        error = "Player not found";
+        return false;
     }
 
-    error = "Player not found";
-    return false;
+    player->setFilePathAndStatus (file.getFullPathName(), "loading", file.getFileName());
+    // the render swaps it in at its next block; the sample it replaces is freed off the audio thread
+    player->setSample (std::move (data), std::move (streams), *streamer, file.getFileName());
+    return true;
 }
 
 SuperSamplePlayer* SuperSamplerProcessor::getPlayer (int playerId) const
@@ -1258,8 +1896,8 @@ void SuperSamplerProcessor::previewBrowsedFile(const juce::File& file)
 
         if (previewPlayer != nullptr && previewLoadedFile == file)
         {
-            previewPlayer->stop();
-            previewPlayer->trigger();
+            previewPlayer->requestStop();
+            previewPlayer->requestTrigger();
             return;
         }
     }
@@ -1269,7 +1907,7 @@ void SuperSamplerProcessor::previewBrowsedFile(const juce::File& file)
     {
         const std::lock_guard<std::mutex> lock(playerMutex);
         if (previewPlayer != nullptr)
-            previewPlayer->stop();
+            previewPlayer->requestStop();
     }
 
     loadSampleAsync(-1, file, [this, requestGeneration, file] (bool ok, juce::String)
@@ -1292,6 +1930,12 @@ void SuperSamplerProcessor::previewBrowsedFile(const juce::File& file)
 void SuperSamplerProcessor::stopPreviewPlayback()
 {
     previewRequestGeneration.fetch_add(1, std::memory_order_acq_rel);
+    {
+        const std::lock_guard<std::mutex> lock(loadJobsMutex);
+        auto it = loadJobs.find(-1);
+        if (it != loadJobs.end() && it->second != nullptr)
+            it->second->cancel();
+    }
     if (previewPlayer != nullptr)
-        previewPlayer->stop();
+        previewPlayer->requestStop();
 }
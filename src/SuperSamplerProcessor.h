@@ -1,15 +1,21 @@
 #pragma once
 #include <JuceHeader.h>
+#include <array>
 #include <atomic>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
 #include <vector>
 
 #include "MachineInterface.h"
-
-class SuperSamplePlayer;
+#include "SampleCache.h"
+#include "SampleLoader.h"
+#include "SampleStreamer.h"
+#include "SnapshotExchange.h"
+#include "SuperSamplePlayer.h"
 
 
 //==============================================================================
@@ -91,10 +97,40 @@ public:
     void triggerFromWeb (int playerId);
     /** Sets the static gain of a player. */
     void setGainFromUI (int playerId, float gain);
+    /** Sets how many voices a player may sound at once. */
+    void setPolyphonyFromUI (int playerId, int voices);
+    /** Sets how a player picks a voice to steal when all are busy. */
+    void setVoiceStealModeFromUI (int playerId, SuperSamplePlayer::VoiceStealMode mode);
+    /** Sets a player's choke group, 0 for none. */
+    void setChokeGroupFromUI (int playerId, int group);
+    /** Sets whether a player tracks the keyboard, the note that plays it at its recorded pitch, and its fine tune in cents. */
+    void setPitchFromUI (int playerId, bool keyTracking, int rootNote, int fineTuneCents);
+    /** Sets a player's sample format, none following the default, and reloads its sample in it. */
+    void setSampleFormatFromUI (int playerId, std::optional<SampleFormat> format);
     /** Formats a note label for the sequencer view. */
     std::string describeNoteForSequencer (int midiNote) const;
     /** Returns true while the integrated file browser is open. */
     bool isBrowsingFiles() const;
+    /** Sets how long a sample must be, in seconds, before later loads stream it from disk. 0 keeps every sample in RAM. */
+    void setStreamThresholdSeconds (float seconds);
+    /** Returns the streaming threshold in seconds, 0 when streaming is off. */
+    float getStreamThresholdSeconds() const noexcept;
+    /** Sets the interpolation every player, including the browser preview, reads its sample with. */
+    void setResampleQuality (ResampleQuality newQuality);
+    /** Returns the interpolation players read their samples with. */
+    ResampleQuality getResampleQuality() const;
+    /** Sets whether later loads build prefiltered half-rate copies of each sample for playing it far above its root. */
+    void setMipLevelsEnabled (bool shouldBuild) noexcept;
+    /** Returns true when loads build prefiltered half-rate copies. */
+    bool getMipLevelsEnabled() const noexcept;
+    /** Sets whether later loads of uncompressed WAV and AIFF files play straight from a memory mapping of the file. */
+    void setMemoryMappingEnabled (bool shouldMap) noexcept;
+    /** Returns true when uncompressed files are memory mapped instead of decoded. */
+    bool getMemoryMappingEnabled() const noexcept;
+    /** Sets the format later loads keep samples in for players without a format of their own. */
+    void setDefaultSampleFormat (SampleFormat format) noexcept;
+    /** Returns the format samples are kept in by default. */
+    SampleFormat getDefaultSampleFormat() const noexcept;
 
     /** Builds the machine-editor UI cells for the sampler. */
     std::vector<std::vector<UIBox>> getUIBoxes(const MachineUiContext& context) override;
@@ -134,6 +170,20 @@ private:
         int midiHigh = 127;
         /** Player gain displayed in the UI. */
         float gain = 1.0f;
+        /** Voices the player may sound at once. */
+        int polyphony = 8;
+        /** True when the player steals its quietest voice rather than its oldest. */
+        bool stealsQuietest = false;
+        /** Choke group, 0 for none. */
+        int chokeGroup = 0;
+        /** True when the player plays notes at their pitch relative to rootNote. */
+        bool keyTracking = false;
+        /** MIDI note that plays the sample at its recorded pitch. */
+        int rootNote = 60;
+        /** Fine tune in cents. */
+        int fineTuneCents = 0;
+        /** The player's own SampleFormat, or -1 when it follows the default. */
+        int sampleFormat = -1;
         /** True when the player is currently active. */
         bool isPlaying = false;
         /** Player VU level in decibels. */
@@ -144,6 +194,15 @@ private:
         std::string fileName;
     };
 
+    /** What the render reads of the player list, rebuilt whole whenever it or a range changes. */
+    struct PlayerSet
+    {
+        /** Every player, kept alive while the render may still be playing them. */
+        std::vector<std::shared_ptr<SuperSamplePlayer>> players;
+        /** Players whose range covers each MIDI note, in player order. */
+        std::array<std::vector<SuperSamplePlayer*>, 128> playersForNote;
+    };
+
     /** JUCE parameter tree used for state persistence. */
     juce::AudioProcessorValueTreeState apvts;
     /** Last browsed sample directory, persisted across sessions. */
@@ -156,18 +215,39 @@ private:
     void broadcastMessage (const juce::String& msg);
     /** Processes MIDI-triggered playback for all players. */
     void processSamplerBlock (juce::AudioBuffer<float>& buffer, const juce::MidiBuffer& midi);
+    /** Renders one segment of the block from every player and the preview. */
+    void renderPlayers (juce::AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept;
+    /** Starts every player whose range covers the note, after choking the groups they belong to. */
+    void triggerPlayersForNote (int midiNote, int velocity) noexcept;
+    /** Publishes the players and the note index built from their ranges to the render. Call with playerMutex held. */
+    void publishPlayerSet();
+    /** Frees the player sets and player setups the render has swapped out. Call with playerMutex held. */
+    void collectRetiredPlayback();
     /** Adds a new player and returns its id. */
     int addSamplePlayer();
     /** Removes a player internally by id. */
     bool removeSamplePlayerInternal (int playerId);
     /** Exports sampler state to a JUCE var. */
     juce::var toVar() const;
-    /** Loads a sample asynchronously into a player. */
+    /** Queues a sample load into a player on the shared loader, replacing any load still pending for it.
+     *  onComplete runs on the message thread unless the load is cancelled. */
     void loadSampleAsync (int playerId, const juce::File& file, std::function<void (bool, juce::String)> onComplete);
     /** Sets the MIDI range for a player. */
     bool setMidiRange (int playerId, int low, int high);
     /** Sets the gain for a player. */
     bool setGain (int playerId, float gain);
+    /** Sets the polyphony for a player. */
+    bool setPolyphony (int playerId, int voices);
+    /** Sets the voice steal mode for a player. */
+    bool setVoiceStealMode (int playerId, SuperSamplePlayer::VoiceStealMode mode);
+    /** Sets the choke group for a player. */
+    bool setChokeGroup (int playerId, int group);
+    /** Sets key tracking, root note and fine tune for a player. */
+    bool setPitch (int playerId, bool keyTracking, int rootNote, int fineTuneCents);
+    /** Sets a player's own sample format. Returns false if the player does not exist. */
+    bool setSampleFormat (int playerId, std::optional<SampleFormat> format);
+    /** Stops every player in the group except those that accept the note, which are about to play it. */
+    void chokeGroupForNote (int group, int midiNote) noexcept;
     /** Triggers a player by id. */
     bool trigger (int playerId);
     /** Returns the waveform SVG for a player. */
@@ -180,8 +260,14 @@ private:
     juce::ValueTree exportToValueTree() const;
     /** Restores sampler state from a ValueTree. */
     void importFromValueTree (const juce::ValueTree& tree);
-    /** Loads a sample synchronously into a player. */
-    bool loadSampleInternal (int playerId, const juce::File& file, juce::String& error);
+    /** Loads a sample synchronously into a player. When job is given the decode stops early if it is cancelled. */
+    bool loadSampleInternal (int playerId, const juce::File& file, juce::String& error, SampleLoader::Job* job = nullptr);
+    /** Publishes a fully built sample to a player, giving it read-ahead streams of its own when the
+     *  sample streams. */
+    bool installSample (int playerId,
+                        const juce::File& file,
+                        std::shared_ptr<const SampleData> data,
+                        juce::String& error);
     /** Returns the player matching an id, or null. */
     SuperSamplePlayer* getPlayer (int playerId) const;
     /** Builds the integrated file-browser UI. */
@@ -201,11 +287,26 @@ private:
     /** Stops the preview player immediately. */
     void stopPreviewPlayback();
 
-    /** Owned sample players for normal sampler playback. */
-    std::vector<std::unique_ptr<SuperSamplePlayer>> players;
+    /** Read-ahead thread shared with every other sampler. Declared before the players, which make streams from it. */
+    juce::SharedResourcePointer<SampleStreamer> streamer;
+    /** Decode threads shared with every other sampler. */
+    juce::SharedResourcePointer<SampleLoader> loader;
+    /** Decoded samples shared with every other sampler. */
+    juce::SharedResourcePointer<SampleCache> sampleCache;
+    /** The latest load queued for each player, -1 being the preview, so a newer one can cancel it. */
+    std::map<int, std::shared_ptr<SampleLoader::Job>> loadJobs;
+    /** Protects loadJobs. */
+    std::mutex loadJobsMutex;
+    /** Sample players for normal sampler playback. Guarded by playerMutex. */
+    std::vector<std::shared_ptr<SuperSamplePlayer>> players;
     /** Hidden player used for browser preview playback. */
     std::unique_ptr<SuperSamplePlayer> previewPlayer;
-    /** Protects player state shared between UI and audio threads. */
+    /** Hands rebuilt player sets to the render. */
+    SnapshotExchange<PlayerSet> playerSetExchange;
+    /** The player set being rendered. Audio thread only. */
+    std::unique_ptr<PlayerSet> renderSet;
+    /** Serialises the UI, web and loader threads over the players and browser state. The render
+     *  never takes it; it reads only what publishPlayerSet and the players publish. */
     mutable std::mutex playerMutex;
     /** Next player id to allocate. */
     int nextId { 1 };
@@ -240,6 +341,16 @@ private:
     double currentOutputSampleRate { 44100.0 };
     /** Last block size seen in prepareToPlay. */
     int currentBlockSize { 512 };
+    /** Samples longer than this many seconds stream from disk; 0 keeps them all resident. */
+    std::atomic<float> streamThresholdSeconds { 30.0f };
+    /** Interpolation given to every player. Guarded by playerMutex. */
+    ResampleQuality resampleQuality { ResampleQuality::cubic };
+    /** True when loads build mip levels for resident samples. */
+    std::atomic<bool> mipLevelsEnabled { true };
+    /** True when loads map uncompressed files rather than decoding them. */
+    std::atomic<bool> memoryMappingEnabled { false };
+    /** Format samples are kept in for players without one of their own. */
+    std::atomic<SampleFormat> defaultSampleFormat { SampleFormat::float32 };
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SuperSamplerProcessor)
@@ -3,10 +3,12 @@
 
 TrackerController::TrackerController( Sequencer* _sequencer, 
                                         ClockAbs* _clockAbs, 
-                                        SequencerEditor* _seqEditor)
+                                        SequencerEditor* _seqEditor,
+                                        ProjectHost* _projectHost)
                                         : sequencer{_sequencer},
                                         clock{_clockAbs}, 
-                                        seqEditor{_seqEditor}
+                                        seqEditor{_seqEditor},
+                                        projectHost{_projectHost}
 {
 
 }
@@ -76,15 +78,22 @@ void TrackerController::setBPM(unsigned int bpm)
 {
     clock->setBPM(bpm);    
 }
-void TrackerController::loadTrack(const std::string& fname)
+bool TrackerController::loadTrack(const std::string& fname)
 {
-    juce::ignoreUnused(fname);
-
+    if (projectHost == nullptr || fname.empty())
+        return false;
+    return projectHost->loadProjectFile(fname);
 }
-void TrackerController::saveTrack(const std::string& fname)
+bool TrackerController::saveTrack(const std::string& fname)
 {
-    juce::ignoreUnused(fname);
-
+    if (projectHost == nullptr || fname.empty())
+        return false;
+    return projectHost->saveProjectFile(fname);
+}
+void TrackerController::setAutosave(const std::string& fname, int intervalSeconds)
+{
+    if (projectHost != nullptr)
+        projectHost->setProjectAutosave(fname, intervalSeconds);
 }
 
 void TrackerController::incrementBPM()
@@ -5,11 +5,24 @@
 #include "ClockAbs.h"
 #include "MachineUtilsAbs.h"
 
+/** Interface for saving and loading whole projects, implemented by the processor. */
+class ProjectHost
+{
+public:
+    virtual ~ProjectHost() = default;
+    /** Writes the whole project to the file. Returns false if it could not be written. */
+    virtual bool saveProjectFile(const std::string& path) = 0;
+    /** Replaces the project with the file's. Samples finish loading in the background. */
+    virtual bool loadProjectFile(const std::string& path) = 0;
+    /** Saves what changed to the file every intervalSeconds. An empty path or 0 turns it off. */
+    virtual void setProjectAutosave(const std::string& path, int intervalSeconds) = 0;
+};
+
 /** This class provides high level control over the tracker. Includes 'sequencer-level' things  */
 class TrackerController{
   public:
     /** Creates a high-level controller for the shared tracker state. */
-    TrackerController( Sequencer* _sequencer, ClockAbs* _clockAbs, SequencerEditor* _seqEditor);
+    TrackerController( Sequencer* _sequencer, ClockAbs* _clockAbs, SequencerEditor* _seqEditor, ProjectHost* _projectHost = nullptr);
 /** Returns tracker controls and status information as a grid of strings. */
     std::vector<std::vector<std::string>> getControlPanelAsGridOfStrings();
 /** Stops tracker playback. */
@@ -23,10 +36,12 @@ class TrackerController{
     /** Decrements the global tempo by one BPM. */
     void decrementBPM();
     
-    /** Loads tracker state from disk. */
-    void loadTrack(const std::string& fname);
-    /** Saves tracker state to disk. */
-    void saveTrack(const std::string& fname);
+    /** Loads tracker state from disk. Returns false if the file could not be read. */
+    bool loadTrack(const std::string& fname);
+    /** Saves tracker state to disk. Returns false if the file could not be written. */
+    bool saveTrack(const std::string& fname);
+    /** Autosaves changes to the file every intervalSeconds, or stops autosaving for 0. */
+    void setAutosave(const std::string& fname, int intervalSeconds);
   private:
     /** Owned sequencer model controlled by this wrapper. */
     Sequencer* sequencer; 
@@ -34,5 +49,7 @@ class TrackerController{
     ClockAbs* clock;
     /** Shared editor state that reflects controller actions. */
     SequencerEditor* seqEditor;
+    /** Project persistence, or nullptr if this controller cannot save. */
+    ProjectHost* projectHost;
     // SequencerEditor* seqEditor; 
 };
@@ -10,6 +10,7 @@
 #include "TrackerMainProcessor.h"
 #include "TrackerMainUI.h"
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 
 namespace
@@ -22,6 +23,21 @@ constexpr const char* zoomInAddress = "/zoom_in";
 constexpr const char* zoomOutAddress = "/zoom_out";
 constexpr const char* incrementAddress = "/increment";
 constexpr const char* decrementAddress = "/decrement";
+constexpr std::uint32_t kArpSeedBase = 0x41525031u;
+constexpr std::uint32_t kPolyArpSeedBase = 0x50415250u;
+constexpr int kMidiClocksPerGridTick = 3; // 24 ppqn over 8 grid ticks per quarter
+// second order delay-locked loop gains for a bandwidth of 2% of the pulse rate
+constexpr double kMidiClockLoopOmega = 2.0 * 3.14159265358979323846 * 0.02;
+constexpr double kMidiClockLoopB = 1.4142135623730951 * kMidiClockLoopOmega;
+constexpr double kMidiClockLoopC = kMidiClockLoopOmega * kMidiClockLoopOmega;
+// the loop settles to well inside this, so a steady clock stops retuning the engine
+constexpr double kMidiClockTempoToleranceBpm = 0.01;
+
+bool isMidiClockSyncMessage(const juce::MidiMessage& message)
+{
+    return message.isMidiClock() || message.isMidiStart() || message.isMidiStop()
+        || message.isMidiContinue() || message.isSongPositionPointer();
+}
 std::string formatMidiNoteLabel(unsigned short note)
 {
     const std::size_t noteIndex = static_cast<std::size_t>(note % 12);
@@ -33,9 +49,43 @@ std::string formatMidiNoteLabel(unsigned short note)
     return disp;
 }
 
-double getSecondsPerTickFromBpm(double bpm)
+double getSecondsPerTickFromBpm(double bpm, int ticksPerQuarter)
+{
+    return (60.0 / (bpm > 0.0 ? bpm : 120.0)) / static_cast<double>(ticksPerQuarter);
+}
+
+/** decode saved step rows, padding or trimming each row to the current column count */
+std::vector<std::vector<double>> stepRowsFromVar(const juce::var& dataVar)
 {
-    return bpm > 0.0 ? (60.0 / bpm) / 8.0 : (60.0 / 120.0) / 8.0;
+    std::vector<std::vector<double>> data;
+    if (!dataVar.isArray())
+        return data;
+    for (const auto& rowVar : *dataVar.getArray())
+    {
+        std::vector<double> row;
+        if (rowVar.isArray())
+        {
+            for (const auto& val : *rowVar.getArray())
+                row.push_back(static_cast<double>(val));
+        }
+        if (!row.empty())
+        {
+            if (row.size() == Step::maxInd + 2)
+            {
+                std::vector<double> remapped = { row[Step::cmdInd], row[2], row[3], row[4], row[5] };
+                data.push_back(std::move(remapped));
+            }
+            else
+            {
+                if (row.size() < Step::maxInd + 1)
+                    row.resize(Step::maxInd + 1, 0.0);
+                if (row.size() > Step::maxInd + 1)
+                    row.resize(Step::maxInd + 1);
+                data.push_back(std::move(row));
+            }
+        }
+    }
+    return data;
 }
 
 bool isAudioSourceType(CommandType type)
@@ -52,6 +102,12 @@ bool isAudioEffectType(CommandType type)
         || type == CommandType::AuxSend2Fx;
 }
 
+/** relative project paths are taken from the working directory */
+juce::File resolveProjectPath(const std::string& path)
+{
+    return juce::File::getCurrentWorkingDirectory().getChildFile(juce::String(path));
+}
+
 float gainDbToLinear(float gainDb)
 {
     return std::pow(10.0f, gainDb / 20.0f);
@@ -91,6 +147,21 @@ float linearToMeterNormalised(float linearLevel)
     return juce::jlimit(0.0f, 1.0f, (db + 48.0f) / 48.0f);
 }
 
+/** true if the position lands in [blockStart, blockEnd) on the wrapping elapsed sample clock */
+bool isSampleInBlock(int position, int blockStart, int blockEnd)
+{
+    if (blockEnd < blockStart)
+        return position >= blockStart || position < blockEnd;
+    return position >= blockStart && position < blockEnd;
+}
+
+/** the earlier of two positions on the wrapping elapsed sample clock */
+int earlierSample(int a, int b, int horizon)
+{
+    const int bAheadOfA = ((b - a) % horizon + horizon) % horizon;
+    return bAheadOfA <= horizon / 2 ? a : b;
+}
+
 }
 
 void TrackerMainProcessor::enqueueMachineMidi(juce::MidiBuffer& targetBuffer,
@@ -108,9 +179,16 @@ void TrackerMainProcessor::enqueueMachineMidi(juce::MidiBuffer& targetBuffer,
 
     // DBG("q-ing midi: delta since last note on " << samplesSinceLast << " on at " << onSample << " off at " << offSample);
     
+    // a retrigger ends the sounding note first, so its stale note-off cannot cut the new one short
+    const std::size_t channelIndex = static_cast<std::size_t>(channel > 0 ? channel - 1 : 0);
+    if (activeMidiNotes.isActive(channelIndex, outNote))
+    {
+        const int previousOff = earlierSample(activeMidiNotes.getOffSample(channelIndex, outNote), onSample, maxHorizon);
+        targetBuffer.addEvent(MidiMessage::noteOff((int)channel, (int)outNote), previousOff);
+    }
     targetBuffer.addEvent(MidiMessage::noteOn((int)channel, (int)outNote, (uint8)outVelocity), onSample);
-    targetBuffer.addEvent(MidiMessage::noteOff((int)channel, (int)outNote, (uint8)outVelocity), offSample);
-    outstandingNoteOffs++;
+    // the note-off waits in the table until flushDueNoteOffs, so stop and mute can pull it forward
+    activeMidiNotes.noteOn(channelIndex, outNote, offSample % maxHorizon);
 }
 
 TrackerMainProcessor::MachineStack::SlotState TrackerMainProcessor::makeDefaultSlotState(CommandType type)
@@ -197,14 +275,8 @@ bool TrackerMainProcessor::isStackAssigned(std::size_t stackIndex)
 
     for (std::size_t seq = 0; seq < playbackSequencer->howManySequences(); ++seq)
     {
-        const auto* sequence = playbackSequencer->getSequence(seq);
-        if (sequence == nullptr)
-            continue;
-
-        if (sequence->isMuted())
-            continue;
-
-        if (static_cast<std::size_t>(sequence->getMachineId()) == stackIndex)
+        std::size_t machineId = 0;
+        if (playbackSequencer->getPlayingMachineId(seq, machineId) && machineId == stackIndex)
             return true;
     }
 
@@ -252,6 +324,11 @@ void TrackerMainProcessor::resetSongState()
 {
     sequenceSets.clear();
     sequenceSets.push_back(createDefaultSequenceSet());
+    resetSongTransport();
+}
+
+void TrackerMainProcessor::resetSongTransport()
+{
     songRows.clear();
     songRows.push_back({ 0, 16 });
     songPlayMode = SongPlayMode::sequence;
@@ -305,7 +382,7 @@ void TrackerMainProcessor::bindViewedSequenceSetToEditor()
     if (auto* viewedSequencer = getViewedSequencerInternal())
     {
         seqEditor.setSequencer(viewedSequencer);
-        trackerController = TrackerController{viewedSequencer, this, &seqEditor};
+        trackerController = TrackerController{viewedSequencer, this, &seqEditor, this};
 
         const auto maxSeq = juce::jmax<int>(0, static_cast<int>(viewedSequencer->howManySequences()) - 1);
         seqEditor.setCurrentSequence(juce::jlimit(0, maxSeq, static_cast<int>(seqEditor.getCurrentSequence())));
@@ -319,22 +396,78 @@ void TrackerMainProcessor::schedulePlaybackSequenceSetSwitch(std::size_t index)
 {
     if (sequenceSets.empty())
         return;
-    const auto safeIndex = std::min(index, sequenceSets.size() - 1);
-    pendingPlaybackSequenceSetIndex = safeIndex;
-    primeSequenceSetForTransportStart(safeIndex);
+    pendingPlaybackSequenceSetIndex = std::min(index, sequenceSets.size() - 1);
 }
 
-void TrackerMainProcessor::primeSequenceSetForTransportStart(std::size_t index)
+void TrackerMainProcessor::resolveSongRowPatterns(std::size_t row)
 {
-    if (sequenceSets.empty())
+    if (row >= songRows.size() || sequenceSets.empty())
+        return;
+    const auto& songRow = songRows[row];
+    const auto rowSetIndex = std::min(songRow.sequenceSetId, sequenceSets.size() - 1);
+    auto* rowSequencer = sequenceSets[rowSetIndex].get();
+    if (rowSequencer == nullptr)
+        return;
+
+    // a set can appear in several rows with different references, so start clean each time.
+    // Leave the playing set alone unless it is the one being retargeted: it keeps its sources until the switch
+    for (std::size_t setIndex = 0; setIndex < sequenceSets.size(); ++setIndex)
+        if (sequenceSets[setIndex] != nullptr && (setIndex == rowSetIndex || setIndex != activePlaybackSequenceSetIndex))
+            sequenceSets[setIndex]->clearSequenceSources();
+
+    const std::size_t trackCount = std::min(songRow.trackPatterns.size(), rowSequencer->howManySequences());
+    for (std::size_t track = 0; track < trackCount; ++track)
+    {
+        const int setId = songRow.trackPatterns[track];
+        if (setId < 0 || static_cast<std::size_t>(setId) >= sequenceSets.size()
+            || static_cast<std::size_t>(setId) == songRow.sequenceSetId)
+            continue;
+        auto* sourceSequencer = sequenceSets[static_cast<std::size_t>(setId)].get();
+        if (sourceSequencer != nullptr && track < sourceSequencer->howManySequences())
+            rowSequencer->setSequenceSource(track, sourceSequencer, track);
+    }
+}
+
+void TrackerMainProcessor::scheduleSongRowPlayback(std::size_t row)
+{
+    if (row >= songRows.size())
         return;
-    const auto safeIndex = std::min(index, sequenceSets.size() - 1);
-    if (safeIndex == activePlaybackSequenceSetIndex)
+    // the row's references are resolved when the switch lands, so the playing set is not retargeted early
+    schedulePlaybackSequenceSetSwitch(songRows[row].sequenceSetId);
+    primeSongRowForTransportStart(row);
+}
+
+void TrackerMainProcessor::primeSongRowForTransportStart(std::size_t row)
+{
+    if (row >= songRows.size() || sequenceSets.empty())
         return;
-    if (auto* pendingSequencer = sequenceSets[safeIndex].get())
+    const auto& songRow = songRows[row];
+    const auto rowSetIndex = std::min(songRow.sequenceSetId, sequenceSets.size() - 1);
+    const auto* playbackSequencer = getPlaybackSequencerInternal();
+    if (rowSetIndex != activePlaybackSequenceSetIndex)
+    {
+        if (auto* pendingSequencer = sequenceSets[rowSetIndex].get())
+        {
+            // sources left from an earlier row could point at sequences playing now. The switch resolves new ones
+            pendingSequencer->stop();
+            pendingSequencer->clearSequenceSources();
+            pendingSequencer->resetForTransportStart();
+        }
+    }
+
+    // referenced patterns live in other sets. Any still sounding in this row get reset by the switch instead
+    for (std::size_t track = 0; track < songRow.trackPatterns.size(); ++track)
     {
-        pendingSequencer->stop();
-        pendingSequencer->resetForTransportStart();
+        const int setId = songRow.trackPatterns[track];
+        if (setId < 0 || static_cast<std::size_t>(setId) >= sequenceSets.size()
+            || static_cast<std::size_t>(setId) == rowSetIndex)
+            continue;
+        auto* sourceSequencer = sequenceSets[static_cast<std::size_t>(setId)].get();
+        if (sourceSequencer == nullptr || track >= sourceSequencer->howManySequences())
+            continue;
+        if (playbackSequencer != nullptr && playbackSequencer->playsSequence(*sourceSequencer, track))
+            continue;
+        sourceSequencer->resetSequenceForTransportStart(track);
     }
 }
 
@@ -381,6 +514,9 @@ void TrackerMainProcessor::applyPendingSequenceSetSwitchForCurrentQuarterBeat()
     if (!pendingPlaybackSequenceSetIndex.has_value() || ((getCurrentQuarterBeat() - 1) % 4) != 0)
         return;
 
+    // every pending switch comes from scheduleSongRowPlayback(currentSongRow)
+    if (currentSongRow < songRows.size() && songRows[currentSongRow].sequenceSetId == *pendingPlaybackSequenceSetIndex)
+        resolveSongRowPatterns(currentSongRow);
     switchPlaybackSequenceSetImmediately(*pendingPlaybackSequenceSetIndex, true);
 }
 
@@ -416,7 +552,7 @@ void TrackerMainProcessor::handleSongBeatBoundary()
     if (currentSongRowBeatCounter <= 0)
     {
         currentSongRowBeatCounter = juce::jmax(1, songRows[currentSongRow].beatCount);
-        primeSequenceSetForTransportStart(songRows[(currentSongRow + 1) % songRows.size()].sequenceSetId);
+        primeSongRowForTransportStart((currentSongRow + 1) % songRows.size());
     }
 
     if (currentSongRowBeatCounter <= 0)
@@ -427,18 +563,18 @@ void TrackerMainProcessor::handleSongBeatBoundary()
     if (currentSongRowBeatCounter > 0)
     {
         if (currentSongRowBeatCounter == 1 && songRows.size() > 1)
-            primeSequenceSetForTransportStart(songRows[(currentSongRow + 1) % songRows.size()].sequenceSetId);
+            primeSongRowForTransportStart((currentSongRow + 1) % songRows.size());
         return;
     }
 
     currentSongRow = (currentSongRow + 1) % songRows.size();
     selectedSongRow = currentSongRow;
     currentSongRowBeatCounter = juce::jmax(1, songRows[currentSongRow].beatCount);
-    schedulePlaybackSequenceSetSwitch(songRows[currentSongRow].sequenceSetId);
+    scheduleSongRowPlayback(currentSongRow);
     applyPendingSequenceSetSwitchForCurrentQuarterBeat();
 
     if (songRows.size() > 1)
-        primeSequenceSetForTransportStart(songRows[(currentSongRow + 1) % songRows.size()].sequenceSetId);
+        primeSongRowForTransportStart((currentSongRow + 1) % songRows.size());
 }
 
 bool TrackerMainProcessor::stackContainsType(std::size_t stackIndex, CommandType machineType) const
@@ -479,12 +615,86 @@ void TrackerMainProcessor::allNotesOffForStack(std::size_t stackIndex)
             stack->wavetableSynth->allNotesOff();
         if (stack->delayFx != nullptr)
             stack->delayFx->allNotesOff();
-        samplerEventsToSend.push_back({ stackIndex, MidiMessage::allNotesOff(1), elapsedSamples });
-        midiToSend.addEvent(MidiMessage::allNotesOff(getStackMidiOutputChannel(stackIndex)), elapsedSamples);
+        releaseSamplerNotes(stackIndex);
+        releaseMidiChannelNotes(getStackMidiOutputChannel(stackIndex));
         stack->arpeggiatorClockActive = false;
     }
 }
 
+void TrackerMainProcessor::releaseSamplerNotes(std::size_t stackIndex)
+{
+    activeSamplerNotes.releaseChannel(stackIndex, [this](std::size_t stack, int note, int)
+    {
+        samplerEventsToSend.push_back({ stack, MidiMessage::noteOff(1, note), elapsedSamples });
+    });
+}
+
+void TrackerMainProcessor::releaseMidiChannelNotes(int channel)
+{
+    if (channel < 1 || channel > 16)
+        return;
+    activeMidiNotes.releaseChannel(static_cast<std::size_t>(channel - 1), [this, channel](std::size_t, int note, int)
+    {
+        midiToSend.addEvent(MidiMessage::noteOff(channel, note), elapsedSamples);
+    });
+}
+
+void TrackerMainProcessor::releaseNotesOfIdleStacks()
+{
+    std::bitset<kMachineStackCount> liveStacks;
+    if (auto* playbackSequencer = getPlaybackSequencerInternal())
+    {
+        // ask what each track last played, so song rows that reference another set's track count that track
+        for (std::size_t seq = 0; seq < playbackSequencer->howManySequences(); ++seq)
+        {
+            std::size_t stackIndex = 0;
+            if (playbackSequencer->getPlayingMachineId(seq, stackIndex) && stackIndex < liveStacks.size())
+                liveStacks.set(stackIndex);
+        }
+    }
+    if (liveStacks == stacksWithLiveSequences)
+        return;
+
+    // another live stack may still be playing on the same MIDI channel
+    std::bitset<ActiveNoteTable::kChannelCount> liveChannels;
+    for (std::size_t i = 0; i < machineStacks.size() && i < liveStacks.size(); ++i)
+        if (liveStacks.test(i))
+            liveChannels.set(static_cast<std::size_t>(getStackMidiOutputChannel(i) - 1));
+
+    for (std::size_t i = 0; i < machineStacks.size() && i < liveStacks.size(); ++i)
+    {
+        if (!stacksWithLiveSequences.test(i) || liveStacks.test(i))
+            continue;
+        releaseSamplerNotes(i);
+        const int channel = getStackMidiOutputChannel(i);
+        if (!liveChannels.test(static_cast<std::size_t>(channel - 1)))
+            releaseMidiChannelNotes(channel);
+    }
+    stacksWithLiveSequences = liveStacks;
+}
+
+void TrackerMainProcessor::flushDueNoteOffs(juce::MidiBuffer& midiMessages, int blockStartSample, int blockEndSample)
+{
+    const auto isDue = [blockStartSample, blockEndSample](int offSample)
+    {
+        return isSampleInBlock(offSample, blockStartSample, blockEndSample);
+    };
+    const auto offsetInBlock = [this, blockStartSample](int offSample)
+    {
+        return ((offSample - blockStartSample) % maxHorizon + maxHorizon) % maxHorizon;
+    };
+    // these land after any same-sample note-on already in the buffers, so zero length notes still end
+    activeMidiNotes.releaseDue(isDue, [&midiMessages, &offsetInBlock](std::size_t channel, int note, int offSample)
+    {
+        midiMessages.addEvent(MidiMessage::noteOff(static_cast<int>(channel) + 1, note), offsetInBlock(offSample));
+    });
+    activeSamplerNotes.releaseDue(isDue, [this, &offsetInBlock](std::size_t stackIndex, int note, int offSample)
+    {
+        if (stackIndex < machineStacks.size())
+            machineStacks[stackIndex].samplerMidiBuffer.addEvent(MidiMessage::noteOff(1, note), offsetInBlock(offSample));
+    });
+}
+
 void TrackerMainProcessor::enqueueStackSamplerMidi(std::size_t stackIndex,
                                                    unsigned short outNote,
                                                    unsigned short outVelocity,
@@ -493,8 +703,137 @@ void TrackerMainProcessor::enqueueStackSamplerMidi(std::size_t stackIndex,
     const int samplesPerTickInt = static_cast<int>(samplesPerTick);
     const int offsetSamples = (samplesPerTickInt * static_cast<int>(outDurTicks)) % maxHorizon;
     const int offSample = elapsedSamples + offsetSamples;
+    if (activeSamplerNotes.isActive(stackIndex, outNote))
+    {
+        const int previousOff = earlierSample(activeSamplerNotes.getOffSample(stackIndex, outNote), elapsedSamples, maxHorizon);
+        samplerEventsToSend.push_back({ stackIndex, MidiMessage::noteOff(1, static_cast<int>(outNote)), previousOff });
+    }
     samplerEventsToSend.push_back({ stackIndex, MidiMessage::noteOn(1, static_cast<int>(outNote), static_cast<uint8>(outVelocity)), elapsedSamples });
-    samplerEventsToSend.push_back({ stackIndex, MidiMessage::noteOff(1, static_cast<int>(outNote), static_cast<uint8>(outVelocity)), offSample });
+    activeSamplerNotes.noteOn(stackIndex, outNote, offSample % maxHorizon);
+}
+
+void TrackerMainProcessor::collectBlockParameterLocks(int blockStartSample, int blockEndSample)
+{
+    blockParameterLockCount = 0;
+    int kept = 0;
+    for (int i = 0; i < parameterLockCount; ++i)
+    {
+        const auto& event = parameterLockQueue[static_cast<std::size_t>(i)];
+        if (!isSampleInBlock(event.samplePosition, blockStartSample, blockEndSample))
+        {
+            parameterLockQueue[static_cast<std::size_t>(kept++)] = event;
+            continue;
+        }
+        ParameterLockEvent inBlock = event;
+        inBlock.samplePosition = ((event.samplePosition - blockStartSample) % maxHorizon + maxHorizon) % maxHorizon;
+        // insertion sort that keeps queue order for events on the same sample
+        int insertAt = blockParameterLockCount;
+        while (insertAt > 0 && blockParameterLocks[static_cast<std::size_t>(insertAt - 1)].samplePosition > inBlock.samplePosition)
+        {
+            blockParameterLocks[static_cast<std::size_t>(insertAt)] = blockParameterLocks[static_cast<std::size_t>(insertAt - 1)];
+            --insertAt;
+        }
+        blockParameterLocks[static_cast<std::size_t>(insertAt)] = inBlock;
+        ++blockParameterLockCount;
+    }
+    parameterLockCount = kept;
+}
+
+void TrackerMainProcessor::applyParameterLock(const ParameterLockEvent& event)
+{
+    auto* stack = getMachineStack(event.stackIndex);
+    if (stack == nullptr)
+        return;
+    auto* machine = getMachineForStackType(*stack, event.machineType);
+    if (machine == nullptr)
+        return;
+    if (event.value < 0.0f)
+        machine->clearParameterLock(event.parameterId);
+    else
+        machine->setParameterLock(event.parameterId, event.value);
+}
+
+void TrackerMainProcessor::clearParameterLocks()
+{
+    parameterLockCount = 0;
+    blockParameterLockCount = 0;
+    for (auto& stack : machineStacks)
+    {
+        for (const auto& slot : stack.slots)
+        {
+            if (isAuxSendType(slot.type))
+                continue;
+            if (auto* machine = getMachineForStackType(stack, slot.type))
+                for (int parameterId = 0; parameterId < machine->getLockableParameterCount(); ++parameterId)
+                    machine->clearParameterLock(parameterId);
+        }
+    }
+}
+
+void TrackerMainProcessor::renderStackSegment(MachineStack& stack, int startSample, int numSamples)
+{
+    // views onto the stack's buffers, so locks can change parameters part way through the block without copying
+    const int numChannels = stack.renderBuffer.getNumChannels();
+    juce::AudioBuffer<float> stackBuffer(stack.renderBuffer.getArrayOfWritePointers(), numChannels, startSample, numSamples);
+
+    if (stack.wavetableProcessingActive && stack.wavetableSynth != nullptr)
+        stack.wavetableSynth->processBlock(stackBuffer, emptyMidiBuffer);
+
+    for (const auto& slot : stack.slots)
+    {
+        const auto type = slot.type;
+        if (!isAudioEffectType(type))
+            continue;
+
+        const bool slotEnabled = slot.enabled;
+
+        if (isAuxSendType(type))
+        {
+            if (!slotEnabled)
+                continue;
+
+            auto* auxBus = getAuxBusForType(type);
+            if (auxBus == nullptr
+                || auxBus->inputBuffer.getNumChannels() < numChannels
+                || auxBus->inputBuffer.getNumSamples() != stack.renderBuffer.getNumSamples())
+            {
+                continue;
+            }
+
+            const float sendGainLinear = gainDbToLinear(slot.sendLevelDb);
+            for (int channel = 0; channel < numChannels; ++channel)
+                auxBus->inputBuffer.addFrom(channel, startSample, stackBuffer, channel, 0, numSamples, sendGainLinear);
+            continue;
+        }
+
+        const float returnGainLinear = gainDbToLinear(slot.returnLevelDb);
+        if (auto* effect = getAudioEffectForStackType(stack, type))
+        {
+            if (!slotEnabled && type == CommandType::DelayFx)
+            {
+                juce::AudioBuffer<float> delayTailBuffer(stack.delayTailBuffer.getArrayOfWritePointers(), numChannels, startSample, numSamples);
+                delayTailBuffer.clear();
+                effect->processAudioBuffer(delayTailBuffer);
+                if (returnGainLinear != 1.0f)
+                    delayTailBuffer.applyGain(returnGainLinear);
+                for (int channel = 0; channel < numChannels; ++channel)
+                    stackBuffer.addFrom(channel, 0, delayTailBuffer, channel, 0, numSamples);
+                continue;
+            }
+
+            if (!slotEnabled)
+                continue;
+
+            const float sendGainLinear = gainDbToLinear(slot.sendLevelDb);
+            if (sendGainLinear != 1.0f)
+                stackBuffer.applyGain(sendGainLinear);
+
+            effect->processAudioBuffer(stackBuffer);
+
+            if (returnGainLinear != 1.0f)
+                stackBuffer.applyGain(returnGainLinear);
+        }
+    }
 }
 
 void TrackerMainProcessor::dispatchNoteThroughStack(std::size_t stackIndex,
@@ -538,18 +877,19 @@ void TrackerMainProcessor::dispatchNoteThroughStack(std::size_t stackIndex,
                 anyTerminalTriggered = true;
                 break;
             case CommandType::Arpeggiator:
+                // arps hold their slot lengths in grid ticks
                 if (stack->arpeggiator != nullptr)
                 {
                     MachineNoteEvent outEvent;
-                    if (stack->arpeggiator->handleIncomingNote(note, velocity, durInTicks, outEvent))
-                        dispatchNoteThroughStack(stackIndex, outEvent.note, outEvent.velocity, outEvent.durationTicks, slotIndex + 1);
+                    if (stack->arpeggiator->handleIncomingNote(note, velocity, engineToGridTicks(durInTicks), outEvent))
+                        dispatchNoteThroughStack(stackIndex, outEvent.note, outEvent.velocity, gridToEngineTicks(outEvent.durationTicks), slotIndex + 1);
                 }
                 return;
             case CommandType::PolyArpeggiator:
                 if (stack->polyArpeggiator != nullptr)
                 {
                     MachineNoteEvent outEvent;
-                    stack->polyArpeggiator->handleIncomingNote(note, velocity, durInTicks, outEvent);
+                    stack->polyArpeggiator->handleIncomingNote(note, velocity, engineToGridTicks(durInTicks), outEvent);
                 }
                 return;
             case CommandType::Sampler:
@@ -689,17 +1029,32 @@ void TrackerMainProcessor::emitClockedMachineEvent(std::size_t stackIndex, Comma
     dispatchNoteThroughStack(stackIndex,
                              event.note,
                              event.velocity,
-                             event.durationTicks,
+                             gridToEngineTicks(event.durationTicks),
                              *slotIndex + 1);
 }
 
-void TrackerMainProcessor::processPlaybackTickBoundary()
+bool TrackerMainProcessor::processPlaybackTickBoundary()
 {
-    advanceClockTick();
-    emitQuarterBeatTickIfNeeded();
+    const int engineTickInGridTick = engineTicksIntoGridTick;
+    engineTicksIntoGridTick = (engineTicksIntoGridTick + 1) % getTicksPerGridTick();
+    // the song only moves on grid ticks; sequences and clocked machines move on every engine tick,
+    // after the grid tick's song and beat handling so a row change lands before its first step
+    const bool onGridTick = engineTickInGridTick == 0;
+    if (onGridTick)
+    {
+        holdUntilGridTick = false;
+        advanceClockTick();
+        emitQuarterBeatTickIfNeeded();
+    }
+    else
+    {
+        notifyClockEngineTick(engineTickInGridTick);
+    }
+    emitMidiClockForTick(engineTickInGridTick);
 
-    if (auto* playbackSequencer = getPlaybackSequencerInternal())
+    if (auto* playbackSequencer = getPlaybackSequencerInternal(); playbackSequencer != nullptr && !holdUntilGridTick)
         playbackSequencer->tick();
+    return onGridTick;
 }
 
 //==============================================================================
@@ -714,10 +1069,9 @@ TrackerMainProcessor::TrackerMainProcessor()
                      #endif
                        ),
                        seqEditor{nullptr},
-                       trackerController{nullptr, this, &seqEditor},
+                       trackerController{nullptr, this, &seqEditor, this},
                        elapsedSamples{0}, maxHorizon{44100 * 3600},
-                       samplesPerTick{44100/(120/60)/8}, bpm{120.0},
-                       outstandingNoteOffs{0},
+                       samplesPerTick{44100/(120/60)/ClockAbs::kGridTicksPerQuarter}, bpm{120.0},
                        apvts(*this, nullptr, "params", createParameterLayout())
 #endif
 {
@@ -739,10 +1093,29 @@ TrackerMainProcessor::TrackerMainProcessor()
 
     // put some test notes into the sequencer to see if they flow through
     initialiseOsc();
+
+    seqEditor.setArmedSequenceChangedHandler([this]()
+    {
+        const std::lock_guard<std::mutex> lock(liveMidiRecorderMutex);
+        liveMidiRecorderWake.notify_one();
+    });
+    liveMidiRecorderRunning.store(true, std::memory_order_release);
+    liveMidiRecorder = std::thread([this]() { runLiveMidiRecorder(); });
 }
 
 TrackerMainProcessor::~TrackerMainProcessor()
 {
+    projectAutosaverRunning.store(false, std::memory_order_release);
+    if (projectAutosaver.joinable())
+        projectAutosaver.join();
+    waitForProjectSampleLoader();
+    liveMidiRecorderRunning.store(false, std::memory_order_release);
+    {
+        const std::lock_guard<std::mutex> lock(liveMidiRecorderMutex);
+        liveMidiRecorderWake.notify_one();
+    }
+    if (liveMidiRecorder.joinable())
+        liveMidiRecorder.join();
     removeClockListeners();
     oscReceiver.removeListener(this);
     oscReceiver.disconnect();
@@ -840,11 +1213,14 @@ void TrackerMainProcessor::initialiseMachines()
     auxBus2.id = 2;
     auxBus1.machine = std::make_unique<AuxReverbMachine>(juce::Reverb::Parameters{ 0.72f, 0.35f, 0.28f, 0.0f, 1.0f, 0.0f });
     auxBus2.machine = std::make_unique<AuxReverbMachine>(juce::Reverb::Parameters{ 0.42f, 0.55f, 0.22f, 0.0f, 0.75f, 0.0f });
-    for (auto& stack : machineStacks)
+    for (std::size_t stackIndex = 0; stackIndex < machineStacks.size(); ++stackIndex)
     {
+        auto& stack = machineStacks[stackIndex];
         stack.sampler = std::make_unique<SuperSamplerProcessor>();
         stack.arpeggiator = std::make_unique<ArpeggiatorMachine>();
         stack.polyArpeggiator = std::make_unique<PolyArpeggiatorMachine>();
+        stack.arpeggiator->setRandomSeed(FastRandom::seedForIndex(kArpSeedBase, static_cast<std::uint32_t>(stackIndex)));
+        stack.polyArpeggiator->setRandomSeed(FastRandom::seedForIndex(kPolyArpSeedBase, static_cast<std::uint32_t>(stackIndex)));
         stack.wavetableSynth = std::make_unique<WavetableSynthMachine>();
         stack.distortionFx = std::make_unique<WaveshaperDistortionMachine>();
         stack.delayFx = std::make_unique<DelayFxMachine>();
@@ -864,13 +1240,14 @@ void TrackerMainProcessor::initialiseMachines()
     samplerEventsToSend.clear();
     scratchFutureSamplerEvents.clear();
 
-    const double secondsPerTick = getSecondsPerTickFromBpm(getBPM());
+    // note lengths arrive in engine ticks, delay sync counts grid ticks
+    const double secondsPerTick = getSecondsPerTickFromBpm(getBPM(), getTicksPerQuarter());
     for (auto& stack : machineStacks)
     {
         if (stack.wavetableSynth != nullptr)
             stack.wavetableSynth->setSecondsPerTick(secondsPerTick);
         if (stack.delayFx != nullptr)
-            stack.delayFx->setSecondsPerTick(secondsPerTick);
+            stack.delayFx->setSecondsPerTick(secondsPerTick * getTicksPerGridTick());
     }
     refreshAllStackProcessingStates();
     configureClockListeners();
@@ -879,6 +1256,7 @@ void TrackerMainProcessor::initialiseMachines()
 
 void TrackerMainProcessor::recreateSequencersAndMachines()
 {
+    waitForProjectSampleLoader();
     suspendProcessing(true);
     CommandProcessor::sendAllNotesOff();
     if (auto* playbackSequencer = getPlaybackSequencerInternal())
@@ -887,6 +1265,7 @@ void TrackerMainProcessor::recreateSequencersAndMachines()
     resetSongState();
     bindViewedSequenceSetToEditor();
     seqEditor.resetCursor();
+    seqEditor.clearUndoHistory();
     seqEditor.gotoSongPage();
     seqEditor.setMachineHost(this);
     seqEditor.setSongHost(this);
@@ -934,6 +1313,7 @@ void TrackerMainProcessor::oscMessageReceived(const juce::OSCMessage& message)
         return;
     DBG("OSC in: " << formatOscMessage(message));
     handleIncomingOscControlMessage(message);
+    markProjectChanged();
 }
 
 void TrackerMainProcessor::oscBundleReceived(const juce::OSCBundle& bundle)
@@ -1060,15 +1440,15 @@ void TrackerMainProcessor::handleIncomingOscControlMessage(const juce::OSCMessag
         if (steps <= 0)
             return;
 
-        withAudioThreadExclusive([&]()
+        // the whole burst is one edit that hands playback each changed pattern once. Pattern edits
+        // leave the audio thread alone; only other pages need it held
+        const int amount = address == incrementAddress ? steps : -steps;
+        withEditorLock([&]()
         {
-            for (int i = 0; i < steps; ++i)
-            {
-                if (address == incrementAddress)
-                    seqEditor.incrementAtCursor();
-                else
-                    seqEditor.decrementAtCursor();
-            }
+            if (seqEditor.editsOnlyPatterns())
+                seqEditor.adjustAtCursor(amount);
+            else
+                withAudioThreadExclusive([&]() { seqEditor.adjustAtCursor(amount); });
             if (auto* viewedSequencer = getViewedSequencerInternal())
                 viewedSequencer->requestStrUpdate();
         });
@@ -1102,8 +1482,8 @@ void TrackerMainProcessor::prepareToPlay (double sampleRate, int samplesPerBlock
 {
     const double activeSampleRate = sampleRate > 0.0 ? sampleRate : 44100.0;
     const double activeBpm = getBPM();
-    samplesPerTick = static_cast<unsigned int> (juce::jmax (1, static_cast<int> (std::lround (activeSampleRate * (60.0 / activeBpm) / 8.0))));
-    const double secondsPerTick = getSecondsPerTickFromBpm(activeBpm);
+    samplesPerTick = static_cast<unsigned int> (juce::jmax (1, static_cast<int> (std::lround (activeSampleRate * (60.0 / activeBpm) / getTicksPerQuarter()))));
+    const double secondsPerTick = getSecondsPerTickFromBpm(activeBpm, getTicksPerQuarter());
     const int preparedBlockSize = juce::jmax(1, samplesPerBlock);
     auxBus1.inputBuffer.setSize(2, preparedBlockSize);
     auxBus2.inputBuffer.setSize(2, preparedBlockSize);
@@ -1137,7 +1517,7 @@ void TrackerMainProcessor::prepareToPlay (double sampleRate, int samplesPerBlock
         if (stack.delayFx != nullptr)
         {
             stack.delayFx->prepareToPlay(sampleRate, samplesPerBlock);
-            stack.delayFx->setSecondsPerTick(secondsPerTick);
+            stack.delayFx->setSecondsPerTick(secondsPerTick * getTicksPerGridTick());
         }
         if (stack.channelStripFx != nullptr)
             stack.channelStripFx->prepareToPlay(sampleRate, samplesPerBlock);
@@ -1213,22 +1593,9 @@ void TrackerMainProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce:
     std::lock_guard<std::mutex> audioLock(audioMutex);
     juce::ScopedNoDenormals noDenormals;
     auto* playbackSequencer = getPlaybackSequencerInternal();
-    bool receivedMidi = false; 
-    for (const MidiMessageMetadata metadata : midiMessages){
-        if (metadata.getMessage().isNoteOn()) {
-            // DBG("Got a note " << metadata.getMessage().getNoteNumber());
-            // add a note to the current sequence 
-            // and move it on a step 
-
-            // get the armed sequence 
-
-            // seqEditor.enterStepData(metadata.getMessage().getNoteNumber(), Step::noteInd);
-            receivedMidi = true; 
-        }
-    }
-    if (receivedMidi) {
-        // tell the 
-    }
+    liveMidiCaptureFrom = 0;
+    liveMidiLastTickSample = 0.0;
+    blockSamplesPerTick = 0.0;
 
     emptyMidiBuffer.clear();
 
@@ -1269,20 +1636,14 @@ void TrackerMainProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce:
                     playbackSequencer->play();
                 setBPM(posInfo.bpm);
 
-                const double ticksPerQuarter = 8.0;
+                const double ticksPerQuarter = static_cast<double>(getTicksPerQuarter());
+                const int ticksPerGridTick = getTicksPerGridTick();
                 const double samplesPerTickDouble = getSampleRate() * (60.0 / posInfo.bpm) / ticksPerQuarter;
                 double tickPosition = posInfo.ppqPosition * ticksPerQuarter;
                 double tickPhase = std::fmod(tickPosition, 1.0);
                 if (tickPhase < 0.0)
                     tickPhase += 1.0;
 
-                if (!hostPpqValid || posInfo.ppqPosition < lastHostPpqPosition)
-                {
-                    // Transport restarted or jumped; re-sync tick phase from the new PPQ position.
-                    hostPpqValid = true;
-                }
-                lastHostPpqPosition = posInfo.ppqPosition;
-
                 const double phaseEpsilon = 1.0e-6;
                 long long tickIndex = static_cast<long long>(std::floor(tickPosition));
                 double sampleOffsetToNextTick = 0.0;
@@ -1291,12 +1652,26 @@ void TrackerMainProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce:
                     ++tickIndex;
                     sampleOffsetToNextTick = (1.0 - tickPhase) * samplesPerTickDouble;
                 }
+                if (!hostPpqValid || posInfo.ppqPosition < lastHostPpqPosition)
+                {
+                    // Transport restarted or jumped; land directly on the host position instead of waiting for a beat.
+                    hostPpqValid = true;
+                    const auto engineTick = static_cast<std::uint64_t>(juce::jmax(0LL, tickIndex));
+                    const auto perGridTick = static_cast<std::uint64_t>(ticksPerGridTick);
+                    seekToSongTick((engineTick + perGridTick - 1u) / perGridTick, static_cast<int>(engineTick % perGridTick));
+                }
+                lastHostPpqPosition = posInfo.ppqPosition;
+                blockSamplesPerTick = samplesPerTickDouble * ticksPerGridTick;
+                const int engineTicksSinceGridTick = (engineTicksIntoGridTick + ticksPerGridTick - 1) % ticksPerGridTick;
+                liveMidiLastTickSample = sampleOffsetToNextTick - samplesPerTickDouble * (1 + engineTicksSinceGridTick);
 
                 for (double offset = sampleOffsetToNextTick; offset < blockSizeSamples; offset += samplesPerTickDouble, ++tickIndex)
                 {
                     const int tickSampleOffset = static_cast<int>(offset);
+                    captureLiveMidi(midiMessages, blockStartSample, tickSampleOffset);
                     elapsedSamples = (blockStartSample + tickSampleOffset) % maxHorizon;
-                    processPlaybackTickBoundary();
+                    if (processPlaybackTickBoundary())
+                        liveMidiLastTickSample = offset;
                 }
                 elapsedSamples = blockEndSample;
             }
@@ -1313,29 +1688,45 @@ void TrackerMainProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce:
     {
         hostPpqValid = false;
         hostWasPlaying = false;
-        const int samplesPerTickInt = static_cast<int>(samplesPerTick);
-        int samplesAdvanced = 0;
-        while (samplesPerTickInt > 0)
+        const double activeSampleRate = getSampleRate() > 0.0 ? getSampleRate() : 44100.0;
+        const double exactSamplesPerTick = activeSampleRate * (60.0 / getBPM()) / getTicksPerQuarter();
+        const int ticksPerGridTick = getTicksPerGridTick();
+        blockSamplesPerTick = exactSamplesPerTick * ticksPerGridTick;
+        const int engineTicksSinceGridTick = (engineTicksIntoGridTick + ticksPerGridTick - 1) % ticksPerGridTick;
+        liveMidiLastTickSample = samplesUntilInternalTick - exactSamplesPerTick * (1 + engineTicksSinceGridTick);
+        const bool followMidiClock = midiClockSlaveEnabled.load(std::memory_order_relaxed);
+        if (followMidiClock)
+            runMidiClockSlaveBlock(midiMessages, blockStartSample, blockSizeSamples);
+        // at high resolutions a tick is only a couple of hundred samples, so rounding every tick
+        // would pull the tempo off; carry the fractional position across blocks instead
+        while (!followMidiClock && samplesUntilInternalTick < blockSizeSamples)
         {
-            const int remainder = elapsedSamples % samplesPerTickInt;
-            const int samplesUntilNextTick = remainder == 0
-                ? samplesPerTickInt
-                : (samplesPerTickInt - remainder);
-
-            if (samplesAdvanced + samplesUntilNextTick > blockSizeSamples)
-                break;
-
-            samplesAdvanced += samplesUntilNextTick;
-            elapsedSamples = (elapsedSamples + samplesUntilNextTick) % maxHorizon;
-            processPlaybackTickBoundary();
+            const int tickSampleOffset = static_cast<int>(samplesUntilInternalTick);
+            captureLiveMidi(midiMessages, blockStartSample, tickSampleOffset);
+            elapsedSamples = (blockStartSample + tickSampleOffset) % maxHorizon;
+            if (processPlaybackTickBoundary())
+                liveMidiLastTickSample = samplesUntilInternalTick;
+            samplesUntilInternalTick += exactSamplesPerTick;
         }
+        samplesUntilInternalTick = juce::jmax(0.0, samplesUntilInternalTick - blockSizeSamples);
         elapsedSamples = blockEndSample;
     }
+    captureLiveMidi(midiMessages, blockStartSample, blockSizeSamples);
+    totalSamplesProcessed += blockSizeSamples;
     hostClockActive.store(usingHostClock, std::memory_order_relaxed);
     const bool sequencerPlaying = playbackSequencer != nullptr && playbackSequencer->isPlaying();
     if (sequencerWasPlaying && !sequencerPlaying)
+    {
         allNotesOff();
+        if (midiClockOutputRunning)
+        {
+            midiToSend.addEvent(MidiMessage::midiStop(), blockStartSample);
+            midiClockOutputRunning = false;
+        }
+    }
     sequencerWasPlaying = sequencerPlaying;
+    // mutes, reassigned tracks and row switches leave notes sounding on stacks nothing plays any more
+    releaseNotesOfIdleStacks();
     // to get sample-accurate midi as opposed to block-accurate midi (!)
     // now add any midi that should have occurred within this block
     // to the outgoing midibuffer 
@@ -1356,7 +1747,6 @@ void TrackerMainProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce:
             else{// it is in the future            
                 futureMidi.addEvent(metadata.getMessage(),  metadata.samplePosition);
             }
-            if (metadata.getMessage().isNoteOff()) outstandingNoteOffs --;
         }
         if (blockStartSample < blockEndSample){
             // normal case where block start is before block end as no wrap has occurred. 
@@ -1374,8 +1764,6 @@ void TrackerMainProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce:
 
                 futureMidi.addEvent(metadata.getMessage(),  metadata.samplePosition);
             }
-            if (metadata.getMessage().isNoteOff()) outstandingNoteOffs --;
-
         }
     }
     midiToSend.clear();
@@ -1418,6 +1806,8 @@ void TrackerMainProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce:
         }
     }
     samplerEventsToSend.swap(scratchFutureSamplerEvents);
+    flushDueNoteOffs(midiMessages, blockStartSample, blockEndSample);
+    collectBlockParameterLocks(blockStartSample, blockEndSample);
 
     if (auxBus1.inputBuffer.getNumChannels() != 2 || auxBus1.inputBuffer.getNumSamples() != buffer.getNumSamples())
         auxBus1.inputBuffer.setSize(2, buffer.getNumSamples(), false, false, true);
@@ -1432,6 +1822,9 @@ void TrackerMainProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce:
         {
             if (!stack->audioProcessingActive)
             {
+                for (int e = 0; e < blockParameterLockCount; ++e)
+                    if (blockParameterLocks[static_cast<std::size_t>(e)].stackIndex == i)
+                        applyParameterLock(blockParameterLocks[static_cast<std::size_t>(e)]);
                 const float attack = 0.65f;
                 const float decay = 0.12f;
                 const float meterTarget = 0.0f;
@@ -1457,64 +1850,21 @@ void TrackerMainProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce:
 
             if (stack->samplerProcessingActive && stack->sampler != nullptr)
                 stack->sampler->processBlock(stackBuffer, stack->samplerMidiBuffer);
-            if (stack->wavetableProcessingActive && stack->wavetableSynth != nullptr)
-                stack->wavetableSynth->processBlock(stackBuffer, emptyMidiBuffer);
 
-            for (const auto& slot : stack->slots)
+            // split the rest of the chain wherever one of this stack's parameter locks lands
+            int segmentStart = 0;
+            for (int e = 0; e < blockParameterLockCount; ++e)
             {
-                const auto type = slot.type;
-                if (!isAudioEffectType(type))
-                    continue;
-
-                const bool slotEnabled = slot.enabled;
-
-                if (isAuxSendType(type))
-                {
-                    if (!slotEnabled)
-                        continue;
-
-                    auto* auxBus = getAuxBusForType(type);
-                    if (auxBus == nullptr
-                        || auxBus->inputBuffer.getNumChannels() < buffer.getNumChannels()
-                        || auxBus->inputBuffer.getNumSamples() != buffer.getNumSamples())
-                    {
-                        continue;
-                    }
-
-                    const float sendGainLinear = gainDbToLinear(slot.sendLevelDb);
-                    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
-                        auxBus->inputBuffer.addFrom(channel, 0, stackBuffer, channel, 0, stackBuffer.getNumSamples(), sendGainLinear);
+                const auto& lockEvent = blockParameterLocks[static_cast<std::size_t>(e)];
+                if (lockEvent.stackIndex != i)
                     continue;
-                }
-
-                const float returnGainLinear = gainDbToLinear(slot.returnLevelDb);
-                if (auto* effect = getAudioEffectForStackType(*stack, type))
-                {
-                    if (!slotEnabled && type == CommandType::DelayFx)
-                    {
-                        auto& delayTailBuffer = stack->delayTailBuffer;
-                        delayTailBuffer.clear();
-                        effect->processAudioBuffer(delayTailBuffer);
-                        if (returnGainLinear != 1.0f)
-                            delayTailBuffer.applyGain(returnGainLinear);
-                        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
-                            stackBuffer.addFrom(channel, 0, delayTailBuffer, channel, 0, delayTailBuffer.getNumSamples());
-                        continue;
-                    }
-
-                    if (!slotEnabled)
-                        continue;
-
-                    const float sendGainLinear = gainDbToLinear(slot.sendLevelDb);
-                    if (sendGainLinear != 1.0f)
-                        stackBuffer.applyGain(sendGainLinear);
-
-                    effect->processAudioBuffer(stackBuffer);
-
-                    if (returnGainLinear != 1.0f)
-                        stackBuffer.applyGain(returnGainLinear);
-                }
+                if (lockEvent.samplePosition > segmentStart)
+                    renderStackSegment(*stack, segmentStart, lockEvent.samplePosition - segmentStart);
+                applyParameterLock(lockEvent);
+                segmentStart = juce::jmax(segmentStart, lockEvent.samplePosition);
             }
+            if (segmentStart < stackBuffer.getNumSamples())
+                renderStackSegment(*stack, segmentStart, stackBuffer.getNumSamples() - segmentStart);
 
             const float stackGainLinear = gainDbToLinear(stack->gainDb);
             stackBuffer.applyGain(stackGainLinear);
@@ -1575,20 +1925,41 @@ juce::AudioProcessorValueTreeState::ParameterLayout TrackerMainProcessor::create
 
 void TrackerMainProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    withAudioThreadExclusive([&]()
-    {
-        const auto stateVar = serializeSequencerState();
-        const auto json = juce::JSON::toString(stateVar);
-        apvts.state.setProperty("json", json, nullptr);
-
-        juce::MemoryOutputStream stream(destData, true);
-        if (auto xml = apvts.copyState().createXml())
-            xml->writeTo(stream);
-    });
+    // the encoding works on the snapshot, so it runs after the audio thread is let go
+    const auto snapshot = takeProjectSnapshot();
+    juce::MemoryOutputStream stream(destData, false);
+    ProjectFormat::write(snapshot, stream);
 }
 
 void TrackerMainProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
+    if (sizeInBytes <= 0)
+        return;
+    // a project file still loading its samples would otherwise overwrite the samplers restored here
+    waitForProjectSampleLoader();
+
+    if (ProjectFormat::isProjectData(data, static_cast<std::size_t>(sizeInBytes)))
+    {
+        // decode and build the new sequence sets before taking the audio thread,
+        // so all it waits for is the swap into the live objects
+        ProjectSnapshot snapshot;
+        juce::MemoryInputStream input(data, static_cast<size_t>(sizeInBytes), false);
+        if (!ProjectFormat::read(input, snapshot))
+            return;
+        auto loadedSets = buildSequenceSets(snapshot);
+        withAudioThreadExclusive([&]()
+        {
+            applyProjectSnapshot(snapshot, loadedSets);
+        });
+        restoreMachineStates(snapshot);
+        // samplers decode their sample files while playing, so they load after the swap
+        restoreSamplerStates(snapshot);
+        markProjectChanged();
+        // loadedSets now holds the replaced sets, freed here rather than under the audio lock
+        return;
+    }
+
+    // sessions saved before the binary format: XML holding the JSON state
     withAudioThreadExclusive([&]()
     {
         juce::MemoryInputStream input(data, static_cast<size_t>(sizeInBytes), false);
@@ -1606,6 +1977,7 @@ void TrackerMainProcessor::setStateInformation (const void* data, int sizeInByte
             restoreSequencerState(parsed);
         }
     });
+    markProjectChanged();
 }
 
 juce::var TrackerMainProcessor::stringGridToVar(const std::vector<std::vector<std::string>>& grid)
@@ -1646,29 +2018,7 @@ juce::var TrackerMainProcessor::getUiState()
     state->setProperty("bpm", getBPM());
     state->setProperty("isPlaying", playbackSequencer != nullptr && playbackSequencer->isPlaying());
 
-    juce::String modeStr = "sequence";
-    switch (seqEditor.getEditMode())
-    {
-        case SequencerEditorMode::arrangingSong:
-            modeStr = "song";
-            break;
-        case SequencerEditorMode::selectingSeqAndStep:
-            modeStr = "sequence";
-            break;
-        case SequencerEditorMode::editingStep:
-            modeStr = "step";
-            break;
-        case SequencerEditorMode::configuringSequence:
-            modeStr = "config";
-            break;
-        case SequencerEditorMode::machineConfig:
-            modeStr = "machine";
-            break;
-        case SequencerEditorMode::resetConfirmation:
-            modeStr = "reset";
-            break;
-    }
-    state->setProperty("mode", modeStr);
+    state->setProperty("mode", editModeName(seqEditor.getEditMode()));
 
     state->setProperty("currentSequence", static_cast<int>(seqEditor.getCurrentSequence()));
     state->setProperty("currentStep", static_cast<int>(seqEditor.getCurrentStep()));
@@ -1702,58 +2052,103 @@ juce::var TrackerMainProcessor::getUiState()
     state->setProperty("machineType", currentSequence->getMachineType());
     state->setProperty("triggerProbability", currentSequence->getTriggerProbability());
 
-    state->setProperty("ticksPerStep", static_cast<int>(viewedSequencer->getSequence(seqEditor.getCurrentSequence())->getTicksPerStep()));
+    state->setProperty("ticksPerStep", viewedSequencer->getSequence(seqEditor.getCurrentSequence())->getTicksPerStep());
 
     return state.get();
 }
 
-juce::var TrackerMainProcessor::serializeSingleSequencer(const Sequencer& sequencerToSave) const
+juce::var TrackerMainProcessor::serializeSingleSequencer(const Sequencer& sequencerToSave, SongSaveTables* tables) const
 {
     juce::DynamicObject::Ptr seqRoot = new juce::DynamicObject();
     juce::Array<juce::var> sequencesVar;
     const auto seqCount = sequencerToSave.howManySequences();
     for (std::size_t seqIndex = 0; seqIndex < seqCount; ++seqIndex)
     {
-        juce::DynamicObject::Ptr seqObj = new juce::DynamicObject();
-        Sequence* seq = const_cast<Sequencer&>(sequencerToSave).getSequence(seqIndex);
-        const auto length = seq->getLength();
-        seqObj->setProperty("length", static_cast<int>(length));
-        seqObj->setProperty("type", static_cast<int>(seq->getType()));
-        seqObj->setProperty("ticksPerStep", static_cast<int>(seq->getTicksPerStep()));
-        seqObj->setProperty("muted", seq->isMuted());
-        seqObj->setProperty("machineId", seq->getMachineId());
-        seqObj->setProperty("machineType", seq->getMachineType());
-        seqObj->setProperty("triggerProbability", seq->getTriggerProbability());
-
-        juce::Array<juce::var> stepsVar;
-        for (std::size_t step = 0; step < length; ++step)
-        {
-            juce::DynamicObject::Ptr stepObj = new juce::DynamicObject();
-            stepObj->setProperty("active", sequencerToSave.isStepActive(seqIndex, step));
-            juce::Array<juce::var> rows;
-            const auto data = const_cast<Sequencer&>(sequencerToSave).getStepData(seqIndex, step);
-            for (const auto& row : data)
+        if (tables == nullptr)
+        {
+            sequencesVar.add(serializeSequence(sequencerToSave, seqIndex, nullptr));
+            continue;
+        }
+
+        // identical tracks across sets, e.g. one drum pattern under several bass lines,
+        // go into the pattern pool once and are referenced by index
+        const Sequence* seq = const_cast<Sequencer&>(sequencerToSave).getSequence(seqIndex);
+        auto& candidates = tables->patternsByHash[seq->getContentHash()];
+        int patternIndex = -1;
+        for (const auto& candidate : candidates)
+        {
+            if (candidate.first->hasSameContent(*seq))
             {
-                juce::Array<juce::var> cols;
-                for (auto val : row)
-                    cols.add(val);
-                rows.add(cols);
+                patternIndex = candidate.second;
+                break;
             }
-            stepObj->setProperty("data", rows);
-            stepsVar.add(stepObj.get());
         }
-
-        seqObj->setProperty("steps", stepsVar);
-        sequencesVar.add(seqObj.get());
+        if (patternIndex < 0)
+        {
+            patternIndex = tables->patterns.size();
+            tables->patterns.add(serializeSequence(sequencerToSave, seqIndex, tables));
+            candidates.push_back({ seq, patternIndex });
+        }
+        juce::DynamicObject::Ptr refObj = new juce::DynamicObject();
+        refObj->setProperty("pattern", patternIndex);
+        sequencesVar.add(refObj.get());
     }
 
     seqRoot->setProperty("sequences", sequencesVar);
     return juce::var(seqRoot.get());
 }
 
-void TrackerMainProcessor::restoreSingleSequencer(Sequencer& target, const juce::var& seqVar)
+juce::var TrackerMainProcessor::serializeSequence(const Sequencer& sequencerToSave, std::size_t seqIndex, SongSaveTables* tables) const
 {
-    if (!seqVar.isObject())
+    juce::DynamicObject::Ptr seqObj = new juce::DynamicObject();
+    Sequence* seq = const_cast<Sequencer&>(sequencerToSave).getSequence(seqIndex);
+    const auto length = seq->getLength();
+    seqObj->setProperty("length", static_cast<int>(length));
+    seqObj->setProperty("type", static_cast<int>(seq->getType()));
+    seqObj->setProperty("ticksPerStep", seq->getTicksPerStep());
+    seqObj->setProperty("muted", seq->isMuted());
+    seqObj->setProperty("machineId", seq->getMachineId());
+    seqObj->setProperty("machineType", seq->getMachineType());
+    seqObj->setProperty("triggerProbability", seq->getTriggerProbability());
+    seqObj->setProperty("randomSeed", static_cast<juce::int64>(seq->getRandomSeed()));
+
+    juce::Array<juce::var> stepsVar;
+    for (std::size_t step = 0; step < length; ++step)
+    {
+        juce::DynamicObject::Ptr stepObj = new juce::DynamicObject();
+        stepObj->setProperty("active", sequencerToSave.isStepActive(seqIndex, step));
+        const auto data = sequencerToSave.getSharedStepData(seqIndex, step);
+        if (data == nullptr)
+        {
+            stepsVar.add(stepObj.get());
+            continue;
+        }
+        if (tables != nullptr)
+        {
+            // song rows cloned from each other share most of their step blocks,
+            // so write each block once and refer to it by index
+            auto found = tables->indexOfBlock.find(data.get());
+            if (found == tables->indexOfBlock.end())
+            {
+                found = tables->indexOfBlock.emplace(data.get(), tables->blocks.size()).first;
+                tables->blocks.add(numberGridToVar(*data));
+            }
+            stepObj->setProperty("block", found->second);
+        }
+        else
+        {
+            stepObj->setProperty("data", numberGridToVar(*data));
+        }
+        stepsVar.add(stepObj.get());
+    }
+
+    seqObj->setProperty("steps", stepsVar);
+    return juce::var(seqObj.get());
+}
+
+void TrackerMainProcessor::restoreSingleSequencer(Sequencer& target, const juce::var& seqVar, SongLoadTables* tables)
+{
+    if (!seqVar.isObject())
         return;
 
     const auto seqArrayVar = seqVar.getProperty("sequences", juce::var());
@@ -1768,89 +2163,104 @@ void TrackerMainProcessor::restoreSingleSequencer(Sequencer& target, const juce:
         if (!seqObj.isObject())
             continue;
 
-        Sequence* seq = target.getSequence(i);
-        const int length = juce::jmax(1, static_cast<int>(seqObj.getProperty("length", static_cast<int>(seq->getLength()))));
-        seq->ensureEnoughStepsForLength(static_cast<std::size_t>(length));
-        seq->setLength(static_cast<std::size_t>(length));
+        const auto patternVar = seqObj.getProperty("pattern", juce::var());
+        if (tables != nullptr && !patternVar.isVoid())
+        {
+            const int patternIndex = static_cast<int>(patternVar);
+            if (patternIndex < 0 || patternIndex >= tables->patterns.size())
+                continue;
+            auto& restored = tables->restoredPatterns[static_cast<std::size_t>(patternIndex)];
+            if (restored.first != nullptr)
+            {
+                target.copySequenceFrom(*restored.first, restored.second, i);
+            }
+            else
+            {
+                restoreSequence(target, i, tables->patterns[patternIndex], tables);
+                restored = { &target, i };
+            }
+            continue;
+        }
+        restoreSequence(target, i, seqObj, tables);
+    }
+}
+
+void TrackerMainProcessor::restoreSequence(Sequencer& target, std::size_t i, const juce::var& seqObj, const SongLoadTables* tables)
+{
+    if (!seqObj.isObject())
+        return;
 
-        const auto typeInt = static_cast<int>(seqObj.getProperty("type", static_cast<int>(seq->getType())));
-        seq->setType(static_cast<SequenceType>(typeInt));
+    Sequence* seq = target.getSequence(i);
+    const int length = juce::jmax(1, static_cast<int>(seqObj.getProperty("length", static_cast<int>(seq->getLength()))));
+    seq->ensureEnoughStepsForLength(static_cast<std::size_t>(length));
+    seq->setLength(static_cast<std::size_t>(length));
 
-        const std::size_t tps = static_cast<std::size_t>(static_cast<int>(seqObj.getProperty("ticksPerStep", static_cast<int>(seq->getTicksPerStep()))));
-        seq->setTicksPerStep(tps);
-        seq->onZeroSetTicksPerStep(tps);
+    const auto typeInt = static_cast<int>(seqObj.getProperty("type", static_cast<int>(seq->getType())));
+    seq->setType(static_cast<SequenceType>(typeInt));
 
-        const double machineId = static_cast<double>(seqObj.getProperty("machineId", seq->getMachineId()));
-        const double machineType = static_cast<double>(seqObj.getProperty("machineType", seq->getMachineType()));
-        const double triggerProbability = static_cast<double>(seqObj.getProperty("triggerProbability", seq->getTriggerProbability()));
+    // grid ticks, fractional when set at a finer tick resolution
+    const double tps = juce::jlimit(1.0, 16.0, static_cast<double>(seqObj.getProperty("ticksPerStep", seq->getTicksPerStep())));
+    seq->setTicksPerStep(tps);
+    seq->onZeroSetTicksPerStep(tps);
 
-        const auto stepsVar = seqObj.getProperty("steps", juce::var());
-        if (stepsVar.isArray())
-        {
-            const auto& stepsArray = *stepsVar.getArray();
-            const auto stepsToLoad = std::min(static_cast<std::size_t>(stepsArray.size()), static_cast<std::size_t>(length));
-            for (std::size_t step = 0; step < stepsToLoad; ++step)
-            {
-                const auto& stepVar = stepsArray[static_cast<int>(step)];
-                if (!stepVar.isObject())
-                    continue;
+    const double machineId = static_cast<double>(seqObj.getProperty("machineId", seq->getMachineId()));
+    const double machineType = static_cast<double>(seqObj.getProperty("machineType", seq->getMachineType()));
+    const double triggerProbability = static_cast<double>(seqObj.getProperty("triggerProbability", seq->getTriggerProbability()));
 
-                const auto dataVar = stepVar.getProperty("data", juce::var());
-                if (dataVar.isArray())
-                {
-                    std::vector<std::vector<double>> data;
-                    for (const auto& rowVar : *dataVar.getArray())
-                    {
-                        std::vector<double> row;
-                        if (rowVar.isArray())
-                        {
-                            for (const auto& val : *rowVar.getArray())
-                                row.push_back(static_cast<double>(val));
-                        }
-                        if (!row.empty())
-                        {
-                            if (row.size() == Step::maxInd + 2)
-                            {
-                                std::vector<double> remapped = { row[Step::cmdInd], row[2], row[3], row[4], row[5] };
-                                data.push_back(std::move(remapped));
-                            }
-                            else
-                            {
-                                if (row.size() < Step::maxInd + 1)
-                                    row.resize(Step::maxInd + 1, 0.0);
-                                if (row.size() > Step::maxInd + 1)
-                                    row.resize(Step::maxInd + 1);
-                                data.push_back(std::move(row));
-                            }
-                        }
-                    }
-                    if (!data.empty())
-                        target.setStepData(i, step, data);
-                }
+    const auto stepsVar = seqObj.getProperty("steps", juce::var());
+    if (stepsVar.isArray())
+    {
+        const auto& stepsArray = *stepsVar.getArray();
+        const auto stepsToLoad = std::min(static_cast<std::size_t>(stepsArray.size()), static_cast<std::size_t>(length));
+        for (std::size_t step = 0; step < stepsToLoad; ++step)
+        {
+            const auto& stepVar = stepsArray[static_cast<int>(step)];
+            if (!stepVar.isObject())
+                continue;
 
-                const bool active = static_cast<bool>(stepVar.getProperty("active", true));
-                if (target.isStepActive(i, step) != active)
-                    target.toggleStepActive(i, step);
+            const auto blockVar = stepVar.getProperty("block", juce::var());
+            const auto dataVar = stepVar.getProperty("data", juce::var());
+            if (tables != nullptr && !blockVar.isVoid())
+            {
+                const int blockIndex = static_cast<int>(blockVar);
+                if (blockIndex >= 0 && static_cast<std::size_t>(blockIndex) < tables->blocks.size())
+                    target.setSharedStepData(i, step, tables->blocks[static_cast<std::size_t>(blockIndex)]);
             }
+            else if (dataVar.isArray())
+            {
+                auto data = stepRowsFromVar(dataVar);
+                if (!data.empty())
+                    target.setStepData(i, step, data);
+            }
+
+            const bool active = static_cast<bool>(stepVar.getProperty("active", true));
+            if (target.isStepActive(i, step) != active)
+                target.toggleStepActive(i, step);
         }
+    }
 
-        seq->setMachineId(machineId);
-        seq->setMachineType(machineType);
-        seq->setTriggerProbability(triggerProbability);
+    seq->setMachineId(machineId);
+    seq->setMachineType(machineType);
+    seq->setTriggerProbability(triggerProbability);
+    const auto seedVar = seqObj.getProperty("randomSeed", juce::var());
+    if (!seedVar.isVoid())
+        seq->setRandomSeed(static_cast<std::uint32_t>(static_cast<juce::int64>(seedVar)));
 
-        const bool mutedTarget = static_cast<bool>(seqObj.getProperty("muted", false));
-        if (seq->isMuted() != mutedTarget)
-            target.toggleSequenceMute(i);
-    }
+    const bool mutedTarget = static_cast<bool>(seqObj.getProperty("muted", false));
+    if (seq->isMuted() != mutedTarget)
+        target.toggleSequenceMute(i);
 }
 
 juce::var TrackerMainProcessor::serializeSequencerState()
 {
     juce::DynamicObject::Ptr root = new juce::DynamicObject();
     juce::Array<juce::var> sequenceSetStates;
+    SongSaveTables tables;
     for (const auto& sequenceSet : sequenceSets)
         if (sequenceSet != nullptr)
-            sequenceSetStates.add(serializeSingleSequencer(*sequenceSet));
+            sequenceSetStates.add(serializeSingleSequencer(*sequenceSet, &tables));
+    root->setProperty("stepBlocks", tables.blocks);
+    root->setProperty("patterns", tables.patterns);
     root->setProperty("sequenceSets", sequenceSetStates);
     root->setProperty("viewedSequenceSetIndex", static_cast<int>(viewedSequenceSetIndex));
     root->setProperty("activePlaybackSequenceSetIndex", static_cast<int>(activePlaybackSequenceSetIndex));
@@ -1858,6 +2268,7 @@ juce::var TrackerMainProcessor::serializeSequencerState()
     root->setProperty("currentSongRow", static_cast<int>(currentSongRow));
     root->setProperty("currentSongRowBeatCounter", currentSongRowBeatCounter);
     root->setProperty("songPlayMode", songPlayMode == SongPlayMode::song ? "song" : "sequence");
+    root->setProperty("ticksPerQuarter", getTicksPerQuarter());
     root->setProperty("currentSequence", static_cast<int>(seqEditor.getCurrentSequence()));
     root->setProperty("currentStep", static_cast<int>(seqEditor.getCurrentStep()));
     root->setProperty("currentStepRow", static_cast<int>(seqEditor.getCurrentStepRow()));
@@ -1865,11 +2276,7 @@ juce::var TrackerMainProcessor::serializeSequencerState()
     root->setProperty("currentSongRowCursor", static_cast<int>(seqEditor.getCurrentSongRow()));
     root->setProperty("currentSongColCursor", static_cast<int>(seqEditor.getCurrentSongCol()));
 
-    juce::String modeStr = "sequence";
-    const auto uiState = getUiState();
-    if (uiState.isObject())
-        modeStr = uiState.getProperty("mode", "sequence").toString();
-    root->setProperty("mode", modeStr);
+    root->setProperty("mode", editModeName(seqEditor.getEditMode()));
 
     juce::Array<juce::var> songRowsVar;
     for (const auto& row : songRows)
@@ -1877,6 +2284,13 @@ juce::var TrackerMainProcessor::serializeSequencerState()
         juce::DynamicObject::Ptr rowObj = new juce::DynamicObject();
         rowObj->setProperty("sequenceSetId", static_cast<int>(row.sequenceSetId));
         rowObj->setProperty("beatCount", row.beatCount);
+        if (!row.trackPatterns.empty())
+        {
+            juce::Array<juce::var> trackPatternsVar;
+            for (const int setId : row.trackPatterns)
+                trackPatternsVar.add(setId);
+            rowObj->setProperty("trackPatterns", trackPatternsVar);
+        }
         songRowsVar.add(rowObj.get());
     }
     root->setProperty("songRows", songRowsVar);
@@ -1946,11 +2360,29 @@ void TrackerMainProcessor::restoreSequencerState(const juce::var& stateVar)
     const auto sequenceSetsVar = stateVar.getProperty("sequenceSets", juce::var());
     if (sequenceSetsVar.isArray() && !sequenceSetsVar.getArray()->isEmpty())
     {
+        // decode each stored step block once so restored sets share them again
+        SongLoadTables tables;
+        const auto stepBlocksVar = stateVar.getProperty("stepBlocks", juce::var());
+        if (stepBlocksVar.isArray())
+        {
+            for (const auto& blockVar : *stepBlocksVar.getArray())
+            {
+                auto rows = stepRowsFromVar(blockVar);
+                if (rows.empty())
+                    rows = Step{}.getData();
+                tables.blocks.push_back(std::make_shared<Step::Rows>(std::move(rows)));
+            }
+        }
+        const auto patternsVar = stateVar.getProperty("patterns", juce::var());
+        if (patternsVar.isArray())
+            tables.patterns = *patternsVar.getArray();
+        tables.restoredPatterns.assign(static_cast<std::size_t>(tables.patterns.size()), { nullptr, 0 });
+
         sequenceSets.clear();
         for (const auto& sequenceSetVar : *sequenceSetsVar.getArray())
         {
             auto sequenceSet = createDefaultSequenceSet();
-            restoreSingleSequencer(*sequenceSet, sequenceSetVar);
+            restoreSingleSequencer(*sequenceSet, sequenceSetVar, &tables);
             sequenceSets.push_back(std::move(sequenceSet));
         }
     }
@@ -1974,6 +2406,16 @@ void TrackerMainProcessor::restoreSequencerState(const juce::var& stateVar)
             row.beatCount = juce::jmax(1, static_cast<int>(rowVar.getProperty("beatCount", rowVar.getProperty("repeatCount", 16))));
             if (!sequenceSets.empty())
                 row.sequenceSetId = std::min(row.sequenceSetId, sequenceSets.size() - 1);
+            const auto trackPatternsVar = rowVar.getProperty("trackPatterns", juce::var());
+            if (trackPatternsVar.isArray())
+            {
+                const int maxSetId = static_cast<int>(sequenceSets.size()) - 1;
+                for (const auto& setIdVar : *trackPatternsVar.getArray())
+                {
+                    const int setId = static_cast<int>(setIdVar);
+                    row.trackPatterns.push_back(setId < 0 || setId > maxSetId ? -1 : setId);
+                }
+            }
             songRows.push_back(row);
         }
     }
@@ -1982,63 +2424,29 @@ void TrackerMainProcessor::restoreSequencerState(const juce::var& stateVar)
 
     viewedSequenceSetIndex = static_cast<std::size_t>(juce::jmax(0, static_cast<int>(stateVar.getProperty("viewedSequenceSetIndex", 0))));
     activePlaybackSequenceSetIndex = static_cast<std::size_t>(juce::jmax(0, static_cast<int>(stateVar.getProperty("activePlaybackSequenceSetIndex", static_cast<int>(viewedSequenceSetIndex)))));
-    if (!sequenceSets.empty())
-    {
-        viewedSequenceSetIndex = std::min(viewedSequenceSetIndex, sequenceSets.size() - 1);
-        activePlaybackSequenceSetIndex = std::min(activePlaybackSequenceSetIndex, sequenceSets.size() - 1);
-    }
-
     selectedSongRow = static_cast<std::size_t>(juce::jmax(0, static_cast<int>(stateVar.getProperty("selectedSongRow", 0))));
     currentSongRow = static_cast<std::size_t>(juce::jmax(0, static_cast<int>(stateVar.getProperty("currentSongRow", static_cast<int>(selectedSongRow)))));
-    if (!songRows.empty())
-    {
-        selectedSongRow = std::min(selectedSongRow, songRows.size() - 1);
-        currentSongRow = std::min(currentSongRow, songRows.size() - 1);
-    }
+    clampSongPosition();
     currentSongRowBeatCounter = juce::jmax(1, static_cast<int>(stateVar.getProperty("currentSongRowBeatCounter", songRows.empty() ? 16 : songRows[currentSongRow].beatCount)));
     songPlayMode = stateVar.getProperty("songPlayMode", "sequence").toString().equalsIgnoreCase("song")
         ? SongPlayMode::song
         : SongPlayMode::sequence;
     pendingPlaybackSequenceSetIndex.reset();
+    resolveSongRowPatterns(currentSongRow);
+    // states saved before the resolution was stored ran at the grid rate
+    setTickResolution(static_cast<int>(stateVar.getProperty("ticksPerQuarter", ClockAbs::kGridTicksPerQuarter)));
 
     bindViewedSequenceSetToEditor();
+    seqEditor.clearUndoHistory();
     auto* viewedSequencer = getViewedSequencerInternal();
     if (viewedSequencer == nullptr)
         return;
 
-    int seq = static_cast<int>(stateVar.getProperty("currentSequence", static_cast<int>(seqEditor.getCurrentSequence())));
-    const int maxSeq = static_cast<int>(std::max<std::size_t>(1, viewedSequencer->howManySequences())) - 1;
-    seq = juce::jlimit(0, juce::jmax(0, maxSeq), seq);
-    seqEditor.setCurrentSequence(seq);
-
-    int step = static_cast<int>(stateVar.getProperty("currentStep", static_cast<int>(seqEditor.getCurrentStep())));
-    const int maxStep = static_cast<int>(std::max<std::size_t>(1, viewedSequencer->howManySteps(static_cast<std::size_t>(seq)))) - 1;
-    step = juce::jlimit(0, juce::jmax(0, maxStep), step);
-    seqEditor.setCurrentStep(step);
-
-    int stepRow = static_cast<int>(stateVar.getProperty("currentStepRow", static_cast<int>(seqEditor.getCurrentStepRow())));
-    stepRow = juce::jmax(0, stepRow);
-    // seqEditor.setCurrentStepRow(stepRow);
-
-    int stepCol = static_cast<int>(stateVar.getProperty("currentStepCol", static_cast<int>(seqEditor.getCurrentStepCol())));
-    stepCol = juce::jmax(0, stepCol);
-    // seqEditor.setCurrentStepCol(stepCol);
-
-    seqEditor.setSelectedSongCursor(
-        static_cast<std::size_t>(juce::jmax(0, static_cast<int>(stateVar.getProperty("currentSongRowCursor", static_cast<int>(selectedSongRow))))),
-        static_cast<std::size_t>(juce::jmax(0, static_cast<int>(stateVar.getProperty("currentSongColCursor", 0)))));
-
-    juce::String mode = stateVar.getProperty("mode", "sequence").toString().toLowerCase();
-    if (mode == "song")
-        seqEditor.setEditMode(SequencerEditorMode::arrangingSong);
-    else if (mode == "step")
-        seqEditor.setEditMode(SequencerEditorMode::editingStep);
-    else if (mode == "config")
-        seqEditor.setEditMode(SequencerEditorMode::configuringSequence);
-    else if (mode == "machine")
-        seqEditor.setEditMode(SequencerEditorMode::machineConfig);
-    else
-        seqEditor.setEditMode(SequencerEditorMode::selectingSeqAndStep);
+    restoreEditorState(static_cast<int>(stateVar.getProperty("currentSequence", static_cast<int>(seqEditor.getCurrentSequence()))),
+                       static_cast<int>(stateVar.getProperty("currentStep", static_cast<int>(seqEditor.getCurrentStep()))),
+                       static_cast<std::size_t>(juce::jmax(0, static_cast<int>(stateVar.getProperty("currentSongRowCursor", static_cast<int>(selectedSongRow))))),
+                       static_cast<std::size_t>(juce::jmax(0, static_cast<int>(stateVar.getProperty("currentSongColCursor", 0)))),
+                       stateVar.getProperty("mode", "sequence").toString());
 
     const auto machineStacksVar = stateVar.getProperty("machineStacks", juce::var());
     if (machineStacksVar.isArray())
@@ -2059,13 +2467,11 @@ void TrackerMainProcessor::restoreSequencerState(const juce::var& stateVar)
                     if (!slotVar.isObject())
                         continue;
                     const auto type = static_cast<CommandType>(static_cast<int>(slotVar.getProperty("type", static_cast<int>(CommandType::MidiNote))));
-                    auto slot = makeDefaultSlotState(type);
-                    slot.enabled = static_cast<bool>(slotVar.getProperty("enabled", slot.enabled));
-                    slot.sendLevelDb = juce::jlimit(-60.0f, 12.0f, static_cast<float>(slotVar.getProperty("sendLevelDb", slot.sendLevelDb)));
-                    slot.returnLevelDb = juce::jlimit(-60.0f, 12.0f, static_cast<float>(slotVar.getProperty("returnLevelDb", slot.returnLevelDb)));
-                    if (!slotSupportsReturnLevel(type))
-                        slot.returnLevelDb = 0.0f;
-                    stack.slots.push_back(slot);
+                    const auto defaults = makeDefaultSlotState(type);
+                    stack.slots.push_back(restoreSlotState(type,
+                                                           static_cast<bool>(slotVar.getProperty("enabled", defaults.enabled)),
+                                                           static_cast<float>(slotVar.getProperty("sendLevelDb", defaults.sendLevelDb)),
+                                                           static_cast<float>(slotVar.getProperty("returnLevelDb", defaults.returnLevelDb))));
                 }
             }
             if (stack.slots.empty())
@@ -2124,11 +2530,8 @@ void TrackerMainProcessor::restoreSequencerState(const juce::var& stateVar)
                     return;
                 juce::MemoryBlock state;
                 juce::MemoryOutputStream stream(state, false);
-                if (!juce::Base64::convertFromBase64(stream, encoded))
-                    return;
-                if (state.getSize() == 0)
-                    return;
-                machine->setStateInformation(state.getData(), static_cast<int>(state.getSize()));
+                if (juce::Base64::convertFromBase64(stream, encoded))
+                    restoreMachineState(machine, state);
             };
 
             decodeMachineState(stackArray[static_cast<int>(i)].getProperty("sampler", juce::var()), stack.sampler.get());
@@ -2153,11 +2556,8 @@ void TrackerMainProcessor::restoreSequencerState(const juce::var& stateVar)
                 return;
             juce::MemoryBlock state;
             juce::MemoryOutputStream stream(state, false);
-            if (!juce::Base64::convertFromBase64(stream, encoded))
-                return;
-            if (state.getSize() == 0)
-                return;
-            machine->setStateInformation(state.getData(), static_cast<int>(state.getSize()));
+            if (juce::Base64::convertFromBase64(stream, encoded))
+                restoreMachineState(machine, state);
         };
 
         decodeMachineState(sharedAuxVar.getProperty("aux1", juce::var()), auxBus1.machine.get());
@@ -2177,6 +2577,452 @@ void TrackerMainProcessor::restoreSequencerState(const juce::var& stateVar)
     sendChangeMessage();
 }
 
+juce::String TrackerMainProcessor::exportStateAsJson()
+{
+    return withAudioThreadExclusive([&]()
+    {
+        return juce::JSON::toString(serializeSequencerState());
+    });
+}
+
+void TrackerMainProcessor::captureProjectSnapshot(ProjectSnapshot& snapshot)
+{
+    // every track is taken as its own pattern: step blocks are shared rather than copied, so this
+    // costs little beyond reference counts. takeProjectSnapshot merges the duplicates afterwards
+    std::size_t trackCount = 0;
+    for (const auto& sequenceSet : sequenceSets)
+        if (sequenceSet != nullptr)
+            trackCount += sequenceSet->howManySequences();
+    snapshot.patterns.reserve(trackCount);
+    for (const auto& sequenceSet : sequenceSets)
+    {
+        if (sequenceSet == nullptr)
+            continue;
+        std::vector<std::uint32_t> tracks;
+        tracks.reserve(sequenceSet->howManySequences());
+        for (std::size_t seqIndex = 0; seqIndex < sequenceSet->howManySequences(); ++seqIndex)
+        {
+            const Sequence* seq = sequenceSet->getSequence(seqIndex);
+            tracks.push_back(static_cast<std::uint32_t>(snapshot.patterns.size()));
+
+            auto& pattern = snapshot.patterns.emplace_back();
+            pattern.length = seq->getLength();
+            pattern.type = seq->getType();
+            pattern.ticksPerStep = seq->getTicksPerStep();
+            pattern.muted = seq->isMuted();
+            pattern.machineId = seq->getMachineId();
+            pattern.machineType = seq->getMachineType();
+            pattern.triggerProbability = seq->getTriggerProbability();
+            pattern.randomSeed = seq->getRandomSeed();
+            pattern.stepData.reserve(pattern.length);
+            pattern.stepActive.reserve(pattern.length);
+            for (std::size_t step = 0; step < pattern.length; ++step)
+            {
+                pattern.stepData.push_back(sequenceSet->getSharedStepData(seqIndex, step));
+                pattern.stepActive.push_back(sequenceSet->isStepActive(seqIndex, step));
+            }
+        }
+        snapshot.sequenceSets.push_back(std::move(tracks));
+    }
+
+    for (const auto& row : songRows)
+        snapshot.songRows.push_back({ row.sequenceSetId, row.beatCount, row.trackPatterns });
+    snapshot.songMode = songPlayMode == SongPlayMode::song;
+    snapshot.viewedSequenceSetIndex = viewedSequenceSetIndex;
+    snapshot.activePlaybackSequenceSetIndex = activePlaybackSequenceSetIndex;
+    snapshot.selectedSongRow = selectedSongRow;
+    snapshot.currentSongRow = currentSongRow;
+    snapshot.currentSongRowBeatCounter = currentSongRowBeatCounter;
+    snapshot.ticksPerQuarter = getTicksPerQuarter();
+
+    snapshot.currentSequence = seqEditor.getCurrentSequence();
+    snapshot.currentStep = seqEditor.getCurrentStep();
+    snapshot.currentStepRow = seqEditor.getCurrentStepRow();
+    snapshot.currentStepCol = seqEditor.getCurrentStepCol();
+    snapshot.songRowCursor = seqEditor.getCurrentSongRow();
+    snapshot.songColCursor = seqEditor.getCurrentSongCol();
+    snapshot.editMode = editModeName(seqEditor.getEditMode()).toStdString();
+
+    for (const auto& stack : machineStacks)
+    {
+        auto& savedStack = snapshot.stacks.emplace_back();
+        for (const auto& slot : stack.slots)
+            savedStack.slots.push_back({ slot.type, slot.enabled, slot.sendLevelDb, slot.returnLevelDb });
+        savedStack.midiOutputChannel = stack.midiOutputChannel;
+        savedStack.gainDb = stack.gainDb;
+    }
+}
+
+void TrackerMainProcessor::captureMachineStates(ProjectSnapshot& snapshot)
+{
+    const auto stackCount = std::min(snapshot.stacks.size(), machineStacks.size());
+    for (std::size_t i = 0; i < stackCount; ++i)
+    {
+        auto& stack = machineStacks[i];
+        auto& savedStack = snapshot.stacks[i];
+        const std::pair<CommandType, MachineInterface*> machines[] = {
+            { CommandType::Sampler, stack.sampler.get() },
+            { CommandType::Arpeggiator, stack.arpeggiator.get() },
+            { CommandType::PolyArpeggiator, stack.polyArpeggiator.get() },
+            { CommandType::WavetableSynth, stack.wavetableSynth.get() },
+            { CommandType::DistortionFx, stack.distortionFx.get() },
+            { CommandType::DelayFx, stack.delayFx.get() },
+            { CommandType::ChannelStripFx, stack.channelStripFx.get() },
+        };
+        for (const auto& [type, machine] : machines)
+        {
+            if (machine == nullptr)
+                continue;
+            auto& savedMachine = savedStack.machines.emplace_back();
+            savedMachine.type = type;
+            machine->getStateInformation(savedMachine.data);
+        }
+    }
+
+    if (auxBus1.machine != nullptr)
+        auxBus1.machine->getStateInformation(snapshot.aux1State);
+    if (auxBus2.machine != nullptr)
+        auxBus2.machine->getStateInformation(snapshot.aux2State);
+}
+
+std::vector<std::unique_ptr<Sequencer>> TrackerMainProcessor::buildSequenceSets(const ProjectSnapshot& snapshot)
+{
+    std::vector<std::unique_ptr<Sequencer>> builtSets;
+    // where each pattern was first restored, so later uses can share its step blocks
+    std::vector<std::pair<Sequencer*, std::size_t>> restoredPatterns(snapshot.patterns.size(), { nullptr, 0 });
+    for (const auto& tracks : snapshot.sequenceSets)
+    {
+        auto sequenceSet = createDefaultSequenceSet();
+        const auto trackCount = std::min(tracks.size(), sequenceSet->howManySequences());
+        for (std::size_t track = 0; track < trackCount; ++track)
+        {
+            const auto patternIndex = static_cast<std::size_t>(tracks[track]);
+            if (patternIndex >= snapshot.patterns.size())
+                continue;
+            auto& restored = restoredPatterns[patternIndex];
+            if (restored.first != nullptr)
+            {
+                sequenceSet->copySequenceFrom(*restored.first, restored.second, track);
+            }
+            else
+            {
+                restorePattern(*sequenceSet, track, snapshot.patterns[patternIndex]);
+                restored = { sequenceSet.get(), track };
+            }
+        }
+        builtSets.push_back(std::move(sequenceSet));
+    }
+    if (builtSets.empty())
+        builtSets.push_back(createDefaultSequenceSet());
+    return builtSets;
+}
+
+void TrackerMainProcessor::applyProjectSnapshot(const ProjectSnapshot& snapshot, std::vector<std::unique_ptr<Sequencer>>& builtSets)
+{
+    assert(!builtSets.empty());
+    sequenceSets.swap(builtSets);
+    resetSongTransport();
+
+    songRows.clear();
+    const int maxSetId = static_cast<int>(sequenceSets.size()) - 1;
+    for (const auto& savedRow : snapshot.songRows)
+    {
+        SongRow row;
+        row.sequenceSetId = std::min(savedRow.sequenceSetId, sequenceSets.size() - 1);
+        row.beatCount = juce::jmax(1, savedRow.beatCount);
+        for (const int setId : savedRow.trackPatterns)
+            row.trackPatterns.push_back(setId < 0 || setId > maxSetId ? -1 : setId);
+        songRows.push_back(row);
+    }
+    if (songRows.empty())
+        songRows.push_back({ 0, 16 });
+
+    viewedSequenceSetIndex = snapshot.viewedSequenceSetIndex;
+    activePlaybackSequenceSetIndex = snapshot.activePlaybackSequenceSetIndex;
+    selectedSongRow = snapshot.selectedSongRow;
+    currentSongRow = snapshot.currentSongRow;
+    clampSongPosition();
+    currentSongRowBeatCounter = juce::jmax(1, snapshot.currentSongRowBeatCounter);
+    songPlayMode = snapshot.songMode ? SongPlayMode::song : SongPlayMode::sequence;
+    pendingPlaybackSequenceSetIndex.reset();
+    resolveSongRowPatterns(currentSongRow);
+    // an unsupported value from a damaged file leaves the resolution as it was
+    setTickResolution(snapshot.ticksPerQuarter);
+
+    bindViewedSequenceSetToEditor();
+    seqEditor.clearUndoHistory();
+    auto* viewedSequencer = getViewedSequencerInternal();
+    if (viewedSequencer == nullptr)
+        return;
+
+    restoreEditorState(static_cast<int>(snapshot.currentSequence),
+                       static_cast<int>(snapshot.currentStep),
+                       snapshot.songRowCursor,
+                       snapshot.songColCursor,
+                       juce::String(snapshot.editMode));
+
+    const auto stackCount = std::min(snapshot.stacks.size(), machineStacks.size());
+    for (std::size_t i = 0; i < stackCount; ++i)
+    {
+        const auto& savedStack = snapshot.stacks[i];
+        auto& stack = machineStacks[i];
+        stack.slots.clear();
+        for (const auto& slot : savedStack.slots)
+            stack.slots.push_back(restoreSlotState(slot.type, slot.enabled, slot.sendLevelDb, slot.returnLevelDb));
+        if (stack.slots.empty())
+            stack.slots.push_back(makeDefaultSlotState(CommandType::MidiNote));
+        stack.midiOutputChannel = juce::jlimit(1, 16, savedStack.midiOutputChannel);
+        stack.gainDb = juce::jlimit(-48.0f, 6.0f, savedStack.gainDb);
+        stack.meterLevel = 0.0f;
+        // machine states are left to the caller, which restores them once the audio thread is running again
+        refreshStackProcessingState(stack);
+    }
+
+    viewedSequencer->updateSeqStringGrid();
+    sendChangeMessage();
+}
+
+ProjectSnapshot TrackerMainProcessor::takeProjectSnapshot()
+{
+    // only the copy of the patterns and song holds the audio thread up.
+    // Machines guard their own state, so they are read after it is let go
+    ProjectSnapshot snapshot;
+    withAudioThreadExclusive([&]()
+    {
+        captureProjectSnapshot(snapshot);
+    });
+    snapshot.mergeDuplicatePatterns();
+    captureMachineStates(snapshot);
+    return snapshot;
+}
+
+void TrackerMainProcessor::restoreMachineStates(const ProjectSnapshot& snapshot)
+{
+    // each machine parses its own state under its own lock, so none of this holds up the audio thread
+    const auto stackCount = std::min(snapshot.stacks.size(), machineStacks.size());
+    for (std::size_t i = 0; i < stackCount; ++i)
+        for (const auto& savedMachine : snapshot.stacks[i].machines)
+            if (savedMachine.type != CommandType::Sampler && !isAuxSendType(savedMachine.type))
+                restoreMachineState(getMachineForStackType(machineStacks[i], savedMachine.type), savedMachine.data);
+
+    restoreMachineState(auxBus1.machine.get(), snapshot.aux1State);
+    restoreMachineState(auxBus2.machine.get(), snapshot.aux2State);
+}
+
+void TrackerMainProcessor::restoreSamplerStates(const ProjectSnapshot& snapshot)
+{
+    const auto stackCount = std::min(snapshot.stacks.size(), machineStacks.size());
+    for (std::size_t i = 0; i < stackCount; ++i)
+        for (const auto& savedMachine : snapshot.stacks[i].machines)
+            if (savedMachine.type == CommandType::Sampler)
+                restoreMachineState(machineStacks[i].sampler.get(), savedMachine.data);
+}
+
+bool TrackerMainProcessor::saveProjectFile(const std::string& path)
+{
+    if (path.empty())
+        return false;
+    const auto file = resolveProjectPath(path);
+    const auto snapshot = takeProjectSnapshot();
+
+    const std::lock_guard<std::mutex> lock(projectFileMutex);
+    // saving over the autosave file goes through it, so its next update knows what is on disk
+    if (projectAutosaveFile != nullptr && projectAutosaveFile->getFile() == file)
+        return projectAutosaveFile->save(snapshot);
+    return ProjectFile(file).save(snapshot);
+}
+
+bool TrackerMainProcessor::loadProjectFile(const std::string& path)
+{
+    if (path.empty())
+        return false;
+    const auto file = resolveProjectPath(path);
+
+    ProjectSnapshot snapshot;
+    {
+        const std::lock_guard<std::mutex> lock(projectFileMutex);
+        if (!ProjectFile::load(file, snapshot))
+            return false;
+    }
+
+    waitForProjectSampleLoader();
+    auto loadedSets = buildSequenceSets(snapshot);
+    withAudioThreadExclusive([&]()
+    {
+        applyProjectSnapshot(snapshot, loadedSets);
+    });
+    restoreMachineStates(snapshot);
+    markProjectChanged();
+    // patterns, song and the other machines are live now; sample files decode in the background
+    projectSampleLoader = std::thread([this, snapshot = std::move(snapshot)]()
+    {
+        restoreSamplerStates(snapshot);
+    });
+    return true;
+}
+
+void TrackerMainProcessor::setProjectAutosave(const std::string& path, int intervalSeconds)
+{
+    {
+        const std::lock_guard<std::mutex> lock(projectFileMutex);
+        if (path.empty() || intervalSeconds <= 0)
+        {
+            projectAutosaveFile.reset();
+            projectAutosaveIntervalSeconds.store(0, std::memory_order_relaxed);
+            return;
+        }
+        const auto file = resolveProjectPath(path);
+        if (projectAutosaveFile == nullptr || projectAutosaveFile->getFile() != file)
+        {
+            projectAutosaveFile = std::make_unique<ProjectFile>(file);
+            // a new file starts empty, so the next autosave writes it whether or not anything changed
+            markProjectChanged();
+        }
+        projectAutosaveIntervalSeconds.store(intervalSeconds, std::memory_order_relaxed);
+    }
+
+    if (!projectAutosaverRunning.exchange(true, std::memory_order_acq_rel))
+        projectAutosaver = std::thread([this]() { runProjectAutosaver(); });
+}
+
+void TrackerMainProcessor::markProjectChanged()
+{
+    projectChangeGeneration.fetch_add(1, std::memory_order_release);
+}
+
+void TrackerMainProcessor::runProjectAutosaver()
+{
+    auto lastSave = std::chrono::steady_clock::now();
+    std::uint64_t savedGeneration = 0;
+    while (projectAutosaverRunning.load(std::memory_order_acquire))
+    {
+        // short sleeps so the destructor never waits long to join
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        const int intervalSeconds = projectAutosaveIntervalSeconds.load(std::memory_order_relaxed);
+        const auto now = std::chrono::steady_clock::now();
+        if (intervalSeconds <= 0 || now - lastSave < std::chrono::seconds(intervalSeconds))
+            continue;
+        lastSave = now;
+
+        // nothing to snapshot or encode until something has changed. The generation is read
+        // first, so a change made while this save runs is picked up by the next one
+        const auto generation = projectChangeGeneration.load(std::memory_order_acquire);
+        if (generation == savedGeneration)
+            continue;
+        const auto snapshot = takeProjectSnapshot();
+        const std::lock_guard<std::mutex> lock(projectFileMutex);
+        if (projectAutosaveFile != nullptr && projectAutosaveFile->update(snapshot))
+            savedGeneration = generation;
+    }
+}
+
+void TrackerMainProcessor::waitForProjectSampleLoader()
+{
+    if (projectSampleLoader.joinable())
+        projectSampleLoader.join();
+}
+
+void TrackerMainProcessor::restorePattern(Sequencer& target, std::size_t i, const ProjectSnapshot::Pattern& pattern)
+{
+    Sequence* seq = target.getSequence(i);
+    const auto length = std::max<std::size_t>(1, pattern.length);
+    seq->ensureEnoughStepsForLength(length);
+    seq->setLength(length);
+    seq->setType(pattern.type);
+    seq->setTicksPerStep(pattern.ticksPerStep);
+    seq->onZeroSetTicksPerStep(pattern.ticksPerStep);
+
+    const auto stepsToLoad = std::min(pattern.stepData.size(), length);
+    for (std::size_t step = 0; step < stepsToLoad; ++step)
+    {
+        if (pattern.stepData[step] != nullptr)
+            target.setSharedStepData(i, step, pattern.stepData[step]);
+        const bool active = step < pattern.stepActive.size() ? pattern.stepActive[step] : true;
+        if (target.isStepActive(i, step) != active)
+            target.toggleStepActive(i, step);
+    }
+
+    seq->setMachineId(pattern.machineId);
+    seq->setMachineType(pattern.machineType);
+    seq->setTriggerProbability(pattern.triggerProbability);
+    seq->setRandomSeed(pattern.randomSeed);
+    if (seq->isMuted() != pattern.muted)
+        target.toggleSequenceMute(i);
+}
+
+void TrackerMainProcessor::clampSongPosition()
+{
+    if (!sequenceSets.empty())
+    {
+        viewedSequenceSetIndex = std::min(viewedSequenceSetIndex, sequenceSets.size() - 1);
+        activePlaybackSequenceSetIndex = std::min(activePlaybackSequenceSetIndex, sequenceSets.size() - 1);
+    }
+    if (!songRows.empty())
+    {
+        selectedSongRow = std::min(selectedSongRow, songRows.size() - 1);
+        currentSongRow = std::min(currentSongRow, songRows.size() - 1);
+    }
+}
+
+void TrackerMainProcessor::restoreEditorState(int sequence, int step, std::size_t songRowCursor, std::size_t songColCursor, const juce::String& mode)
+{
+    auto* viewedSequencer = getViewedSequencerInternal();
+    if (viewedSequencer == nullptr)
+        return;
+
+    const int maxSeq = static_cast<int>(std::max<std::size_t>(1, viewedSequencer->howManySequences())) - 1;
+    sequence = juce::jlimit(0, juce::jmax(0, maxSeq), sequence);
+    seqEditor.setCurrentSequence(sequence);
+
+    const int maxStep = static_cast<int>(std::max<std::size_t>(1, viewedSequencer->howManySteps(static_cast<std::size_t>(sequence)))) - 1;
+    step = juce::jlimit(0, juce::jmax(0, maxStep), step);
+    seqEditor.setCurrentStep(step);
+
+    seqEditor.setSelectedSongCursor(songRowCursor, songColCursor);
+
+    const auto modeName = mode.toLowerCase();
+    if (modeName == "song")
+        seqEditor.setEditMode(SequencerEditorMode::arrangingSong);
+    else if (modeName == "step")
+        seqEditor.setEditMode(SequencerEditorMode::editingStep);
+    else if (modeName == "config")
+        seqEditor.setEditMode(SequencerEditorMode::configuringSequence);
+    else if (modeName == "machine")
+        seqEditor.setEditMode(SequencerEditorMode::machineConfig);
+    else
+        seqEditor.setEditMode(SequencerEditorMode::selectingSeqAndStep);
+}
+
+juce::String TrackerMainProcessor::editModeName(SequencerEditorMode mode)
+{
+    switch (mode)
+    {
+        case SequencerEditorMode::arrangingSong: return "song";
+        case SequencerEditorMode::selectingSeqAndStep: return "sequence";
+        case SequencerEditorMode::editingStep: return "step";
+        case SequencerEditorMode::configuringSequence: return "config";
+        case SequencerEditorMode::machineConfig: return "machine";
+        case SequencerEditorMode::resetConfirmation: return "reset";
+    }
+    return "sequence";
+}
+
+TrackerMainProcessor::MachineStack::SlotState TrackerMainProcessor::restoreSlotState(CommandType type, bool enabled, float sendLevelDb, float returnLevelDb)
+{
+    auto slot = makeDefaultSlotState(type);
+    slot.enabled = enabled;
+    slot.sendLevelDb = juce::jlimit(-60.0f, 12.0f, sendLevelDb);
+    slot.returnLevelDb = slotSupportsReturnLevel(type) ? juce::jlimit(-60.0f, 12.0f, returnLevelDb) : 0.0f;
+    return slot;
+}
+
+void TrackerMainProcessor::restoreMachineState(MachineInterface* machine, const juce::MemoryBlock& state)
+{
+    if (machine == nullptr || state.getSize() == 0)
+        return;
+    machine->setStateInformation(state.getData(), static_cast<int>(state.getSize()));
+}
+
 ////// end of state saving and restoring stuff 
 //==============================================================================
 // This creates new instances of the plugin..
@@ -2247,7 +3093,7 @@ void TrackerMainProcessor::setSelectedSongRow(std::size_t row)
             {
                 currentSongRow = selectedSongRow;
                 currentSongRowBeatCounter = juce::jmax(1, songRows[selectedSongRow].beatCount);
-                schedulePlaybackSequenceSetSwitch(songRows[selectedSongRow].sequenceSetId);
+                scheduleSongRowPlayback(selectedSongRow);
             }
             else
             {
@@ -2296,8 +3142,9 @@ std::size_t TrackerMainProcessor::addSongRowByCloningViewedSet()
     if (viewedSequencer == nullptr)
         return 0;
 
+    // the new set shares step blocks with the viewed one until either is edited
     auto newSequenceSet = createDefaultSequenceSet();
-    restoreSingleSequencer(*newSequenceSet, serializeSingleSequencer(*viewedSequencer));
+    newSequenceSet->copyPatternsFrom(*viewedSequencer);
     sequenceSets.push_back(std::move(newSequenceSet));
     const std::size_t newSetIndex = sequenceSets.size() - 1;
     songRows.push_back({ newSetIndex, 16 });
@@ -2324,10 +3171,23 @@ void TrackerMainProcessor::removeSongRow(std::size_t row)
 
     if (!setStillReferenced && removedSetId < sequenceSets.size() && sequenceSets.size() > 1)
     {
+        // other sets may be playing tracks from the one about to go
+        for (auto& sequenceSet : sequenceSets)
+            if (sequenceSet != nullptr)
+                sequenceSet->clearSequenceSources();
         sequenceSets.erase(sequenceSets.begin() + static_cast<std::ptrdiff_t>(removedSetId));
         for (auto& songRow : songRows)
+        {
             if (songRow.sequenceSetId > removedSetId)
                 --songRow.sequenceSetId;
+            for (int& setId : songRow.trackPatterns)
+            {
+                if (setId == static_cast<int>(removedSetId))
+                    setId = -1;
+                else if (setId > static_cast<int>(removedSetId))
+                    --setId;
+            }
+        }
 
         if (viewedSequenceSetIndex > removedSetId && viewedSequenceSetIndex > 0)
             --viewedSequenceSetIndex;
@@ -2355,6 +3215,7 @@ void TrackerMainProcessor::removeSongRow(std::size_t row)
     if (!songRows.empty())
         currentSongRowBeatCounter = juce::jmax(1, songRows[currentSongRow].beatCount);
 
+    resolveSongRowPatterns(currentSongRow);
     setSelectedSongRow(selectedSongRow);
 }
 
@@ -2369,6 +3230,35 @@ void TrackerMainProcessor::adjustSongRowSequenceSetId(std::size_t row, int direc
         setSelectedSongRow(row);
 }
 
+std::size_t TrackerMainProcessor::getSongRowTrackPattern(std::size_t row, std::size_t track) const
+{
+    if (row >= songRows.size())
+        return 0;
+    const auto& songRow = songRows[row];
+    if (track < songRow.trackPatterns.size() && songRow.trackPatterns[track] >= 0)
+        return static_cast<std::size_t>(songRow.trackPatterns[track]);
+    return songRow.sequenceSetId;
+}
+
+void TrackerMainProcessor::adjustSongRowTrackPattern(std::size_t row, std::size_t track, int direction)
+{
+    if (row >= songRows.size() || sequenceSets.empty() || direction == 0)
+        return;
+    auto& songRow = songRows[row];
+    if (track >= songRow.trackPatterns.size())
+        songRow.trackPatterns.resize(track + 1, -1);
+
+    const int maxId = static_cast<int>(sequenceSets.size() - 1);
+    const int next = juce::jlimit(0, maxId, static_cast<int>(getSongRowTrackPattern(row, track)) + direction);
+    // referencing the row's own set is stored as 'follow the row' so changing the row's set carries it along
+    songRow.trackPatterns[track] = (static_cast<std::size_t>(next) == songRow.sequenceSetId) ? -1 : next;
+    while (!songRow.trackPatterns.empty() && songRow.trackPatterns.back() < 0)
+        songRow.trackPatterns.pop_back();
+
+    if (row == currentSongRow)
+        resolveSongRowPatterns(row);
+}
+
 void TrackerMainProcessor::adjustSongRowBeatCount(std::size_t row, int direction)
 {
     if (row >= songRows.size() || direction == 0)
@@ -2400,7 +3290,7 @@ void TrackerMainProcessor::toggleSongPlayback()
     pendingTransportQuarterBeatReset = true;
     pendingTransportStartOnQuarterBeat = true;
     if (!songRows.empty())
-        schedulePlaybackSequenceSetSwitch(songRows[currentSongRow].sequenceSetId);
+        scheduleSongRowPlayback(currentSongRow);
     else if (auto* targetSequencer = getPlaybackSequencerInternal())
     {
         targetSequencer->stop();
@@ -2419,7 +3309,7 @@ void TrackerMainProcessor::rewindSongTransport()
     pendingTransportQuarterBeatReset = true;
     pendingTransportStartOnQuarterBeat = wasPlaying;
     if (!songRows.empty())
-        schedulePlaybackSequenceSetSwitch(songRows[currentSongRow].sequenceSetId);
+        scheduleSongRowPlayback(currentSongRow);
     else if (auto* targetSequencer = getPlaybackSequencerInternal())
     {
         targetSequencer->stop();
@@ -2428,6 +3318,89 @@ void TrackerMainProcessor::rewindSongTransport()
     updateClockedMachineActivity();
 }
 
+void TrackerMainProcessor::seekSongPosition(std::size_t row, int beat, int tick, bool startPlaying)
+{
+    if (songRows.empty())
+        return;
+    const auto safeRow = std::min(row, songRows.size() - 1);
+    std::uint64_t ticks = 0;
+    if (songPlayMode == SongPlayMode::song)
+        for (std::size_t i = 0; i < safeRow; ++i)
+            ticks += static_cast<std::uint64_t>(juce::jmax(1, songRows[i].beatCount)) * 4u;
+    else
+        selectedSongRow = safeRow;
+    ticks += static_cast<std::uint64_t>(juce::jmax(0, beat)) * 4u + static_cast<std::uint64_t>(juce::jmax(0, tick));
+
+    seekToSongTick(ticks);
+    if (startPlaying)
+    {
+        if (auto* playbackSequencer = getPlaybackSequencerInternal())
+            playbackSequencer->play();
+        pendingTransportStartOnQuarterBeat = false;
+        updateClockedMachineActivity();
+    }
+}
+
+void TrackerMainProcessor::seekToSongTick(std::uint64_t ticksFromSongStart, int engineTickInGridTick)
+{
+    if (songRows.empty() || sequenceSets.empty())
+        return;
+
+    // in sequence mode the selected row loops forever, otherwise walk the arrangement
+    std::size_t row = std::min(selectedSongRow, songRows.size() - 1);
+    std::uint64_t ticksIntoRow = ticksFromSongStart;
+    if (songPlayMode == SongPlayMode::song)
+    {
+        std::uint64_t songTicks = 0;
+        for (const auto& songRow : songRows)
+            songTicks += static_cast<std::uint64_t>(juce::jmax(1, songRow.beatCount)) * 4u;
+        ticksIntoRow = ticksFromSongStart % songTicks;
+        row = 0;
+        while (ticksIntoRow >= static_cast<std::uint64_t>(juce::jmax(1, songRows[row].beatCount)) * 4u)
+        {
+            ticksIntoRow -= static_cast<std::uint64_t>(juce::jmax(1, songRows[row].beatCount)) * 4u;
+            ++row;
+        }
+    }
+
+    CommandProcessor::sendAllNotesOff();
+    // clock followers only take a new song position while stopped; the next tick sends it and continues
+    if (midiClockOutputRunning)
+    {
+        midiToSend.addEvent(MidiMessage::midiStop(), elapsedSamples);
+        midiClockOutputRunning = false;
+    }
+    resolveSongRowPatterns(row);
+    switchPlaybackSequenceSetImmediately(songRows[row].sequenceSetId, false);
+    currentSongRow = row;
+    selectedSongRow = row;
+    // handleSongBeatBoundary counts the row down on every beat after its first tick
+    const int beatCount = juce::jmax(1, songRows[row].beatCount);
+    currentSongRowBeatCounter = ticksIntoRow == 0
+        ? beatCount + 1
+        : beatCount - static_cast<int>((ticksIntoRow - 1u) / 4u);
+    // the next grid tick is tick ticksFromSongStart, with the song starting on quarter beat 1. Landing part way
+    // through the grid tick before it, the engine ticks left in that one have already gone by
+    const auto perGridTick = static_cast<std::uint64_t>(getTicksPerGridTick());
+    const int engineTicksIn = ticksFromSongStart == 0 ? 0 : juce::jlimit(0, getTicksPerGridTick() - 1, engineTickInGridTick);
+    auto engineTicksSince = [perGridTick, engineTicksIn](std::uint64_t gridTicks)
+    {
+        return engineTicksIn == 0 ? gridTicks * perGridTick : (gridTicks - 1u) * perGridTick + static_cast<std::uint64_t>(engineTicksIn);
+    };
+    // sequences of a row starting on the next grid tick must not hear the engine ticks left over from the row before
+    holdUntilGridTick = ticksIntoRow == 0 && engineTicksIn != 0;
+    if (auto* playbackSequencer = getPlaybackSequencerInternal())
+        playbackSequencer->seekTo(holdUntilGridTick ? 0u : engineTicksSince(ticksIntoRow));
+
+    setCurrentQuarterBeat(ticksFromSongStart == 0 ? 0 : static_cast<int>((ticksFromSongStart - 1u) % 16u) + 1);
+    setClockTicks(ticksFromSongStart == 0 ? -1 : static_cast<std::int64_t>(ticksFromSongStart - 1u));
+    engineTicksIntoGridTick = engineTicksIn;
+    notifyClockSeek(engineTicksSince(ticksFromSongStart));
+    pendingTransportQuarterBeatReset = false;
+    pendingPlaybackSequenceSetIndex.reset();
+    updateClockedMachineActivity();
+}
+
 std::size_t TrackerMainProcessor::getMachineCount(CommandType type) const
 {
     switch (type)
@@ -2694,12 +3667,13 @@ void TrackerMainProcessor::adjustMachineReturnLevelDbInStack(std::size_t stackIn
 void TrackerMainProcessor::allNotesOff()
 {
     midiToSend.clear();// remove anything that's hanging around. 
-    for (int chan = 1; chan < 17; ++chan){
-        midiToSend.addEvent(MidiMessage::allNotesOff(chan), static_cast<int>(elapsedSamples));
-    }
     samplerEventsToSend.clear();
     for (std::size_t i = 0; i < machineStacks.size(); ++i)
         allNotesOffForStack(i);
+    // stacks can change MIDI channel while notes sound, so sweep every channel the table still holds
+    for (int chan = 1; chan < 17; ++chan)
+        releaseMidiChannelNotes(chan);
+    clearParameterLocks();
 }
 
 std::string TrackerMainProcessor::describeStepNote(CommandType machineType, unsigned short machineId, unsigned short note) const
@@ -2754,6 +3728,49 @@ void TrackerMainProcessor::sendMessageToMachine(CommandType machineType, unsigne
                        velocity,
                        durInTicks);
 }
+void TrackerMainProcessor::sendParameterLock(unsigned short machineId, unsigned short slotIndex, unsigned short parameterId, unsigned short value, unsigned short holdTicks)
+{
+    const auto stackIndex = static_cast<std::size_t>(machineId);
+    auto* stack = getMachineStack(stackIndex);
+    const auto* slot = getMachineSlot(stackIndex, slotIndex);
+    // aux machines are shared by every stack, so one sequence does not get to lock them
+    if (stack == nullptr || slot == nullptr || isAuxSendType(slot->type))
+        return;
+    const auto* machine = getMachineForStackType(*stack, slot->type);
+    if (machine == nullptr || static_cast<int>(parameterId) >= machine->getLockableParameterCount())
+        return;
+
+    // a new lock brings its own release, so any release still waiting for this parameter would only cut it short
+    const CommandType machineType = slot->type;
+    int kept = 0;
+    for (int i = 0; i < parameterLockCount; ++i)
+    {
+        const auto& event = parameterLockQueue[static_cast<std::size_t>(i)];
+        const bool staleRelease = event.value < 0.0f
+            && event.stackIndex == stackIndex
+            && event.machineType == machineType
+            && event.parameterId == static_cast<int>(parameterId);
+        if (!staleRelease)
+            parameterLockQueue[static_cast<std::size_t>(kept++)] = event;
+    }
+    parameterLockCount = kept;
+    if (parameterLockCount + 2 > kParameterLockQueueSize)
+        return;
+
+    const int holdSamples = (static_cast<int>(samplesPerTick) * static_cast<int>(holdTicks)) % maxHorizon;
+    ParameterLockEvent lock;
+    lock.samplePosition = elapsedSamples;
+    lock.stackIndex = stackIndex;
+    lock.machineType = machineType;
+    lock.parameterId = static_cast<int>(parameterId);
+    lock.value = juce::jlimit(0.0f, 1.0f, static_cast<float>(value) / 127.0f);
+    ParameterLockEvent release = lock;
+    release.samplePosition = (elapsedSamples + holdSamples) % maxHorizon;
+    release.value = -1.0f;
+    parameterLockQueue[static_cast<std::size_t>(parameterLockCount++)] = lock;
+    parameterLockQueue[static_cast<std::size_t>(parameterLockCount++)] = release;
+}
+
 void TrackerMainProcessor::sendQueuedMessages(long tick)
 {
     juce::ignoreUnused(tick);
@@ -2769,15 +3786,15 @@ void TrackerMainProcessor::setBPM(double _bpm)
     assert(_bpm > 0);
     const double activeSampleRate = getSampleRate() > 0.0 ? getSampleRate() : 44100.0;
     // update tick interval in samples 
-    samplesPerTick = static_cast<unsigned int> (juce::jmax (1, static_cast<int> (std::lround (activeSampleRate * (60.0 / _bpm) / 8.0))));
+    samplesPerTick = static_cast<unsigned int> (juce::jmax (1, static_cast<int> (std::lround (activeSampleRate * (60.0 / _bpm) / getTicksPerQuarter()))));
     bpm.store(_bpm, std::memory_order_relaxed);
-    const double secondsPerTick = getSecondsPerTickFromBpm(_bpm);
+    const double secondsPerTick = getSecondsPerTickFromBpm(_bpm, getTicksPerQuarter());
     for (auto& stack : machineStacks)
     {
         if (stack.wavetableSynth != nullptr)
             stack.wavetableSynth->setSecondsPerTick(secondsPerTick);
         if (stack.delayFx != nullptr)
-            stack.delayFx->setSecondsPerTick(secondsPerTick);
+            stack.delayFx->setSecondsPerTick(secondsPerTick * getTicksPerGridTick());
     }
 }
 
@@ -2801,6 +3818,376 @@ bool TrackerMainProcessor::isHostClockActive() const
     return hostClockActive.load(std::memory_order_relaxed);
 }
 
+void TrackerMainProcessor::setLiveMidiThruEnabled(bool enabled)
+{
+    liveMidiThruEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool TrackerMainProcessor::isLiveMidiThruEnabled() const
+{
+    return liveMidiThruEnabled.load(std::memory_order_relaxed);
+}
+
+void TrackerMainProcessor::setMidiClockOutputEnabled(bool enabled)
+{
+    midiClockOutputEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool TrackerMainProcessor::isMidiClockOutputEnabled() const
+{
+    return midiClockOutputEnabled.load(std::memory_order_relaxed);
+}
+
+void TrackerMainProcessor::setMidiClockSlaveEnabled(bool enabled)
+{
+    midiClockSlaveEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool TrackerMainProcessor::isMidiClockSlaveEnabled() const
+{
+    return midiClockSlaveEnabled.load(std::memory_order_relaxed);
+}
+
+bool TrackerMainProcessor::setTickResolution(int ticksPerQuarter)
+{
+    const auto previousTicksPerGridTick = static_cast<std::size_t>(getTicksPerGridTick());
+    if (!setTicksPerQuarter(ticksPerQuarter))
+        return false;
+    // start the finer ticks on a grid tick, with the sequences' engine tick counts moved over to match.
+    // The arps follow by themselves on their next tick
+    engineTicksIntoGridTick = 0;
+    holdUntilGridTick = false;
+    if (static_cast<std::size_t>(getTicksPerGridTick()) != previousTicksPerGridTick)
+    {
+        for (auto& sequencer : sequenceSets)
+            if (sequencer != nullptr)
+                sequencer->rescaleTicks(previousTicksPerGridTick, static_cast<std::size_t>(getTicksPerGridTick()));
+    }
+    const std::int64_t gridTickSteps = kMidiClocksPerGridTick * getTicksPerGridTick();
+    midiClockNextTickPulse = ((midiClockPulsesReceived * getTicksPerGridTick() + gridTickSteps - 1) / gridTickSteps) * gridTickSteps;
+    setBPM(getBPM());
+    return true;
+}
+
+void TrackerMainProcessor::cycleTickResolution()
+{
+    constexpr std::array<int, 4> resolutions { 8, 24, 48, 96 };
+    const auto current = std::find(resolutions.begin(), resolutions.end(), getTicksPerQuarter());
+    const auto next = current == resolutions.end() || std::next(current) == resolutions.end()
+        ? resolutions.begin()
+        : std::next(current);
+    setTickResolution(*next);
+}
+
+void TrackerMainProcessor::emitMidiClockForTick(int engineTickInGridTick)
+{
+    auto* playbackSequencer = getPlaybackSequencerInternal();
+    const bool playing = playbackSequencer != nullptr && playbackSequencer->isPlaying();
+    if (!midiClockOutputEnabled.load(std::memory_order_relaxed) || !playing)
+    {
+        if (midiClockOutputRunning)
+            midiToSend.addEvent(MidiMessage::midiStop(), elapsedSamples);
+        midiClockOutputRunning = false;
+        return;
+    }
+
+    if (!midiClockOutputRunning)
+    {
+        // followers can only pick up on a sixteenth, so wait for a grid tick
+        if (engineTickInGridTick != 0)
+            return;
+        // from the top is a start, anywhere else is a song position then continue
+        const auto tick = getCurrentTick();
+        if (tick <= 0)
+            midiToSend.addEvent(MidiMessage::midiStart(), elapsedSamples);
+        else
+        {
+            midiToSend.addEvent(MidiMessage::songPositionPointer(static_cast<int>(tick / 2)), elapsedSamples);
+            midiToSend.addEvent(MidiMessage::midiContinue(), elapsedSamples);
+        }
+        midiClockOutputRunning = true;
+    }
+
+    // at 24 ppqn multiples the pulses sit on engine ticks, otherwise spread them up to the next grid tick
+    const int ticksPerGridTick = getTicksPerGridTick();
+    if (ticksPerGridTick % kMidiClocksPerGridTick == 0)
+    {
+        if (engineTickInGridTick % (ticksPerGridTick / kMidiClocksPerGridTick) == 0)
+            midiToSend.addEvent(MidiMessage::midiClock(), elapsedSamples);
+        return;
+    }
+    if (engineTickInGridTick != 0)
+        return;
+    const double samplesBetweenTicks = blockSamplesPerTick > 0.0 ? blockSamplesPerTick : static_cast<double>(samplesPerTick) * ticksPerGridTick;
+    for (int pulse = 0; pulse < kMidiClocksPerGridTick; ++pulse)
+    {
+        const int offset = static_cast<int>(std::lround(pulse * samplesBetweenTicks / kMidiClocksPerGridTick));
+        midiToSend.addEvent(MidiMessage::midiClock(), (elapsedSamples + offset) % maxHorizon);
+    }
+}
+
+void TrackerMainProcessor::runMidiClockSlaveBlock(const juce::MidiBuffer& midi, int blockStartSample, int blockSizeSamples)
+{
+    const double blockStart = static_cast<double>(totalSamplesProcessed);
+    const double blockEnd = static_cast<double>(blockSizeSamples);
+    // an engine tick is 3 / ticksPerGridTick pulses, i.e. kMidiClocksPerGridTick steps of 1 / ticksPerGridTick pulse
+    const std::int64_t pulseSteps = getTicksPerGridTick();
+    double now = 0.0;
+    auto it = midi.cbegin();
+    for (;;)
+    {
+        while (it != midi.cend() && !isMidiClockSyncMessage((*it).getMessage()))
+            ++it;
+        const double eventSample = it != midi.cend() ? static_cast<double>((*it).samplePosition) : blockEnd;
+
+        // grid ticks land on the smoothed time of every third pulse and engine ticks are spread between them,
+        // running at most one grid tick ahead of the last pulse that actually arrived
+        double tickSample = blockEnd;
+        const auto stepsAhead = midiClockNextTickPulse - midiClockPulsesReceived * pulseSteps;
+        if (midiClockLocked && stepsAhead < kMidiClocksPerGridTick * pulseSteps)
+        {
+            const double pulsesAhead = static_cast<double>(stepsAhead) / static_cast<double>(pulseSteps);
+            const double predicted = midiClockNextPulseTime + pulsesAhead * midiClockPeriod - blockStart;
+            tickSample = juce::jmax(now, predicted);
+        }
+
+        if (tickSample < eventSample && tickSample < blockEnd)
+        {
+            const int tickSampleOffset = static_cast<int>(tickSample);
+            blockSamplesPerTick = kMidiClocksPerGridTick * midiClockPeriod;
+            captureLiveMidi(midi, blockStartSample, tickSampleOffset);
+            elapsedSamples = (blockStartSample + tickSampleOffset) % maxHorizon;
+            if (processPlaybackTickBoundary())
+                liveMidiLastTickSample = tickSample;
+            midiClockNextTickPulse += kMidiClocksPerGridTick;
+            now = tickSample;
+            continue;
+        }
+        if (it == midi.cend())
+            break;
+
+        now = eventSample;
+        handleIncomingMidiClockMessage((*it).getMessage(), blockStart + eventSample);
+        ++it;
+    }
+}
+
+void TrackerMainProcessor::handleIncomingMidiClockMessage(const juce::MidiMessage& message, double absoluteSample)
+{
+    if (message.isMidiClock())
+    {
+        const double sampleRate = getSampleRate() > 0.0 ? getSampleRate() : 44100.0;
+        const double error = absoluteSample - midiClockNextPulseTime;
+        if (!midiClockLocked || std::abs(error) > 2.0 * midiClockPeriod)
+        {
+            // (re)lock: take the period from the last gap if it is believable, else from the current tempo
+            const double gap = absoluteSample - midiClockLastPulseTime;
+            if (midiClockLastPulseTime >= 0.0 && gap > 0.0 && gap < sampleRate)
+                midiClockPeriod = gap;
+            else if (midiClockPeriod <= 0.0)
+                midiClockPeriod = sampleRate * 60.0 / (getBPM() * 24.0);
+            midiClockNextPulseTime = absoluteSample + midiClockPeriod;
+            midiClockLocked = true;
+        }
+        else
+        {
+            midiClockNextPulseTime += kMidiClockLoopB * error + midiClockPeriod;
+            midiClockPeriod += kMidiClockLoopC * error;
+        }
+        midiClockLastPulseTime = absoluteSample;
+        ++midiClockPulsesReceived;
+        // after a dropout, pick the tick grid up again rather than firing a burst of catch-up ticks
+        const std::int64_t pulseSteps = getTicksPerGridTick();
+        const std::int64_t gridTickSteps = kMidiClocksPerGridTick * pulseSteps;
+        if (midiClockPulsesReceived * pulseSteps - midiClockNextTickPulse > gridTickSteps)
+        {
+            midiClockNextTickPulse = ((midiClockPulsesReceived * pulseSteps + gridTickSteps - 1) / gridTickSteps) * gridTickSteps;
+            engineTicksIntoGridTick = 0;
+        }
+        const double followedBpm = juce::jlimit(20.0, 400.0, sampleRate * 60.0 / (24.0 * midiClockPeriod));
+        if (std::abs(followedBpm - getBPM()) >= kMidiClockTempoToleranceBpm)
+            setBPM(followedBpm);
+        return;
+    }
+
+    auto* playbackSequencer = getPlaybackSequencerInternal();
+    if (message.isMidiStart())
+    {
+        // hold the first tick back until the downbeat pulse arrives
+        midiClockLocked = false;
+        midiClockPulsesReceived = 0;
+        midiClockNextTickPulse = 0;
+        seekToSongTick(0);
+        if (auto* startedSequencer = getPlaybackSequencerInternal())
+            startedSequencer->play();
+    }
+    else if (message.isSongPositionPointer())
+    {
+        // song position counts sixteenths: six pulses or two grid ticks each
+        const auto sixteenths = static_cast<std::int64_t>(message.getSongPositionPointerMidiBeat());
+        midiClockLocked = false;
+        midiClockPulsesReceived = sixteenths * 6;
+        midiClockNextTickPulse = midiClockPulsesReceived * getTicksPerGridTick();
+        const bool wasPlaying = playbackSequencer != nullptr && playbackSequencer->isPlaying();
+        seekToSongTick(static_cast<std::uint64_t>(sixteenths * 2));
+        if (auto* movedSequencer = getPlaybackSequencerInternal(); movedSequencer != nullptr && wasPlaying)
+            movedSequencer->play();
+    }
+    else if (message.isMidiContinue())
+    {
+        if (playbackSequencer != nullptr)
+            playbackSequencer->play();
+    }
+    else if (message.isMidiStop())
+    {
+        if (playbackSequencer != nullptr)
+            playbackSequencer->stop();
+    }
+    updateClockedMachineActivity();
+}
+
+void TrackerMainProcessor::captureLiveMidi(const juce::MidiBuffer& midi, int blockStartSample, int untilSample)
+{
+    if (untilSample <= liveMidiCaptureFrom)
+        return;
+
+    for (auto it = midi.findNextSamplePosition(liveMidiCaptureFrom); it != midi.cend(); ++it)
+    {
+        const auto metadata = *it;
+        if (metadata.samplePosition >= untilSample)
+            break;
+        const auto message = metadata.getMessage();
+        if (!message.isNoteOnOrOff())
+            continue;
+
+        const auto armed = seqEditor.getArmedSequence();
+        auto* playbackSequencer = getPlaybackSequencerInternal();
+        const bool recording = playbackSequencer != nullptr && playbackSequencer->isPlaying()
+            && armed < playbackSequencer->howManySequences();
+        // while playing, quantise against and write to the pattern the armed track is playing
+        std::size_t targetSetIndex = viewedSequenceSetIndex;
+        if (recording)
+        {
+            targetSetIndex = activePlaybackSequenceSetIndex;
+            if (currentSongRow < songRows.size() && songRows[currentSongRow].sequenceSetId == activePlaybackSequenceSetIndex)
+                targetSetIndex = getSongRowTrackPattern(currentSongRow, armed);
+        }
+        auto* targetSequencer = targetSetIndex < sequenceSets.size() ? sequenceSets[targetSetIndex].get() : nullptr;
+        if (targetSequencer == nullptr || armed >= targetSequencer->howManySequences())
+            continue;
+        auto* sequence = targetSequencer->getSequence(armed);
+        const double ticksPerStep = sequence->getTicksPerStep();
+
+        if (message.isNoteOn() && liveMidiThruEnabled.load(std::memory_order_relaxed))
+        {
+            // play it at the sample it arrived on, not the last tick
+            const int tickElapsedSamples = elapsedSamples;
+            elapsedSamples = (blockStartSample + metadata.samplePosition) % maxHorizon;
+            sendMessageToMachine(static_cast<CommandType>(static_cast<std::size_t>(sequence->getMachineType())),
+                                 static_cast<unsigned short>(sequence->getMachineId()),
+                                 static_cast<unsigned short>(message.getNoteNumber()),
+                                 static_cast<unsigned short>(message.getVelocity()),
+                                 gridToEngineTicks(ticksPerStep));
+            elapsedSamples = tickElapsedSamples;
+        }
+
+        if (!recording)
+            continue;
+
+        LiveMidiEvent event;
+        event.tick = getCurrentTick();
+        if (blockSamplesPerTick > 0.0)
+            event.tickFraction = juce::jlimit(0.0, 1.0, (metadata.samplePosition - liveMidiLastTickSample) / blockSamplesPerTick);
+        event.sequenceSet = targetSetIndex;
+        event.sequence = armed;
+        const std::size_t length = juce::jmax<std::size_t>(1, sequence->getLength());
+        event.nextStep = playbackSequencer->getCurrentStep(armed) % length;
+        event.lastStep = (event.nextStep + length - 1) % length;
+        // the sequence has counted up to the last engine tick, which may have come after the last grid tick
+        const int ticksPerGridTick = getTicksPerGridTick();
+        const int engineTicksSinceGridTick = (engineTicksIntoGridTick + ticksPerGridTick - 1) % ticksPerGridTick;
+        event.ticksIntoStep = static_cast<double>(playbackSequencer->getTicksElapsed(armed)) / ticksPerGridTick
+            - static_cast<double>(engineTicksSinceGridTick) / ticksPerGridTick + event.tickFraction;
+        event.ticksPerStep = static_cast<double>(CommandProcessor::toEngineTicks(ticksPerStep)) / ticksPerGridTick;
+        event.note = message.getNoteNumber();
+        event.velocity = message.getVelocity();
+        event.noteOn = message.isNoteOn();
+
+        int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+        liveMidiFifo.prepareToWrite(1, start1, size1, start2, size2);
+        if (size1 > 0)
+            liveMidiQueue[static_cast<std::size_t>(start1)] = event;
+        liveMidiFifo.finishedWrite(size1);
+    }
+    liveMidiCaptureFrom = untilSample;
+}
+
+void TrackerMainProcessor::runLiveMidiRecorder()
+{
+    std::vector<LiveMidiEvent> batch;
+    batch.reserve(kLiveMidiQueueSize);
+    while (liveMidiRecorderRunning.load(std::memory_order_acquire))
+    {
+        batch.clear();
+        int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+        liveMidiFifo.prepareToRead(liveMidiFifo.getNumReady(), start1, size1, start2, size2);
+        for (int i = 0; i < size1; ++i)
+            batch.push_back(liveMidiQueue[static_cast<std::size_t>(start1 + i)]);
+        for (int i = 0; i < size2; ++i)
+            batch.push_back(liveMidiQueue[static_cast<std::size_t>(start2 + i)]);
+        liveMidiFifo.finishedRead(size1 + size2);
+
+        if (batch.empty())
+        {
+            // nothing can arrive until a sequence is armed, so sleep until then
+            if (!seqEditor.isArmedForLiveMIDI())
+            {
+                std::unique_lock<std::mutex> lock(liveMidiRecorderMutex);
+                liveMidiRecorderWake.wait(lock, [this]()
+                {
+                    return !liveMidiRecorderRunning.load(std::memory_order_acquire) || seqEditor.isArmedForLiveMIDI();
+                });
+                continue;
+            }
+            // short poll so recording keeps up with the audio thread, not the UI frame rate
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        // recording only writes patterns, so it never waits for the audio thread
+        withEditorLock([&]()
+        {
+            for (const auto& event : batch)
+                recordLiveMidiEvent(event);
+        });
+    }
+}
+
+void TrackerMainProcessor::recordLiveMidiEvent(const LiveMidiEvent& event)
+{
+    const double position = static_cast<double>(event.tick) + event.tickFraction;
+    auto& held = heldLiveNotes[static_cast<std::size_t>(event.note & 127)];
+    if (!event.noteOn)
+    {
+        if (held.held && held.sequenceSet < sequenceSets.size())
+        {
+            seqEditor.recordLiveNoteLength(sequenceSets[held.sequenceSet].get(), held.sequence, held.step, held.row, position - held.onTick);
+            markProjectChanged();
+        }
+        held.held = false;
+        return;
+    }
+    if (event.sequenceSet >= sequenceSets.size())
+        return;
+
+    // snap to whichever step start is nearer: the one that just played or the one coming up
+    const std::size_t step = event.ticksIntoStep * 2.0 < event.ticksPerStep
+        ? event.lastStep
+        : event.nextStep;
+    const std::size_t row = seqEditor.recordLiveNote(sequenceSets[event.sequenceSet].get(), event.sequence, step, event.note, event.velocity);
+    held = { true, event.sequenceSet, event.sequence, step, row, position };
+    markProjectChanged();
+}
+
 
 void TrackerMainProcessor::clearPendingEvents()
 {
@@ -9,20 +9,26 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <array>
 #include <atomic>
+#include <bitset>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <deque>
 #include <optional>
 #include <thread>
 #include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 #include "MachineUtilsAbs.h"
+#include "ActiveNoteTable.h"
 #include "ClockAbs.h"
 #include "Sequencer.h"
 #include "SequencerEditor.h"
 #include "TrackerController.h"
+#include "ProjectFile.h"
 #include "SuperSamplerProcessor.h"
 #include "machines/ArpeggiatorMachine.h"
 #include "machines/PolyArpeggiatorMachine.h"
@@ -43,6 +49,7 @@ class TrackerMainProcessor  :    public MachineUtilsAbs,
                             public juce::ChangeBroadcaster,
                             public MachineHost,
                             public SongHost,
+                            public ProjectHost,
                             private juce::OSCReceiver::Listener<juce::OSCReceiver::MessageLoopCallback>
 
                             #if JucePlugin_Enable_ARA
@@ -57,6 +64,7 @@ public:
     // the MachineUtils interface 
     void allNotesOff() override;
     void sendMessageToMachine(CommandType machineType, unsigned short machineId, unsigned short note, unsigned short velocity, unsigned short durInTicks) override; 
+    void sendParameterLock(unsigned short machineId, unsigned short slotIndex, unsigned short parameterId, unsigned short value, unsigned short holdTicks) override;
     std::string describeStepNote(CommandType machineType, unsigned short machineId, unsigned short note) const override;
     void sendQueuedMessages(long tick) override; 
     // the ClockAbs interface
@@ -65,6 +73,21 @@ public:
     void setInternalClockEnabled(bool enabled);
     bool isInternalClockEnabled() const;
     bool isHostClockActive() const;
+    /** when on, live MIDI notes play straight through the armed sequence's machine stack */
+    void setLiveMidiThruEnabled(bool enabled);
+    bool isLiveMidiThruEnabled() const;
+    /** send 24 ppqn MIDI clock, start/stop/continue and song position along with the engine ticks */
+    void setMidiClockOutputEnabled(bool enabled);
+    bool isMidiClockOutputEnabled() const;
+    /** follow incoming MIDI clock and transport instead of the internal tempo */
+    void setMidiClockSlaveEnabled(bool enabled);
+    bool isMidiClockSlaveEnabled() const;
+    /** run the engine at 8, 24, 48 or 96 ticks per quarter. Sequences, arps and note lengths run on these ticks,
+     * so step lengths can fall between the 8 per quarter grid ticks; the song still moves on the grid.
+     * Saved with the project. Returns false for other values */
+    bool setTickResolution(int ticksPerQuarter);
+    /** step through the supported tick resolutions */
+    void cycleTickResolution();
     
 
     //==============================================================================
@@ -100,6 +123,14 @@ public:
     //==============================================================================
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
+    /** the project as readable JSON, for debugging. Older sessions saved this way still load */
+    juce::String exportStateAsJson();
+    // the ProjectHost interface
+    bool saveProjectFile(const std::string& path) override;
+    bool loadProjectFile(const std::string& path) override;
+    void setProjectAutosave(const std::string& path, int intervalSeconds) override;
+    /** tell the autosaver the project may have changed. Call after an edit, from any thread */
+    void markProjectChanged();
     /** wipes midiToSend  */
     void clearPendingEvents();
 
@@ -141,9 +172,17 @@ public:
     std::size_t addSongRowByCloningViewedSet() override;
     void removeSongRow(std::size_t row) override;
     void adjustSongRowSequenceSetId(std::size_t row, int direction) override;
+    std::size_t getSongRowTrackPattern(std::size_t row, std::size_t track) const override;
+    void adjustSongRowTrackPattern(std::size_t row, std::size_t track, int direction) override;
     void adjustSongRowBeatCount(std::size_t row, int direction) override;
     void toggleSongPlayback() override;
     void rewindSongTransport() override;
+    void seekSongPosition(std::size_t row, int beat, int tick, bool startPlaying) override;
+    /** put every sequence, arp and the song position where the sent number of grid ticks
+     * from the top of the song would leave them, without replaying those ticks.
+     * engineTickInGridTick places the engine part way into the last of those grid ticks.
+     * Call from the audio thread or inside withAudioThreadExclusive */
+    void seekToSongTick(std::uint64_t ticksFromSongStart, int engineTickInGridTick = 0);
     void sendCurrentCellValueOverOscIfChanged();
     void recreateSequencersAndMachines();
     struct PendingZoomCommand
@@ -154,10 +193,21 @@ public:
     };
     std::vector<PendingZoomCommand> consumePendingZoomCommands();
 
+    /** run fn holding the editor lock, which keeps the editing threads (UI, OSC, live recording)
+     * apart without holding up the audio thread. Enough for edits that only reach playback through
+     * published patterns, see SequencerEditor::editsOnlyPatterns. withAudioThreadExclusive takes it too */
+    template <typename Fn>
+    auto withEditorLock(Fn&& fn) -> decltype(fn())
+    {
+        const std::lock_guard<std::recursive_mutex> lock(editorMutex);
+        return fn();
+    }
+
     template <typename Fn>
     auto withAudioThreadExclusive(Fn&& fn) -> decltype(fn())
     {
         using ReturnType = decltype(fn());
+        const std::lock_guard<std::recursive_mutex> editorLock(editorMutex);
         for (;;)
         {
             while (processing.load(std::memory_order_acquire))
@@ -183,6 +233,26 @@ private:
     {
         std::size_t sequenceSetId = 0;
         int beatCount = 16;
+        /** per track, the sequence set whose pattern plays on that track, or -1 for this row's own set.
+         * Empty means every track plays from sequenceSetId
+        */
+        std::vector<int> trackPatterns;
+    };
+    /** pools filled during one save, so step blocks and whole patterns shared between sequence sets are stored once */
+    struct SongSaveTables
+    {
+        std::unordered_map<const Step::Rows*, int> indexOfBlock;
+        juce::Array<juce::var> blocks;
+        std::unordered_map<std::uint64_t, std::vector<std::pair<const Sequence*, int>>> patternsByHash;
+        juce::Array<juce::var> patterns;
+    };
+    /** the same pools read back during one load */
+    struct SongLoadTables
+    {
+        std::vector<Step::SharedRows> blocks;
+        juce::Array<juce::var> patterns;
+        /** where each pattern was first restored, so later uses can share its step blocks */
+        std::vector<std::pair<Sequencer*, std::size_t>> restoredPatterns;
     };
     std::vector<std::unique_ptr<Sequencer>> sequenceSets;
     std::vector<SongRow> songRows;
@@ -252,6 +322,8 @@ private:
     SharedAuxBus auxBus1;
     SharedAuxBus auxBus2;
     std::mutex audioMutex;
+    /** see withEditorLock. Recursive so an edit under it can step up to withAudioThreadExclusive */
+    std::recursive_mutex editorMutex;
     std::atomic<bool> processing { false };
     juce::MidiBuffer emptyMidiBuffer;
 
@@ -270,15 +342,86 @@ private:
     bool sequencerWasPlaying {false};
     std::atomic<bool> internalClockEnabled { true };
     std::atomic<bool> hostClockActive { false };
+    /** a live MIDI note, stamped on the audio thread with where it fell against the armed sequence */
+    struct LiveMidiEvent
+    {
+        /** last grid tick before the note */
+        std::int64_t tick = 0;
+        /** how far the note sat between that tick and the next, 0 to 1 */
+        double tickFraction = 0.0;
+        /** the set whose sequence plays on the armed track, which is where the note is written */
+        std::size_t sequenceSet = 0;
+        std::size_t sequence = 0;
+        /** the step that last triggered and the one that triggers next */
+        std::size_t lastStep = 0;
+        std::size_t nextStep = 0;
+        /** grid ticks from the last step's start to the note, and between steps. Fractional at finer resolutions */
+        double ticksIntoStep = 0.0;
+        double ticksPerStep = 1.0;
+        int note = 0;
+        int velocity = 0;
+        bool noteOn = true;
+    };
+    /** where a held live note was written, so its note-off can set the length */
+    struct HeldLiveNote
+    {
+        bool held = false;
+        std::size_t sequenceSet = 0;
+        std::size_t sequence = 0;
+        std::size_t step = 0;
+        std::size_t row = 0;
+        double onTick = 0.0;
+    };
+    static constexpr int kLiveMidiQueueSize = 512;
+    /** audio thread writes, recorder thread reads; never blocks either side */
+    std::array<LiveMidiEvent, kLiveMidiQueueSize> liveMidiQueue;
+    juce::AbstractFifo liveMidiFifo { kLiveMidiQueueSize };
+    /** block-relative sample of the last grid tick, used to place notes between ticks */
+    double liveMidiLastTickSample {0.0};
+    /** samples between grid ticks under whichever clock is driving this block */
+    double blockSamplesPerTick {0.0};
+    /** internal clock: samples from the start of the next block to the next engine tick */
+    double samplesUntilInternalTick {0.0};
+    /** first block sample whose incoming MIDI has not been captured yet */
+    int liveMidiCaptureFrom {0};
+    std::atomic<bool> liveMidiThruEnabled { false };
+    /** recorder thread only */
+    std::array<HeldLiveNote, 128> heldLiveNotes;
+    std::atomic<bool> liveMidiRecorderRunning { false };
+    std::thread liveMidiRecorder;
+    /** the recorder sleeps on this while nothing is armed. Notified when arming changes or on shutdown */
+    std::mutex liveMidiRecorderMutex;
+    std::condition_variable liveMidiRecorderWake;
+    std::atomic<bool> midiClockOutputEnabled { false };
+    /** true between sending start/continue and sending stop */
+    bool midiClockOutputRunning { false };
+    std::atomic<bool> midiClockSlaveEnabled { false };
+    /** running sample count, so incoming clock can be timed across blocks */
+    std::int64_t totalSamplesProcessed { 0 };
+    /** delay-locked loop that smooths incoming clock, in absolute samples */
+    bool midiClockLocked { false };
+    double midiClockPeriod { 0.0 };
+    double midiClockNextPulseTime { 0.0 };
+    double midiClockLastPulseTime { -1.0 };
+    /** pulses counted from the last start or song position, and the point the next engine tick waits for.
+     * The latter counts in 1/getTicksPerGridTick() pulse steps so every resolution lands on whole numbers */
+    std::int64_t midiClockPulsesReceived { 0 };
+    std::int64_t midiClockNextTickPulse { 0 };
+    /** engine ticks gone by since the last grid tick, 0 when the next engine tick is a grid tick */
+    int engineTicksIntoGridTick { 0 };
+    /** set by a seek landing just before a song row starts, so its sequences wait for the row's first grid tick */
+    bool holdUntilGridTick { false };
     std::atomic<double> bpm; 
-    int outstandingNoteOffs;
+    /** notes sounding per MIDI output channel and per sampler stack, with where their note-offs are due */
+    ActiveNoteTable activeMidiNotes;
+    ActiveNoteTable activeSamplerNotes;
     /** configure plugin params */
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
     /** stores the plugin state */
     juce::AudioProcessorValueTreeState apvts;
   
     juce::var stringGridToVar(const std::vector<std::vector<std::string>>& grid);
-    juce::var numberGridToVar(const std::vector<std::vector<double>>& grid);
+    static juce::var numberGridToVar(const std::vector<std::vector<double>>& grid);
   
     /** convert ui state into a var  */
     juce::var getUiState();
@@ -286,8 +429,50 @@ private:
     juce::var serializeSequencerState();
     /** retrieve state from var  */
     void restoreSequencerState(const juce::var& stateVar);
+    /** copy the patterns, song, editor and stack layout into the snapshot, one pattern per track.
+     * Step blocks are shared, not copied, so this is quick. Call inside withAudioThreadExclusive */
+    void captureProjectSnapshot(ProjectSnapshot& snapshot);
+    /** add each machine's own state to a captured snapshot. Machines guard their state themselves,
+     * so call this outside withAudioThreadExclusive */
+    void captureMachineStates(ProjectSnapshot& snapshot);
+    /** the sequence sets a snapshot describes, built away from the audio thread */
+    static std::vector<std::unique_ptr<Sequencer>> buildSequenceSets(const ProjectSnapshot& snapshot);
+    /** swap in sets from buildSequenceSets, leaving the replaced ones in builtSets to free later,
+     * and apply the rest of the snapshot apart from machine states. Call inside withAudioThreadExclusive */
+    void applyProjectSnapshot(const ProjectSnapshot& snapshot, std::vector<std::unique_ptr<Sequencer>>& builtSets);
+    static void restorePattern(Sequencer& target, std::size_t seqIndex, const ProjectSnapshot::Pattern& pattern);
+    /** the whole project, holding the audio thread only for captureProjectSnapshot */
+    ProjectSnapshot takeProjectSnapshot();
+    /** load the snapshot's machine states other than the samplers', which applyProjectSnapshot leaves out.
+     * Call outside withAudioThreadExclusive */
+    void restoreMachineStates(const ProjectSnapshot& snapshot);
+    /** load the snapshot's sampler states, which applyProjectSnapshot leaves out. Call outside withAudioThreadExclusive */
+    void restoreSamplerStates(const ProjectSnapshot& snapshot);
+    /** autosave thread loop: bring projectAutosaveFile up to date every projectAutosaveIntervalSeconds */
+    void runProjectAutosaver();
+    /** block until samples from the last loadProjectFile have finished loading */
+    void waitForProjectSampleLoader();
+    /** serialises project file reads and writes, and guards projectAutosaveFile */
+    std::mutex projectFileMutex;
+    std::unique_ptr<ProjectFile> projectAutosaveFile;
+    std::atomic<int> projectAutosaveIntervalSeconds { 0 };
+    std::atomic<bool> projectAutosaverRunning { false };
+    /** bumped by markProjectChanged; the autosaver skips intervals where it has not moved */
+    std::atomic<std::uint64_t> projectChangeGeneration { 1 };
+    std::thread projectAutosaver;
+    /** loads sample files after loadProjectFile has returned, so the project is usable straight away */
+    std::thread projectSampleLoader;
+    /** pull the viewed, playing and selected indices back inside the current sets and song rows */
+    void clampSongPosition();
+    /** put the editor cursor and mode back, clamped to the viewed sequence set */
+    void restoreEditorState(int sequence, int step, std::size_t songRowCursor, std::size_t songColCursor, const juce::String& mode);
+    static juce::String editModeName(SequencerEditorMode mode);
+    static MachineStack::SlotState restoreSlotState(CommandType type, bool enabled, float sendLevelDb, float returnLevelDb);
+    static void restoreMachineState(MachineInterface* machine, const juce::MemoryBlock& state);
     static std::unique_ptr<Sequencer> createDefaultSequenceSet();
     void resetSongState();
+    /** reset song rows and the transport, keeping the sequence sets */
+    void resetSongTransport();
     Sequencer* getViewedSequencerInternal();
     const Sequencer* getViewedSequencerInternal() const;
     Sequencer* getPlaybackSequencerInternal();
@@ -298,9 +483,28 @@ private:
     void applyPendingSequenceSetSwitchForCurrentQuarterBeat();
     bool isPlaybackSequencerAtBoundary() const;
     void handleSongBeatBoundary();
-    void primeSequenceSetForTransportStart(std::size_t index);
-    juce::var serializeSingleSequencer(const Sequencer& sequencerToSave) const;
-    void restoreSingleSequencer(Sequencer& target, const juce::var& seqVar);
+    /** stop and rewind the row's set, and the patterns it references from other sets, ready for the row to start */
+    void primeSongRowForTransportStart(std::size_t row);
+    juce::var serializeSingleSequencer(const Sequencer& sequencerToSave, SongSaveTables* tables = nullptr) const;
+    juce::var serializeSequence(const Sequencer& sequencerToSave, std::size_t seqIndex, SongSaveTables* tables) const;
+    void restoreSingleSequencer(Sequencer& target, const juce::var& seqVar, SongLoadTables* tables = nullptr);
+    void restoreSequence(Sequencer& target, std::size_t seqIndex, const juce::var& seqObj, const SongLoadTables* tables);
+    /** point the row's sequence set at the patterns its tracks reference. Call before the row starts playing */
+    void resolveSongRowPatterns(std::size_t row);
+    /** queue the row's sequence set for playback. Its track patterns are resolved when the switch lands */
+    void scheduleSongRowPlayback(std::size_t row);
+    /** audio thread: stamp the sent block's incoming notes that land before untilSample and queue them for recording */
+    void captureLiveMidi(const juce::MidiBuffer& midi, int blockStartSample, int untilSample);
+    /** recorder thread loop: drain the live MIDI queue into the armed sequence */
+    void runLiveMidiRecorder();
+    /** quantise a captured note onto the armed sequence's nearest step and write it */
+    void recordLiveMidiEvent(const LiveMidiEvent& event);
+    /** queue the start/continue and clock pulses that go with the engine tick being processed */
+    void emitMidiClockForTick(int engineTickInGridTick);
+    /** drive this block's engine ticks from the smoothed incoming MIDI clock */
+    void runMidiClockSlaveBlock(const juce::MidiBuffer& midi, int blockStartSample, int blockSizeSamples);
+    /** feed one incoming clock, start, stop, continue or song position message to the loop and transport */
+    void handleIncomingMidiClockMessage(const juce::MidiMessage& message, double absoluteSample);
     static constexpr std::size_t kMachineStackCount = 16;
     MachineStack* getMachineStack(std::size_t stackIndex);
     const MachineStack* getMachineStack(std::size_t stackIndex) const;
@@ -331,7 +535,8 @@ private:
     void updateClockedMachineActivity();
     void emitQuarterBeatTickIfNeeded();
     void emitClockedMachineEvent(std::size_t stackIndex, CommandType machineType, const MachineNoteEvent& event);
-    void processPlaybackTickBoundary();
+    /** run one engine tick. Returns true if it was also a grid tick, which moves the song and sequences on */
+    bool processPlaybackTickBoundary();
     void enqueueMachineMidi(juce::MidiBuffer& targetBuffer,
                             unsigned short channel,
                             unsigned short outNote,
@@ -350,6 +555,43 @@ private:
                                   unsigned short durInTicks,
                                   std::size_t startSlotIndex = 0);
     void allNotesOffForStack(std::size_t stackIndex);
+    /** send note-offs now for the notes sounding on the stack's sampler */
+    void releaseSamplerNotes(std::size_t stackIndex);
+    /** send note-offs now for the notes sounding on the MIDI output channel (1-16) */
+    void releaseMidiChannelNotes(int channel);
+    /** release the notes of stacks that lost their last unmuted sequence since the last call */
+    void releaseNotesOfIdleStacks();
+    /** add the note-offs that fall due in this block to the outgoing and sampler buffers */
+    void flushDueNoteOffs(juce::MidiBuffer& midiMessages, int blockStartSample, int blockEndSample);
+    /** stacks that had an unmuted sequence at the last releaseNotesOfIdleStacks call */
+    std::bitset<kMachineStackCount> stacksWithLiveSequences;
+    /** a step's parameter lock, or the release of one, waiting for its sample */
+    struct ParameterLockEvent
+    {
+        /** on the wrapping elapsed sample clock while queued, an offset into the block once collected */
+        int samplePosition = 0;
+        std::size_t stackIndex = 0;
+        CommandType machineType = CommandType::MidiNote;
+        int parameterId = 0;
+        /** 0-1 across the parameter's range, or negative to hand the parameter back */
+        float value = -1.0f;
+    };
+    static constexpr int kParameterLockQueueSize = 256;
+    /** audio thread only, in the order events were queued, so a release queued by an earlier step
+     * still lands before a lock queued for the same sample */
+    std::array<ParameterLockEvent, kParameterLockQueueSize> parameterLockQueue;
+    int parameterLockCount { 0 };
+    /** the events that fall in the block being rendered, sorted by block offset */
+    std::array<ParameterLockEvent, kParameterLockQueueSize> blockParameterLocks;
+    int blockParameterLockCount { 0 };
+    /** move the queued parameter lock events that fall in this block into blockParameterLocks */
+    void collectBlockParameterLocks(int blockStartSample, int blockEndSample);
+    /** set or release one parameter lock on its machine */
+    void applyParameterLock(const ParameterLockEvent& event);
+    /** drop queued locks and hand every locked parameter back to its machine */
+    void clearParameterLocks();
+    /** run the stack's wavetable and effect slots over part of its render buffer */
+    void renderStackSegment(MachineStack& stack, int startSample, int numSamples);
     //==============================================================================
     juce::OSCReceiver oscReceiver;
     juce::OSCSender oscSender;
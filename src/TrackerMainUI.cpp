@@ -185,7 +185,7 @@ void TrackerMainUI::timerCallback ()
   // check what to draw based on the state of the 
   // editor
   SequencerEditorMode editMode = SequencerEditorMode::selectingSeqAndStep;
-  audioProcessor.withAudioThreadExclusive([&]()
+  audioProcessor.withEditorLock([&]()
   {
       editMode = seqEditor->getEditMode();
   });
@@ -233,7 +233,7 @@ void TrackerMainUI::timerCallback ()
     {
       const int bpmInt = static_cast<int>(std::lround(audioProcessor.getBPM()));
       std::string hudTitle;
-      audioProcessor.withAudioThreadExclusive([&]()
+      audioProcessor.withEditorLock([&]()
       {
           const auto sequenceIndex = seqEditor->getCurrentSequence();
           const auto stepIndex = seqEditor->getCurrentStep();
@@ -268,7 +268,7 @@ void TrackerMainUI::timerCallback ()
 
   waitingForPaint = true; 
   if (updateSeqStrOnNextDraw || framesDrawn % 60 == 0){
-    audioProcessor.withAudioThreadExclusive([&]()
+    audioProcessor.withEditorLock([&]()
     {
         audioProcessor.getSequencer()->requestStrUpdate();
     });
@@ -298,7 +298,8 @@ void TrackerMainUI::prepareSequenceView()
   size_t currentStep = 0;
   size_t armedSequence = SequencerAbs::notArmed;
   bool isPlaying = false;
-  audioProcessor.withAudioThreadExclusive([&]()
+  // only editor state and the playheads, which tick keeps readable, so the audio thread can carry on
+  audioProcessor.withEditorLock([&]()
   {
       currentSequence = seqEditor->getCurrentSequence();
       currentStep = seqEditor->getCurrentStep();
@@ -346,7 +347,7 @@ void TrackerMainUI::prepareStepView()
     size_t currentStepCol = 0;
     size_t currentStepRow = 0;
     bool isPlaying = false;
-    audioProcessor.withAudioThreadExclusive([&]()
+    audioProcessor.withEditorLock([&]()
     {
         currentSequence = seqEditor->getCurrentSequence();
         currentStep = seqEditor->getCurrentStep();
@@ -410,7 +411,7 @@ void TrackerMainUI::prepareSeqConfigView()
     });
 
     constexpr std::size_t mixerRows = 8;
-    constexpr std::size_t baseRows = 3;
+    constexpr std::size_t baseRows = 4;
     constexpr float minGainDb = -48.0f;
     constexpr float maxGainDb = 6.0f;
     const std::size_t totalRows = baseRows + mixerRows;
@@ -755,17 +756,21 @@ void TrackerMainUI::prepareSongView()
     std::size_t currentSongRow = 0;
     std::size_t currentSongCol = 0;
     std::size_t playbackSongRow = 0;
+    std::size_t trackCount = 0;
     SongPlayMode playMode = SongPlayMode::sequence;
     audioProcessor.withAudioThreadExclusive([&]()
     {
         rowCount += audioProcessor.getSongRowCount();
+        if (auto* sequencer = audioProcessor.getSequencer())
+            trackCount = sequencer->howManySequences();
         currentSongRow = seqEditor->getCurrentSongRow();
         currentSongCol = seqEditor->getCurrentSongCol();
         playbackSongRow = audioProcessor.getCurrentPlaybackSongRow();
         playMode = audioProcessor.getSongPlayMode();
     });
 
-    std::vector<std::vector<UIBox>> boxes(4, std::vector<UIBox>(rowCount));
+    const std::size_t colCount = SequencerEditor::songTrackFirstCol + trackCount;
+    std::vector<std::vector<UIBox>> boxes(colCount, std::vector<UIBox>(rowCount));
 
     boxes[0][0].kind = UIBox::Kind::TrackerCell;
     boxes[0][0].text = "PLAY SONG";
@@ -775,8 +780,11 @@ void TrackerMainUI::prepareSongView()
     boxes[1][0].isHighlighted = playMode == SongPlayMode::sequence;
     boxes[2][0].kind = UIBox::Kind::None;
     boxes[2][0].isDisabled = true;
-    boxes[3][0].kind = UIBox::Kind::None;
-    boxes[3][0].isDisabled = true;
+    for (std::size_t col = 3; col < colCount; ++col)
+    {
+        boxes[col][0].kind = UIBox::Kind::None;
+        boxes[col][0].isDisabled = true;
+    }
 
     audioProcessor.withAudioThreadExclusive([&]()
     {
@@ -791,22 +799,26 @@ void TrackerMainUI::prepareSongView()
             boxes[2][displayRow].text = "EDIT";
             boxes[3][displayRow].kind = UIBox::Kind::TrackerCell;
             boxes[3][displayRow].text = "DEL";
+            for (std::size_t track = 0; track < trackCount; ++track)
+            {
+                auto& box = boxes[SequencerEditor::songTrackFirstCol + track][displayRow];
+                box.kind = UIBox::Kind::TrackerCell;
+                box.text = "T" + std::to_string(track + 1) + " " + std::to_string(audioProcessor.getSongRowTrackPattern(row, track) + 1);
+            }
 
             if (playMode == SongPlayMode::song && row == playbackSongRow)
             {
-                boxes[0][displayRow].isHighlighted = true;
-                boxes[1][displayRow].isHighlighted = true;
-                boxes[2][displayRow].isHighlighted = true;
-                boxes[3][displayRow].isHighlighted = true;
+                for (std::size_t col = 0; col < colCount; ++col)
+                    boxes[col][displayRow].isHighlighted = true;
             }
         }
     });
 
     currentSongRow = std::min(currentSongRow, rowCount - 1);
-    currentSongCol = std::min(currentSongCol, static_cast<std::size_t>(currentSongRow == 0 ? 1 : 3));
+    currentSongCol = std::min(currentSongCol, currentSongRow == 0 ? std::size_t{1} : colCount - 1);
     boxes[currentSongCol][currentSongRow].isSelected = true;
 
-    updateCellStates(boxes, rowCount, 4);
+    updateCellStates(boxes, rowCount, colCount);
     overlayState.text = "Song";
     overlayState.color = palette.textPrimary;
     overlayState.glowColor = palette.gridPlayhead;
@@ -1183,213 +1195,309 @@ float TrackerMainUI::getSamplerCellDepthScale(const UIBox& cell) const
 bool TrackerMainUI::keyPressed(const juce::KeyPress& key, juce::Component* originatingComponent)
 {
     juce::ignoreUnused(originatingComponent);
-    return audioProcessor.withAudioThreadExclusive([&]() -> bool
+    const bool handled = audioProcessor.withEditorLock([&]() -> bool
     {
-        if (key.getModifiers().isShiftDown())
-        {
-            const juce::juce_wchar ch = key.getTextCharacter();
-            if (ch == 'C' || ch == 'c')
-            {
-                const bool enabled = audioProcessor.isInternalClockEnabled();
-                audioProcessor.setInternalClockEnabled(!enabled);
-                return true;
-            }
-        }
-
-        if (key.getModifiers().isCtrlDown())
-        {
-            const int keyCode = key.getKeyCode();
-            if (keyCode == 'r' || keyCode == 'R')
-            {
-                seqEditor->requestTrackerReset();
-                audioProcessor.getSequencer()->requestStrUpdate();
-                return true;
-            }
-#if JucePlugin_Build_Standalone
-            if (keyCode == 'q' || keyCode == 'Q')
-            {
-                seqEditor->requestApplicationQuit();
-                audioProcessor.getSequencer()->requestStrUpdate();
-                return true;
-            }
-
-            if (keyCode == 'p' || keyCode == 'P')
-            {
-                showStandaloneAudioMidiSettings();
-                return true;
-            }
-#endif
-        }
+        // pattern edits reach playback through the patterns they publish, so they leave the
+        // audio thread alone. Anything else may touch state it reads directly
+        if (isPatternEditKey(key))
+            return handleKeyPress(key, false);
+        return audioProcessor.withAudioThreadExclusive([&]() { return handleKeyPress(key, true); });
+    });
+    if (handled)
+        audioProcessor.markProjectChanged();
+    return handled;
+}
 
-        bool handled = false;
+bool TrackerMainUI::isPatternEditKey(const juce::KeyPress& key) const
+{
+    const auto modifiers = key.getModifiers();
+    if (modifiers.isCtrlDown())
+    {
+        // undo and redo follow what they would change: pattern edits stay off the audio thread
         const int keyCode = key.getKeyCode();
-        const char ch = static_cast<char>(std::tolower(static_cast<unsigned char>(key.getTextCharacter())));
-        const bool machineCapturesKeyboard = seqEditor->machineWantsExclusiveKeyboardInput();
-
-        if (machineCapturesKeyboard && !key.getModifiers().isCtrlDown())
-        {
-            if (key.isKeyCode(juce::KeyPress::backspaceKey))
-                return seqEditor->machineHandleTextBackspace();
-
-            if (ch >= 32 && ch <= 126)
-                return seqEditor->machineHandleTextInput(ch);
-        }
+        if (keyCode == 'z' || keyCode == 'Z')
+            return modifiers.isShiftDown() ? seqEditor->redoEditsOnlyPatterns() : seqEditor->undoEditsOnlyPatterns();
+        if (keyCode == 'y' || keyCode == 'Y')
+            return seqEditor->redoEditsOnlyPatterns();
+    }
+    if (modifiers.isCtrlDown() || modifiers.isShiftDown() || !seqEditor->editsOnlyPatterns()
+        || seqEditor->machineWantsExclusiveKeyboardInput())
+        return false;
+
+    if (key.isKeyCode(juce::KeyPress::upKey) || key.isKeyCode(juce::KeyPress::downKey)
+        || key.isKeyCode(juce::KeyPress::leftKey) || key.isKeyCode(juce::KeyPress::rightKey)
+        || key.isKeyCode(juce::KeyPress::backspaceKey) || key.isKeyCode(juce::KeyPress::returnKey))
+        return true;
+
+    const char ch = static_cast<char>(std::tolower(static_cast<unsigned char>(key.getTextCharacter())));
+    if (seqEditor->isPatternEditKey(ch))
+        return true;
+    if (seqEditor->isNoteKey(ch))
+        return false;
+    switch (ch)
+    {
+        case '\t':
+        case ',':
+        case '.':
+            return true;
+        // on the sequence page these reach sequence state the audio thread reads outside
+        // the published pattern, so they stay exclusive there. So does the mute key, q
+        case '-':
+        case '=':
+        case '[':
+        case ']':
+            return seqEditor->getCurrentPage() == SequencerEditorPage::step;
+        default:
+            return false;
+    }
+}
 
-        if (key.isKeyCode(juce::KeyPress::spaceKey))
+bool TrackerMainUI::handleKeyPress(const juce::KeyPress& key, bool previewNotes)
+{
+    if (key.getModifiers().isShiftDown())
+    {
+        const juce::juce_wchar ch = key.getTextCharacter();
+        if (ch == 'C' || ch == 'c')
         {
-            seqEditor->togglePlayback();
-            handled = true;
+            const bool enabled = audioProcessor.isInternalClockEnabled();
+            audioProcessor.setInternalClockEnabled(!enabled);
+            return true;
         }
-        else if (keyCode == '5')
+        if (ch == 'T' || ch == 't')
         {
-            handled = seqEditor->enterMachineDetailFromAnywhere();
+            audioProcessor.setLiveMidiThruEnabled(!audioProcessor.isLiveMidiThruEnabled());
+            return true;
         }
-        else if (keyCode >= '1' && keyCode <= '6')
+        if (ch == 'O' || ch == 'o')
         {
-            handled = seqEditor->selectPageShortcut(keyCode - '0');
+            audioProcessor.setMidiClockOutputEnabled(!audioProcessor.isMidiClockOutputEnabled());
+            return true;
         }
-        else if (seqEditor->handleChordKey(ch))
+        if (ch == 'F' || ch == 'f')
         {
-            handled = true;
+            audioProcessor.setMidiClockSlaveEnabled(!audioProcessor.isMidiClockSlaveEnabled());
+            return true;
         }
-        else if (seqEditor->handleNoteKey(ch))
+        if (ch == 'R' || ch == 'r')
         {
-            handled = true;
+            audioProcessor.cycleTickResolution();
+            return true;
         }
-        else if (key.isKeyCode(juce::KeyPress::backspaceKey))
+    }
+
+    if (key.getModifiers().isCtrlDown())
+    {
+        const int keyCode = key.getKeyCode();
+        if (keyCode == 'r' || keyCode == 'R')
         {
-            handled = seqEditor->machineHandleTextBackspace();
-            if (!handled)
-            {
-                seqEditor->resetAtCursor();
-                handled = true;
-            }
+            seqEditor->requestTrackerReset();
+            audioProcessor.getSequencer()->requestStrUpdate();
+            return true;
         }
-        else if (key.isKeyCode(juce::KeyPress::escapeKey))
+        if (keyCode == 'z' || keyCode == 'Z')
         {
-            handled = seqEditor->dismissCurrentTransientUi();
+            if (key.getModifiers().isShiftDown())
+                seqEditor->redo();
+            else
+                seqEditor->undo();
+            audioProcessor.getSequencer()->requestStrUpdate();
+            return true;
         }
-        else if (key.isKeyCode(juce::KeyPress::returnKey))
+        if (keyCode == 'y' || keyCode == 'Y')
         {
-            seqEditor->click();
-            handled = true;
+            seqEditor->redo();
+            audioProcessor.getSequencer()->requestStrUpdate();
+            return true;
         }
-        else if (key.isKeyCode(juce::KeyPress::upKey))
+#if JucePlugin_Build_Standalone
+        if (keyCode == 'q' || keyCode == 'Q')
         {
-            seqEditor->moveCursorUp();
-            handled = true;
+            seqEditor->requestApplicationQuit();
+            audioProcessor.getSequencer()->requestStrUpdate();
+            return true;
         }
-        else if (key.isKeyCode(juce::KeyPress::pageUpKey))
+
+        if (keyCode == 'p' || keyCode == 'P')
         {
-            if (seqEditor->getCurrentPage() == SequencerEditorPage::machine)
-            {
-                for (int i = 0; i < 6; ++i)
-                    seqEditor->moveCursorUp();
-                handled = true;
-            }
+            showStandaloneAudioMidiSettings();
+            return true;
         }
-        else if (key.isKeyCode(juce::KeyPress::downKey))
+#endif
+    }
+
+    bool handled = false;
+    const int keyCode = key.getKeyCode();
+    const char ch = static_cast<char>(std::tolower(static_cast<unsigned char>(key.getTextCharacter())));
+    const bool machineCapturesKeyboard = seqEditor->machineWantsExclusiveKeyboardInput();
+
+    if (machineCapturesKeyboard && !key.getModifiers().isCtrlDown())
+    {
+        if (key.isKeyCode(juce::KeyPress::backspaceKey))
+            return seqEditor->machineHandleTextBackspace();
+
+        if (ch >= 32 && ch <= 126)
+            return seqEditor->machineHandleTextInput(ch);
+    }
+
+    if (key.isKeyCode(juce::KeyPress::spaceKey) && key.getModifiers().isShiftDown())
+    {
+        seqEditor->playFromCursor();
+        handled = true;
+    }
+    else if (key.isKeyCode(juce::KeyPress::spaceKey))
+    {
+        seqEditor->togglePlayback();
+        handled = true;
+    }
+    else if (keyCode == '5')
+    {
+        handled = seqEditor->enterMachineDetailFromAnywhere();
+    }
+    else if (keyCode >= '1' && keyCode <= '6')
+    {
+        handled = seqEditor->selectPageShortcut(keyCode - '0');
+    }
+    else if (seqEditor->handleChordKey(ch))
+    {
+        handled = true;
+    }
+    else if (seqEditor->handleNoteKey(ch, previewNotes))
+    {
+        handled = true;
+    }
+    else if (key.isKeyCode(juce::KeyPress::backspaceKey))
+    {
+        handled = seqEditor->machineHandleTextBackspace();
+        if (!handled)
         {
-            seqEditor->moveCursorDown();
+            seqEditor->resetAtCursor();
             handled = true;
         }
-        else if (key.isKeyCode(juce::KeyPress::pageDownKey))
-        {
-            if (seqEditor->getCurrentPage() == SequencerEditorPage::machine)
-            {
-                for (int i = 0; i < 6; ++i)
-                    seqEditor->moveCursorDown();
-                handled = true;
-            }
-        }
-        else if (key.isKeyCode(juce::KeyPress::leftKey))
+    }
+    else if (key.isKeyCode(juce::KeyPress::escapeKey))
+    {
+        handled = seqEditor->dismissCurrentTransientUi();
+    }
+    else if (key.isKeyCode(juce::KeyPress::returnKey))
+    {
+        seqEditor->click();
+        handled = true;
+    }
+    else if (key.isKeyCode(juce::KeyPress::upKey))
+    {
+        seqEditor->moveCursorUp();
+        handled = true;
+    }
+    else if (key.isKeyCode(juce::KeyPress::pageUpKey))
+    {
+        if (seqEditor->getCurrentPage() == SequencerEditorPage::machine)
         {
-            seqEditor->moveCursorLeft();
+            for (int i = 0; i < 6; ++i)
+                seqEditor->moveCursorUp();
             handled = true;
         }
-        else if (key.isKeyCode(juce::KeyPress::rightKey))
+    }
+    else if (key.isKeyCode(juce::KeyPress::downKey))
+    {
+        seqEditor->moveCursorDown();
+        handled = true;
+    }
+    else if (key.isKeyCode(juce::KeyPress::pageDownKey))
+    {
+        if (seqEditor->getCurrentPage() == SequencerEditorPage::machine)
         {
-            seqEditor->moveCursorRight();
+            for (int i = 0; i < 6; ++i)
+                seqEditor->moveCursorDown();
             handled = true;
         }
-        else
+    }
+    else if (key.isKeyCode(juce::KeyPress::leftKey))
+    {
+        seqEditor->moveCursorLeft();
+        handled = true;
+    }
+    else if (key.isKeyCode(juce::KeyPress::rightKey))
+    {
+        seqEditor->moveCursorRight();
+        handled = true;
+    }
+    else
+    {
+        switch (ch)
         {
-            switch (ch)
-            {
-                case 'q':
-                    seqEditor->toggleMuteCurrentSequence();
-                    handled = true;
-                    break;
-                case 'w':
-                // toggle solo
-                    // seqEditor->toggleMuteCurrentSequence();
-                    handled = true;
-                    break;
-                    
-                case 'e':
-                    seqEditor->toggleArmCurrentSequence();
-                    handled = true;
-                    break;
-                case 'r':
-                    seqEditor->rewindTransport();
-                    handled = true;
-                    break;
-                case '\t':
-                    if (seqEditor->getCurrentPage() == SequencerEditorPage::machine && seqEditor->isEditingMachineDetail())
-                        handled = seqEditor->cycleMachineDetailNext();
-                    else
-                    {
-                        seqEditor->nextStep();
-                        handled = true;
-                    }
-                    break;
-                case '-':
-                    seqEditor->removeRow();
-                    handled = true;
-                    break;
-                case '=':
-                    seqEditor->addRow();
-                    handled = true;
-                    break;
-                case '_':
-                {
-                    const double bpm = audioProcessor.getBPM();
-                    audioProcessor.setBPM(bpm <= 1.0 ? 1.0 : bpm - 1.0);
-                    handled = true;
-                    break;
-                }
-                case '+':
+            case 'q':
+                seqEditor->toggleMuteCurrentSequence();
+                handled = true;
+                break;
+            case 'w':
+            // toggle solo
+                // seqEditor->toggleMuteCurrentSequence();
+                handled = true;
+                break;
+                
+            case 'e':
+                seqEditor->toggleArmCurrentSequence();
+                handled = true;
+                break;
+            case 'r':
+                seqEditor->rewindTransport();
+                handled = true;
+                break;
+            case '\t':
+                if (seqEditor->getCurrentPage() == SequencerEditorPage::machine && seqEditor->isEditingMachineDetail())
+                    handled = seqEditor->cycleMachineDetailNext();
+                else
                 {
-                    audioProcessor.setBPM(audioProcessor.getBPM() + 1.0);
+                    seqEditor->nextStep();
                     handled = true;
-                    break;
                 }
-                case '[':
-                    seqEditor->decrementAtCursor();
-                    handled = true;
-                    break;
-                case ']':
-                    seqEditor->incrementAtCursor();
-                    handled = true;
-                    break;
-                case ',':
-                    seqEditor->decrementOctave();
-                    handled = true;
-                    break;
-                case '.':
-                    seqEditor->incrementOctave();
-                    handled = true;
-                    break;
-                default:
-                    break;
+                break;
+            case '-':
+                seqEditor->removeRow();
+                handled = true;
+                break;
+            case '=':
+                seqEditor->addRow();
+                handled = true;
+                break;
+            case '_':
+            {
+                const double bpm = audioProcessor.getBPM();
+                audioProcessor.setBPM(bpm <= 1.0 ? 1.0 : bpm - 1.0);
+                handled = true;
+                break;
+            }
+            case '+':
+            {
+                audioProcessor.setBPM(audioProcessor.getBPM() + 1.0);
+                handled = true;
+                break;
             }
+            case '[':
+                seqEditor->decrementAtCursor();
+                handled = true;
+                break;
+            case ']':
+                seqEditor->incrementAtCursor();
+                handled = true;
+                break;
+            case ',':
+                seqEditor->decrementOctave();
+                handled = true;
+                break;
+            case '.':
+                seqEditor->incrementOctave();
+                handled = true;
+                break;
+            default:
+                break;
         }
+    }
 
-        if (handled)
-            audioProcessor.getSequencer()->requestStrUpdate();
+    if (handled)
+        audioProcessor.getSequencer()->requestStrUpdate();
 
-        return handled;
-    });
+    return handled;
 }
 
 bool TrackerMainUI::keyStateChanged(bool isKeyDown, juce::Component* originatingComponent)
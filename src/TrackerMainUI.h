@@ -53,6 +53,11 @@ public:
     // void updateStringOnNextDraw();
     long framesDrawn; 
 private:
+    /** true for keys that only edit the viewed patterns or move the cursor over them,
+     * which keyPressed runs without holding up the audio thread */
+    bool isPatternEditKey(const juce::KeyPress& key) const;
+    /** act on a key. previewNotes lets a typed note sound through its machine while stopped */
+    bool handleKeyPress(const juce::KeyPress& key, bool previewNotes);
 
 // some variables to control the display style
     // render sizes for cells and 
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+
+// Closed-form arpeggiator read head positions, so transport seeks never replay clock ticks.
+namespace ArpSeek
+{
+/** Order an ordered read head walks its slots in. Random heads are positioned by the caller. */
+enum class Order
+{
+    forward,
+    backward,
+    pingPong
+};
+
+/** Where a read head sits after a number of advances from reset. */
+struct HeadPosition
+{
+    int playHead = -1;
+    int pingPongDirection = 1;
+    int octaveIndex = 0;
+};
+
+/** How many times a head with the sent divisor advanced during the first ticks after a clock reset.
+    Heads advance on every tick whose index is a multiple of the divisor, starting with tick 0. */
+inline std::uint64_t advancesAfterTicks(std::uint64_t ticks, int divisor)
+{
+    const auto safeDivisor = static_cast<std::uint64_t>(divisor > 0 ? divisor : 1);
+    return (ticks + safeDivisor - 1u) / safeDivisor;
+}
+
+/** The ticksSinceStep counter a head holds after the sent number of ticks. */
+inline int ticksSinceStepAfterTicks(std::uint64_t ticks, int divisor)
+{
+    const int safeDivisor = divisor > 0 ? divisor : 1;
+    if (ticks == 0)
+        return safeDivisor - 1;
+    return static_cast<int>((ticks - 1u) % static_cast<std::uint64_t>(safeDivisor));
+}
+
+/** Matches what repeated advancePlayHead calls on a freshly reset head would leave behind. */
+inline HeadPosition positionAfterAdvances(Order order, int length, int octaveSpan, std::uint64_t advances)
+{
+    HeadPosition position;
+    if (advances == 0 || length <= 0)
+        return position;
+
+    const auto len = static_cast<std::uint64_t>(length);
+    const auto span = static_cast<std::uint64_t>(octaveSpan > 1 ? octaveSpan : 1);
+    const std::uint64_t index = advances - 1u;
+    std::uint64_t octaveWraps = 0;
+
+    if (order == Order::forward)
+    {
+        position.playHead = static_cast<int>(index % len);
+        octaveWraps = index / len;
+    }
+    else if (order == Order::backward)
+    {
+        position.playHead = static_cast<int>(len - 1u - (index % len));
+        octaveWraps = index / len;
+    }
+    else if (length == 1)
+    {
+        // a single slot bounces in place, flipping direction every step
+        position.playHead = 0;
+        position.pingPongDirection = (advances % 2u) == 1u ? 1 : -1;
+        octaveWraps = advances >= 3u ? (advances - 1u) / 2u : 0u;
+    }
+    else
+    {
+        // 0,1..len-1,len-2..1 then back to 0; the octave moves on when we leave 0 going up again
+        const std::uint64_t period = 2u * (len - 1u);
+        const std::uint64_t phase = index % period;
+        if (phase == 0)
+        {
+            position.playHead = 0;
+            position.pingPongDirection = advances == 1u ? 1 : -1;
+        }
+        else if (phase < len)
+        {
+            position.playHead = static_cast<int>(phase);
+            position.pingPongDirection = 1;
+        }
+        else
+        {
+            position.playHead = static_cast<int>(period - phase);
+            position.pingPongDirection = -1;
+        }
+        octaveWraps = advances >= 2u ? (advances - 2u) / period : 0u;
+    }
+
+    position.octaveIndex = static_cast<int>(octaveWraps % span);
+    return position;
+}
+} // namespace ArpSeek
@@ -3,9 +3,9 @@
 #include <JuceHeader.h>
 #include <algorithm>
 #include <cstring>
-#include <random>
 #include <tuple>
 
+#include "ArpSeek.h"
 #include "MachineUtilsAbs.h"
 
 namespace
@@ -184,7 +184,7 @@ std::vector<std::vector<UIBox>> ArpeggiatorMachine::getUIBoxes(const MachineUiCo
             {
                 const std::lock_guard<std::mutex> guard(stateMutex);
                 quarterBeatDivisor = nextQuarterBeatDivisor(quarterBeatDivisor, direction < 0 ? -1 : 1);
-                ticksSinceStep = juce::jmax(0, quarterBeatDivisor - 1);
+                ticksSinceStep = getStepTicks() - 1;
             };
         }
         else if (col == 5)
@@ -292,7 +292,7 @@ void ArpeggiatorMachine::resetPlayback()
     resetPlaybackState();
 }
 
-void ArpeggiatorMachine::tick(int quarterBeat)
+void ArpeggiatorMachine::tick(const ClockTick& clockTick)
 {
     std::function<void(const MachineNoteEvent&)> callbackCopy;
     MachineNoteEvent outEvent;
@@ -301,13 +301,14 @@ void ArpeggiatorMachine::tick(int quarterBeat)
     {
         const std::lock_guard<std::mutex> lock(stateMutex);
         clampLength();
+        followTicksPerGridTick(clockTick.ticksPerGridTick);
         if (!clockActive || length <= 0 || countActiveSlots() == 0)
             return;
-        if (quarterBeat == 1)
-            ticksSinceStep = juce::jmax(0, quarterBeatDivisor - 1);
+        if (clockTick.quarterBeat == 1 && clockTick.isGridTick())
+            ticksSinceStep = getStepTicks() - 1;
 
         ++ticksSinceStep;
-        if (ticksSinceStep < juce::jmax(1, quarterBeatDivisor))
+        if (ticksSinceStep < getStepTicks())
             return;
         ticksSinceStep = 0;
 
@@ -332,7 +333,41 @@ void ArpeggiatorMachine::tick(int quarterBeat)
 
 void ArpeggiatorMachine::reset()
 {
-    resetPlayback();
+    const std::lock_guard<std::mutex> lock(stateMutex);
+    random.reseed();
+    resetPlaybackState();
+}
+
+void ArpeggiatorMachine::seek(std::uint64_t engineTicksSinceReset, int ticksPerGridTick)
+{
+    const std::lock_guard<std::mutex> lock(stateMutex);
+    clampLength();
+    clockTicksPerGridTick = juce::jmax(1, ticksPerGridTick);
+    random.reseed();
+    resetPlaybackState();
+    if (length <= 0 || countActiveSlots() == 0)
+        return;
+
+    ticksSinceStep = ArpSeek::ticksSinceStepAfterTicks(engineTicksSinceReset, getStepTicks());
+    const auto advances = ArpSeek::advancesAfterTicks(engineTicksSinceReset, getStepTicks());
+    if (advances == 0)
+        return;
+
+    if (playMode == PlayMode::random)
+    {
+        // every random step draws a slot then an octave
+        random.discard(2u * (advances - 1u));
+        advancePlayHead();
+        return;
+    }
+
+    const auto order = playMode == PlayMode::pingPong ? ArpSeek::Order::pingPong
+        : playMode == PlayMode::down                   ? ArpSeek::Order::backward
+                                                        : ArpSeek::Order::forward;
+    const auto position = ArpSeek::positionAfterAdvances(order, length, octaveSpan, advances);
+    playHead = position.playHead;
+    pingPongDirection = position.pingPongDirection;
+    currentOctaveIndex = position.octaveIndex;
 }
 
 void ArpeggiatorMachine::setClockEventCallback(std::function<void(const MachineNoteEvent&)> callback)
@@ -349,6 +384,12 @@ void ArpeggiatorMachine::setClockActive(bool shouldBeActive)
     clockActive = shouldBeActive;
 }
 
+void ArpeggiatorMachine::setRandomSeed(std::uint32_t seed)
+{
+    const std::lock_guard<std::mutex> lock(stateMutex);
+    random.seed(seed);
+}
+
 bool ArpeggiatorMachine::shiftNoteAtCell(int row, int col, int semitones)
 {
     const std::lock_guard<std::mutex> lock(stateMutex);
@@ -402,6 +443,7 @@ void ArpeggiatorMachine::getStateInformation(juce::MemoryBlock& destData)
     root->setProperty("pingPongDirection", pingPongDirection);
     root->setProperty("currentOctaveIndex", currentOctaveIndex);
     root->setProperty("playMode", static_cast<int>(playMode));
+    root->setProperty("randomSeed", static_cast<juce::int64>(random.getSeed()));
 
     juce::Array<juce::var> slotsVar;
     slotsVar.ensureStorageAllocated(kMaxLength);
@@ -478,6 +520,9 @@ void ArpeggiatorMachine::setStateInformation(const void* data, int sizeInBytes)
         modeIndex = juce::jlimit(0, static_cast<int>(PlayMode::random), modeIndex);
         playMode = static_cast<PlayMode>(modeIndex);
     }
+    const auto seedVar = obj->getProperty("randomSeed");
+    if (!seedVar.isVoid())
+        random.seed(static_cast<std::uint32_t>(static_cast<juce::int64>(seedVar)));
 
     const auto slotsVar = obj->getProperty("slots");
     if (slotsVar.isArray())
@@ -528,12 +573,27 @@ void ArpeggiatorMachine::clampLength()
     currentOctaveIndex = juce::jlimit(0, octaveSpan - 1, currentOctaveIndex);
 }
 
+int ArpeggiatorMachine::getStepTicks() const
+{
+    return juce::jmax(1, quarterBeatDivisor) * clockTicksPerGridTick;
+}
+
+void ArpeggiatorMachine::followTicksPerGridTick(int ticksPerGridTick)
+{
+    ticksPerGridTick = juce::jmax(1, ticksPerGridTick);
+    if (ticksPerGridTick == clockTicksPerGridTick)
+        return;
+    // the resolution changes on a grid tick, so keep the count of whole grid ticks gone by
+    ticksSinceStep = (ticksSinceStep / clockTicksPerGridTick + 1) * ticksPerGridTick - 1;
+    clockTicksPerGridTick = ticksPerGridTick;
+}
+
 void ArpeggiatorMachine::resetPlaybackState()
 {
     playHead = -1;
     pingPongDirection = 1;
     currentOctaveIndex = 0;
-    ticksSinceStep = juce::jmax(0, quarterBeatDivisor - 1);
+    ticksSinceStep = getStepTicks() - 1;
 }
 
 int ArpeggiatorMachine::countActiveSlots() const
@@ -580,8 +640,7 @@ void ArpeggiatorMachine::sortActiveSlots()
 
 void ArpeggiatorMachine::shuffleSlots()
 {
-    std::mt19937 rng(static_cast<std::mt19937::result_type>(juce::Random::getSystemRandom().nextInt()));
-    std::shuffle(slots.begin(), slots.begin() + length, rng);
+    std::shuffle(slots.begin(), slots.begin() + length, random);
     resetPlaybackState();
 }
 
@@ -592,8 +651,8 @@ int ArpeggiatorMachine::advancePlayHead()
 
     if (playMode == PlayMode::random)
     {
-        playHead = juce::Random::getSystemRandom().nextInt(juce::jmax(1, length));
-        currentOctaveIndex = juce::Random::getSystemRandom().nextInt(juce::jmax(1, octaveSpan));
+        playHead = random.nextInt(juce::jmax(1, length));
+        currentOctaveIndex = random.nextInt(juce::jmax(1, octaveSpan));
         return playHead;
     }
 
@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "ClockAbs.h"
+#include "FastRandom.h"
 #include "MachineInterface.h"
 
 // Simple note accumulator/arpeggiator machine driven by incoming MIDI notes.
@@ -41,14 +42,18 @@ public:
                             MachineNoteEvent& outEvent) override;
     /** Clears the playhead state and any currently sounding playback. */
     void resetPlayback();
-    /** Receives the global quarter-beat clock. */
-    void tick(int quarterBeat) override;
+    /** Receives every engine tick of the global clock. */
+    void tick(const ClockTick& clockTick) override;
     /** Resets playback counters to the start of the bar. */
     void reset() override;
+    /** Places the playhead where the sent number of engine ticks after a reset would leave it. */
+    void seek(std::uint64_t engineTicksSinceReset, int ticksPerGridTick) override;
     /** Sets the callback used to emit clocked arp notes. */
     void setClockEventCallback(std::function<void(const MachineNoteEvent&)> callback);
     /** Enables or disables note emission on clock ticks. */
     void setClockActive(bool shouldBeActive);
+    /** Sets the seed that random mode and shuffles restart from on clock reset. */
+    void setRandomSeed(std::uint32_t seed);
     bool shiftNoteAtCell(int row, int col, int semitones) override;
     bool clearCell(int row, int col) override;
 
@@ -84,8 +89,10 @@ private:
     int quarterBeatDivisor = 1;
     /** Number of octaves cycled during playback. */
     int octaveSpan = 1;
-    /** Number of received clock ticks since the last emitted arp step. */
+    /** Number of received engine ticks since the last emitted arp step. */
     int ticksSinceStep = 0;
+    /** Engine ticks per grid tick as the clock last sent them. */
+    int clockTicksPerGridTick = 1;
     /** True when incoming notes should overwrite arp memory. */
     bool recordEnabled = false;
     /** Write head used while recording notes into memory. */
@@ -104,11 +111,17 @@ private:
     std::function<void(const MachineNoteEvent&)> clockEventCallback;
     /** True when clock ticks should emit notes. */
     bool clockActive = false;
+    /** Seeded generator for random mode and shuffles; reseeded on clock reset. */
+    FastRandom random;
     /** Protects arp state shared between UI and audio threads. */
     mutable std::mutex stateMutex;
 
     /** Clamps the visible arp length into the supported range. */
     void clampLength();
+    /** Engine ticks between arp steps at the current divisor and resolution. */
+    int getStepTicks() const;
+    /** Rescales the step counter when the clock resolution has changed since the last tick. */
+    void followTicksPerGridTick(int ticksPerGridTick);
     /** Resets playback-only state without wiping recorded notes. */
     void resetPlaybackState();
     /** Counts how many note slots currently contain a note. */
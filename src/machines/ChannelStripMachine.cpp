@@ -2,6 +2,32 @@
 
 #include <cmath>
 
+namespace
+{
+/** lockable parameter ids, in the order the controls appear on the machine page */
+enum LockableParameter
+{
+    kSatDriveLock = 0,
+    kSatMixLock,
+    kDistDriveLock,
+    kDistOutputLock,
+    kCompInputLock,
+    kCompThresholdLock,
+    kCompRatioLock,
+    kCompAttackLock,
+    kCompOutputLock,
+    kBassLock,
+    kMidLock,
+    kMidFreqLock,
+    kTrebleLock,
+    kLimiterThresholdLock
+};
+
+constexpr const char* kLockableParameterNames[] {
+    "SAT", "SMIX", "DDRV", "DOUT", "CIN", "THR", "RAT", "ATT", "COUT", "BAS", "MID", "MFQ", "TRE", "LIM"
+};
+}
+
 ChannelStripMachine::ChannelStripMachine()
     : oversampling(kMaxChannels,
                    1,
@@ -52,7 +78,7 @@ void ChannelStripMachine::prepareToPlay(double sampleRate, int samplesPerBlock)
     saturator.functionToUse = [](float x) { return ChannelStripMachine::softClip(x); };
     distShaper.functionToUse = [](float x) { return ChannelStripMachine::softClip(x * 0.85f); };
 
-    updateDSPSettings(captureParameters());
+    updateDSPSettings(applyParameterLocks(captureParameters()));
     resetDSPState();
 }
 
@@ -125,7 +151,7 @@ void ChannelStripMachine::processAudioBuffer(juce::AudioBuffer<float>& buffer)
         resetDSPState();
 
     if (dspDirty.exchange(false, std::memory_order_acq_rel))
-        updateDSPSettings(captureParameters());
+        updateDSPSettings(applyParameterLocks(captureParameters()));
 
     const auto channelsToProcess = juce::jmin<int>(buffer.getNumChannels(), static_cast<int>(kMaxChannels));
     if (channelsToProcess <= 0)
@@ -246,6 +272,49 @@ ChannelStripMachine::ParameterSnapshot ChannelStripMachine::captureParameters()
     return parameters;
 }
 
+ChannelStripMachine::ParameterSnapshot ChannelStripMachine::applyParameterLocks(ParameterSnapshot parameters) const
+{
+    parameters.satDriveDb = parameterLocks.apply(kSatDriveLock, parameters.satDriveDb, kMinSatDriveDb, kMaxSatDriveDb);
+    parameters.satMix = parameterLocks.apply(kSatMixLock, parameters.satMix, kMinSatMix, kMaxSatMix);
+    parameters.distDriveDb = parameterLocks.apply(kDistDriveLock, parameters.distDriveDb, kMinDistDriveDb, kMaxDistDriveDb);
+    parameters.distOutputDb = parameterLocks.apply(kDistOutputLock, parameters.distOutputDb, kMinDistOutputDb, kMaxDistOutputDb);
+    parameters.compInputDb = parameterLocks.apply(kCompInputLock, parameters.compInputDb, kMinCompInputDb, kMaxCompInputDb);
+    parameters.compThresholdDb = parameterLocks.apply(kCompThresholdLock, parameters.compThresholdDb, kMinCompThresholdDb, kMaxCompThresholdDb);
+    parameters.compRatio = parameterLocks.apply(kCompRatioLock, parameters.compRatio, kMinCompRatio, kMaxCompRatio);
+    parameters.compAttackMs = parameterLocks.apply(kCompAttackLock, parameters.compAttackMs, kMinCompAttackMs, kMaxCompAttackMs);
+    parameters.compOutputDb = parameterLocks.apply(kCompOutputLock, parameters.compOutputDb, kMinCompOutputDb, kMaxCompOutputDb);
+    parameters.bassDb = parameterLocks.apply(kBassLock, parameters.bassDb, kMinEqDb, kMaxEqDb);
+    parameters.midDb = parameterLocks.apply(kMidLock, parameters.midDb, kMinEqDb, kMaxEqDb);
+    parameters.midFreqHz = parameterLocks.apply(kMidFreqLock, parameters.midFreqHz, kMinMidFreqHz, kMaxMidFreqHz);
+    parameters.trebleDb = parameterLocks.apply(kTrebleLock, parameters.trebleDb, kMinEqDb, kMaxEqDb);
+    parameters.limiterThresholdDb = parameterLocks.apply(kLimiterThresholdLock, parameters.limiterThresholdDb, kMinLimiterThresholdDb, kMaxLimiterThresholdDb);
+    return parameters;
+}
+
+int ChannelStripMachine::getLockableParameterCount() const
+{
+    return kLockableParameterCount;
+}
+
+const char* ChannelStripMachine::getLockableParameterName(int parameterId) const
+{
+    if (parameterId < 0 || parameterId >= kLockableParameterCount)
+        return "";
+    return kLockableParameterNames[parameterId];
+}
+
+void ChannelStripMachine::setParameterLock(int parameterId, float normalisedValue)
+{
+    parameterLocks.set(parameterId, normalisedValue);
+    dspDirty.store(true, std::memory_order_release);
+}
+
+void ChannelStripMachine::clearParameterLock(int parameterId)
+{
+    parameterLocks.clear(parameterId);
+    dspDirty.store(true, std::memory_order_release);
+}
+
 void ChannelStripMachine::updateDSPSettings(const ParameterSnapshot& parameters)
 {
     saturatorInputGain.setGainDecibels(parameters.satDriveDb);
@@ -277,19 +346,20 @@ void ChannelStripMachine::updateEQCoefficients(const ParameterSnapshot& paramete
     if (trebleShelf.state == nullptr)
         trebleShelf.state = juce::dsp::IIR::Coefficients<float>::makeHighShelf(currentSampleRate, trebleFreqHz, shelfQ, 1.0f);
 
-    *bassShelf.state = *juce::dsp::IIR::Coefficients<float>::makeLowShelf(
+    // step locks can land here on the audio thread, so refill the existing coefficients in place
+    *bassShelf.state = juce::dsp::IIR::ArrayCoefficients<float>::makeLowShelf(
         currentSampleRate,
         bassFreqHz,
         shelfQ,
         juce::Decibels::decibelsToGain(parameters.bassDb));
 
-    *midPeak.state = *juce::dsp::IIR::Coefficients<float>::makePeakFilter(
+    *midPeak.state = juce::dsp::IIR::ArrayCoefficients<float>::makePeakFilter(
         currentSampleRate,
         parameters.midFreqHz,
         midQ,
         juce::Decibels::decibelsToGain(parameters.midDb));
 
-    *trebleShelf.state = *juce::dsp::IIR::Coefficients<float>::makeHighShelf(
+    *trebleShelf.state = juce::dsp::IIR::ArrayCoefficients<float>::makeHighShelf(
         currentSampleRate,
         trebleFreqHz,
         shelfQ,
@@ -8,6 +8,7 @@
 #include <JuceHeader.h>
 
 #include "AudioEffectMachine.h"
+#include "ParameterLockSet.h"
 
 class ChannelStripMachine final : public AudioEffectMachine
 {
@@ -20,6 +21,10 @@ public:
     void processAudioBuffer(juce::AudioBuffer<float>& buffer) override;
     void getStateInformation(juce::MemoryBlock& destData) override;
     void setStateInformation(const void* data, int sizeInBytes) override;
+    int getLockableParameterCount() const override;
+    const char* getLockableParameterName(int parameterId) const override;
+    void setParameterLock(int parameterId, float normalisedValue) override;
+    void clearParameterLock(int parameterId) override;
 
 private:
     using Filter = juce::dsp::ProcessorDuplicator<
@@ -89,6 +94,10 @@ private:
     juce::dsp::Limiter<float> limiter;
     juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> satMixSmoothed;
 
+    /** step locks, in the order the controls appear on the machine page */
+    static constexpr int kLockableParameterCount = 14;
+    ParameterLockSet<kLockableParameterCount> parameterLocks;
+
     std::atomic<bool> dspDirty { true };
     std::atomic<bool> dspResetRequested { false };
 
@@ -111,6 +120,8 @@ private:
     };
 
     ParameterSnapshot captureParameters() const;
+    /** the snapshot with any step locks laid over it */
+    ParameterSnapshot applyParameterLocks(ParameterSnapshot parameters) const;
     void updateDSPSettings(const ParameterSnapshot& parameters);
     void updateEQCoefficients(const ParameterSnapshot& parameters);
     void resetDSPState();
@@ -4,6 +4,11 @@
 namespace
 {
 constexpr double kDelayStateVersion = 1.0;
+constexpr int kSyncTicksParameter = 0;
+constexpr int kDelayMsParameter = 1;
+constexpr int kFeedbackParameter = 2;
+constexpr int kMixParameter = 3;
+constexpr int kMaxSyncTicks = 64;
 }
 
 void DelayFxMachine::prepareToPlay(double sampleRate, int samplesPerBlock)
@@ -64,7 +69,7 @@ std::vector<std::vector<UIBox>> DelayFxMachine::getUIBoxes(const MachineUiContex
     boxes[1][1].onAdjust = [this](int direction)
     {
         const std::lock_guard<std::mutex> guard(stateMutex);
-        syncTicks = juce::jlimit(1, 64, syncTicks + direction);
+        syncTicks = juce::jlimit(1, kMaxSyncTicks, syncTicks + direction);
     };
 
     boxes[0][2].kind = UIBox::Kind::TrackerCell;
@@ -90,6 +95,8 @@ void DelayFxMachine::processAudioBuffer(juce::AudioBuffer<float>& buffer)
         return;
 
     const int delaySamples = getDelaySamples();
+    const float feedbackValue = parameterLocks.apply(kFeedbackParameter, feedback, 0.0f, 0.95f);
+    const float mixValue = parameterLocks.apply(kMixParameter, mix, 0.0f, 1.0f);
     const int delayBufferSamples = delayBuffer.getNumSamples();
     const int readPositionBase = (writePosition - delaySamples + delayBufferSamples) % delayBufferSamples;
 
@@ -103,10 +110,10 @@ void DelayFxMachine::processAudioBuffer(juce::AudioBuffer<float>& buffer)
             const int delayChannel = juce::jlimit(0, delayBuffer.getNumChannels() - 1, channel);
             const float dry = buffer.getSample(channel, sampleIndex);
             const float delayed = delayBuffer.getSample(delayChannel, readPosition);
-            const float wet = dry + (delayed * feedback);
+            const float wet = dry + (delayed * feedbackValue);
 
             delayBuffer.setSample(delayChannel, writeIndex, wet);
-            buffer.setSample(channel, sampleIndex, juce::jmap(mix, dry, delayed));
+            buffer.setSample(channel, sampleIndex, juce::jmap(mixValue, dry, delayed));
         }
     }
 
@@ -115,9 +122,8 @@ void DelayFxMachine::processAudioBuffer(juce::AudioBuffer<float>& buffer)
 
 void DelayFxMachine::setSecondsPerTick(double secondsPerTick)
 {
-    const std::lock_guard<std::mutex> lock(stateMutex);
     if (secondsPerTick > 0.0)
-        currentSecondsPerTick = secondsPerTick;
+        currentSecondsPerTick.store(secondsPerTick, std::memory_order_relaxed);
 }
 
 void DelayFxMachine::allNotesOff()
@@ -126,10 +132,13 @@ void DelayFxMachine::allNotesOff()
     clearDelayBuffer();
 }
 
-void DelayFxMachine::tick(int quarterBeat)
+void DelayFxMachine::tick(const ClockTick& clockTick)
 {
+    // the bar position only moves on grid ticks
+    if (!clockTick.isGridTick())
+        return;
     const std::lock_guard<std::mutex> lock(stateMutex);
-    currentQuarterBeat = juce::jlimit(0, 16, quarterBeat);
+    currentQuarterBeat = juce::jlimit(0, 16, clockTick.quarterBeat);
 }
 
 void DelayFxMachine::reset()
@@ -172,7 +181,7 @@ void DelayFxMachine::setStateInformation(const void* data, int sizeInBytes)
 
     const std::lock_guard<std::mutex> lock(stateMutex);
     mode = static_cast<DelayMode>(juce::jlimit(0, 1, static_cast<int>(parsed.getProperty("mode", static_cast<int>(mode)))));
-    syncTicks = juce::jlimit(1, 64, static_cast<int>(parsed.getProperty("syncTicks", syncTicks)));
+    syncTicks = juce::jlimit(1, kMaxSyncTicks, static_cast<int>(parsed.getProperty("syncTicks", syncTicks)));
     delayMs = juce::jlimit(1.0f, static_cast<float>(kMaxDelaySeconds * 1000), static_cast<float>(parsed.getProperty("delayMs", delayMs)));
     feedback = juce::jlimit(0.0f, 0.95f, static_cast<float>(parsed.getProperty("feedback", feedback)));
     mix = juce::jlimit(0.0f, 1.0f, static_cast<float>(parsed.getProperty("mix", mix)));
@@ -195,9 +204,40 @@ void DelayFxMachine::clearDelayBuffer()
 int DelayFxMachine::getDelaySamples() const
 {
     if (mode == DelayMode::sync)
-        return juce::jlimit(1, juce::jmax(1, delayBuffer.getNumSamples() - 1), static_cast<int>(std::round(currentSecondsPerTick * static_cast<double>(syncTicks) * currentSampleRate)));
+    {
+        const float ticks = std::round(parameterLocks.apply(kSyncTicksParameter, static_cast<float>(syncTicks), 1.0f, static_cast<float>(kMaxSyncTicks)));
+        return juce::jlimit(1, juce::jmax(1, delayBuffer.getNumSamples() - 1), static_cast<int>(std::round(currentSecondsPerTick.load(std::memory_order_relaxed) * static_cast<double>(ticks) * currentSampleRate)));
+    }
+
+    const float ms = parameterLocks.apply(kDelayMsParameter, delayMs, 1.0f, static_cast<float>(kMaxDelaySeconds * 1000));
+    return juce::jlimit(1, juce::jmax(1, delayBuffer.getNumSamples() - 1), static_cast<int>(std::round((static_cast<double>(ms) / 1000.0) * currentSampleRate)));
+}
+
+int DelayFxMachine::getLockableParameterCount() const
+{
+    return parameterLocks.size();
+}
 
-    return juce::jlimit(1, juce::jmax(1, delayBuffer.getNumSamples() - 1), static_cast<int>(std::round((static_cast<double>(delayMs) / 1000.0) * currentSampleRate)));
+const char* DelayFxMachine::getLockableParameterName(int parameterId) const
+{
+    switch (parameterId)
+    {
+        case kSyncTicksParameter: return "TIME";
+        case kDelayMsParameter: return "MS";
+        case kFeedbackParameter: return "FDBK";
+        case kMixParameter: return "MIX";
+        default: return "";
+    }
+}
+
+void DelayFxMachine::setParameterLock(int parameterId, float normalisedValue)
+{
+    parameterLocks.set(parameterId, normalisedValue);
+}
+
+void DelayFxMachine::clearParameterLock(int parameterId)
+{
+    parameterLocks.clear(parameterId);
 }
 
 std::string DelayFxMachine::formatFloat(float value, int decimals)
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <mutex>
 #include <string>
 #include <vector>
@@ -8,6 +9,7 @@
 
 #include "AudioEffectMachine.h"
 #include "ClockAbs.h"
+#include "ParameterLockSet.h"
 
 class DelayFxMachine final : public AudioEffectMachine, public ClockListener
 {
@@ -28,13 +30,18 @@ public:
     /** Clears buffered delay audio when transport or notes are stopped. */
     void allNotesOff() override;
     /** Tracks quarter-beat bar position for synced transport state. */
-    void tick(int quarterBeat) override;
+    void tick(const ClockTick& clockTick) override;
     /** Clears delay state on transport resets. */
     void reset() override;
     /** Serialises the delay settings. */
     void getStateInformation(juce::MemoryBlock& destData) override;
     /** Restores the delay settings from serialised state. */
     void setStateInformation(const void* data, int sizeInBytes) override;
+    /** Sync time, milliseconds, feedback and mix can be locked from sequencer steps. */
+    int getLockableParameterCount() const override;
+    const char* getLockableParameterName(int parameterId) const override;
+    void setParameterLock(int parameterId, float normalisedValue) override;
+    void clearParameterLock(int parameterId) override;
 
 private:
     /** Selects between tracker-synchronised delay time and free milliseconds. */
@@ -48,11 +55,12 @@ private:
     mutable std::mutex stateMutex;
     /** Current host/sample playback rate. */
     double currentSampleRate = 44100.0;
-    /** Current tracker tick duration used for sync mode. */
-    double currentSecondsPerTick = 60.0 / (120.0 * 8.0);
+    /** Current grid tick duration used for sync mode.
+        Kept outside stateMutex so tempo changes never wait on the editor. */
+    std::atomic<double> currentSecondsPerTick { 60.0 / (120.0 * 8.0) };
     /** Active delay timing mode. */
     DelayMode mode = DelayMode::sync;
-    /** Delay length in tracker ticks when sync mode is selected. */
+    /** Delay length in grid ticks when sync mode is selected. */
     int syncTicks = 8;
     /** Delay length in milliseconds when free-time mode is selected. */
     float delayMs = 250.0f;
@@ -60,6 +68,9 @@ private:
     float feedback = 0.35f;
     /** Wet/dry balance for the effect output. */
     float mix = 0.3f;
+    /** Step locks over sync time, milliseconds, feedback and mix, in that order.
+        Kept outside stateMutex so the audio thread can set them without waiting on the editor. */
+    ParameterLockSet<4> parameterLocks;
     /** Circular audio buffer that stores delayed samples. */
     juce::AudioBuffer<float> delayBuffer;
     /** Current write head position into the delay buffer. */
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/**
+ * Per-parameter overrides that sequencer steps place over a machine's own settings.
+ * Locks are written on the audio thread and may be read from any thread, so each one is a
+ * single atomic and nothing here blocks or allocates.
+ */
+template <std::size_t ParameterCount>
+class ParameterLockSet
+{
+public:
+    ParameterLockSet() noexcept { clearAll(); }
+
+    static constexpr int size() noexcept { return static_cast<int>(ParameterCount); }
+
+    /** Holds the parameter at a 0-1 position in its range. Out of range ids are ignored. */
+    void set(int parameterId, float normalisedValue) noexcept
+    {
+        if (!inRange(parameterId))
+            return;
+        const float clamped = normalisedValue < 0.0f ? 0.0f : (normalisedValue > 1.0f ? 1.0f : normalisedValue);
+        values[static_cast<std::size_t>(parameterId)].store(clamped, std::memory_order_relaxed);
+    }
+
+    /** Hands the parameter back to the machine's own setting. */
+    void clear(int parameterId) noexcept
+    {
+        if (inRange(parameterId))
+            values[static_cast<std::size_t>(parameterId)].store(kUnlocked, std::memory_order_relaxed);
+    }
+
+    void clearAll() noexcept
+    {
+        for (auto& value : values)
+            value.store(kUnlocked, std::memory_order_relaxed);
+    }
+
+    bool isLocked(int parameterId) const noexcept
+    {
+        return inRange(parameterId) && values[static_cast<std::size_t>(parameterId)].load(std::memory_order_relaxed) >= 0.0f;
+    }
+
+    /** The locked value mapped onto minValue..maxValue, or unlockedValue if nothing holds the parameter. */
+    float apply(int parameterId, float unlockedValue, float minValue, float maxValue) const noexcept
+    {
+        if (!inRange(parameterId))
+            return unlockedValue;
+        const float normalised = values[static_cast<std::size_t>(parameterId)].load(std::memory_order_relaxed);
+        if (normalised < 0.0f)
+            return unlockedValue;
+        return minValue + (maxValue - minValue) * normalised;
+    }
+
+private:
+    static constexpr float kUnlocked = -1.0f;
+
+    static bool inRange(int parameterId) noexcept
+    {
+        return parameterId >= 0 && parameterId < static_cast<int>(ParameterCount);
+    }
+
+    std::array<std::atomic<float>, ParameterCount> values;
+};
@@ -2,9 +2,9 @@
 
 #include <JuceHeader.h>
 #include <algorithm>
-#include <random>
 #include <tuple>
 
+#include "ArpSeek.h"
 #include "MachineUtilsAbs.h"
 
 namespace
@@ -176,7 +176,7 @@ std::vector<std::vector<UIBox>> PolyArpeggiatorMachine::getUIBoxes(const Machine
             const std::lock_guard<std::mutex> guard(stateMutex);
             auto& head = readHeads[static_cast<std::size_t>(headIndex)];
             head.quarterBeatDivisor = nextQuarterBeatDivisor(head.quarterBeatDivisor, direction < 0 ? -1 : 1);
-            head.ticksSinceStep = juce::jmax(0, head.quarterBeatDivisor - 1);
+            head.ticksSinceStep = getStepTicks(head) - 1;
         };
 
         boxes[3][row].kind = UIBox::Kind::TrackerCell;
@@ -316,7 +316,7 @@ void PolyArpeggiatorMachine::allNotesOff()
     resetReadHeads();
 }
 
-void PolyArpeggiatorMachine::tick(int quarterBeat)
+void PolyArpeggiatorMachine::tick(const ClockTick& clockTick)
 {
     std::function<void(const MachineNoteEvent&)> callbackCopy;
     std::vector<MachineNoteEvent> outEvents;
@@ -324,9 +324,9 @@ void PolyArpeggiatorMachine::tick(int quarterBeat)
     {
         const std::lock_guard<std::mutex> lock(stateMutex);
         clampState();
+        followTicksPerGridTick(clockTick.ticksPerGridTick);
         if (!clockActive || length <= 0 || countActiveSlots() == 0)
             return;
-        juce::ignoreUnused(quarterBeat);
 
         callbackCopy = clockEventCallback;
         if (callbackCopy == nullptr)
@@ -335,11 +335,11 @@ void PolyArpeggiatorMachine::tick(int quarterBeat)
         for (int headIndex = 0; headIndex < readHeadCount; ++headIndex)
         {
             auto& head = readHeads[static_cast<std::size_t>(headIndex)];
-            if (quarterBeat == 1)
-                head.ticksSinceStep = juce::jmax(0, head.quarterBeatDivisor - 1);
+            if (clockTick.quarterBeat == 1 && clockTick.isGridTick())
+                head.ticksSinceStep = getStepTicks(head) - 1;
 
             ++head.ticksSinceStep;
-            if (head.ticksSinceStep < juce::jmax(1, head.quarterBeatDivisor))
+            if (head.ticksSinceStep < getStepTicks(head))
                 continue;
             head.ticksSinceStep = 0;
 
@@ -365,7 +365,72 @@ void PolyArpeggiatorMachine::tick(int quarterBeat)
 
 void PolyArpeggiatorMachine::reset()
 {
-    allNotesOff();
+    const std::lock_guard<std::mutex> lock(stateMutex);
+    random.reseed();
+    resetReadHeads();
+}
+
+void PolyArpeggiatorMachine::seek(std::uint64_t engineTicksSinceReset, int ticksPerGridTick)
+{
+    const std::lock_guard<std::mutex> lock(stateMutex);
+    clampState();
+    clockTicksPerGridTick = juce::jmax(1, ticksPerGridTick);
+    random.reseed();
+    resetReadHeads();
+    // tick does nothing at all without a callback or notes, so neither do we
+    if (clockEventCallback == nullptr || length <= 0 || countActiveSlots() == 0)
+        return;
+
+    // random heads share one generator and draw a slot then an octave per step, in head order
+    std::uint64_t totalDraws = 0;
+    for (int headIndex = 0; headIndex < readHeadCount; ++headIndex)
+    {
+        const auto& head = readHeads[static_cast<std::size_t>(headIndex)];
+        if (head.playMode == PlayMode::random)
+            totalDraws += 2u * ArpSeek::advancesAfterTicks(engineTicksSinceReset, getStepTicks(head));
+    }
+
+    for (int headIndex = 0; headIndex < readHeadCount; ++headIndex)
+    {
+        auto& head = readHeads[static_cast<std::size_t>(headIndex)];
+        head.ticksSinceStep = ArpSeek::ticksSinceStepAfterTicks(engineTicksSinceReset, getStepTicks(head));
+        const auto advances = ArpSeek::advancesAfterTicks(engineTicksSinceReset, getStepTicks(head));
+        if (advances == 0)
+            continue;
+
+        if (head.playMode != PlayMode::random)
+        {
+            const auto order = head.playMode == PlayMode::pingPong ? ArpSeek::Order::pingPong
+                : head.playMode == PlayMode::down                  ? ArpSeek::Order::backward
+                                                                    : ArpSeek::Order::forward;
+            const auto position = ArpSeek::positionAfterAdvances(order, length, head.octaveSpan, advances);
+            head.playHead = position.playHead;
+            head.pingPongDirection = position.pingPongDirection;
+            head.currentOctaveIndex = position.octaveIndex;
+            continue;
+        }
+
+        // count every draw made before this head's last step, then replay just that step
+        const std::uint64_t lastStepTick = (advances - 1u) * static_cast<std::uint64_t>(getStepTicks(head));
+        std::uint64_t drawsBefore = 0;
+        for (int otherIndex = 0; otherIndex < readHeadCount; ++otherIndex)
+        {
+            const auto& other = readHeads[static_cast<std::size_t>(otherIndex)];
+            if (other.playMode != PlayMode::random)
+                continue;
+            drawsBefore += 2u * ArpSeek::advancesAfterTicks(lastStepTick, getStepTicks(other));
+            const auto otherDivisor = static_cast<std::uint64_t>(getStepTicks(other));
+            if (otherIndex < headIndex && lastStepTick % otherDivisor == 0)
+                drawsBefore += 2u;
+        }
+
+        FastRandom probe = random;
+        probe.discard(drawsBefore);
+        head.playHead = probe.nextInt(juce::jmax(1, length));
+        head.currentOctaveIndex = probe.nextInt(juce::jmax(1, head.octaveSpan));
+    }
+
+    random.discard(totalDraws);
 }
 
 void PolyArpeggiatorMachine::setClockEventCallback(std::function<void(const MachineNoteEvent&)> callback)
@@ -382,6 +447,12 @@ void PolyArpeggiatorMachine::setClockActive(bool shouldBeActive)
     clockActive = shouldBeActive;
 }
 
+void PolyArpeggiatorMachine::setRandomSeed(std::uint32_t seed)
+{
+    const std::lock_guard<std::mutex> lock(stateMutex);
+    random.seed(seed);
+}
+
 bool PolyArpeggiatorMachine::shiftNoteAtCell(int row, int col, int semitones)
 {
     const std::lock_guard<std::mutex> lock(stateMutex);
@@ -430,6 +501,7 @@ void PolyArpeggiatorMachine::getStateInformation(juce::MemoryBlock& destData)
     root->setProperty("recordEnabled", recordEnabled);
     root->setProperty("recordHead", recordHead);
     root->setProperty("readHeadCount", readHeadCount);
+    root->setProperty("randomSeed", static_cast<juce::int64>(random.getSeed()));
 
     juce::Array<juce::var> slotsVar;
     for (const auto& slot : slots)
@@ -484,6 +556,8 @@ void PolyArpeggiatorMachine::setStateInformation(const void* data, int sizeInByt
     recordEnabled = static_cast<bool>(parsed.getProperty("recordEnabled", recordEnabled));
     recordHead = static_cast<int>(parsed.getProperty("recordHead", recordHead));
     readHeadCount = static_cast<int>(parsed.getProperty("readHeadCount", readHeadCount));
+    if (const auto seedVar = obj->getProperty("randomSeed"); !seedVar.isVoid())
+        random.seed(static_cast<std::uint32_t>(static_cast<juce::int64>(seedVar)));
 
     if (const auto slotsVar = obj->getProperty("slots"); slotsVar.isArray())
     {
@@ -557,6 +631,22 @@ void PolyArpeggiatorMachine::clampState()
     }
 }
 
+int PolyArpeggiatorMachine::getStepTicks(const ReadHead& head) const
+{
+    return juce::jmax(1, head.quarterBeatDivisor) * clockTicksPerGridTick;
+}
+
+void PolyArpeggiatorMachine::followTicksPerGridTick(int ticksPerGridTick)
+{
+    ticksPerGridTick = juce::jmax(1, ticksPerGridTick);
+    if (ticksPerGridTick == clockTicksPerGridTick)
+        return;
+    // the resolution changes on a grid tick, so keep the count of whole grid ticks gone by
+    for (auto& head : readHeads)
+        head.ticksSinceStep = (head.ticksSinceStep / clockTicksPerGridTick + 1) * ticksPerGridTick - 1;
+    clockTicksPerGridTick = ticksPerGridTick;
+}
+
 void PolyArpeggiatorMachine::resetReadHeads()
 {
     for (auto& head : readHeads)
@@ -564,7 +654,7 @@ void PolyArpeggiatorMachine::resetReadHeads()
         head.playHead = -1;
         head.pingPongDirection = 1;
         head.currentOctaveIndex = 0;
-        head.ticksSinceStep = juce::jmax(0, head.quarterBeatDivisor - 1);
+        head.ticksSinceStep = getStepTicks(head) - 1;
     }
 }
 
@@ -611,8 +701,7 @@ void PolyArpeggiatorMachine::sortActiveSlots()
 
 void PolyArpeggiatorMachine::shuffleSlots()
 {
-    std::mt19937 rng(static_cast<std::mt19937::result_type>(juce::Random::getSystemRandom().nextInt()));
-    std::shuffle(slots.begin(), slots.begin() + length, rng);
+    std::shuffle(slots.begin(), slots.begin() + length, random);
     resetReadHeads();
 }
 
@@ -634,8 +723,8 @@ int PolyArpeggiatorMachine::advancePlayHead(ReadHead& head)
 
     if (head.playMode == PlayMode::random)
     {
-        head.playHead = juce::Random::getSystemRandom().nextInt(juce::jmax(1, length));
-        head.currentOctaveIndex = juce::Random::getSystemRandom().nextInt(juce::jmax(1, head.octaveSpan));
+        head.playHead = random.nextInt(juce::jmax(1, length));
+        head.currentOctaveIndex = random.nextInt(juce::jmax(1, head.octaveSpan));
         return head.playHead;
     }
 
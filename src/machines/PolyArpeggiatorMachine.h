@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "ClockAbs.h"
+#include "FastRandom.h"
 #include "MachineInterface.h"
 
 class PolyArpeggiatorMachine final : public MachineInterface, public ClockListener
@@ -44,14 +45,18 @@ public:
     void removeEntry(int entryIndex) override;
     /** Clears active playback state across all heads. */
     void allNotesOff() override;
-    /** Receives the global quarter-beat clock. */
-    void tick(int quarterBeat) override;
+    /** Receives every engine tick of the global clock. */
+    void tick(const ClockTick& clockTick) override;
     /** Resets read heads to the start of the bar. */
     void reset() override;
+    /** Places every read head where the sent number of engine ticks after a reset would leave it. */
+    void seek(std::uint64_t engineTicksSinceReset, int ticksPerGridTick) override;
     /** Sets the callback used to emit clocked arp notes. */
     void setClockEventCallback(std::function<void(const MachineNoteEvent&)> callback);
     /** Enables or disables note emission on clock ticks. */
     void setClockActive(bool shouldBeActive);
+    /** Sets the seed that random heads and shuffles restart from on clock reset. */
+    void setRandomSeed(std::uint32_t seed);
     bool shiftNoteAtCell(int row, int col, int semitones) override;
     bool clearCell(int row, int col) override;
 
@@ -87,7 +92,7 @@ private:
         PlayMode playMode = PlayMode::pingPong;
         /** Number of octaves cycled during playback for this head. */
         int octaveSpan = 1;
-        /** Number of received clock ticks since this head last emitted a step. */
+        /** Number of received engine ticks since this head last emitted a step. */
         int ticksSinceStep = 0;
         /** Current octave layer used during playback for this head. */
         int currentOctaveIndex = 0;
@@ -118,11 +123,19 @@ private:
     std::function<void(const MachineNoteEvent&)> clockEventCallback;
     /** True when clock ticks should emit notes. */
     bool clockActive = false;
+    /** Engine ticks per grid tick as the clock last sent them. */
+    int clockTicksPerGridTick = 1;
+    /** Seeded generator for random heads and shuffles; reseeded on clock reset. */
+    FastRandom random;
     /** Protects poly-arp state shared between UI and audio threads. */
     mutable std::mutex stateMutex;
 
     /** Clamps all editable state into valid ranges. */
     void clampState();
+    /** Engine ticks between a read head's steps at its divisor and the current resolution. */
+    int getStepTicks(const ReadHead& head) const;
+    /** Rescales the heads' step counters when the clock resolution has changed since the last tick. */
+    void followTicksPerGridTick(int ticksPerGridTick);
     /** Resets playback state for all read heads. */
     void resetReadHeads();
     /** Counts how many note slots currently contain a note. */
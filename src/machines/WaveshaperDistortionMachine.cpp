@@ -4,6 +4,10 @@
 namespace
 {
 constexpr double kDistortionStateVersion = 1.0;
+constexpr int kDriveParameter = 0;
+constexpr int kToneParameter = 1;
+constexpr int kMixParameter = 2;
+constexpr int kOutputParameter = 3;
 }
 
 void WaveshaperDistortionMachine::prepareToPlay(double sampleRate, int samplesPerBlock)
@@ -58,10 +62,10 @@ std::vector<std::vector<UIBox>> WaveshaperDistortionMachine::getUIBoxes(const Ma
 
 void WaveshaperDistortionMachine::processAudioBuffer(juce::AudioBuffer<float>& buffer)
 {
-    const float driveValue = drive.load(std::memory_order_relaxed);
-    const float toneValue = tone.load(std::memory_order_relaxed);
-    const float mixValue = mix.load(std::memory_order_relaxed);
-    const float outputValue = output.load(std::memory_order_relaxed);
+    const float driveValue = parameterLocks.apply(kDriveParameter, drive.load(std::memory_order_relaxed), kMinDrive, kMaxDrive);
+    const float toneValue = parameterLocks.apply(kToneParameter, tone.load(std::memory_order_relaxed), 0.0f, 1.0f);
+    const float mixValue = parameterLocks.apply(kMixParameter, mix.load(std::memory_order_relaxed), 0.0f, 1.0f);
+    const float outputValue = parameterLocks.apply(kOutputParameter, output.load(std::memory_order_relaxed), 0.0f, 2.0f);
     const float sampleRateValue = static_cast<float>(currentSampleRate.load(std::memory_order_relaxed));
 
     const float toneHz = juce::jmap(toneValue, 500.0f, 12000.0f);
@@ -128,6 +132,33 @@ void WaveshaperDistortionMachine::setStateInformation(const void* data, int size
     resetToneState();
 }
 
+int WaveshaperDistortionMachine::getLockableParameterCount() const
+{
+    return parameterLocks.size();
+}
+
+const char* WaveshaperDistortionMachine::getLockableParameterName(int parameterId) const
+{
+    switch (parameterId)
+    {
+        case kDriveParameter: return "DRV";
+        case kToneParameter: return "TONE";
+        case kMixParameter: return "MIX";
+        case kOutputParameter: return "OUT";
+        default: return "";
+    }
+}
+
+void WaveshaperDistortionMachine::setParameterLock(int parameterId, float normalisedValue)
+{
+    parameterLocks.set(parameterId, normalisedValue);
+}
+
+void WaveshaperDistortionMachine::clearParameterLock(int parameterId)
+{
+    parameterLocks.clear(parameterId);
+}
+
 std::string WaveshaperDistortionMachine::formatFloat(float value, int decimals)
 {
     return juce::String(value, decimals).toStdString();
@@ -8,6 +8,7 @@
 #include <JuceHeader.h>
 
 #include "AudioEffectMachine.h"
+#include "ParameterLockSet.h"
 
 class WaveshaperDistortionMachine final : public AudioEffectMachine
 {
@@ -27,6 +28,11 @@ public:
     void getStateInformation(juce::MemoryBlock& destData) override;
     /** Restores the current distortion settings. */
     void setStateInformation(const void* data, int sizeInBytes) override;
+    /** Drive, tone, mix and output can be locked from sequencer steps. */
+    int getLockableParameterCount() const override;
+    const char* getLockableParameterName(int parameterId) const override;
+    void setParameterLock(int parameterId, float normalisedValue) override;
+    void clearParameterLock(int parameterId) override;
 
 private:
     /** Minimum allowed drive multiplier. */
@@ -44,6 +50,8 @@ private:
     std::atomic<float> mix { 1.0f };
     /** Final output gain after shaping. */
     std::atomic<float> output { 0.8f };
+    /** Step locks over drive, tone, mix and output, in that order. */
+    ParameterLockSet<4> parameterLocks;
     /** Per-channel filter state for the tone stage. */
     std::array<float, 2> toneState {};
 
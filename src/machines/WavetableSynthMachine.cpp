@@ -8,6 +8,10 @@ constexpr double kStateVersion = 1.0;
 constexpr float kMaxAttackSeconds = 2.0f;
 constexpr float kMaxDecaySeconds = 2.0f;
 constexpr float kMaxReleaseSeconds = 3.0f;
+constexpr int kAttackParameter = 0;
+constexpr int kDecayParameter = 1;
+constexpr int kSustainParameter = 2;
+constexpr int kReleaseParameter = 3;
 }
 
 WavetableSynthMachine::WavetableSynthMachine()
@@ -39,6 +43,9 @@ void WavetableSynthMachine::processBlock(juce::AudioBuffer<float>& buffer, juce:
     if (numSamples <= 0 || numChannels <= 0)
         return;
 
+    if (envelopeLocksChanged.exchange(false, std::memory_order_acq_rel))
+        updateVoiceEnvelopeParameters();
+
     for (int sample = 0; sample < numSamples; ++sample)
     {
         float outputSample = 0.0f;
@@ -178,7 +185,7 @@ bool WavetableSynthMachine::handleIncomingNote(unsigned short note,
     voice.phaseDelta = juce::MidiMessage::getMidiNoteInHertz(static_cast<int>(note)) / currentSampleRate;
     voice.ageSamples = 0;
     voice.noteDurationSamples = juce::jmax(1, static_cast<int>(std::lround(currentSampleRate
-        * currentSecondsPerTick
+        * currentSecondsPerTick.load(std::memory_order_relaxed)
         * static_cast<double>(juce::jmax(1, static_cast<int>(durationTicks))))));
     voice.samplesUntilRelease = voice.noteDurationSamples;
     voice.releaseStarted = false;
@@ -190,9 +197,8 @@ bool WavetableSynthMachine::handleIncomingNote(unsigned short note,
 
 void WavetableSynthMachine::setSecondsPerTick(double secondsPerTick)
 {
-    const std::lock_guard<std::mutex> lock(stateMutex);
     if (secondsPerTick > 0.0)
-        currentSecondsPerTick = secondsPerTick;
+        currentSecondsPerTick.store(secondsPerTick, std::memory_order_relaxed);
 }
 
 void WavetableSynthMachine::allNotesOff()
@@ -275,6 +281,35 @@ void WavetableSynthMachine::setStateInformation(const void* data, int sizeInByte
     updateVoiceEnvelopeParameters();
 }
 
+int WavetableSynthMachine::getLockableParameterCount() const
+{
+    return envelopeLocks.size();
+}
+
+const char* WavetableSynthMachine::getLockableParameterName(int parameterId) const
+{
+    switch (parameterId)
+    {
+        case kAttackParameter: return "A";
+        case kDecayParameter: return "D";
+        case kSustainParameter: return "S";
+        case kReleaseParameter: return "R";
+        default: return "";
+    }
+}
+
+void WavetableSynthMachine::setParameterLock(int parameterId, float normalisedValue)
+{
+    envelopeLocks.set(parameterId, normalisedValue);
+    envelopeLocksChanged.store(true, std::memory_order_release);
+}
+
+void WavetableSynthMachine::clearParameterLock(int parameterId)
+{
+    envelopeLocks.clear(parameterId);
+    envelopeLocksChanged.store(true, std::memory_order_release);
+}
+
 void WavetableSynthMachine::initialiseTables()
 {
     for (int i = 0; i < kTableSize; ++i)
@@ -290,10 +325,10 @@ void WavetableSynthMachine::initialiseTables()
 void WavetableSynthMachine::updateVoiceEnvelopeParameters()
 {
     juce::ADSR::Parameters parameters;
-    parameters.attack = attackSeconds;
-    parameters.decay = decaySeconds;
-    parameters.sustain = sustainLevel;
-    parameters.release = releaseSeconds;
+    parameters.attack = envelopeLocks.apply(kAttackParameter, attackSeconds, 0.0f, kMaxAttackSeconds);
+    parameters.decay = envelopeLocks.apply(kDecayParameter, decaySeconds, 0.0f, kMaxDecaySeconds);
+    parameters.sustain = envelopeLocks.apply(kSustainParameter, sustainLevel, 0.0f, 1.0f);
+    parameters.release = envelopeLocks.apply(kReleaseParameter, releaseSeconds, 0.0f, kMaxReleaseSeconds);
 
     for (auto& voice : voices)
     {
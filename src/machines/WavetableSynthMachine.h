@@ -1,12 +1,14 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <mutex>
 #include <vector>
 
 #include <JuceHeader.h>
 
 #include "MachineInterface.h"
+#include "ParameterLockSet.h"
 
 class WavetableSynthMachine final : public MachineInterface
 {
@@ -35,6 +37,11 @@ public:
     void getStateInformation(juce::MemoryBlock& destData) override;
     /** Restores the synth state. */
     void setStateInformation(const void* data, int sizeInBytes) override;
+    /** The ADSR stages can be locked from sequencer steps. */
+    int getLockableParameterCount() const override;
+    const char* getLockableParameterName(int parameterId) const override;
+    void setParameterLock(int parameterId, float normalisedValue) override;
+    void clearParameterLock(int parameterId) override;
 
 private:
     /** Available base waveforms for wavetable morphing. */
@@ -96,8 +103,9 @@ private:
 
     /** Current sample rate used by the synth. */
     double currentSampleRate = 44100.0;
-    /** Current tracker tick duration used for note lengths. */
-    double currentSecondsPerTick = 60.0 / (120.0 * 8.0);
+    /** Current tracker tick duration used for note lengths.
+        Kept outside stateMutex so tempo changes never wait on the editor. */
+    std::atomic<double> currentSecondsPerTick { 60.0 / (120.0 * 8.0) };
     /** Round-robin voice allocation cursor. */
     int nextVoiceIndex = 0;
     /** Number of active wavetable steps. */
@@ -111,6 +119,10 @@ private:
     float sustainLevel = 0.65f;
     /** ADSR release time in seconds. */
     float releaseSeconds = 0.2f;
+    /** Step locks over attack, decay, sustain and release, in that order. */
+    ParameterLockSet<4> envelopeLocks;
+    /** Set when a lock changes, so the next render pushes the envelope to the voices under stateMutex. */
+    std::atomic<bool> envelopeLocksChanged { false };
 
     /** Fills the static waveform lookup tables. */
     void initialiseTables();
@@ -14,6 +14,22 @@ bool shouldAutoStartSongPlayback()
     return juce::SystemStats::getEnvironmentVariable("MYK_TRACKER_AUTOPLAY", {}) == "1";
 }
 
+/** MYK_TRACKER_PROJECT names a project file to open at launch and then autosave to,
+ * every MYK_TRACKER_AUTOSAVE_SECONDS seconds (30 by default, 0 turns autosave off) */
+void openProjectFromEnvironment(juce::AudioProcessor* processor)
+{
+    const auto projectPath = juce::SystemStats::getEnvironmentVariable("MYK_TRACKER_PROJECT", {});
+    auto* trackerProcessor = dynamic_cast<TrackerMainProcessor*>(processor);
+    if (projectPath.isEmpty() || trackerProcessor == nullptr)
+        return;
+
+    auto* controller = trackerProcessor->getTrackerController();
+    if (juce::File::getCurrentWorkingDirectory().getChildFile(projectPath).existsAsFile())
+        controller->loadTrack(projectPath.toStdString());
+    const int autosaveSeconds = juce::SystemStats::getEnvironmentVariable("MYK_TRACKER_AUTOSAVE_SECONDS", "30").getIntValue();
+    controller->setAutosave(projectPath.toStdString(), autosaveSeconds);
+}
+
 void initialiseIoBuffers(juce::Span<const float* const> ins,
                          juce::Span<float* const> outs,
                          int numSamples,
@@ -597,6 +613,7 @@ StandalonePluginHolder::StandalonePluginHolder(juce::PropertySet* settingsToUse,
 
     setupAudioDevices(preferredDefaultDeviceName, options.get());
     reloadPluginState();
+    openProjectFromEnvironment(processor.get());
     startPlaying();
 }
 